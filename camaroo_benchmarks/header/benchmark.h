@@ -0,0 +1,42 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <string>
+
+namespace camaroo_bench {
+
+    using bench_fn = void (*)();
+
+    struct options {
+        size_t max_threads; // --max-threads, defaults to the hardware thread count
+        size_t scale;       // --scale, multiplies the default problem sizes
+    };
+
+    std::map<std::string, bench_fn>& registry();
+    const options& get_options();
+
+    struct registrar {
+        registrar(const char* name, bench_fn fn) { registry()[name] = fn; }
+    };
+
+    // Best wall time over repeats runs, in milliseconds
+    inline double time_ms(const std::function<void()>& fn, int repeats = 5) {
+        double best = 0;
+        for (int i = 0; i < repeats; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            if (i == 0 || elapsed.count() < best)
+                best = elapsed.count();
+        }
+        return best;
+    }
+}
+
+#define CAMAROO_BENCHMARK(name) \
+    static void name##_benchmark(); \
+    static camaroo_bench::registrar name##_registrar(#name, name##_benchmark); \
+    static void name##_benchmark()
@@ -0,0 +1,45 @@
+#include <benchmark.h>
+#include <ast_cache.h>
+#include <hash.h>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// Startup cost of a large script, parsing the source against loading its .cmrc
+CAMAROO_BENCHMARK(ast_cache) {
+    using namespace camaroo_core;
+
+    size_t functions = size_t(2000) * camaroo_bench::get_options().scale;
+    std::string source;
+    for (size_t i = 0; i < functions; ++i) {
+        std::string n = std::to_string(i);
+        source += "func f" + n + "(num x, fnum y) -> fnum {\n"
+                  "    num total = x * " + n + " + 1;\n"
+                  "    for (num i, in (0 to x)) {\n"
+                  "        total = total + i * (x - " + n + ");\n"
+                  "    }\n"
+                  "    return y + total;\n"
+                  "}\n";
+    }
+
+    uint64_t hash = content_hash(source);
+    std::string cache_file = "ast_cache_bench.cmrc";
+    {
+        Parser parser(source);
+        ast_cache::store(cache_file, parser.parse_program(), hash);
+    }
+
+    double parse_ms = camaroo_bench::time_ms([&]() {
+        Parser parser(source);
+        parser.parse_program();
+    });
+    double load_ms = camaroo_bench::time_ms([&]() {
+        ast_cache::load(cache_file, hash);
+    });
+    std::remove(cache_file.c_str());
+
+    std::cout << source.size() / 1024 << " KiB of source\n";
+    std::cout << std::fixed << std::setprecision(2) << "parse " << parse_ms << " ms, load .cmrc " << load_ms
+              << " ms, " << parse_ms / load_ms << "x\n";
+}
@@ -0,0 +1,48 @@
+#include <benchmark.h>
+#include <channel.h>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Messages per second through one channel with 1 to max_threads senders and as many receivers
+CAMAROO_BENCHMARK(channel_throughput) {
+    using namespace camaroo_core;
+
+    size_t messages = size_t(200) * 1000 * camaroo_bench::get_options().scale;
+    auto message = make_object(TokenType::num, int64_t(1));
+
+    std::cout << messages << " messages per run\n";
+    std::cout << std::setw(10) << "capacity" << std::setw(8) << "pairs" << std::setw(12) << "ms"
+              << std::setw(16) << "messages/s" << '\n';
+
+    for (size_t capacity : {size_t(1), size_t(64), size_t(1024)}) {
+        for (size_t pairs = 1; pairs <= camaroo_bench::get_options().max_threads; ++pairs) {
+            double ms = camaroo_bench::time_ms([&]() {
+                camaroo_channel channel(TokenType::num, capacity);
+                std::vector<std::thread> threads;
+                for (size_t s = 0; s < pairs; ++s) {
+                    size_t share = messages / pairs + (s < messages % pairs);
+                    threads.emplace_back([&, share]() {
+                        for (size_t i = 0; i < share; ++i)
+                            channel.send(message);
+                    });
+                }
+                std::vector<std::thread> receivers;
+                for (size_t r = 0; r < pairs; ++r) {
+                    receivers.emplace_back([&]() {
+                        while (channel.receive()) {}
+                    });
+                }
+                for (auto& thread : threads)
+                    thread.join();
+                channel.close();
+                for (auto& thread : receivers)
+                    thread.join();
+            }, 3);
+
+            std::cout << std::setw(10) << capacity << std::setw(8) << pairs << std::fixed << std::setprecision(2)
+                      << std::setw(12) << ms << std::setw(16) << std::setprecision(0) << messages / (ms / 1000) << '\n';
+        }
+    }
+}
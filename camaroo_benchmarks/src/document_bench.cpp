@@ -0,0 +1,40 @@
+#include <benchmark.h>
+#include <document.h>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// One keystroke in the middle of a large buffer, re-parsing all of it against editing a Document
+CAMAROO_BENCHMARK(document_edit) {
+    using namespace camaroo_core;
+
+    size_t functions = size_t(2000) * camaroo_bench::get_options().scale;
+    std::string source;
+    for (size_t i = 0; i < functions; ++i) {
+        std::string n = std::to_string(i);
+        source += "func f" + n + "(num x, fnum y) -> fnum {\n"
+                  "    num total = x * " + n + " + 1;\n"
+                  "    for (num i, in (0 to x)) {\n"
+                  "        total = total + i * (x - " + n + ");\n"
+                  "    }\n"
+                  "    return y + total;\n"
+                  "}\n";
+    }
+
+    Document document(source);
+    size_t at = source.find("x * " + std::to_string(functions / 2) + " ");
+    double full_ms = camaroo_bench::time_ms([&]() {
+        Parser parser(document.get_source());
+        parser.parse_program();
+    });
+    // Typing a digit and deleting it again, two edits per repeat
+    double edit_ms = camaroo_bench::time_ms([&]() {
+        document.edit(at, 0, "7");
+        document.edit(at, 1, "");
+    }) / 2;
+
+    std::cout << functions << " functions, " << source.size() / 1024 << " KiB of source, "
+              << document.last_reparsed() << " statement(s) reparsed per edit\n";
+    std::cout << std::fixed << std::setprecision(3) << "full parse " << full_ms << " ms, edit " << edit_ms
+              << " ms, " << full_ms / edit_ms << "x\n";
+}
@@ -0,0 +1,55 @@
+#include <benchmark.h>
+#include <engine.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs per second of one short script, parsed every run against compiled once, with 1 to max_threads callers
+CAMAROO_BENCHMARK(engine_runs) {
+    using namespace camaroo_core;
+
+    size_t runs = size_t(2000) * camaroo_bench::get_options().scale;
+    std::string source =
+        "func scale(num x) -> num {\n"
+        "    return x * 3 + 1;\n"
+        "}\n"
+        "num total = 0;\n"
+        "for (num i, in (0 to 20)) {\n"
+        "    total = total + scale(i);\n"
+        "}\n"
+        "println(total);\n";
+
+    Engine engine(1);
+    std::shared_ptr<const Script> compiled = engine.compile(source);
+
+    std::cout << runs << " runs per measurement\n";
+    std::cout << std::setw(8) << "threads" << std::setw(14) << "parse runs/s" << std::setw(16) << "compiled runs/s" << '\n';
+
+    for (size_t threads = 1; threads <= camaroo_bench::get_options().max_threads; ++threads) {
+        auto measure = [&](bool parse_every_run) {
+            return camaroo_bench::time_ms([&]() {
+                std::vector<std::thread> callers;
+                for (size_t t = 0; t < threads; ++t) {
+                    size_t share = runs / threads + (t < runs % threads);
+                    callers.emplace_back([&, share]() {
+                        for (size_t i = 0; i < share; ++i) {
+                            std::ostringstream out;
+                            Context context(engine, out);
+                            engine.run(parse_every_run ? *engine.compile(source) : *compiled, context);
+                        }
+                    });
+                }
+                for (auto& caller : callers)
+                    caller.join();
+            }, 3);
+        };
+
+        double parsed_ms = measure(true);
+        double compiled_ms = measure(false);
+        std::cout << std::fixed << std::setprecision(0) << std::setw(8) << threads << std::setw(14) << runs / (parsed_ms / 1000)
+                  << std::setw(16) << runs / (compiled_ms / 1000) << '\n';
+    }
+}
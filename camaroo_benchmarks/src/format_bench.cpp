@@ -0,0 +1,45 @@
+#include <benchmark.h>
+#include <engine.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// A report printed a piece at a time, one print per value, against the same lines as interpolated text
+CAMAROO_BENCHMARK(text_formatting) {
+    using namespace camaroo_core;
+
+    size_t n = size_t(20000) * camaroo_bench::get_options().scale;
+    std::string loop = "for (num i, in (0 to " + std::to_string(n) + ")) {\n";
+    std::string pieces = "text unit = \"ms\";\n" + loop +
+                         "    print(\"row \");\n"
+                         "    print(i);\n"
+                         "    print(\": took \");\n"
+                         "    print(i % 97);\n"
+                         "    print(unit);\n"
+                         "    print(\", ok \");\n"
+                         "    println(i < 5);\n"
+                         "}\n";
+    std::string interpolated = "text unit = \"ms\";\n" + loop +
+                               "    println(\"row {i}: took {i % 97}{unit}, ok {i < 5}\");\n"
+                               "}\n";
+
+    Engine engine(1);
+    std::shared_ptr<const Script> printed = engine.compile(pieces);
+    std::shared_ptr<const Script> formatted = engine.compile(interpolated);
+    std::ostringstream printed_out, formatted_out;
+    double printed_ms = camaroo_bench::time_ms([&]() {
+        printed_out.str("");
+        Context context(engine, printed_out);
+        engine.run(*printed, context);
+    });
+    double formatted_ms = camaroo_bench::time_ms([&]() {
+        formatted_out.str("");
+        Context context(engine, formatted_out);
+        engine.run(*formatted, context);
+    });
+
+    std::cout << n << " lines, same output: " << (printed_out.str() == formatted_out.str() ? "yes" : "no") << "\n";
+    std::cout << std::fixed << std::setprecision(2) << "prints " << printed_ms << " ms, interpolated " << formatted_ms
+              << " ms, " << printed_ms / formatted_ms << "x\n";
+}
@@ -0,0 +1,51 @@
+#include <benchmark.h>
+#include <engine.h>
+#include <hoist.h>
+#include <strength.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Nested loops whose bodies keep reading globals and working out the same products, with strides over the loop
+// variables, run with arithmetic chains alone against chains with invariants and inductions taken out
+CAMAROO_BENCHMARK(loop_invariants) {
+    using namespace camaroo_core;
+
+    size_t n = size_t(100) * camaroo_bench::get_options().scale;
+    std::string source =
+        "num width = 640;\n"
+        "num height = 480;\n"
+        "num stride = 7;\n"
+        "num total = 0;\n"
+        "for (num y, in (0 to " + std::to_string(n) + ")) {\n"
+        "    for (num x, in (0 to 200)) {\n"
+        "        total = total + (width * height + stride) % 1000 + x * stride + (y * 4 + 1) + width * stride;\n"
+        "        total = total + (x * 8 + 3) - height;\n"
+        "    }\n"
+        "}\n"
+        "println(total);\n";
+
+    Program plain = Parser(source).parse_program();
+    Program hoisted = Parser(source).parse_program();
+    reduce_strength(plain.statements);
+    reduce_strength(hoisted.statements);
+    size_t moved = hoist_invariants(hoisted.statements);
+
+    thread_pool pool(1);
+    std::ostringstream plain_out, hoisted_out, err;
+    output_stream plain_output(plain_out, err), hoisted_output(hoisted_out, err);
+    double plain_ms = camaroo_bench::time_ms([&]() {
+        evaluator state(pool, plain_output);
+        state.evaluate_program(plain);
+    });
+    double hoisted_ms = camaroo_bench::time_ms([&]() {
+        evaluator state(pool, hoisted_output);
+        state.evaluate_program(hoisted);
+    });
+
+    std::cout << n * 200 << " inner iterations, " << moved << " expressions taken out of loops, same output: "
+              << (plain_out.str() == hoisted_out.str() ? "yes" : "no") << "\n";
+    std::cout << std::fixed << std::setprecision(2) << "run in place " << plain_ms << " ms, hoisted " << hoisted_ms
+              << " ms, " << plain_ms / hoisted_ms << "x\n";
+}
@@ -0,0 +1,45 @@
+#include <benchmark.h>
+#include <engine.h>
+#include <inliner.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// A loop calling a tiny wrapper func on every iteration, run as calls against the same loop with the body inlined
+CAMAROO_BENCHMARK(function_inlining) {
+    using namespace camaroo_core;
+
+    size_t n = size_t(20000) * camaroo_bench::get_options().scale;
+    std::string source =
+        "func calc(num a, num b) -> num {\n"
+        "    num sum = a + b;\n"
+        "    return sum * 3 - a;\n"
+        "}\n"
+        "num total = 0;\n"
+        "for (num i, in (0 to " + std::to_string(n) + ")) {\n"
+        "    total = total + calc(i, 7) % 1000;\n"
+        "}\n"
+        "println(total);\n";
+
+    Program called = Parser(source).parse_program();
+    Program inlined = Parser(source).parse_program();
+    size_t replaced = inline_calls(inlined.statements);
+
+    thread_pool pool(1);
+    std::ostringstream called_out, inlined_out, err;
+    output_stream called_output(called_out, err), inlined_output(inlined_out, err);
+    double called_ms = camaroo_bench::time_ms([&]() {
+        evaluator state(pool, called_output);
+        state.evaluate_program(called);
+    });
+    double inlined_ms = camaroo_bench::time_ms([&]() {
+        evaluator state(pool, inlined_output);
+        state.evaluate_program(inlined);
+    });
+
+    std::cout << n << " calls, " << replaced << " call sites inlined, same output: "
+              << (called_out.str() == inlined_out.str() ? "yes" : "no") << "\n";
+    std::cout << std::fixed << std::setprecision(2) << "called " << called_ms << " ms, inlined " << inlined_ms
+              << " ms, " << called_ms / inlined_ms << "x\n";
+}
@@ -0,0 +1,47 @@
+#include <benchmark.h>
+#include <engine.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Startup of a large library where the script only calls one function, parsing every body against
+// brace matching them and parsing the one that runs
+CAMAROO_BENCHMARK(lazy_parse) {
+    using namespace camaroo_core;
+
+    size_t functions = size_t(2000) * camaroo_bench::get_options().scale;
+    std::string source;
+    for (size_t i = 0; i < functions; ++i) {
+        std::string n = std::to_string(i);
+        source += "func f" + n + "(num x, fnum y) -> fnum {\n"
+                  "    num total = x * " + n + " + 1;\n"
+                  "    for (num i, in (0 to x)) {\n"
+                  "        total = total + i * (x - " + n + ");\n"
+                  "    }\n"
+                  "    return y + total;\n"
+                  "}\n";
+    }
+    source += "println(f0(10, 0.5));\n";
+
+    double eager_ms = camaroo_bench::time_ms([&]() {
+        Parser parser(source);
+        parser.parse_program();
+    });
+    double lazy_ms = camaroo_bench::time_ms([&]() {
+        Parser parser(source, true);
+        parser.parse_program();
+    });
+
+    Engine engine(1);
+    std::ostringstream out, err;
+    double run_ms = camaroo_bench::time_ms([&]() {
+        Context context(engine, out, err);
+        engine.run(*engine.compile(source), context);
+    });
+
+    std::cout << functions << " functions, " << source.size() / 1024 << " KiB of source\n";
+    std::cout << std::fixed << std::setprecision(2) << "parse all bodies " << eager_ms << " ms, skip bodies "
+              << lazy_ms << " ms, " << eager_ms / lazy_ms << "x\n";
+    std::cout << "compile and run calling one function " << run_ms << " ms\n";
+}
@@ -0,0 +1,51 @@
+#include <benchmark.h>
+#include <list.h>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Counting spaces a character at a time, each one a one-character text compared on its own, against the same
+// characters as a byte-packed list of letters compared as a whole
+CAMAROO_BENCHMARK(letter_processing) {
+    using namespace camaroo_core;
+
+    size_t n = size_t(200000) * camaroo_bench::get_options().scale;
+    std::string source;
+    for (size_t i = 0; source.size() < n; ++i)
+        source += "word" + std::to_string(i % 1000) + (i % 7 ? " " : ".\n");
+    camaroo_text text(source);
+
+    size_t text_spaces = 0;
+    size_t text_bytes = 0;
+    double texts_ms = camaroo_bench::time_ms([&]() {
+        std::vector<std::shared_ptr<camaroo_object>> characters;
+        characters.reserve(text.size());
+        for (size_t i = 0; i < text.size(); ++i)
+            characters.push_back(make_object(TokenType::text, text.slice(i, 1)));
+        const camaroo_text space(" ");
+        text_spaces = 0;
+        for (const auto& character : characters)
+            text_spaces += std::get<camaroo_text>(character->variable_value) == space;
+        text_bytes = characters.size() * (sizeof(camaroo_object) + sizeof(std::shared_ptr<camaroo_object>));
+    }, 3);
+
+    thread_pool pool(1);
+    size_t letter_spaces = 0;
+    size_t letter_bytes = 0;
+    double letters_ms = camaroo_bench::time_ms([&]() {
+        std::string_view whole = text.view();
+        std::vector<uint8_t> bytes(whole.begin(), whole.end());
+        letter_bytes = bytes.size();
+        camaroo_object letters{TokenType::list, std::make_shared<camaroo_list>(camaroo_list{TokenType::letter, std::move(bytes)})};
+        std::shared_ptr<camaroo_object> spaces = list_compare(pool, simd::compare_op::equal, letters,
+                                                              camaroo_object{TokenType::letter, U' '});
+        std::shared_ptr<camaroo_object> total = list_sum(pool, *std::get<std::shared_ptr<camaroo_list>>(spaces->variable_value));
+        letter_spaces = static_cast<size_t>(std::get<int64_t>(total->variable_value));
+    }, 3);
+
+    std::cout << text.size() << " characters, same count: " << (text_spaces == letter_spaces ? "yes" : "no") << ", "
+              << text_bytes / text.size() << " bytes each as texts, " << letter_bytes / text.size() << " as letters\n";
+    std::cout << std::fixed << std::setprecision(2) << "texts " << texts_ms << " ms, letters " << letters_ms
+              << " ms, " << texts_ms / letters_ms << "x\n";
+}
@@ -0,0 +1,45 @@
+#include <benchmark.h>
+#include <list.h>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+// Times the parallel list built-ins on one big list with 1 to max_threads threads
+CAMAROO_BENCHMARK(list_scaling) {
+    using namespace camaroo_core;
+
+    size_t n = size_t(8) * 1000 * 1000 * camaroo_bench::get_options().scale;
+    std::mt19937_64 rng(1);
+    std::uniform_int_distribution<int64_t> dist(-1000000, 1000000);
+    std::vector<int64_t> values(n);
+    for (auto& value : values)
+        value = dist(rng);
+
+    auto xs = make_object(TokenType::list, std::make_shared<camaroo_list>(camaroo_list{TokenType::num, std::move(values)}));
+    const camaroo_list& list = *std::get<std::shared_ptr<camaroo_list>>(xs->variable_value);
+    auto two = make_object(TokenType::num, int64_t(2));
+    auto zero = make_object(TokenType::num, int64_t(0));
+
+    std::cout << n << " num elements, " << simd::active_kernels() << " kernels\n";
+    std::cout << std::setw(8) << "threads" << std::setw(12) << "sum ms" << std::setw(12) << "map ms"
+              << std::setw(12) << "filter ms" << std::setw(12) << "sort ms" << std::setw(12) << "speedup" << '\n';
+
+    double baseline = 0;
+    for (size_t threads = 1; threads <= camaroo_bench::get_options().max_threads; ++threads) {
+        thread_pool pool(threads);
+        double sum_ms = camaroo_bench::time_ms([&]() { list_sum(pool, list); });
+        double map_ms = camaroo_bench::time_ms([&]() { list_arith(pool, simd::arith_op::multiply, *xs, *two); });
+        double filter_ms = camaroo_bench::time_ms([&]() {
+            auto mask = list_compare(pool, simd::compare_op::greater, *xs, *zero);
+            list_filter(pool, list, *std::get<std::shared_ptr<camaroo_list>>(mask->variable_value));
+        });
+        double sort_ms = camaroo_bench::time_ms([&]() { list_sort(pool, list); }, 2);
+
+        double total = sum_ms + map_ms + filter_ms + sort_ms;
+        if (threads == 1)
+            baseline = total;
+        std::cout << std::fixed << std::setprecision(2) << std::setw(8) << threads << std::setw(12) << sum_ms
+                  << std::setw(12) << map_ms << std::setw(12) << filter_ms << std::setw(12) << sort_ms
+                  << std::setw(11) << baseline / total << "x\n";
+    }
+}
@@ -0,0 +1,54 @@
+#include <benchmark.h>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace camaroo_bench {
+
+    std::map<std::string, bench_fn>& registry() {
+        static std::map<std::string, bench_fn> benchmarks;
+        return benchmarks;
+    }
+
+    options& mutable_options() {
+        static options current = {std::max<size_t>(1, std::thread::hardware_concurrency()), 1};
+        return current;
+    }
+
+    const options& get_options() {
+        return mutable_options();
+    }
+}
+
+// bench-<system>-<arch> [--max-threads N] [--scale N] [benchmark names...], runs everything when no name is given
+int main(int argc, char** argv) {
+    std::vector<std::string> selected;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if ((arg == "--max-threads" || arg == "--scale") && i + 1 < argc) {
+            size_t value = std::max<size_t>(1, std::stoul(argv[++i]));
+            if (arg == "--max-threads")
+                camaroo_bench::mutable_options().max_threads = value;
+            else
+                camaroo_bench::mutable_options().scale = value;
+            continue;
+        }
+        if (arg == "--list") {
+            for (const auto& [name, fn] : camaroo_bench::registry())
+                std::cout << name << '\n';
+            return 0;
+        }
+        selected.push_back(arg);
+    }
+
+    for (const auto& [name, fn] : camaroo_bench::registry()) {
+        if (!selected.empty() && std::find(selected.begin(), selected.end(), name) == selected.end())
+            continue;
+        std::cout << "== " << name << '\n';
+        fn();
+        std::cout << '\n';
+    }
+    return 0;
+}
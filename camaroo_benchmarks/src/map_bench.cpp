@@ -0,0 +1,73 @@
+#include <benchmark.h>
+#include <map.h>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Putting keys in and looking them up, half of the lookups missing, in camaroo_map against std::unordered_map.
+// num keys are spread out the way ids are, text keys are counted over rows that repeat them like a group-by does
+CAMAROO_BENCHMARK(map_throughput) {
+    using namespace camaroo_core;
+
+    size_t n = size_t(200000) * camaroo_bench::get_options().scale;
+    std::vector<int64_t> ids(n);
+    for (size_t i = 0; i < n; ++i)
+        ids[i] = static_cast<int64_t>(i * 2654435761u % (4 * n));
+    // Looked up in an order unrelated to the one they went in
+    std::vector<int64_t> lookups(ids);
+    std::mt19937_64 random(11);
+    std::shuffle(lookups.begin(), lookups.end(), random);
+
+    int64_t std_found = 0, map_found = 0;
+    double std_num_ms = camaroo_bench::time_ms([&]() {
+        std::unordered_map<int64_t, int64_t> table;
+        for (size_t i = 0; i < n; ++i)
+            table[ids[i]] = static_cast<int64_t>(i);
+        std_found = 0;
+        for (size_t i = 0; i < n; ++i) {
+            auto hit = table.find(lookups[i]);
+            auto miss = table.find(lookups[i] + 1);
+            std_found += (hit != table.end() ? hit->second : 0) + (miss != table.end() ? 1 : 0);
+        }
+    }, 3);
+    double map_num_ms = camaroo_bench::time_ms([&]() {
+        camaroo_map table(TokenType::num, TokenType::num);
+        for (size_t i = 0; i < n; ++i)
+            table.insert(ids[i], int64_t(0)) = static_cast<int64_t>(i);
+        map_found = 0;
+        for (size_t i = 0; i < n; ++i) {
+            Value* hit = table.find(lookups[i]);
+            Value* miss = table.find(lookups[i] + 1);
+            map_found += (hit ? std::get<int64_t>(*hit) : 0) + (miss ? 1 : 0);
+        }
+    }, 3);
+
+    std::vector<std::string> rows(n);
+    for (size_t i = 0; i < n; ++i)
+        rows[i] = "customer-" + std::to_string(i * 7919 % (n / 8 + 1));
+
+    int64_t std_counted = 0, map_counted = 0;
+    double std_text_ms = camaroo_bench::time_ms([&]() {
+        std::unordered_map<std::string, int64_t> counts;
+        for (const std::string& row : rows)
+            ++counts[row];
+        std_counted = static_cast<int64_t>(counts.size()) * 1000000 + counts[rows[n / 2]];
+    }, 3);
+    double map_text_ms = camaroo_bench::time_ms([&]() {
+        camaroo_map counts(TokenType::text, TokenType::num);
+        for (const std::string& row : rows)
+            ++std::get<int64_t>(counts.insert(row, int64_t(0)));
+        map_counted = static_cast<int64_t>(counts.size()) * 1000000 + std::get<int64_t>(*counts.find(rows[n / 2]));
+    }, 3);
+
+    std::cout << n << " num keys and " << n << " text rows, same results: "
+              << (std_found == map_found && std_counted == map_counted ? "yes" : "no") << "\n";
+    std::cout << std::fixed << std::setprecision(2) << "num keys: unordered_map " << std_num_ms << " ms, map " << map_num_ms
+              << " ms, " << std_num_ms / map_num_ms << "x\n";
+    std::cout << "text counts: unordered_map " << std_text_ms << " ms, map " << map_text_ms << " ms, "
+              << std_text_ms / map_text_ms << "x\n";
+}
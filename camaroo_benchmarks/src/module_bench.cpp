@@ -0,0 +1,57 @@
+#include <benchmark.h>
+#include <module.h>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// Startup of a program split over many modules: parsing with 1 to max_threads threads, then through warm .cmrc files
+CAMAROO_BENCHMARK(module_load) {
+    using namespace camaroo_core;
+
+    size_t module_count = size_t(200) * camaroo_bench::get_options().scale;
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "camaroo_module_bench";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    std::string root;
+    for (size_t m = 0; m < module_count; ++m) {
+        std::ofstream module(directory / ("m" + std::to_string(m) + ".cmr"));
+        for (size_t f = 0; f < 20; ++f) {
+            std::string name = "m" + std::to_string(m) + "f" + std::to_string(f);
+            module << "func " << name << "(num x) -> num {\n"
+                   << "    num total = x;\n"
+                   << "    for (num i, in (0 to x)) {\n"
+                   << "        total = total + i * " << f << ";\n"
+                   << "    }\n"
+                   << "    return total;\n"
+                   << "}\n";
+        }
+        root += "use m" + std::to_string(m) + ";\n";
+    }
+    std::string root_path = (directory / "main.cmr").string();
+
+    std::cout << module_count << " modules\n";
+    std::cout << std::setw(8) << "threads" << std::setw(12) << "parse ms" << std::setw(12) << ".cmrc ms" << '\n';
+    for (size_t threads = 1; threads <= camaroo_bench::get_options().max_threads; ++threads) {
+        thread_pool pool(threads);
+        if (!modules::link(root, root_path, pool).has_compiled) {
+            std::cout << "generated modules don't compile\n";
+            break;
+        }
+        double parse_ms = camaroo_bench::time_ms([&]() {
+            modules::link(root, root_path, pool);
+        }, 3);
+
+        ast_cache::settings cache{true, ""};
+        modules::link(root, root_path, pool, cache);
+        double cached_ms = camaroo_bench::time_ms([&]() {
+            modules::link(root, root_path, pool, cache);
+        }, 3);
+
+        std::cout << std::fixed << std::setprecision(2) << std::setw(8) << threads << std::setw(12) << parse_ms
+                  << std::setw(12) << cached_ms << '\n';
+    }
+    std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,41 @@
+#include <benchmark.h>
+#include <evaluator.h>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// Runs a parallel for whose iterations do uneven amounts of work with 1 to max_threads threads
+CAMAROO_BENCHMARK(parallel_for) {
+    using namespace camaroo_core;
+
+    size_t n = size_t(4000) * camaroo_bench::get_options().scale;
+    std::string source =
+        "num total = 0;\n"
+        "parallel for (num64 i, in (0 to " + std::to_string(n) + "), reduce + total) {\n"
+        "    num acc = 0;\n"
+        "    for (num j, in (0 to i / 100)) {\n"
+        "        acc = acc + j * i;\n"
+        "    }\n"
+        "    total = total + acc;\n"
+        "}\n";
+
+    Parser parser(source);
+    Program program = parser.parse_program();
+
+    std::cout << n << " iterations with triangular cost\n";
+    std::cout << std::setw(8) << "threads" << std::setw(12) << "ms" << std::setw(12) << "speedup" << '\n';
+
+    double baseline = 0;
+    for (size_t threads = 1; threads <= camaroo_bench::get_options().max_threads; ++threads) {
+        thread_pool pool(threads);
+        double ms = camaroo_bench::time_ms([&]() {
+            evaluator context(pool);
+            context.evaluate_program(program);
+        }, 3);
+
+        if (threads == 1)
+            baseline = ms;
+        std::cout << std::fixed << std::setprecision(2) << std::setw(8) << threads << std::setw(12) << ms
+                  << std::setw(11) << baseline / ms << "x\n";
+    }
+}
@@ -0,0 +1,34 @@
+#include <benchmark.h>
+#include <pattern.h>
+#include <iomanip>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <vector>
+
+// Filtering log lines with std::regex, which backtracks, against the lazy DFA behind regex()
+CAMAROO_BENCHMARK(regex_filtering) {
+    size_t n = size_t(5000) * camaroo_bench::get_options().scale;
+    std::vector<std::string> lines;
+    for (size_t i = 0; i < n; ++i)
+        lines.push_back("GET /items/" + std::to_string(i) + (i % 97 ? " status=200 took=3ms" : " status=503 error=timeout took=900ms"));
+    const std::string pattern = "status=5\\d\\d .*took=\\d{3,}ms$";
+
+    size_t backtracked = 0, walked = 0;
+    std::regex backtracking(pattern);
+    double backtracking_ms = camaroo_bench::time_ms([&]() {
+        backtracked = 0;
+        for (const std::string& line : lines)
+            backtracked += std::regex_search(line, backtracking) ? 1 : 0;
+    });
+    std::shared_ptr<const camaroo_core::camaroo_regex> dfa = camaroo_core::camaroo_regex::compile(pattern);
+    double dfa_ms = camaroo_bench::time_ms([&]() {
+        walked = 0;
+        for (const std::string& line : lines)
+            walked += dfa->search(line) ? 1 : 0;
+    });
+
+    std::cout << n << " lines, " << walked << " matched, same matches: " << (backtracked == walked ? "yes" : "no") << "\n";
+    std::cout << std::fixed << std::setprecision(2) << "std::regex " << backtracking_ms << " ms, dfa " << dfa_ms
+              << " ms, " << backtracking_ms / dfa_ms << "x\n";
+}
@@ -0,0 +1,40 @@
+#include <benchmark.h>
+#include <engine.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Time per REPL line as a session grows, the last lines should cost what the first ones did
+CAMAROO_BENCHMARK(repl_latency) {
+    using namespace camaroo_core;
+
+    size_t lines = size_t(20000) * camaroo_bench::get_options().scale;
+    size_t window = 1000;
+    Engine engine(1);
+    std::ostringstream out, err;
+    Repl repl(engine, out, err);
+    size_t fed = 0;
+
+    auto feed_window = [&](size_t first) {
+        return camaroo_bench::time_ms([&]() {
+            for (size_t i = first; i < first + window; ++i) {
+                std::string n = std::to_string(i);
+                repl.feed("num v" + n + " = " + n + " * 2;");
+                repl.feed("func f" + n + "(num x) -> num {");
+                repl.feed("    return x + v" + n + ";");
+                repl.feed("}");
+            }
+            fed += window * 4;
+        }, 1) / double(window * 4);
+    };
+
+    double first_ms = feed_window(0);
+    for (size_t first = window; first + window < lines; first += window)
+        feed_window(first);
+    double last_ms = feed_window(lines);
+
+    std::cout << fed << " lines fed\n";
+    std::cout << std::fixed << std::setprecision(4) << "first " << window * 4 << " lines " << first_ms
+              << " ms/line, last " << window * 4 << " lines " << last_ms << " ms/line\n";
+}
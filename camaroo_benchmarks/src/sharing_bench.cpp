@@ -0,0 +1,59 @@
+#include <benchmark.h>
+#include <engine.h>
+#include <sharing.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace {
+    size_t expression_nodes(camaroo_core::ASTNode* node) {
+        size_t total = 0;
+        node->visit_expressions([&](std::unique_ptr<camaroo_core::ExpressionNode>& child) {
+            if (child)
+                total += 1 + expression_nodes(child.get());
+        });
+        return total;
+    }
+}
+
+// Generated code that spells the same terms out again in every statement, run with every copy its own tree
+// against one copy per term, memoised where a statement repeats it
+CAMAROO_BENCHMARK(subtree_sharing) {
+    using namespace camaroo_core;
+
+    size_t statements = size_t(20000) * camaroo_bench::get_options().scale;
+    std::string source = "num x = 3;\nnum y = 5;\nnum z = 7;\n";
+    for (size_t i = 0; i < statements; ++i) {
+        std::string n = std::to_string(i % 16);
+        source += "num v" + std::to_string(i) + " = (x * y + z * " + n + ") * (x * y + z * " + n + ") - (x * y + z * " + n + ");\n";
+    }
+
+    Program plain = Parser(source).parse_program();
+    Program shared = Parser(source).parse_program();
+    size_t before = 0;
+    for (const auto& statement : shared.statements)
+        before += expression_nodes(statement.get());
+    size_t removed = share_subtrees(shared.statements);
+
+    thread_pool pool(1);
+    std::ostringstream out, err;
+    output_stream output(out, err);
+    double plain_ms = camaroo_bench::time_ms([&]() {
+        evaluator state(pool, output);
+        state.evaluate_program(plain);
+    });
+    double shared_ms = camaroo_bench::time_ms([&]() {
+        evaluator state(pool, output);
+        state.evaluate_program(shared);
+    });
+    double share_ms = camaroo_bench::time_ms([&]() {
+        Program program = Parser(source).parse_program();
+        share_subtrees(program.statements);
+    }, 3);
+
+    std::cout << statements << " statements, " << before << " expression nodes, " << before - removed << " after sharing\n";
+    std::cout << std::fixed << std::setprecision(2) << "run unshared " << plain_ms << " ms, shared " << shared_ms
+              << " ms, " << plain_ms / shared_ms << "x\n";
+    std::cout << "parse and share " << share_ms << " ms\n";
+}
@@ -0,0 +1,47 @@
+#include <benchmark.h>
+#include <engine.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// A loop driven by config constants, compiled with the values written in against the same script specialized to them
+CAMAROO_BENCHMARK(specialized_scripts) {
+    using namespace camaroo_core;
+
+    size_t n = size_t(20000) * camaroo_bench::get_options().scale;
+    auto script = [&](const std::string& width, const std::string& depth, const std::string& rate) {
+        return "num width = " + width + ";\n"
+               "num depth = " + depth + ";\n"
+               "fnum rate = " + rate + ";\n"
+               "num total = 0;\n"
+               "fnum weighted = 0.0;\n"
+               "for (num r, in (0 to " + std::to_string(n) + ")) {\n"
+               "    for (num k, in (0 to width)) {\n"
+               "        total = total + (k * depth + width) % 7;\n"
+               "    }\n"
+               "    weighted = weighted + rate * depth;\n"
+               "}\n"
+               "println(total);\n"
+               "println(weighted);\n";
+    };
+
+    Engine engine(1);
+    std::shared_ptr<const Script> generic = engine.compile(script("6", "5", "0.25"));
+    std::shared_ptr<const Script> specialized = engine.compile(script("1", "1", "1.0"),
+                                                               {{"width", "6"}, {"depth", "5"}, {"rate", "0.25"}});
+
+    std::ostringstream generic_out, specialized_out;
+    double generic_ms = camaroo_bench::time_ms([&]() {
+        Context context(engine, generic_out);
+        engine.run(*generic, context);
+    });
+    double specialized_ms = camaroo_bench::time_ms([&]() {
+        Context context(engine, specialized_out);
+        engine.run(*specialized, context);
+    });
+
+    std::cout << n << " iterations, same output: " << (generic_out.str() == specialized_out.str() ? "yes" : "no") << "\n";
+    std::cout << std::fixed << std::setprecision(2) << "generic " << generic_ms << " ms, specialized " << specialized_ms
+              << " ms, " << generic_ms / specialized_ms << "x\n";
+}
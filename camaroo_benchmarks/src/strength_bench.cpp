@@ -0,0 +1,42 @@
+#include <benchmark.h>
+#include <engine.h>
+#include <strength.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Integer arithmetic by constants in a loop, one evaluator step per operator against one planned chain per expression
+CAMAROO_BENCHMARK(strength_reduction) {
+    using namespace camaroo_core;
+
+    size_t n = size_t(50000) * camaroo_bench::get_options().scale;
+    std::string source =
+        "num total = 0;\n"
+        "for (num i, in (0 to " + std::to_string(n) + ")) {\n"
+        "    total = total + ((i * 8 + 3) * 5 - 7) / 10 % 16;\n"
+        "    total = total + (i * 3 + 1) / 7 * 2 + 100;\n"
+        "}\n"
+        "println(total);\n";
+
+    Program plain = Parser(source).parse_program();
+    Program reduced = Parser(source).parse_program();
+    size_t chains = reduce_strength(reduced.statements);
+
+    thread_pool pool(1);
+    std::ostringstream plain_out, reduced_out, err;
+    output_stream plain_output(plain_out, err), reduced_output(reduced_out, err);
+    double plain_ms = camaroo_bench::time_ms([&]() {
+        evaluator state(pool, plain_output);
+        state.evaluate_program(plain);
+    });
+    double reduced_ms = camaroo_bench::time_ms([&]() {
+        evaluator state(pool, reduced_output);
+        state.evaluate_program(reduced);
+    });
+
+    std::cout << n << " iterations, " << chains << " chains planned, same output: "
+              << (plain_out.str() == reduced_out.str() ? "yes" : "no") << "\n";
+    std::cout << std::fixed << std::setprecision(2) << "run plain " << plain_ms << " ms, reduced " << reduced_ms
+              << " ms, " << plain_ms / reduced_ms << "x\n";
+}
@@ -0,0 +1,48 @@
+#include <benchmark.h>
+#include <engine.h>
+#include <text.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// A report built a line at a time with +, copying the whole text on every join against joining camaroo_texts,
+// then the same report built by a script
+CAMAROO_BENCHMARK(text_building) {
+    using namespace camaroo_core;
+
+    size_t n = size_t(20000) * camaroo_bench::get_options().scale;
+    std::string copied;
+    double copied_ms = camaroo_bench::time_ms([&]() {
+        std::string report;
+        for (size_t i = 0; i < n; ++i)
+            report = report + "row " + std::to_string(i) + ": ok\n";
+        copied = report;
+    }, 1);
+
+    std::string joined;
+    double joined_ms = camaroo_bench::time_ms([&]() {
+        camaroo_text report;
+        for (size_t i = 0; i < n; ++i)
+            report = report + camaroo_text("row ") + camaroo_text(std::to_string(i)) + camaroo_text(": ok\n");
+        joined = report.str();
+    }, 1);
+
+    std::string source =
+        "text report = \"\";\n"
+        "for (num i, in (0 to " + std::to_string(n) + ")) {\n"
+        "    report = report + \"row: ok\\n\";\n"
+        "}\n"
+        "println(len(report));\n";
+    Engine engine(1);
+    std::shared_ptr<const Script> script = engine.compile(source);
+    std::ostringstream out;
+    double script_ms = camaroo_bench::time_ms([&]() {
+        Context context(engine, out);
+        engine.run(*script, context);
+    }, 1);
+
+    std::cout << n << " rows, same report: " << (copied == joined ? "yes" : "no") << "\n";
+    std::cout << std::fixed << std::setprecision(2) << "copied " << copied_ms << " ms, joined " << joined_ms
+              << " ms, " << copied_ms / joined_ms << "x, script " << script_ms << " ms\n";
+}
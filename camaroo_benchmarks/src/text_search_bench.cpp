@@ -0,0 +1,47 @@
+#include <benchmark.h>
+#include <simd.h>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace {
+    // Compares the whole needle at every offset, what text search looks like without a first pass over bytes
+    size_t find_naive(const char* haystack, size_t n, const char* needle, size_t m) {
+        for (size_t i = 0; i + m <= n; ++i) {
+            size_t j = 0;
+            while (j < m && haystack[i + j] == needle[j])
+                ++j;
+            if (j == m)
+                return i;
+        }
+        return n;
+    }
+}
+
+// Counting a word in log-like text one offset at a time against the vector kernels behind find, count and split
+CAMAROO_BENCHMARK(text_search) {
+    size_t n = size_t(20000) * camaroo_bench::get_options().scale;
+    std::string text;
+    for (size_t i = 0; i < n; ++i)
+        text += "GET /items/" + std::to_string(i) + (i % 97 ? " status=200 took=3ms\n" : " status=500 error timeout\n");
+    const std::string needle = "error";
+
+    auto count_with = [&](auto find) {
+        size_t found = 0;
+        for (size_t at = find(text.data(), text.size(), needle.data(), needle.size()); at < text.size();) {
+            ++found;
+            size_t from = at + needle.size();
+            at = from + find(text.data() + from, text.size() - from, needle.data(), needle.size());
+        }
+        return found;
+    };
+
+    size_t naive_count = 0, simd_count = 0;
+    double naive_ms = camaroo_bench::time_ms([&]() { naive_count = count_with(find_naive); });
+    double simd_ms = camaroo_bench::time_ms([&]() { simd_count = count_with(camaroo_core::simd::find); });
+
+    std::cout << text.size() << " bytes, " << simd_count << " found, same count: " << (naive_count == simd_count ? "yes" : "no") << "\n";
+    std::cout << std::fixed << std::setprecision(2) << "naive " << naive_ms << " ms, simd " << simd_ms
+              << " ms, " << naive_ms / simd_ms << "x\n";
+}
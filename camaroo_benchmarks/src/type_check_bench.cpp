@@ -0,0 +1,53 @@
+#include <benchmark.h>
+#include <engine.h>
+#include <type_check.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// A loop doing num and fnum arithmetic on declared variables, run as parsed against the same loop after check_types
+// marked the operators
+CAMAROO_BENCHMARK(static_types) {
+    using namespace camaroo_core;
+
+    size_t n = size_t(20000) * camaroo_bench::get_options().scale;
+    std::string source =
+        "num total = 0;\n"
+        "fnum area = 0.0;\n"
+        "fnum side = 1.5;\n"
+        "num hits = 0;\n"
+        "for (num i, in (0 to " + std::to_string(n) + ")) {\n"
+        "    total = total + i * i % 97 - i / 3;\n"
+        "    area = area + side * side / 2.0;\n"
+        "    num below = 0;\n"
+        "    for (num j, in (0 to 4)) {\n"
+        "        below = below + j * i % 5;\n"
+        "    }\n"
+        "    hits = hits + below % 2;\n"
+        "}\n"
+        "println(total);\n"
+        "println(area);\n"
+        "println(hits);\n";
+
+    Program plain = Parser(source).parse_program();
+    Program checked = Parser(source).parse_program();
+    size_t errors = check_types(checked.statements).size();
+
+    thread_pool pool(1);
+    std::ostringstream plain_out, checked_out, err;
+    output_stream plain_output(plain_out, err), checked_output(checked_out, err);
+    double plain_ms = camaroo_bench::time_ms([&]() {
+        evaluator state(pool, plain_output);
+        state.evaluate_program(plain);
+    });
+    double checked_ms = camaroo_bench::time_ms([&]() {
+        evaluator state(pool, checked_output);
+        state.evaluate_program(checked);
+    });
+
+    std::cout << n << " iterations, " << errors << " type errors, same output: "
+              << (plain_out.str() == checked_out.str() ? "yes" : "no") << "\n";
+    std::cout << std::fixed << std::setprecision(2) << "unchecked " << plain_ms << " ms, checked " << checked_ms
+              << " ms, " << plain_ms / checked_ms << "x\n";
+}
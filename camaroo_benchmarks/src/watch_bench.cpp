@@ -0,0 +1,47 @@
+#include <benchmark.h>
+#include <watch.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Turnaround after editing the last line of an expensive script, a full run against a watch session rerun
+CAMAROO_BENCHMARK(watch_rerun) {
+    using namespace camaroo_core;
+
+    std::string count = std::to_string(50000 * camaroo_bench::get_options().scale);
+    std::string source =
+        "num total = 0;\n"
+        "for (num i, in (0 to " + count + ")) {\n"
+        "    total = total + i * 3;\n"
+        "}\n"
+        "println(total);\n"
+        "println(\"edited\");\n";
+    std::string edited = source;
+    edited.replace(edited.find("edited"), 6, "edited again");
+
+    thread_pool pool(1);
+    std::ostringstream out, err;
+    double full_ms = camaroo_bench::time_ms([&]() {
+        Parser parser(source);
+        Program program = parser.parse_program();
+        output_stream output(out, err);
+        evaluator state(pool, output);
+        state.evaluate_program(program);
+    });
+
+    watch_session session(pool, out, err);
+    Parser first_parser(source);
+    Program first = first_parser.parse_program();
+    session.run(first);
+    size_t ran = 0;
+    bool flip = false;
+    double rerun_ms = camaroo_bench::time_ms([&]() {
+        Parser parser((flip = !flip) ? edited : source);
+        Program program = parser.parse_program();
+        ran = session.run(program);
+    });
+
+    std::cout << std::fixed << std::setprecision(3) << "full run " << full_ms << " ms, watch rerun " << rerun_ms
+              << " ms running " << ran << " statement(s), " << full_ms / rerun_ms << "x\n";
+}
@@ -1,19 +1,63 @@
 #pragma once
 
+#include <cstdint>
 #include <stdexcept>
+#include <text.h>
 #include <tokenizer.h>
 #include <string>
 #include <memory>
+#include <mutex>
 #include <exception>
+#include <functional>
+#include <string_view>
 #include <variant>
+#include <vector>
 
 namespace camaroo_core {
 
-    using ASTValue = std::variant<int8_t, int16_t, int32_t, int64_t, bool, float, std::string>;
+    using ASTValue = std::variant<int8_t, int16_t, int32_t, int64_t, bool, float, double, std::string>;
+
+    // Which class a node is, token_type() alone can't tell -x from a - x. Passes over the whole tree switch on it.
+    enum class NodeKind : uint8_t {
+        none = 0,
+        identifier,
+        prefix,
+        infix,
+        toggle,
+        num,
+        fnum,
+        text,
+        list,
+        channel,
+        call,
+        assign,
+        print,
+        println,
+        block,
+        for_loop,
+        spawn,
+        function,
+        return_stmnt,
+        yield_stmnt,
+        expression_stmnt,
+        use_stmnt,
+        shared,
+        arith_chain,
+        hoisted,
+        induction,
+        slot,
+        inlined,
+        format,
+        letter,
+        map,
+    };
+
+    class ExpressionNode;
 
     class ASTNode {
     public:
         virtual ~ASTNode() = default;
+        virtual NodeKind node_kind() = 0;
         virtual TokenType token_type() = 0;
         virtual ASTValue token_value() = 0;
         virtual std::string to_string() = 0;
@@ -21,6 +65,8 @@ namespace camaroo_core {
         virtual std::string get_node_type() = 0;
         virtual ASTNode* get_left() { return nullptr; }
         virtual ASTNode* get_right() { return nullptr; }
+        // Hands every expression the node owns directly to visit, which may replace it. Passes that rewrite trees use it
+        virtual void visit_expressions(const std::function<void(std::unique_ptr<ExpressionNode>&)>&) {}
     };
 
     class StatementNode : public ASTNode {
@@ -34,6 +80,7 @@ namespace camaroo_core {
     enum class ExprOrder {
         unknown = 0,
         lowest,
+        range,          // 0 to N
         equals,
         less_greater,
         sum_diff,
@@ -47,6 +94,7 @@ namespace camaroo_core {
         IdentifierNode(const Token& token)
             :identifier(token) {}
 
+        virtual NodeKind node_kind() override { return NodeKind::identifier; }
         virtual TokenType token_type() override { return identifier.type; }
         virtual ASTValue token_value() override { return identifier.value; }
 
@@ -60,11 +108,13 @@ namespace camaroo_core {
         PrefixExpr(const Token& prefix_token, std::unique_ptr<ExpressionNode> right)
             :token(prefix_token), expr(std::move(right)) {}
 
+        virtual NodeKind node_kind() override { return NodeKind::prefix; }
         virtual TokenType token_type() override { return token.type; }
         virtual ASTValue token_value() override { return token.value; }
         virtual std::string to_string() override { return token.value + " " + expr->to_string(); }
 
         virtual ASTNode* get_right() override { return expr.get(); }
+        virtual void visit_expressions(const std::function<void(std::unique_ptr<ExpressionNode>&)>& visit) override { visit(expr); }
     private:
         Token token;
         std::unique_ptr<ExpressionNode> expr;
@@ -76,6 +126,7 @@ namespace camaroo_core {
                                                 std::unique_ptr<ExpressionNode> right)
             :token(prefix_token), left_expr(std::move(left)), right_expr(std::move(right)) {}
 
+        virtual NodeKind node_kind() override { return NodeKind::infix; }
         virtual TokenType token_type() override { return token.type; }
         virtual ASTValue token_value() override { return token.value; }
         virtual std::string to_string() override {
@@ -84,10 +135,18 @@ namespace camaroo_core {
 
         virtual ASTNode* get_left() override { return left_expr.get();}
         virtual ASTNode* get_right() override { return right_expr.get(); }
+        virtual void visit_expressions(const std::function<void(std::unique_ptr<ExpressionNode>&)>& visit) override {
+            visit(left_expr);
+            visit(right_expr);
+        }
+        // num or fnum when check_types found both operands always are one, unknown when they can be anything
+        void set_operand_kind(TokenType kind) { operand_kind = kind; }
+        TokenType get_operand_kind() { return operand_kind; }
     private:
         Token token;
         std::unique_ptr<ExpressionNode> left_expr;
         std::unique_ptr<ExpressionNode> right_expr;
+        TokenType operand_kind = TokenType::unknown;
     };
 
     class ToggleExpr : public ExpressionNode {
@@ -104,8 +163,9 @@ namespace camaroo_core {
             }
         }
 
+        virtual NodeKind node_kind() override { return NodeKind::toggle; }
         virtual TokenType token_type() override { return toggle_token.type; }
-        virtual ASTValue token_value() override { return toggle_token.value; }
+        virtual ASTValue token_value() override { return literal_value; }
         virtual std::string to_string() override { return toggle_token.value; }
         bool get_literal() { return literal_value; }
     private:
@@ -124,6 +184,7 @@ namespace camaroo_core {
             literal_value = static_cast<int64_t>(val);
         }
 
+        virtual NodeKind node_kind() override { return NodeKind::num; }
         virtual TokenType token_type() override { return num_token.type; }
         virtual ASTValue token_value() override { return literal_value; }
         virtual std::string to_string() override { return num_token.value; }
@@ -137,18 +198,19 @@ namespace camaroo_core {
         FNumExpr(const Token& token)
             :num_token(token)
         {
-            float val = std::stof(token.value);
-            if (!(static_cast<float>(val) < INT64_MAX && static_cast<float>(val) > INT64_MIN))
-                throw std::runtime_error("Couldn't parse integer literal");
-            literal_value = static_cast<float>(val);
+            double val = std::stod(token.value);
+            if (!(val < INT64_MAX && val > INT64_MIN))
+                throw std::runtime_error("Couldn't parse float literal");
+            literal_value = val;
         }
 
+        virtual NodeKind node_kind() override { return NodeKind::fnum; }
         virtual TokenType token_type() override { return num_token.type; }
         virtual ASTValue token_value() override { return literal_value; }
         virtual std::string to_string() override { return num_token.value; }
     private:
         Token num_token; // No nodes
-        float literal_value;
+        double literal_value;
     };
 
     class AssignStmnt : public StatementNode {
@@ -156,12 +218,14 @@ namespace camaroo_core {
         AssignStmnt(const Token& type, std::unique_ptr<IdentifierNode> left, std::unique_ptr<ExpressionNode> right)
             :assignType(type), identifier(std::move(left)), expression(std::move(right)) {}
 
+        virtual NodeKind node_kind() override { return NodeKind::assign; }
         virtual TokenType token_type() override { return assignType.type; }
         virtual ASTValue token_value() override { return assignType.value; }
         virtual std::string to_string() override { return assignType.value + " " + identifier->to_string() + " = " + expression->to_string(); }
 
         virtual ASTNode* get_left() override { return identifier.get(); }
         virtual ASTNode* get_right() override { return expression.get(); }
+        virtual void visit_expressions(const std::function<void(std::unique_ptr<ExpressionNode>&)>& visit) override { visit(expression); }
     private:
         Token assignType; // num64, num32, num16, num8, float64, float32, toggle, letter, text, func
         std::unique_ptr<IdentifierNode> identifier; // left node
@@ -175,11 +239,13 @@ namespace camaroo_core {
 
         PrintStmnt(): expr(nullptr) {}
         
+        virtual NodeKind node_kind() override { return NodeKind::print; }
         virtual TokenType token_type() override { return TokenType::print; }
         virtual ASTValue token_value() override { return "print"; }
         virtual std::string to_string() override { return "Print: " + expr->to_string(); }
 
         virtual ASTNode* get_right() override { return expr.get(); }
+        virtual void visit_expressions(const std::function<void(std::unique_ptr<ExpressionNode>&)>& visit) override { visit(expr); }
     private:
         std::unique_ptr<ExpressionNode> expr;
     };
@@ -189,41 +255,596 @@ namespace camaroo_core {
         PrintlnStmnt(std::unique_ptr<ExpressionNode> printable)
             :expr(std::move(printable)) {}
 
+        virtual NodeKind node_kind() override { return NodeKind::println; }
         virtual TokenType token_type() override { return TokenType::println; }
         virtual ASTValue token_value() override { return "println"; }
         virtual std::string to_string() override { return "Println: " + expr->to_string(); }
 
         virtual ASTNode* get_right() override { return expr.get(); }
+        virtual void visit_expressions(const std::function<void(std::unique_ptr<ExpressionNode>&)>& visit) override { visit(expr); }
     private:
         std::unique_ptr<ExpressionNode> expr;
     };
 
     class BlockStmnt : public StatementNode {
     public:
-    BlockStmnt(Token token)
-    : token(token){}
-    
-    virtual TokenType token_type() override { return token.type; }
-    virtual ASTValue token_value() override { return token.value; }
-    virtual std::string to_string() override { return token.value; }
-    
+        BlockStmnt(const Token& token, std::vector<std::unique_ptr<StatementNode>> body, bool has_yield = false)
+            :block_token(token), statements(std::move(body)), yields(has_yield) {}
+
+        virtual NodeKind node_kind() override { return NodeKind::block; }
+        virtual TokenType token_type() override { return block_token.type; }
+        virtual ASTValue token_value() override { return block_token.value; }
+        virtual std::string to_string() override {
+            std::string result = "{ ";
+            for (const auto& statement : statements)
+                result += statement->to_string() + "; ";
+            return result + "}";
+        }
+
+        const std::vector<std::unique_ptr<StatementNode>>& get_statements() { return statements; }
+        // For passes that drop statements or put others in their place
+        std::vector<std::unique_ptr<StatementNode>>& edit_statements() { return statements; }
+        // Whether a yield is somewhere inside, only those blocks have to run as a coroutine
+        bool has_yield() { return yields; }
     private:
-        Token token;
+        Token block_token; // {
+        std::vector<std::unique_ptr<StatementNode>> statements;
+        bool yields;
+    };
+
+    // reduce + total, the loop combines the per-chunk copies of total with op once all chunks ran
+    struct ReductionClause {
+        Token op; // +, *, min, max
+        std::string variable;
+    };
+
+    class ForStmnt : public StatementNode {
+    public:
+        ForStmnt(const Token& token, const Token& type, std::unique_ptr<IdentifierNode> variable,
+                 std::unique_ptr<ExpressionNode> iterable, std::unique_ptr<BlockStmnt> body,
+                 bool parallel, std::vector<ReductionClause> reductions)
+            :for_token(token), variable_type(type), loop_variable(std::move(variable)), iterated(std::move(iterable)),
+             loop_body(std::move(body)), is_parallel_loop(parallel), reduction_clauses(std::move(reductions)) {}
+
+        virtual NodeKind node_kind() override { return NodeKind::for_loop; }
+        virtual TokenType token_type() override { return for_token.type; }
+        virtual ASTValue token_value() override { return for_token.value; }
+        virtual std::string to_string() override {
+            std::string result = (is_parallel_loop ? "parallel for (" : "for (") + variable_type.value + " " +
+                                 loop_variable->to_string() + ", in " + iterated->to_string();
+            for (const auto& clause : reduction_clauses)
+                result += ", reduce " + clause.op.value + " " + clause.variable;
+            return result + ") " + loop_body->to_string();
+        }
+
+        virtual ASTNode* get_left() override { return loop_variable.get(); }
+        virtual ASTNode* get_right() override { return loop_body.get(); }
+        const Token& get_variable_type() { return variable_type; }
+        ExpressionNode* get_iterable() { return iterated.get(); }
+        BlockStmnt* get_body() { return loop_body.get(); }
+        bool is_parallel() { return is_parallel_loop; }
+        virtual void visit_expressions(const std::function<void(std::unique_ptr<ExpressionNode>&)>& visit) override { visit(iterated); }
+        const std::vector<ReductionClause>& get_reductions() { return reduction_clauses; }
+        // How many values hoist_invariants took out of the body, the evaluator keeps room for them while the loop runs
+        void set_hoisted(uint32_t values, uint32_t inductions) { hoisted_values = values; induction_values = inductions; }
+        uint32_t hoisted_count() { return hoisted_values; }
+        uint32_t induction_count() { return induction_values; }
+    private:
+        Token for_token; // for
+        Token variable_type;
+        std::unique_ptr<IdentifierNode> loop_variable;
+        std::unique_ptr<ExpressionNode> iterated; // (a to b) or a list
+        std::unique_ptr<BlockStmnt> loop_body;
+        bool is_parallel_loop;
+        std::vector<ReductionClause> reduction_clauses;
+        uint32_t hoisted_values = 0;
+        uint32_t induction_values = 0;
+    };
+
+    class SpawnStmnt : public StatementNode {
+    public:
+        SpawnStmnt(const Token& token, std::unique_ptr<BlockStmnt> body)
+            :spawn_token(token), task_body(std::move(body)) {}
+
+        virtual NodeKind node_kind() override { return NodeKind::spawn; }
+        virtual TokenType token_type() override { return spawn_token.type; }
+        virtual ASTValue token_value() override { return spawn_token.value; }
+        virtual std::string to_string() override { return "spawn " + task_body->to_string(); }
+
+        virtual ASTNode* get_right() override { return task_body.get(); }
+        BlockStmnt* get_body() { return task_body.get(); }
+    private:
+        Token spawn_token; // spawn
+        std::unique_ptr<BlockStmnt> task_body;
+    };
+
+    struct Parameter {
+        Token type;
+        std::string name;
+    };
+
+    // A func body put in terms of slots, for calls to run without a frame of their own. Parameters take the first
+    // slots and each local the next one, in the order they're declared
+    struct InlineBody {
+        std::vector<std::unique_ptr<ExpressionNode>> locals;
+        // The type keyword each local was declared with
+        std::vector<TokenType> local_types;
+        std::unique_ptr<ExpressionNode> result;
+    };
+
+    // Shared so that functions and running generators keep their body after the program that declared them is gone,
+    // which happens after every line in the REPL
+    struct FunctionDef {
+        Token kind; // func or gen
+        std::string name;
+        std::vector<Parameter> parameters;
+        Token return_type; // for gen, the type of the values it yields
+        std::unique_ptr<BlockStmnt> body;
+        // Top level bodies in scripts are skipped over by the parser and kept as the span of source between
+        // their braces, body stays empty until the first call parses it
+        std::shared_ptr<const std::string> source;
+        size_t body_begin = 0;
+        size_t body_end = 0;
+        std::once_flag body_parsed;
+        // Set by check_types for skipped bodies, whose mistakes then turn up as errors when they're parsed
+        bool checked = false;
+        // Null until get_inline_body first runs, and after it for bodies too big or doing too much to inline
+        std::unique_ptr<InlineBody> inline_body;
+        std::once_flag inline_checked;
+
+        // Parses a skipped body the first time, safe to call from several threads. Throws the parse errors, and
+        // those of check_body when checked is set
+        BlockStmnt* get_body();
+        // Works out inline_body the first time, parsing a skipped body, safe to call from several threads. Lives
+        // with inline_calls
+        const InlineBody* get_inline_body();
+        bool is_deferred() const { return source != nullptr; }
+        std::string_view body_source() const {
+            return std::string_view(*source).substr(body_begin, body_end - body_begin);
+        }
+    };
+
+    class FuncStmnt : public StatementNode {
+    public:
+        FuncStmnt(std::shared_ptr<FunctionDef> function)
+            :definition(std::move(function)) {}
+
+        virtual NodeKind node_kind() override { return NodeKind::function; }
+        virtual TokenType token_type() override { return definition->kind.type; }
+        virtual ASTValue token_value() override { return definition->name; }
+        virtual std::string to_string() override {
+            std::string result = definition->kind.value + " " + definition->name + "(";
+            for (size_t i = 0; i < definition->parameters.size(); ++i)
+                result += (i ? ", " : "") + definition->parameters[i].type.value + " " + definition->parameters[i].name;
+            result += ") -> " + definition->return_type.value + " ";
+            if (definition->is_deferred())
+                return result + std::string(definition->body_source());
+            return result + definition->body->to_string();
+        }
+
+        virtual ASTNode* get_right() override { return definition->body.get(); }
+        const std::shared_ptr<FunctionDef>& get_definition() { return definition; }
+    private:
+        std::shared_ptr<FunctionDef> definition;
+    };
+
+    // return value; in a func, return; in a gen
+    class ReturnStmnt : public StatementNode {
+    public:
+        ReturnStmnt(const Token& token, std::unique_ptr<ExpressionNode> value)
+            :return_token(token), expr(std::move(value)) {}
+
+        virtual NodeKind node_kind() override { return NodeKind::return_stmnt; }
+        virtual TokenType token_type() override { return return_token.type; }
+        virtual ASTValue token_value() override { return return_token.value; }
+        virtual std::string to_string() override { return expr ? "return " + expr->to_string() : "return"; }
+
+        virtual ASTNode* get_right() override { return expr.get(); }
+        virtual void visit_expressions(const std::function<void(std::unique_ptr<ExpressionNode>&)>& visit) override { visit(expr); }
+    private:
+        Token return_token;
+        std::unique_ptr<ExpressionNode> expr;
+    };
+
+    class YieldStmnt : public StatementNode {
+    public:
+        YieldStmnt(const Token& token, std::unique_ptr<ExpressionNode> value)
+            :yield_token(token), expr(std::move(value)) {}
+
+        virtual NodeKind node_kind() override { return NodeKind::yield_stmnt; }
+        virtual TokenType token_type() override { return yield_token.type; }
+        virtual ASTValue token_value() override { return yield_token.value; }
+        virtual std::string to_string() override { return "yield " + expr->to_string(); }
+
+        virtual ASTNode* get_right() override { return expr.get(); }
+        virtual void visit_expressions(const std::function<void(std::unique_ptr<ExpressionNode>&)>& visit) override { visit(expr); }
+    private:
+        Token yield_token;
+        std::unique_ptr<ExpressionNode> expr;
+    };
+
+    // An expression evaluated for its effect, send(jobs, 1);
+    class ExprStmnt : public StatementNode {
+    public:
+        ExprStmnt(std::unique_ptr<ExpressionNode> expression)
+            :expr(std::move(expression)) {}
+
+        virtual NodeKind node_kind() override { return NodeKind::expression_stmnt; }
+        virtual TokenType token_type() override { return TokenType::semicolon; }
+        virtual ASTValue token_value() override { return ";"; }
+        virtual std::string to_string() override { return expr->to_string(); }
+
+        virtual ASTNode* get_right() override { return expr.get(); }
+        virtual void visit_expressions(const std::function<void(std::unique_ptr<ExpressionNode>&)>& visit) override { visit(expr); }
+    private:
+        std::unique_ptr<ExpressionNode> expr;
+    };
+
+    // use name; runs the module in name.cmr once before the file that uses it
+    class UseStmnt : public StatementNode {
+    public:
+        UseStmnt(const Token& token, const std::string& module)
+            :use_token(token), module_name(module) {}
+
+        virtual NodeKind node_kind() override { return NodeKind::use_stmnt; }
+        virtual TokenType token_type() override { return use_token.type; }
+        virtual ASTValue token_value() override { return use_token.value; }
+        virtual std::string to_string() override { return "use " + module_name; }
+
+        const std::string& get_module() { return module_name; }
+    private:
+        Token use_token;
+        std::string module_name; // path relative to the file, without .cmr
     };
 
     class TextExpr : public ExpressionNode {
     public:
         TextExpr(const Token& token)
-            :text_token(token) {
+            :text_token(token), text_value(token.value) {
             literal_value = text_token.value;
         }
 
+        virtual NodeKind node_kind() override { return NodeKind::text; }
         virtual TokenType token_type() override { return text_token.type; }
         virtual ASTValue token_value() override { return literal_value; }
         virtual std::string to_string() override { return "Text: " + text_token.value; }
+        // The value every evaluation hands out, made once so they all share it
+        const camaroo_text& get_text() { return text_value; }
 
         private:
         Token text_token; // No nodes
         std::string literal_value;
+        camaroo_text text_value;
+    };
+
+    // 'a', the token holds the letter as UTF-8 with its escape already decoded, the node the code point
+    class LetterExpr : public ExpressionNode {
+    public:
+        LetterExpr(const Token& token)
+            :letter_token(token) {
+            size_t used = 0;
+            letter_value = token.value.empty() ? U'\0' : decode_utf8(token.value, 0, used);
+        }
+
+        virtual NodeKind node_kind() override { return NodeKind::letter; }
+        virtual TokenType token_type() override { return letter_token.type; }
+        virtual ASTValue token_value() override { return letter_token.value; }
+        virtual std::string to_string() override { return "Letter: " + letter_token.value; }
+        char32_t get_letter() { return letter_value; }
+
+        private:
+        Token letter_token; // No nodes
+        char32_t letter_value;
+    };
+
+    // "total: {x} items", split by the parser into the text around the slots and the expressions in them. There's
+    // always one more piece than slots, the pieces at either end can be empty
+    class FormatExpr : public ExpressionNode {
+    public:
+        FormatExpr(const Token& token, std::vector<camaroo_text> pieces, std::vector<std::unique_ptr<ExpressionNode>> slots)
+            :format_token(token), pieces(std::move(pieces)), slots(std::move(slots)) {}
+
+        virtual NodeKind node_kind() override { return NodeKind::format; }
+        virtual TokenType token_type() override { return format_token.type; }
+        virtual ASTValue token_value() override { return format_token.value; }
+        virtual std::string to_string() override {
+            std::string result = "Format: " + pieces[0].str();
+            for (size_t i = 0; i < slots.size(); ++i)
+                result += "{" + slots[i]->to_string() + "}" + pieces[i + 1].str();
+            return result;
+        }
+
+        const std::vector<camaroo_text>& get_pieces() { return pieces; }
+        const std::vector<std::unique_ptr<ExpressionNode>>& get_slots() { return slots; }
+        virtual void visit_expressions(const std::function<void(std::unique_ptr<ExpressionNode>&)>& visit) override {
+            for (auto& slot : slots)
+                visit(slot);
+        }
+    private:
+        Token format_token; // The literal as written
+        std::vector<camaroo_text> pieces;
+        std::vector<std::unique_ptr<ExpressionNode>> slots;
+    };
+
+    class ListExpr : public ExpressionNode {
+    public:
+        ListExpr(const Token& token, std::vector<std::unique_ptr<ExpressionNode>> items)
+            :list_token(token), elements(std::move(items)) {}
+
+        virtual NodeKind node_kind() override { return NodeKind::list; }
+        virtual TokenType token_type() override { return list_token.type; }
+        virtual ASTValue token_value() override { return list_token.value; }
+        virtual std::string to_string() override {
+            std::string result = "[";
+            for (size_t i = 0; i < elements.size(); ++i)
+                result += (i ? ", " : "") + elements[i]->to_string();
+            return result + "]";
+        }
+
+        const std::vector<std::unique_ptr<ExpressionNode>>& get_elements() { return elements; }
+        virtual void visit_expressions(const std::function<void(std::unique_ptr<ExpressionNode>&)>& visit) override {
+            for (auto& element : elements)
+                visit(element);
+        }
+    private:
+        Token list_token; // [
+        std::vector<std::unique_ptr<ExpressionNode>> elements;
+    };
+
+    class ChannelExpr : public ExpressionNode {
+    public:
+        ChannelExpr(const Token& token, const Token& type, std::unique_ptr<ExpressionNode> size)
+            :channel_token(token), element_type(type), capacity(std::move(size)) {}
+
+        virtual NodeKind node_kind() override { return NodeKind::channel; }
+        virtual TokenType token_type() override { return channel_token.type; }
+        virtual ASTValue token_value() override { return channel_token.value; }
+        virtual std::string to_string() override { return "channel(" + element_type.value + ", " + capacity->to_string() + ")"; }
+
+        virtual ASTNode* get_right() override { return capacity.get(); }
+        const Token& get_element_type() { return element_type; }
+        virtual void visit_expressions(const std::function<void(std::unique_ptr<ExpressionNode>&)>& visit) override { visit(capacity); }
+    private:
+        Token channel_token; // channel
+        Token element_type;
+        std::unique_ptr<ExpressionNode> capacity;
+    };
+
+    // map(text, num), a new empty map every time it's evaluated
+    class MapExpr : public ExpressionNode {
+    public:
+        MapExpr(const Token& token, const Token& key, const Token& value)
+            :map_token(token), key_type(key), value_type(value) {}
+
+        virtual NodeKind node_kind() override { return NodeKind::map; }
+        virtual TokenType token_type() override { return map_token.type; }
+        virtual ASTValue token_value() override { return map_token.value; }
+        virtual std::string to_string() override { return "map(" + key_type.value + ", " + value_type.value + ")"; }
+
+        const Token& get_key_type() { return key_type; }
+        const Token& get_value_type() { return value_type; }
+    private:
+        Token map_token; // map
+        Token key_type;
+        Token value_type;
+    };
+
+    class CallExpr : public ExpressionNode {
+    public:
+        CallExpr(const Token& token, std::unique_ptr<ExpressionNode> function, std::vector<std::unique_ptr<ExpressionNode>> args)
+            :call_token(token), callee(std::move(function)), arguments(std::move(args)) {}
+
+        virtual NodeKind node_kind() override { return NodeKind::call; }
+        virtual TokenType token_type() override { return call_token.type; }
+        virtual ASTValue token_value() override { return call_token.value; }
+        virtual std::string to_string() override {
+            std::string result = callee->to_string() + "(";
+            for (size_t i = 0; i < arguments.size(); ++i)
+                result += (i ? ", " : "") + arguments[i]->to_string();
+            return result + ")";
+        }
+
+        virtual ASTNode* get_left() override { return callee.get(); }
+        const std::vector<std::unique_ptr<ExpressionNode>>& get_arguments() { return arguments; }
+        // The callee is a name, not a value, so only the arguments are handed out
+        virtual void visit_expressions(const std::function<void(std::unique_ptr<ExpressionNode>&)>& visit) override {
+            for (auto& argument : arguments)
+                visit(argument);
+        }
+    private:
+        Token call_token; // (
+        std::unique_ptr<ExpressionNode> callee; // left node
+        std::vector<std::unique_ptr<ExpressionNode>> arguments;
+    };
+
+    // Stands in for a pure expression that appears in several places of a program, see share_subtrees. Every
+    // copy points at the same tree. It answers with the token and children of that tree, so checks on token types
+    // see through it, but anything that casts by token type has to look at node_kind() first
+    class SharedExpr : public ExpressionNode {
+    public:
+        SharedExpr(std::shared_ptr<ExpressionNode> expression, bool memoize)
+            :target(std::move(expression)), memoized(memoize) {}
+
+        virtual NodeKind node_kind() override { return NodeKind::shared; }
+        virtual TokenType token_type() override { return target->token_type(); }
+        virtual ASTValue token_value() override { return target->token_value(); }
+        virtual std::string to_string() override { return target->to_string(); }
+
+        virtual ASTNode* get_left() override { return target->get_left(); }
+        virtual ASTNode* get_right() override { return target->get_right(); }
+        ExpressionNode* get_target() { return target.get(); }
+        const std::shared_ptr<ExpressionNode>& get_shared() { return target; }
+        // Appears more than once in the expression it is part of, which then computes it only once
+        bool is_memoized() { return memoized; }
+    private:
+        std::shared_ptr<ExpressionNode> target;
+        bool memoized;
+    };
+
+    // One step of an ArithChainExpr, the operator and the num literal it applies. The literal is on the left in 3 - x
+    struct ArithStep {
+        Token op;
+        Token constant;
+        int64_t value;
+        bool constant_left;
+    };
+
+    // What a chain of steps does to a num, worked out once by reduce_strength. Runs of + - * become one multiply,
+    // or shift, and one add. Divisions and remainders by constants become shifts or multiplies by magic numbers.
+    struct IntPlan {
+        enum class kind : uint8_t {
+            affine,         // value * multiplier + addend, the multiply is a shift when shift is set
+            divide_pow2,    // by 1 << shift, negated for negative divisors
+            divide_magic,
+            modulo_pow2,
+            modulo_magic,
+            divide,         // the divisor is INT64_MIN, nothing to gain over the plain instruction
+            modulo,
+            zero_divisor,
+        };
+        struct op {
+            kind what;
+            uint8_t shift = 0;
+            int64_t multiplier = 1;
+            int64_t addend = 0;
+            int64_t divisor = 1;
+            int64_t magic = 0;
+        };
+        std::vector<op> ops;
+
+        // Wraps on overflow and throws on division by zero, like the steps one at a time. Defined in strength.cpp
+        int64_t apply(int64_t value) const;
+    };
+
+    // x * 8 + 3, ((x / 4) / 2) % 16 and other chains of arithmetic on one operand with num literals.
+    // When the operand is a num the plan runs in place of the steps, anything else goes through the steps one at
+    // a time with the ordinary operators, so fnums, lists and errors come out the same as before
+    class ArithChainExpr : public ExpressionNode {
+    public:
+        ArithChainExpr(std::unique_ptr<ExpressionNode> operand, std::vector<ArithStep> steps, IntPlan plan)
+            :operand(std::move(operand)), chain(std::move(steps)), int_plan(std::move(plan)) {}
+
+        virtual NodeKind node_kind() override { return NodeKind::arith_chain; }
+        virtual TokenType token_type() override { return chain.back().op.type; }
+        virtual ASTValue token_value() override { return chain.back().op.value; }
+        // The text of the infix expressions the chain came from
+        virtual std::string to_string() override {
+            std::string result = operand->to_string();
+            for (const auto& step : chain) {
+                result = step.constant_left ? "(" + step.constant.value + " " + step.op.value + " " + result + ")"
+                                            : "(" + result + " " + step.op.value + " " + step.constant.value + ")";
+            }
+            return result;
+        }
+
+        virtual ASTNode* get_left() override { return operand.get(); }
+        virtual void visit_expressions(const std::function<void(std::unique_ptr<ExpressionNode>&)>& visit) override { visit(operand); }
+        ExpressionNode* get_operand() { return operand.get(); }
+        const std::vector<ArithStep>& get_steps() { return chain; }
+        const IntPlan& get_plan() { return int_plan; }
+    private:
+        std::unique_ptr<ExpressionNode> operand;
+        std::vector<ArithStep> chain; // innermost first
+        IntPlan int_plan;
+    };
+
+    // An expression that comes out the same on every iteration of loop, see hoist_invariants. It is worked out the
+    // first time an iteration needs it and kept until the loop finishes, so an error still comes from the iteration
+    // that hit it. Like SharedExpr it answers with the token and children of its target
+    class HoistedExpr : public ExpressionNode {
+    public:
+        HoistedExpr(std::unique_ptr<ExpressionNode> expression, ForStmnt* loop, uint32_t slot)
+            :target(std::move(expression)), owner(loop), index(slot) {}
+
+        virtual NodeKind node_kind() override { return NodeKind::hoisted; }
+        virtual TokenType token_type() override { return target->token_type(); }
+        virtual ASTValue token_value() override { return target->token_value(); }
+        virtual std::string to_string() override { return target->to_string(); }
+
+        virtual ASTNode* get_left() override { return target->get_left(); }
+        virtual ASTNode* get_right() override { return target->get_right(); }
+        virtual void visit_expressions(const std::function<void(std::unique_ptr<ExpressionNode>&)>& visit) override { visit(target); }
+        ExpressionNode* get_target() { return target.get(); }
+        ForStmnt* get_loop() { return owner; }
+        uint32_t get_slot() { return index; }
+    private:
+        std::unique_ptr<ExpressionNode> target;
+        ForStmnt* owner;
+        uint32_t index;
+    };
+
+    // i * stride, or a chain like i * 8 + 3, over the variable of a range loop that the body never assigns.
+    // Every iteration adds the stride to the value of the iteration before instead of working it out again
+    class InductionExpr : public ExpressionNode {
+    public:
+        // A chain's stride is the multiplier of its plan. Otherwise the target is a multiply and the stride is
+        // the side that isn't the loop variable
+        InductionExpr(std::unique_ptr<ExpressionNode> expression, ForStmnt* loop, uint32_t slot, bool constant_stride,
+                      int64_t stride, bool stride_on_left)
+            :target(std::move(expression)), owner(loop), index(slot), constant(constant_stride), step(stride),
+             step_on_left(stride_on_left) {}
+
+        virtual NodeKind node_kind() override { return NodeKind::induction; }
+        virtual TokenType token_type() override { return target->token_type(); }
+        virtual ASTValue token_value() override { return target->token_value(); }
+        virtual std::string to_string() override { return target->to_string(); }
+
+        virtual ASTNode* get_left() override { return target->get_left(); }
+        virtual ASTNode* get_right() override { return target->get_right(); }
+        virtual void visit_expressions(const std::function<void(std::unique_ptr<ExpressionNode>&)>& visit) override { visit(target); }
+        ExpressionNode* get_target() { return target.get(); }
+        ForStmnt* get_loop() { return owner; }
+        uint32_t get_slot() { return index; }
+        bool has_constant_stride() { return constant; }
+        int64_t get_stride() { return step; }
+        ASTNode* get_stride_side() { return step_on_left ? target->get_left() : target->get_right(); }
+    private:
+        std::unique_ptr<ExpressionNode> target;
+        ForStmnt* owner;
+        uint32_t index;
+        bool constant;
+        int64_t step;
+        bool step_on_left;
+    };
+
+    // A parameter or local in an InlineBody, read from the values the call worked out
+    class SlotExpr : public ExpressionNode {
+    public:
+        SlotExpr(const Token& name, uint32_t slot)
+            :name_token(name), index(slot) {}
+
+        virtual NodeKind node_kind() override { return NodeKind::slot; }
+        virtual TokenType token_type() override { return name_token.type; }
+        virtual ASTValue token_value() override { return name_token.value; }
+        virtual std::string to_string() override { return "ID: " + name_token.value; }
+        uint32_t get_slot() { return index; }
+    private:
+        Token name_token;
+        uint32_t index;
+    };
+
+    // A call to a small func that runs its InlineBody, see inline_calls. The locals are worked out in order, then
+    // the result, with the same checks on arguments and the returned value as a call. The call it came from is
+    // kept and runs instead whenever the name means some other function by then
+    class InlinedCallExpr : public ExpressionNode {
+    public:
+        InlinedCallExpr(std::unique_ptr<CallExpr> call, std::shared_ptr<FunctionDef> definition)
+            :original(std::move(call)), function(std::move(definition)) {}
+
+        virtual NodeKind node_kind() override { return NodeKind::inlined; }
+        virtual TokenType token_type() override { return original->token_type(); }
+        virtual ASTValue token_value() override { return original->token_value(); }
+        virtual std::string to_string() override { return original->to_string(); }
+
+        virtual ASTNode* get_left() override { return original->get_left(); }
+        virtual void visit_expressions(const std::function<void(std::unique_ptr<ExpressionNode>&)>& visit) override {
+            original->visit_expressions(visit);
+        }
+        CallExpr* get_call() { return original.get(); }
+        const std::shared_ptr<FunctionDef>& get_definition() { return function; }
+    private:
+        std::unique_ptr<CallExpr> original;
+        // Runs its get_inline_body, or the call when there is none
+        std::shared_ptr<FunctionDef> function;
     };
 }
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <parser.h>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace camaroo_core {
+
+    // Parsed programs saved as .cmrc files, so an unchanged source skips lexing and parsing on the next start.
+    // A file is only used when it was written by the same interpreter version and format for the same source text,
+    // anything else counts as stale and the caller parses the source again. Trees go in as the parser made them,
+    // the passes that run after linking rewrite them again on every load.
+    namespace ast_cache {
+
+        // Bump whenever NodeKind, TokenType or what a node stores changes
+        constexpr uint32_t format_version = 8;
+
+        struct settings {
+            bool enabled = false;
+            // Empty puts every .cmrc next to its source
+            std::string directory;
+        };
+
+        // Throws when program holds nodes only the optimizer makes
+        std::string serialize(const Program& program, uint64_t source_hash);
+        // nullopt when data is stale, cut short, damaged or not a .cmrc file at all
+        std::optional<Program> deserialize(const char* data, size_t size, uint64_t source_hash);
+
+        // path.cmrc next to the source, or a file in cache_dir named after a hash of the source's path
+        std::string cache_path(const std::string& source_path, const std::string& cache_dir = "");
+
+        // The file is mapped rather than read where the platform has mmap
+        std::optional<Program> load(const std::string& cache_file, uint64_t source_hash);
+        // Writes to a temporary file first and renames it, so readers never see half a cache file. Returns false on failure.
+        bool store(const std::string& cache_file, const Program& program, uint64_t source_hash);
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <object.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace camaroo_core {
+
+    class evaluator;
+
+    using Arguments = std::vector<std::shared_ptr<camaroo_object>>;
+    using builtin_fn = std::shared_ptr<camaroo_object> (*)(evaluator& context, const Arguments& args);
+
+    // Returns nullptr when there is no built-in function with that name
+    builtin_fn find_builtin(const std::string& name);
+    // Kind of value the built-in with that name gives back, unknown when it depends on the arguments or there is none
+    TokenType builtin_result(const std::string& name);
+}
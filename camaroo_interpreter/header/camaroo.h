@@ -0,0 +1,44 @@
+#pragma once
+
+/* Plain C interface to the engine for FFI callers, see engine.h for the C++ one */
+
+#include <stddef.h>
+
+#if defined(_WIN32) && defined(CAMAROO_EXPORTS)
+#define CAMAROO_API __declspec(dllexport)
+#elif defined(__GNUC__)
+#define CAMAROO_API __attribute__((visibility("default")))
+#else
+#define CAMAROO_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct camaroo_engine camaroo_engine;
+typedef struct camaroo_script camaroo_script;
+
+/* Gets text printed by a script, or one error message. text isn't null terminated. */
+typedef void (*camaroo_write_fn)(void* user_data, const char* text, size_t length);
+
+/* thread_count 0 runs on the process wide shared pool */
+CAMAROO_API camaroo_engine* camaroo_engine_new(size_t thread_count);
+CAMAROO_API void camaroo_engine_free(camaroo_engine* engine);
+
+/* Returns NULL when source doesn't compile, *error then gets the parse errors if error isn't NULL.
+   A script can be run by any number of threads at once. */
+CAMAROO_API camaroo_script* camaroo_compile(const camaroo_engine* engine, const char* source, char** error);
+CAMAROO_API void camaroo_script_free(camaroo_script* script);
+
+/* Runs script with fresh variables. Output goes to out and runtime errors to err, either may be NULL to
+   drop it. Returns 0 when every statement ran and -1 otherwise. */
+CAMAROO_API int camaroo_run(const camaroo_engine* engine, const camaroo_script* script,
+                            camaroo_write_fn out, camaroo_write_fn err, void* user_data);
+
+/* Frees strings handed out by the functions above */
+CAMAROO_API void camaroo_string_free(char* text);
+
+#ifdef __cplusplus
+}
+#endif
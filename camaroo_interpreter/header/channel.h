@@ -0,0 +1,44 @@
+#pragma once
+
+#include <object.h>
+#include <ring_buffer.h>
+#include <task_scheduler.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace camaroo_core {
+
+    // Bounded channel between tasks. The values go through a lock-free ring, a sender finding it full
+    // or a receiver finding it empty spins for a moment and then parks until the other side bumps a counter.
+    // Callers that aren't tasks sleep on the counter instead.
+    class camaroo_channel {
+    public:
+        camaroo_channel(TokenType element_type, size_t capacity);
+
+        TokenType element_type() const { return type; }
+        size_t capacity() const { return ring.capacity(); }
+
+        // Blocks while the channel is full, returns false if it is closed
+        bool send(std::shared_ptr<camaroo_object> value);
+        // Blocks while the channel is empty, returns nullptr once it is closed and drained
+        std::shared_ptr<camaroo_object> receive();
+        void close();
+        bool is_closed() const { return closed.load(); }
+
+    private:
+        void wake(std::atomic<uint32_t>& counter, std::atomic<uint32_t>& waiting, task_scheduler::wait_list& parked);
+        void sleep(std::atomic<uint32_t>& counter, uint32_t seen, std::atomic<uint32_t>& waiting,
+                   task_scheduler::wait_list& parked);
+    private:
+        mpmc_ring<std::shared_ptr<camaroo_object>> ring;
+        TokenType type;
+        std::atomic<bool> closed{false};
+        std::atomic<uint32_t> sent{0};
+        std::atomic<uint32_t> received{0};
+        std::atomic<uint32_t> waiting_senders{0};
+        std::atomic<uint32_t> waiting_receivers{0};
+        task_scheduler::wait_list parked_senders;
+        task_scheduler::wait_list parked_receivers;
+    };
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <parser.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace camaroo_core {
+
+    // A source buffer that stays parsed while it is edited, for editors that re-analyse on every keystroke.
+    // Top level statements don't depend on each other to parse, so each one is parsed from its own span of source.
+    // An edit re-lexes from the statement it lands in until the old statement boundaries line up again,
+    // reparses only the statements in between and keeps the trees of every other statement.
+    class Document {
+    public:
+        explicit Document(std::string source);
+
+        // Replaces removed characters at offset with inserted, offset and removed are clamped to the source
+        void edit(size_t offset, size_t removed, const std::string& inserted);
+
+        const std::string& get_source() const { return source; }
+        // The top level statements in source order, pointers stay valid until an edit reparses their statement
+        std::vector<StatementNode*> statements() const;
+        // Parse errors of every statement in source order, empty when the whole buffer compiles
+        std::vector<std::string> errors() const;
+        // Statements parsed by the last edit, or by the constructor
+        size_t last_reparsed() const { return reparsed; }
+    private:
+        // A top level statement and the whitespace and comments ahead of it. The last span may hold only those,
+        // or a statement that isn't finished yet.
+        struct span {
+            size_t begin;
+            size_t end;
+            Program program;
+        };
+
+        // Spans from begin up to the first boundary at or after resync_from that was_boundary accepts, or to the end
+        // of the source. Returns whether it stopped on such a boundary
+        bool scan(size_t begin, size_t resync_from, const std::function<bool(size_t)>& was_boundary,
+                  std::vector<span>& found) const;
+        span parse_span(size_t begin, size_t end) const;
+    private:
+        std::string source;
+        std::vector<span> spans;
+        size_t reparsed = 0;
+    };
+}
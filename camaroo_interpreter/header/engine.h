@@ -0,0 +1,97 @@
+#pragma once
+
+#include <ast_cache.h>
+#include <evaluator.h>
+#include <module.h>
+#include <parser.h>
+#include <specialize.h>
+#include <thread_pool.h>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace camaroo_core {
+
+    // A parsed program. Nothing changes it after compile, so any number of threads can run it at once.
+    class Script {
+    public:
+        explicit Script(Program program, std::vector<modules::source_file> sources = {})
+            :program(std::move(program)), sources(std::move(sources)) {}
+
+        const Program& get_program() const { return program; }
+        // The files it was compiled from, the root file first when it came from one
+        const std::vector<modules::source_file>& get_sources() const { return sources; }
+    private:
+        Program program;
+        std::vector<modules::source_file> sources;
+    };
+
+    class Engine;
+
+    // State for running scripts: variables, functions and where their output goes.
+    // A context runs one script at a time and keeps what it declared for the next run, which is how the REPL works.
+    class Context {
+    public:
+        explicit Context(const Engine& engine, std::ostream& out = std::cout, std::ostream& err = std::cerr);
+
+        Context(const Context&) = delete;
+        Context& operator=(const Context&) = delete;
+
+        camaroo_object* get_variable(const std::string& name) { return state.get_variable(name); }
+        void set_variable(const std::string& name, std::shared_ptr<camaroo_object> value) { state.define_variable(name, std::move(value)); }
+    private:
+        friend class Engine;
+        output_stream output;
+        evaluator state;
+    };
+
+    // Compiles sources once into scripts and runs them with a context per call, from as many threads as needed
+    class Engine {
+    public:
+        // Runs scripts on the shared pool
+        Engine();
+        // Runs scripts on a pool of its own with thread_count threads
+        explicit Engine(size_t thread_count);
+
+        Engine(const Engine&) = delete;
+        Engine& operator=(const Engine&) = delete;
+
+        // Throws with every parse error, one per line, when the source or a module it uses doesn't compile.
+        // Modules are looked up from the working directory. Variables in fixed are specialized, the script is the
+        // residual program and can be run any number of times.
+        std::shared_ptr<const Script> compile(const std::string& source, const specializations& fixed = {}) const;
+        // Compiles the file at path and the modules it uses. With cache enabled each file's current .cmrc is loaded
+        // instead of parsing it, and a stale or missing one is rewritten after parsing.
+        std::shared_ptr<const Script> compile_file(const std::string& path, const ast_cache::settings& cache = {},
+                                                   const specializations& fixed = {}) const;
+        // Returns false when a statement failed, its error went to the context's error stream
+        bool run(const Script& script, Context& context) const;
+
+        thread_pool& get_pool() const { return *pool; }
+    private:
+        std::unique_ptr<thread_pool> owned_pool;
+        thread_pool* pool;
+    };
+
+    // An interactive session. Lines are collected until every bracket they open is closed, then compiled and run
+    // in one context that lives as long as the session, so declarations carry over and a line with errors loses nothing
+    class Repl {
+    public:
+        explicit Repl(const Engine& engine, std::ostream& out = std::cout, std::ostream& err = std::cerr);
+
+        // Runs the statements collected so far once they are complete. false while more lines are needed
+        bool feed(const std::string& line);
+        // Forgets the lines of an unfinished statement
+        void discard();
+        bool is_pending() const { return !pending.empty(); }
+        Context& get_context() { return context; }
+    private:
+        const Engine& engine;
+        std::ostream& err;
+        Context context;
+        std::string pending;
+        // Brackets opened and not yet closed in pending, counted a line at a time so long input stays cheap
+        int64_t open_brackets = 0;
+    };
+}
@@ -1,28 +1,131 @@
 #pragma once
 
 #include "parser.h"
+#include <object.h>
+#include <thread_pool.h>
+#include <task_scheduler.h>
+#include <generator.h>
+#include <atomic>
+#include <mutex>
+#include <ostream>
 #include <unordered_map>
 #include <variant>
 
 namespace camaroo_core {
 
-    using Value = std::variant<int64_t, std::string>;
+    // Where print output and runtime errors go. Spawned tasks and parallel loops share the stream of the
+    // evaluator they came from, so every write is one locked call and lines never interleave.
+    class output_stream {
+    public:
+        output_stream(std::ostream& out, std::ostream& err)
+            :out(out), err(err) {}
+
+        void write(const std::string& text);
+        void report(const std::string& error);
+        size_t error_count() const { return errors.load(); }
 
-    struct camaroo_object {
-        TokenType variable_type;
-        Value variable_value;
+        // std::cout and std::cerr
+        static output_stream& standard();
+    private:
+        std::ostream& out;
+        std::ostream& err;
+        std::mutex lock;
+        std::atomic<size_t> errors{0};
     };
 
     class evaluator {
     public:
-        void evaluate_program(const Program& program);
+        evaluator(thread_pool& pool = thread_pool::shared(), output_stream& output = output_stream::standard())
+            :pool(&pool), output(&output), parent(nullptr) {}
+
+        // Frame on top of outer, for a function call or one chunk of a parallel for. Reads that miss it fall through
+        // to outer and writes stay in the frame. outer can't change while a loop runs, so any number of chunks can read
+        // it at once. Writing one of outer's variables from the frame is an error, the write would be lost with it.
+        evaluator(thread_pool& pool, const evaluator& outer, bool parallel_chunk = false)
+            :pool(&pool), output(outer.output), parent(&outer), parallel_chunk(parallel_chunk) {}
+
+        // Spawned tasks are joined before their evaluator goes away
+        ~evaluator() { tasks.wait(); }
+
+        // Returns false when a statement, or a task it spawned, failed. The errors went to the output's error stream.
+        bool evaluate_program(const Program& program);
         void evaluate_statement(ASTNode* statement);
+        // Joins tasks spawned by statements run one at a time through evaluate_statement
+        void wait_for_tasks() { tasks.wait(); }
 
         std::shared_ptr<camaroo_object> evaluate_expression(ASTNode* statement);
-        camaroo_object* get_variable(const std::string& var_name) { return declared_variables[var_name].get(); }
+        camaroo_object* get_variable(const std::string& var_name) { return find_variable(var_name).get(); }
+        // Declares a global before the program runs, how embedders hand values in
+        void define_variable(const std::string& var_name, std::shared_ptr<camaroo_object> value) { declared_variables[var_name] = std::move(value); }
         const std::unordered_map<std::string, std::shared_ptr<camaroo_object>>& get_variables() { return declared_variables; }
+        thread_pool& get_pool() { return *pool; }
+
+    private:
+        using Scope = std::unordered_map<std::string, std::shared_ptr<camaroo_object>>;
+
+        struct function_entry {
+            std::shared_ptr<FunctionDef> definition;
+            // Evaluator the function was declared in, calls read its variables
+            const evaluator* owner;
+        };
+        using Functions = std::unordered_map<std::string, function_entry>;
+
+        const function_entry* find_function(const std::string& name) const;
+        std::shared_ptr<camaroo_object> call_function(const function_entry& function,
+                                                      const std::vector<std::shared_ptr<camaroo_object>>& args);
+
+        std::shared_ptr<camaroo_object> find_variable(const std::string& name) const;
+        void declare_variable(const std::string& name, std::shared_ptr<camaroo_object> value);
+        void assign_variable(const std::string& name, std::shared_ptr<camaroo_object> value);
+
+        void evaluate_block(BlockStmnt* block);
+        // Runs a gen body, suspending at each yield
+        generator<std::shared_ptr<camaroo_object>> yield_block(BlockStmnt* block);
+        void evaluate_for(ForStmnt* loop);
+        void evaluate_parallel_for(ForStmnt* loop);
+        void evaluate_spawn(SpawnStmnt* spawn);
+        std::shared_ptr<camaroo_object> evaluate_shared(SharedExpr* shared);
+        std::shared_ptr<camaroo_object> evaluate_hoisted(HoistedExpr* hoisted);
+        std::shared_ptr<camaroo_object> evaluate_induction(InductionExpr* induction);
+        std::shared_ptr<camaroo_object> evaluate_inlined(InlinedCallExpr* inlined);
+        // Adds the text of format to the end of into, sized for all of it before anything is written
+        void render(FormatExpr* format, std::string& into);
+        // Every variable and function this evaluator can read, inner scopes shadowing outer ones
+        void collect_visible(Scope& into, Functions& functions_into) const;
+
+        // Values hoist_invariants took out of the body of a loop that is running
+        struct loop_frame {
+            ForStmnt* loop;
+            size_t iteration = 0;
+            std::vector<std::shared_ptr<camaroo_object>> hoisted;
+            // Every induction value with the iteration it belongs to
+            std::vector<std::pair<size_t, std::shared_ptr<camaroo_object>>> inductions;
+        };
+        // Keeps a loop's frame for as long as the loop runs, defined in evaluator.cpp
+        struct loop_frame_guard;
+        loop_frame* find_loop_frame(ForStmnt* loop);
 
     private:
-        std::unordered_map<std::string, std::shared_ptr<camaroo_object>> declared_variables;
+        thread_pool* pool;
+        output_stream* output;
+        const evaluator* parent;
+        bool parallel_chunk = false;
+        Scope declared_variables;
+        // Block scopes, innermost last
+        std::vector<Scope> scopes;
+        Functions functions;
+        // Set by return, blocks and loops stop once it is
+        bool returning = false;
+        std::shared_ptr<camaroo_object> return_value;
+        task_group tasks;
+        // Values of memoised shared expressions, kept until the outermost evaluate_expression call returns
+        std::unordered_map<const ASTNode*, std::shared_ptr<camaroo_object>> shared_values;
+        size_t expression_depth = 0;
+        // Innermost last. Loops run in other evaluators, like the chunks of a parallel loop or function calls,
+        // keep their own, so expressions that find no frame here just work their value out
+        std::vector<loop_frame> loop_frames;
+        // Parameters and locals of inlined calls, those of the one being worked out start at inline_base
+        std::vector<std::shared_ptr<camaroo_object>> inline_values;
+        size_t inline_base = 0;
     };
-}
\ No newline at end of file
+}
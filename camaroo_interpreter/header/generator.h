@@ -0,0 +1,100 @@
+#pragma once
+
+#include <object.h>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace camaroo_core {
+
+    // Coroutine frames are recycled through per-thread free lists bucketed by size, so a generator
+    // that keeps starting nested coroutines (one per loop iteration that yields) stops touching the
+    // heap once the first frames of each size have been handed back
+    namespace frame_allocator {
+        void* allocate(size_t size);
+        void deallocate(void* frame, size_t size);
+    }
+
+    // Lazily produced sequence, the body runs up to its next co_yield each time next() is called
+    template <typename T>
+    class generator {
+    public:
+        struct promise_type {
+            T current{};
+            std::exception_ptr error;
+
+            generator get_return_object() { return generator(std::coroutine_handle<promise_type>::from_promise(*this)); }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_always final_suspend() noexcept { return {}; }
+            std::suspend_always yield_value(T value) {
+                current = std::move(value);
+                return {};
+            }
+            void return_void() {}
+            void unhandled_exception() { error = std::current_exception(); }
+
+            static void* operator new(size_t size) { return frame_allocator::allocate(size); }
+            static void operator delete(void* frame, size_t size) { frame_allocator::deallocate(frame, size); }
+        };
+
+        generator() = default;
+        generator(generator&& other) noexcept
+            :coroutine(std::exchange(other.coroutine, nullptr)) {}
+        generator& operator=(generator&& other) noexcept {
+            if (this != &other) {
+                if (coroutine)
+                    coroutine.destroy();
+                coroutine = std::exchange(other.coroutine, nullptr);
+            }
+            return *this;
+        }
+        ~generator() {
+            if (coroutine)
+                coroutine.destroy();
+        }
+
+        // Runs to the next value and returns false once the body is done, errors from the body come out here
+        bool next() {
+            if (!coroutine || coroutine.done())
+                return false;
+            coroutine.resume();
+            if (coroutine.promise().error)
+                std::rethrow_exception(std::exchange(coroutine.promise().error, nullptr));
+            return !coroutine.done();
+        }
+
+        T& value() { return coroutine.promise().current; }
+
+    private:
+        explicit generator(std::coroutine_handle<promise_type> handle)
+            :coroutine(handle) {}
+
+        std::coroutine_handle<promise_type> coroutine = nullptr;
+    };
+
+    // Value a gen function call or lines() hands out, for loops pull from it one value at a time
+    class camaroo_generator {
+    public:
+        // state is whatever the body needs to outlive it, like the frame its variables live in
+        camaroo_generator(TokenType element_type, generator<std::shared_ptr<camaroo_object>> body,
+                          std::shared_ptr<void> state = nullptr);
+
+        TokenType element_type() const { return type; }
+
+        // Next value or nullptr once the body finished. Only the task that made the generator may resume it,
+        // its frame reads variables that other tasks could be changing.
+        std::shared_ptr<camaroo_object> next();
+
+    private:
+        TokenType type;
+        std::thread::id owner;
+        bool running = false;
+        bool finished = false;
+        // Declared before body so the coroutine is destroyed while the state it points into still exists
+        std::shared_ptr<void> state;
+        generator<std::shared_ptr<camaroo_object>> body;
+    };
+}
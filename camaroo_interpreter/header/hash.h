@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace camaroo_core {
+
+    // 64-bit FNV-1a, used to key compiled scripts by their source text
+    inline uint64_t content_hash(std::string_view text, uint64_t hash = 14695981039346656037ull) {
+        for (unsigned char c : text) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <ast.h>
+#include <memory>
+#include <vector>
+
+namespace camaroo_core {
+
+    // Loop-invariant code motion. Inside the body of a for loop, every pure expression that reads only variables
+    // the body never declares or assigns is wrapped in a HoistedExpr for the outermost loop it doesn't change in,
+    // reads of such variables included. Multiplies of a range loop's variable become InductionExprs.
+    // Spawn, function and gen bodies run in evaluators of their own and start over with no enclosing loops, and so
+    // do parallel loop bodies. Returns how many expressions were wrapped
+    size_t hoist_invariants(const std::vector<std::unique_ptr<StatementNode>>& statements);
+}
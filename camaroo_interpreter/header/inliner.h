@@ -0,0 +1,18 @@
+#pragma once
+
+#include <ast.h>
+#include <memory>
+#include <vector>
+
+namespace camaroo_core {
+
+    // Most expression nodes a func body can have and still be copied into its callers
+    constexpr size_t inline_budget = 32;
+
+    // Replaces calls to small funcs declared in statements with InlinedCallExprs, which run the func's
+    // get_inline_body. A func has one when its body is some num, fnum, text, toggle or list declarations and then a
+    // return, all of them pure expressions over its parameters and earlier locals that stay within inline_budget.
+    // Such a body calls nothing, so it can't recurse. Calls to funcs whose bodies the parser skipped are replaced
+    // when the source is short enough to qualify and find out at the first call. Returns how many calls were replaced
+    size_t inline_calls(const std::vector<std::unique_ptr<StatementNode>>& statements);
+}
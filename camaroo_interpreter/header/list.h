@@ -0,0 +1,39 @@
+#pragma once
+
+#include <object.h>
+#include <simd.h>
+#include <thread_pool.h>
+#include <memory>
+#include <vector>
+
+namespace camaroo_core {
+
+    // Builds a flat list from evaluated literal elements, mixing num and fnum promotes the list to fnum
+    std::shared_ptr<camaroo_object> make_list(const std::vector<std::shared_ptr<camaroo_object>>& elements);
+
+    // Letters in a list take a byte each, so they stop at the first 256 code points
+    constexpr char32_t max_list_letter = 0xFF;
+    // The byte letter takes in a list, an error for letters past max_list_letter
+    uint8_t list_letter(char32_t letter);
+
+    // Lists longer than this are split into chunks of this many elements and spread over the pool
+    constexpr size_t list_parallel_grain = size_t(1) << 16;
+
+    // Element-wise operations, at least one side has to be a list and the other may be a num or fnum scalar
+    std::shared_ptr<camaroo_object> list_arith(thread_pool& pool, simd::arith_op op, const camaroo_object& left, const camaroo_object& right);
+    std::shared_ptr<camaroo_object> list_compare(thread_pool& pool, simd::compare_op op, const camaroo_object& left, const camaroo_object& right);
+
+    // Keeps the elements whose toggle in mask is set
+    std::shared_ptr<camaroo_object> list_filter(thread_pool& pool, const camaroo_list& values, const camaroo_list& mask);
+
+    // Reductions combine their per-chunk results in chunk order, so they don't change with the thread count
+    std::shared_ptr<camaroo_object> list_sum(thread_pool& pool, const camaroo_list& values);
+    std::shared_ptr<camaroo_object> list_min(thread_pool& pool, const camaroo_list& values);
+    std::shared_ptr<camaroo_object> list_max(thread_pool& pool, const camaroo_list& values);
+    std::shared_ptr<camaroo_object> list_dot(thread_pool& pool, const camaroo_list& left, const camaroo_list& right);
+
+    // Returns a sorted copy, chunks are sorted in parallel and then merged pairwise
+    std::shared_ptr<camaroo_object> list_sort(thread_pool& pool, const camaroo_list& values);
+
+    void write_list(std::ostream& out, const camaroo_list& list);
+}
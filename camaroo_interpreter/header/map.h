@@ -0,0 +1,93 @@
+#pragma once
+
+#include <object.h>
+#include <simd.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace camaroo_core {
+
+    // Map from num or text keys to values of one kind, kept in the order the keys were first put in. Lookups go
+    // through a flat open-addressed table with a control byte per slot, holding 7 bits of the key's hash or marking
+    // the slot empty or deleted. A probe matches a group of control bytes at once and only looks at the slots whose
+    // byte matched. num keys sit in the table beside their entry so a probe never leaves it, text keys are kept once
+    // each in one buffer the map owns and probes compare their full hash before the text
+    class camaroo_map {
+    public:
+        // Entries are numbered with 32 bits
+        static constexpr size_t max_keys = UINT32_MAX;
+
+        camaroo_map(TokenType key_type, TokenType value_type);
+
+        TokenType key_type() const { return keys; }
+        TokenType value_type() const { return kind; }
+        size_t size() const { return live; }
+
+        // The value under key, nullptr when there's none
+        Value* find(int64_t key);
+        Value* find(std::string_view key);
+        // The value under key, put in as fill first when there's none
+        Value& insert(int64_t key, const Value& fill);
+        Value& insert(std::string_view key, const Value& fill);
+        // Whether there was a value under key
+        bool erase(int64_t key);
+        bool erase(std::string_view key);
+        // Makes room for count keys, so putting that many in doesn't rehash. Throws past max_keys or when the
+        // memory isn't there
+        void reserve(size_t count);
+
+        // Entries in the order they were put in. Erased ones stay until the next rehash and are skipped
+        size_t entry_count() const { return values.size(); }
+        bool has_entry(size_t entry) const { return !erased[entry]; }
+        std::shared_ptr<camaroo_object> key_at(size_t entry) const;
+        const Value& value_at(size_t entry) const { return values[entry]; }
+
+        // The built-ins hold it for each call so tasks can share a map
+        std::mutex& guard() { return lock; }
+    private:
+        struct num_slot {
+            int64_t key;
+            uint32_t entry;
+        };
+
+        size_t capacity() const { return control.empty() ? 0 : control.size() - simd::group_width; }
+        // The slot whose key match accepts, npos when there's none
+        template <typename Match>
+        size_t probe(uint64_t hash, Match match) const;
+        // The first empty or deleted slot on hash's probe sequence
+        size_t free_slot(uint64_t hash) const;
+        void set_control(size_t slot, uint8_t byte);
+        // The slot holding the key match accepts, or a slot taken for it when there's none, growing the table
+        // first when it's full. found says which
+        template <typename Match>
+        size_t probe_or_claim(uint64_t hash, Match match, bool& found);
+        size_t add_entry(const Value& fill);
+        std::string_view text_key(size_t entry) const;
+        void mark_erased(size_t slot, size_t entry);
+        // Drops erased entries and rebuilds the table with room for count keys
+        void rehash(size_t count);
+    private:
+        TokenType keys;
+        TokenType kind;
+        // capacity + group_width bytes, the last group repeats the first so reading a group never wraps
+        std::vector<uint8_t> control;
+        std::vector<num_slot> num_slots;
+        std::vector<uint32_t> text_slots;
+        // Per entry, in the order they were put in
+        std::vector<int64_t> num_keys;
+        std::vector<uint64_t> text_hashes;
+        // Where each text key starts in key_pool, one more than there are entries so the last one has an end
+        std::vector<uint32_t> text_offsets{0};
+        std::string key_pool;
+        std::vector<Value> values;
+        std::vector<uint8_t> erased;
+        size_t live = 0;
+        // Slots that are full or deleted, probes only stop at empty ones
+        size_t used = 0;
+        std::mutex lock;
+    };
+}
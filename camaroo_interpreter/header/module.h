@@ -0,0 +1,31 @@
+#pragma once
+
+#include <ast_cache.h>
+#include <parser.h>
+#include <thread_pool.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace camaroo_core {
+
+    // use name; loads name.cmr from the directory of the file that says it. Every module runs once,
+    // after the modules it uses, and declares into the same globals as the file that used it.
+    namespace modules {
+
+        // A file a program was linked from, with the hash of the text it was parsed from
+        struct source_file {
+            std::string path;
+            uint64_t hash;
+        };
+
+        // Parses root and every module it uses, directly or not, and links them into one program: each module's
+        // statements once, dependencies first, then root's. Files are found and parsed a wave at a time, the
+        // files of a wave in parallel on pool, and each one goes through its own .cmrc when cache is enabled.
+        // root_path is empty for source that didn't come from a file, its modules are then looked up from the
+        // working directory. When a file fails to parse the result isn't compiled and holds the errors of every
+        // file, modules that use each other throw. sources, when given, gets every file that was linked in.
+        Program link(const std::string& root_source, const std::string& root_path, thread_pool& pool,
+                     const ast_cache::settings& cache = {}, std::vector<source_file>* sources = nullptr);
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <text.h>
+#include <tokenizer.h>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace camaroo_core {
+
+    struct camaroo_list;
+    class camaroo_channel;
+    class camaroo_generator;
+    class camaroo_map;
+
+    // Letters are held as their code point, in place like nums
+    using Value = std::variant<int64_t, camaroo_text, double, bool, char32_t, std::shared_ptr<camaroo_list>,
+                               std::shared_ptr<camaroo_channel>, std::shared_ptr<camaroo_generator>,
+                               std::shared_ptr<camaroo_map>>;
+
+    struct camaroo_object {
+        TokenType variable_type; // num, fnum, text, toggle, letter, list, channel, generator, map
+        Value variable_value;
+    };
+
+    // Lists keep their elements in one flat typed array instead of boxing each one in a camaroo_object,
+    // toggles take one byte (0 or 1) each so they can be used directly as masks, and so do letters, which in a list
+    // are limited to the first 256 code points
+    using ListStorage = std::variant<std::vector<int64_t>, std::vector<double>, std::vector<uint8_t>>;
+
+    struct camaroo_list {
+        TokenType element_type; // num, fnum, toggle, letter
+        ListStorage elements;
+
+        size_t size() const { return std::visit([](const auto& values) { return values.size(); }, elements); }
+    };
+
+    inline std::shared_ptr<camaroo_object> make_object(TokenType type, Value value) {
+        return std::make_shared<camaroo_object>(camaroo_object{type, std::move(value)});
+    }
+
+    // Name of a value kind the way it is written in source, num for TokenType::num
+    const char* type_name(TokenType type);
+    // Kind of value a declaration with this type keyword holds, num for num_type and unknown for keywords that declare nothing
+    TokenType declared_kind(TokenType keyword);
+    void write_object(std::ostream& out, const camaroo_object& object);
+    // What write_object writes, added to the end of out. Only lists, channels and maps go through a stream
+    void append_object(std::string& out, const camaroo_object& object);
+}
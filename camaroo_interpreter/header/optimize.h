@@ -0,0 +1,18 @@
+#pragma once
+
+#include <ast.h>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace camaroo_core {
+
+    // Hands visit every expression a statement owns and those of the statements inside it, each one the root of
+    // an evaluation of its own. Bodies the parser skipped are left out
+    void visit_expression_roots(ASTNode* statement, const std::function<void(std::unique_ptr<ExpressionNode>&)>& visit);
+
+    // Rewrites parsed statements to run faster without changing what they do, inline_calls, reduce_strength,
+    // hoist_invariants and then share_subtrees. Engine::compile runs it over whole programs and FunctionDef::get_body over the bodies
+    // it parses late
+    void optimize(const std::vector<std::unique_ptr<StatementNode>>& statements);
+}
@@ -11,15 +11,21 @@ namespace camaroo_core {
     struct Program {
         std::vector<std::unique_ptr<StatementNode>> statements;
         bool has_compiled = true;
+        // Parse errors in source order, empty when has_compiled is set
+        std::vector<std::string> errors;
     };
 
     class Parser {
     public:
-        Parser(const std::string& source_code);
+        // With lazy_bodies, top level func and gen bodies are only brace matched and get parsed on their first call
+        Parser(const std::string& source_code, bool lazy_bodies = false);
         Program parse_program();
+        // A func or gen body on its own, for bodies that were skipped over. nullptr if it has errors
+        std::unique_ptr<BlockStmnt> parse_function_body(TokenType kind);
     public:
         std::vector<std::string> errors;
     private:
+        std::unique_ptr<StatementNode> parse_statement();
         std::unique_ptr<AssignStmnt> parse_assign_stmnt();
         std::unique_ptr<PrintStmnt> parse_print_stmnt();
         std::unique_ptr<ExpressionNode> parse_expression(ExprOrder precedent);
@@ -31,7 +37,21 @@ namespace camaroo_core {
         std::unique_ptr<ExpressionNode> parse_toggle_expr();
         std::unique_ptr<ExpressionNode> parse_prefix_expr();
         std::unique_ptr<ExpressionNode> parse_text_expr();
-        std::unique_ptr<StatementNode> parse_block_stmnt();
+        std::unique_ptr<ExpressionNode> parse_letter_expr();
+        std::unique_ptr<ExpressionNode> parse_format_expr();
+        std::unique_ptr<BlockStmnt> parse_block_stmnt();
+        std::unique_ptr<StatementNode> parse_for_stmnt();
+        std::unique_ptr<StatementNode> parse_spawn_stmnt();
+        std::unique_ptr<StatementNode> parse_func_stmnt();
+        std::unique_ptr<StatementNode> parse_return_stmnt();
+        std::unique_ptr<StatementNode> parse_yield_stmnt();
+        std::unique_ptr<StatementNode> parse_use_stmnt();
+        std::unique_ptr<StatementNode> parse_expression_stmnt();
+        std::unique_ptr<ExpressionNode> parse_channel_expr();
+        std::unique_ptr<ExpressionNode> parse_map_expr();
+        std::unique_ptr<ExpressionNode> parse_list_expr();
+        std::unique_ptr<ExpressionNode> parse_call_expr(std::unique_ptr<ExpressionNode> function);
+        std::vector<std::unique_ptr<ExpressionNode>> parse_expression_list(TokenType end);
     private:
         void advance_token();
         ExprOrder current_precedence();
@@ -39,13 +59,21 @@ namespace camaroo_core {
         bool validate_token(Token expected_token, bool error = true);
         bool validate_in_tokens(std::vector<Token>& expected_tokens);
         void found_error(std::string token_type);
+        std::unique_ptr<BlockStmnt> parse_body(TokenType kind);
+        TokenType enclosing_body();
     private:
         std::optional<Token> current_token;
         std::optional<Token> next_token;
         Tokenizer tokenizer;
-        std::unordered_map<TokenType, ExprOrder> precedences;
-        std::unordered_map<TokenType, std::function<std::unique_ptr<ExpressionNode>()>> prefix_fns;
-        std::unordered_map<TokenType, std::function<std::unique_ptr<ExpressionNode>(std::unique_ptr<ExpressionNode>)>> infix_fns;
+        // Shared by the functions whose bodies were skipped, null unless lazy_bodies is set
+        std::shared_ptr<const std::string> source;
+        // func, gen, parallel for and spawn bodies being parsed, innermost last. return and yield
+        // only make sense when the innermost one is a func or gen
+        std::vector<TokenType> body_kinds;
+        size_t yield_count = 0;
+        size_t block_depth = 0;
+        struct dispatch_tables;
+        static const dispatch_tables& tables();
     };
 
 }
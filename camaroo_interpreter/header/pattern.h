@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace camaroo_core {
+
+    // Patterns for regex(). A pattern compiles to an NFA once, and matching runs a DFA over it built lazily, a state
+    // the first time the input leads there, so every byte of the text is looked at once and nothing backtracks. The
+    // DFA keeps at most state_limit states and starts over past that. A search that keeps starting over, or finds
+    // another thread using the DFA, steps through the NFA instead, which is slower but just as linear
+    //
+    // Patterns are bytes, literals, ., [a-z] and [^a-z], \d \w \s and their capitals, groups with ( ) or (?: ),
+    // |, *, +, ?, {n}, {n,} and {n,m}. ^ and $ can only start and end the whole pattern
+    class camaroo_regex {
+    public:
+        // Most DFA states kept for one pattern
+        static constexpr size_t state_limit = 1024;
+        // Times a search can start the DFA over before it stops building it
+        static constexpr size_t reset_limit = 8;
+
+        // Most compiled patterns the process keeps, the ones used least recently go first
+        static constexpr size_t cache_limit = 256;
+
+        // The compiled pattern, compiling it when it isn't kept from earlier
+        static std::shared_ptr<const camaroo_regex> compile(const std::string& pattern);
+
+        explicit camaroo_regex(const std::string& pattern);
+
+        // Whether some part of text matches
+        bool search(std::string_view text) const;
+        // The same answer with the NFA alone
+        bool simulate(std::string_view text) const;
+    private:
+        struct term;
+        class parser;
+        struct nfa_state {
+            enum kind_type : uint8_t { bytes, split, match } kind = match;
+            std::bitset<256> accepts;
+            int out = -1;
+            int out1 = -1;
+        };
+        struct dfa_state {
+            std::vector<int> nfa;
+            bool matched = false;
+            std::array<int, 256> next;
+        };
+
+        int emit(const term& node, int next);
+        int add_state(nfa_state state);
+        // The states reachable from these without reading anything, only ones that read a byte or match
+        std::vector<int> closure(std::vector<int> from) const;
+        std::vector<int> step(const std::vector<int>& from, uint8_t byte) const;
+        bool matches(const std::vector<int>& set) const;
+        bool simulate(std::vector<int> set, std::string_view text) const;
+        // Index of the DFA state for set, adding it when it's new
+        int dfa_state_for(std::vector<int> set) const;
+    private:
+        std::vector<nfa_state> nfa;
+        int match_state = -1;
+        std::vector<int> start;
+        bool anchored_start = false;
+        bool anchored_end = false;
+
+        mutable std::mutex building;
+        mutable std::vector<dfa_state> dfa;
+        mutable std::map<std::vector<int>, int> dfa_ids;
+    };
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace camaroo_core {
+
+    // Bounded lock-free queue for any number of producers and consumers (Vyukov's array queue).
+    // Every cell carries a turn number telling whether it is free for the push at that position
+    // or holds the value for the pop at that position, so pushes and pops only contend on one CAS each.
+    // Position p uses cell p % capacity on lap p / capacity, the cell's turn is 2 * lap while it waits
+    // for that lap's push and 2 * lap + 1 while it holds the value, which also works for a capacity of 1.
+    template <typename T>
+    class mpmc_ring {
+    public:
+        explicit mpmc_ring(size_t capacity)
+            :cells(new cell[capacity]), size(capacity)
+        {
+            for (size_t i = 0; i < capacity; ++i)
+                cells[i].turn.store(0, std::memory_order_relaxed);
+        }
+
+        mpmc_ring(const mpmc_ring&) = delete;
+        mpmc_ring& operator=(const mpmc_ring&) = delete;
+
+        size_t capacity() const { return size; }
+
+        // Moves value in and returns true, leaves value alone and returns false when the ring is full
+        bool try_push(T& value) {
+            size_t position = push_position.load(std::memory_order_relaxed);
+            while (true) {
+                cell& slot = cells[position % size];
+                size_t turn = slot.turn.load(std::memory_order_acquire);
+                size_t expected = 2 * (position / size);
+                if (turn == expected) {
+                    if (push_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                        break;
+                } else if (turn < expected) {
+                    return false;
+                } else {
+                    position = push_position.load(std::memory_order_relaxed);
+                }
+            }
+
+            cell& slot = cells[position % size];
+            slot.value = std::move(value);
+            slot.turn.store(2 * (position / size) + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool try_pop(T& out) {
+            size_t position = pop_position.load(std::memory_order_relaxed);
+            while (true) {
+                cell& slot = cells[position % size];
+                size_t turn = slot.turn.load(std::memory_order_acquire);
+                size_t expected = 2 * (position / size) + 1;
+                if (turn == expected) {
+                    if (pop_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                        break;
+                } else if (turn < expected) {
+                    return false;
+                } else {
+                    position = pop_position.load(std::memory_order_relaxed);
+                }
+            }
+
+            cell& slot = cells[position % size];
+            out = std::move(slot.value);
+            slot.value = T();
+            slot.turn.store(2 * (position / size + 1), std::memory_order_release);
+            return true;
+        }
+
+    private:
+        struct cell {
+            std::atomic<size_t> turn;
+            T value;
+        };
+
+        std::unique_ptr<cell[]> cells;
+        size_t size;
+        // Kept on separate cache lines so producers and consumers don't invalidate each other
+        alignas(64) std::atomic<size_t> push_position{0};
+        alignas(64) std::atomic<size_t> pop_position{0};
+    };
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <engine.h>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace camaroo_core {
+
+    // Compiled scripts keyed by a hash of their source, or by the path of the file they came from, so a script that
+    // was seen before skips lexing and parsing. A script is only reused while every file it was linked from still
+    // hashes the same, so editing a module it uses compiles it again.
+    // Safe to use from many threads, the least recently used script goes once capacity is reached.
+    class script_cache {
+    public:
+        script_cache(const Engine& engine, size_t capacity)
+            :engine(engine), capacity(capacity) {}
+
+        // Throws like Engine::compile when source doesn't compile, failures aren't cached
+        std::shared_ptr<const Script> get(const std::string& source);
+        // The file at path, compiled like Engine::compile_file so its modules are found next to it
+        std::shared_ptr<const Script> get_file(const std::string& path);
+        size_t size();
+    private:
+        struct entry {
+            // The source text, or the path of a script compiled from a file
+            std::string origin;
+            bool from_file;
+            std::shared_ptr<const Script> script;
+            uint64_t last_used;
+        };
+
+        std::shared_ptr<const Script> find(uint64_t key, const std::string& origin, bool from_file);
+        void insert(uint64_t key, entry added);
+
+        const Engine& engine;
+        size_t capacity;
+        std::mutex lock;
+        std::unordered_map<uint64_t, entry> scripts;
+        uint64_t clock = 0;
+    };
+
+    // Wire format between camaroo --serve and camaroo --connect, one request per connection.
+    // The client sends "path <absolute path>\n" or "source <byte count>\n<source>".
+    // The server answers with frames of "o<byte count>\n<bytes>" for output and "e<byte count>\n<bytes>" for errors,
+    // in the order they were written, and ends with "x<exit code>\n".
+    namespace protocol {
+        constexpr size_t max_header = 4096;
+        // Longest source a request can send, longer ones are answered with an error
+        constexpr size_t max_source = size_t(64) << 20;
+        // How long the server waits for a whole request to come in, and for each write of its answer to go out
+        constexpr std::chrono::milliseconds timeout{10000};
+    }
+
+    // Accepts requests on a Unix domain socket at socket_path until SIGINT or SIGTERM, running them on worker_count
+    // threads. A client that doesn't send its request or read its answer within timeout is dropped. Returns the
+    // process exit code.
+    int serve(const std::string& socket_path, const Engine& engine, size_t worker_count,
+              std::chrono::milliseconds timeout = protocol::timeout);
+
+    // Sends one request to a server and copies its output to stdout and stderr, returns the script's exit code.
+    // script_path "-" sends standard input as the source.
+    int connect_and_run(const std::string& socket_path, const std::string& script_path);
+}
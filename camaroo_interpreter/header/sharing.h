@@ -0,0 +1,15 @@
+#pragma once
+
+#include <ast.h>
+#include <memory>
+#include <vector>
+
+namespace camaroo_core {
+
+    // Hash-consing for parsed programs. Generated scripts repeat the same expressions over and over, and every copy
+    // is a tree of its own with its own tokens. Pure expressions, built only from names, literals and operators, that
+    // appear more than once are kept once, every place they appeared gets a SharedExpr pointing at that copy.
+    // Copies that repeat inside one expression are memoised, the evaluator computes them once per evaluation.
+    // Bodies the parser skipped are shared when they are parsed. Returns how many nodes went away.
+    size_t share_subtrees(const std::vector<std::unique_ptr<StatementNode>>& statements);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #include <emmintrin.h>
+#endif
+
+namespace camaroo_core::simd {
+
+    enum class arith_op { add, subtract, multiply, divide, modulo };
+    enum class compare_op { equal, not_equal, less, less_equal, greater, greater_equal };
+
+    // Picked once at startup: avx2 when the cpu supports it, sse2 on any other x86-64, scalar elsewhere.
+    const char* active_kernels();
+
+    // out[i] = a[i] op b[i], integer division and modulo by zero have to be rejected by the caller
+    void arith(arith_op op, const int64_t* a, const int64_t* b, int64_t* out, size_t n);
+    void arith(arith_op op, const double* a, const double* b, double* out, size_t n);
+    // out[i] = a[i] op b, or b op a[i] when scalar_left is set
+    void arith_scalar(arith_op op, const int64_t* a, int64_t b, int64_t* out, size_t n, bool scalar_left);
+    void arith_scalar(arith_op op, const double* a, double b, double* out, size_t n, bool scalar_left);
+
+    // Integer sums wrap on overflow so the result never depends on the order of accumulation
+    int64_t sum(const int64_t* a, size_t n);
+    double sum(const double* a, size_t n);
+    int64_t min(const int64_t* a, size_t n); // n must be > 0
+    double min(const double* a, size_t n);
+    int64_t max(const int64_t* a, size_t n);
+    double max(const double* a, size_t n);
+    int64_t dot(const int64_t* a, const int64_t* b, size_t n);
+    double dot(const double* a, const double* b, size_t n);
+
+    // mask[i] = a[i] op b, one byte (0 or 1) per element
+    void compare_scalar(compare_op op, const int64_t* a, int64_t b, uint8_t* mask, size_t n);
+    void compare_scalar(compare_op op, const double* a, double b, uint8_t* mask, size_t n);
+    void compare(compare_op op, const int64_t* a, const int64_t* b, uint8_t* mask, size_t n);
+    void compare(compare_op op, const double* a, const double* b, uint8_t* mask, size_t n);
+    // Bytes compare unsigned, these are what lists of letters hold
+    void compare_scalar(compare_op op, const uint8_t* a, uint8_t b, uint8_t* mask, size_t n);
+    void compare(compare_op op, const uint8_t* a, const uint8_t* b, uint8_t* mask, size_t n);
+
+    // Copies every a[i] with mask[i] != 0 to out, returns the number of copied elements.
+    // out must have room for n elements.
+    size_t compress(const int64_t* a, const uint8_t* mask, int64_t* out, size_t n);
+    size_t compress(const double* a, const uint8_t* mask, double* out, size_t n);
+    size_t count(const uint8_t* mask, size_t n);
+
+    // Bytes hash tables read together, match_group sets bit i when group[i] == byte. It's here rather than behind
+    // the dispatch so a probe doesn't pay a call for every group it reads, and sse2 is always there on x86-64
+    constexpr size_t group_width = 16;
+    inline uint32_t match_group(const uint8_t* group, uint8_t byte) {
+#if defined(__x86_64__) || defined(_M_X64)
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(static_cast<char>(byte)))));
+#else
+        uint32_t bits = 0;
+        for (size_t i = 0; i < group_width; ++i)
+            bits |= static_cast<uint32_t>(group[i] == byte) << i;
+        return bits;
+#endif
+    }
+
+    // Offset of the first needle in haystack, n when it isn't there and 0 for an empty needle. Bytes go through
+    // memchr, longer needles test a vector of positions at a time for their first and last bytes and only compare
+    // the rest where both match
+    size_t find(const char* haystack, size_t n, const char* needle, size_t m);
+}
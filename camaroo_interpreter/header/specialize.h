@@ -0,0 +1,29 @@
+#pragma once
+
+#include <ast.h>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace camaroo_core {
+
+    // Most iterations a loop can have and still be unrolled
+    constexpr size_t unroll_limit = 16;
+
+    // Top level variables fixed for every run of a script and the values they get, as written after --specialize
+    using specializations = std::vector<std::pair<std::string, std::string>>;
+
+    // Splits name=value,name=value. Throws when a pair has no name or no =
+    specializations parse_specializations(const std::string& list);
+
+    // Partial evaluation against fixed inputs. The top level declaration of each variable in fixed is given its value,
+    // read as the type the variable is declared with, and when nothing declares or assigns the variable again the
+    // reads after it become that value. Then expressions on literals alone are folded, range loops with literal
+    // bounds and at most unroll_limit iterations become a block per iteration, and what that leaves unused goes:
+    // loops that never run, statements that are only a literal and declarations of fixed variables nothing reads
+    // anymore. Parallel loops stay loops, func and gen bodies are left for their first call and read fixed variables
+    // like before. Throws when a variable isn't declared at the top level or its value doesn't fit the type.
+    // Runs before check_types and optimize. Returns how many loops were unrolled
+    size_t specialize(std::vector<std::unique_ptr<StatementNode>>& statements, const specializations& fixed);
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <ast.h>
+#include <memory>
+#include <vector>
+
+namespace camaroo_core {
+
+    // Turns chains of + - * / % on one operand with num literals, like x * 2, (x + 1) * 4 - 3 or x % 16,
+    // into ArithChainExprs. Constants are folded across the whole chain, identities like x * 1 and x + 0 disappear,
+    // multiplies by powers of two become shifts and divisions by constants become shifts or multiplies by magic
+    // numbers. Returns how many chains were made
+    size_t reduce_strength(const std::vector<std::unique_ptr<StatementNode>>& statements);
+
+    // The plan for a num going through steps, exposed for tests
+    IntPlan plan_steps(const std::vector<ArithStep>& steps);
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace camaroo_core {
+
+    // Runs spawned tasks on a small set of runner threads. Every task gets its own stack, so a task that
+    // has to wait on a channel or on the tasks it spawned parks on a wait_list and its runner moves on to
+    // the next one, thousands of blocked tasks cost memory but no threads. Waits that can't park, anything
+    // off a task or on platforms without stack switching, still block the thread. A runner that is about to
+    // do that says so, and when every runner is blocked while tasks are still queued a spare one is started.
+    class task_scheduler {
+    public:
+        // Runners are only started once the first task is spawned
+        explicit task_scheduler(size_t runner_count);
+        ~task_scheduler();
+
+        task_scheduler(const task_scheduler&) = delete;
+        task_scheduler& operator=(const task_scheduler&) = delete;
+
+        void spawn(std::function<void()> task);
+
+        // Scheduler used for spawn statements, it gets as many runners as the shared thread_pool has threads
+        static task_scheduler& shared();
+
+        // How deep the evaluator's calls are nested on whatever is running now. Kept per task, so a task
+        // parked in the middle of a call doesn't count against the one its runner picks up next.
+        static size_t& call_depth();
+
+        struct task;
+
+        // Tasks parked until whatever they wait for changes
+        class wait_list {
+        public:
+            // Parks the calling task if still_blocked() holds once the list is locked, so a wake_all from
+            // between the caller's own check and here isn't lost. Returns false without waiting when the
+            // caller isn't a task that can park, it has to block its thread instead.
+            bool park(const std::function<bool()>& still_blocked);
+            // Queues the task parked longest again, it checks for itself whether to go on
+            void wake_one();
+            // Same for every parked task
+            void wake_all();
+        private:
+            friend class task_scheduler;
+            std::mutex lock;
+            std::deque<task*> parked;
+            std::atomic<size_t> count{0};
+        };
+
+        // Wraps a wait that can last, only does something on runner threads
+        class blocking_scope {
+        public:
+            blocking_scope();
+            ~blocking_scope();
+        private:
+            task_scheduler* owner;
+        };
+
+    private:
+        void start_runner();
+        void runner_loop();
+        void run(task* current);
+        void resume(task* parked);
+        void* take_stack();
+        void give_back_stack(void* stack);
+    private:
+        std::mutex lock;
+        std::condition_variable ready;
+        std::deque<task*> queue;
+        std::vector<std::thread> runners;
+        // Stacks of finished tasks, the next ones reuse them instead of mapping new ones
+        std::vector<void*> spare_stacks;
+        size_t base_count;
+        size_t idle = 0;
+        size_t blocked = 0;
+        bool stopping = false;
+    };
+
+    // Counts the tasks spawned through it so they can be joined together
+    class task_group {
+    public:
+        void spawn(task_scheduler& scheduler, std::function<void()> task);
+        void wait();
+    private:
+        std::mutex lock;
+        std::condition_variable finished;
+        // Tasks waiting on the group park here
+        task_scheduler::wait_list waiters;
+        std::atomic<size_t> pending{0};
+    };
+}
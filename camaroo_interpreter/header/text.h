@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace camaroo_core {
+
+    // Text values. They never change once made, so copies share what they hold and x = y can't leak a later change
+    // into both. Short texts sit in place, longer ones in a node every copy points at. Joining long texts with +
+    // makes a node pointing at both halves instead of copying them, and short pieces added to the end are gathered
+    // into chunks, so text built a piece at a time costs about a node per chunk and not a copy of everything so far.
+    // The pieces are put together the first time the whole text is needed in one piece, and kept that way. Slices
+    // longer than a text kept in place point into the text they came from instead of copying it
+    class camaroo_text {
+    public:
+        // Longest text kept in place
+        static constexpr size_t inline_capacity = 15;
+        // Joined texts up to this long, and the chunks pieces are gathered into, are one piece
+        static constexpr size_t flat_limit = 128;
+
+        camaroo_text() = default;
+        explicit camaroo_text(std::string_view text);
+        // Keeps text's buffer instead of copying it
+        static camaroo_text take(std::string&& text);
+
+        size_t size() const { return shared ? shared->length : length; }
+        bool empty() const { return size() == 0; }
+        // The whole text, joining its pieces the first time. Valid for as long as this text or a copy of it is
+        std::string_view view() const;
+        std::string str() const { return std::string(view()); }
+        // count bytes from offset on, as far as the text goes
+        camaroo_text slice(size_t offset, size_t count) const;
+        // Writes the pieces one after another without joining them
+        void write(std::ostream& out) const;
+        int compare(const camaroo_text& other) const { return view().compare(other.view()); }
+        bool operator==(const camaroo_text& other) const { return size() == other.size() && compare(other) == 0; }
+        bool operator!=(const camaroo_text& other) const { return !(*this == other); }
+
+        friend camaroo_text operator+(const camaroo_text& left, const camaroo_text& right);
+    private:
+        // A piece of text, a slice of one, or two texts joined. Nodes never change after they're shared, but for the
+        // text of a joined node, filled once by view()
+        struct node {
+            size_t length = 0;
+            std::shared_ptr<const node> left;
+            std::shared_ptr<const node> right;
+            // The node a slice points into, never a slice itself
+            std::shared_ptr<const node> base;
+            mutable std::string text;
+            // The whole node once it's flat, in text or in base's text for slices
+            mutable std::string_view span;
+            // Set once span holds the whole node, from the start for pieces and slices
+            mutable std::atomic<bool> flat{false};
+            mutable std::once_flag joining;
+
+            node() = default;
+            explicit node(std::string_view piece)
+                :length(piece.size()), text(piece), span(text), flat(true) {}
+            explicit node(std::string&& piece)
+                :length(piece.size()), text(std::move(piece)), span(text), flat(true) {}
+            node(std::shared_ptr<const node> whole, std::string_view part)
+                :length(part.size()), base(std::move(whole)), span(part), flat(true) {}
+            ~node();
+        };
+
+        explicit camaroo_text(std::shared_ptr<const node> joined)
+            :shared(std::move(joined)) {}
+        // This text as a node, texts kept in place get one made
+        std::shared_ptr<const node> as_node() const;
+        // Hands every piece of root to visit in order, going no deeper than a node that's already one piece
+        template <typename Visit>
+        static void for_each_piece(const node& root, Visit&& visit);
+    private:
+        std::shared_ptr<const node> shared;
+        uint8_t length = 0;
+        char small[inline_capacity] = {};
+    };
+
+    inline std::ostream& operator<<(std::ostream& out, const camaroo_text& text) {
+        text.write(out);
+        return out;
+    }
+
+    // The character starting at offset in UTF-8 text, used is set to how many bytes it takes. A byte that doesn't
+    // start a whole character comes out as itself
+    char32_t decode_utf8(std::string_view text, size_t offset, size_t& used);
+    // Adds letter to out as UTF-8
+    void append_utf8(std::string& out, char32_t letter);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace camaroo_core {
+
+    // Work-stealing pool: every worker owns a deque it pushes to and pops from at the back,
+    // idle workers steal from the front of the others. Threads that wait for work they
+    // submitted keep running queued tasks instead of blocking, so nested parallel calls can't deadlock.
+    class thread_pool {
+    public:
+        // thread_count is the total parallelism including the calling thread, so 1 runs everything inline
+        explicit thread_pool(size_t thread_count);
+        ~thread_pool();
+
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+
+        size_t size() const { return workers.size() + 1; }
+
+        // Calls body(begin, end) for the chunks [i * grain, (i + 1) * grain) of [0, count) and returns once all ran.
+        // Chunk boundaries depend only on count and grain, never on the number of threads, so per-chunk
+        // results combined in chunk order are deterministic. The first exception thrown by a chunk is rethrown here.
+        void parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+        // Queues fn to run on some worker, wait with wait_idle()
+        void submit(std::function<void()> fn);
+        void wait_idle();
+
+        // Pool shared by everything that isn't handed a pool of its own
+        static thread_pool& shared();
+        // Only takes effect when called before the first shared() call
+        static void set_shared_threads(size_t thread_count);
+    private:
+        struct task {
+            void (*run)(void* context, size_t first, size_t last);
+            void* context;
+            size_t first;
+            size_t last;
+        };
+
+        struct work_queue {
+            std::mutex lock;
+            std::deque<task> tasks;
+        };
+
+        struct loop_job;
+
+        void push(const task& new_task);
+        bool pop_or_steal(task& found);
+        bool run_one();
+        void worker_loop(size_t index);
+        static void run_loop_chunks(void* context, size_t first, size_t last);
+        static void run_submitted(void* context, size_t, size_t);
+    private:
+        std::vector<std::thread> workers;
+        // One queue per worker and a last one shared by threads outside the pool
+        std::vector<std::unique_ptr<work_queue>> queues;
+        std::atomic<size_t> queued{0};
+        std::atomic<size_t> outstanding{0};
+        std::atomic<bool> stopping{false};
+        std::mutex sleep_lock;
+        std::condition_variable wake_up;
+        std::atomic<size_t> sleepers{0};
+    };
+}
@@ -10,25 +10,41 @@ namespace camaroo_core {
         // data values
         num, fnum,
         letter, text,
+        // Text with {expression} slots, braces that stand for themselves are doubled
+        format,
         toggle,
+        list, channel, generator, map,
         // math operators
         add, subtract, multiply, division, equal, modulo,
         //logical operators
         equal_operator, and_operator, or_operator, not_operator,
+        not_equal_operator, less_operator, less_equal_operator, greater_operator, greater_equal_operator,
         // other
         LCurlyBrace, RCurlyBrace,
         LParen, RParen,
         LSquareBracket, RSquareBracket,
-        semicolon,
+        semicolon, comma, arrow,
         // data types
         num_type,
         fnum_type,
         text_type,letter_type,
         toggle_type,
-        func_type,
+        func_type, gen_type,
+        list_type,
+        channel_type,
+        map_type,
         // print
         print,
         println,
+        // loops
+        for_keyword, in_keyword, to_keyword,
+        parallel_keyword, reduce_keyword,
+        // tasks
+        spawn_keyword,
+        // functions
+        return_keyword, yield_keyword,
+        // modules
+        use_keyword,
     };
 
     struct Token {
@@ -41,9 +57,16 @@ namespace camaroo_core {
             Tokenizer(const std::string& text);
             std::optional<Token> next_token();
             std::optional<Token> peek_next_token();
+            size_t position() const { return pos; }
+            // Moves past the } closing a block whose { was just read, without making tokens of what's inside.
+            // Returns false and stays put when the block is never closed
+            bool skip_block();
         private:
             void advance();
             std::string get_number();
+            // Copies a {slot} of a text literal as written, up to its closing brace. Slots don't go past the end of
+            // the line, returns false when it comes first
+            bool copy_slot(std::string& into);
             Token return_num_token(const std::string& result);
             Token return_fnum_token(const std::string& result);
             TokenType check_std_type(const std::string& result);
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <ast.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace camaroo_core {
+
+    // Static type checking for parsed programs. Works out the kind of value expressions give wherever it is known
+    // before running: literals, loop variables, parameters, variables that are only ever given one kind, calls
+    // to funcs declared earlier in the same body and calls to built-ins the program declares no func in place of.
+    // Names the program doesn't declare, like globals an embedder hands in or the REPL kept from earlier lines, can
+    // be anything. Declarations and assignments that don't fit the declared type are errors, and so is arithmetic,
+    // comparing, looping or calling that would fail at runtime with the kinds found. Arithmetic and comparisons
+    // between two nums or two fnums are marked for the evaluator. Skipped bodies are marked checked and checked when
+    // they're parsed. Returns the errors in source order
+    std::vector<std::string> check_types(const std::vector<std::unique_ptr<StatementNode>>& statements);
+    // The same for the body of definition on its own, with nothing known but the parameters
+    std::vector<std::string> check_body(const FunctionDef& definition, const std::vector<std::unique_ptr<StatementNode>>& statements);
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+namespace camaroo_core {
+
+    inline constexpr const char* camaroo_version = "0.0.1";
+}
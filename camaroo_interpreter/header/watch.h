@@ -0,0 +1,64 @@
+#pragma once
+
+#include <engine.h>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace camaroo_core {
+
+    // Reruns new versions of a script, executing only what a change can reach. Every top level statement's result
+    // is remembered with the versions of the globals it read. When a statement's text and the versions of its inputs
+    // are the same as last time, its globals and output come back from the cache instead of running it again.
+    // Globals get a new version whenever a statement that writes them runs.
+    class watch_session {
+    public:
+        watch_session(thread_pool& pool, std::ostream& out, std::ostream& err);
+
+        watch_session(const watch_session&) = delete;
+        watch_session& operator=(const watch_session&) = delete;
+
+        // Runs program against fresh globals, returns how many statements had to run
+        size_t run(const Program& program);
+    private:
+        // Passes output through and keeps a copy of it for the statement that is running
+        class capture_buffer : public std::streambuf {
+        public:
+            explicit capture_buffer(std::ostream& target)
+                :target(target) {}
+            std::string take();
+        protected:
+            std::streamsize xsputn(const char* text, std::streamsize length) override;
+            int_type overflow(int_type c) override;
+        private:
+            std::ostream& target;
+            std::mutex lock;
+            std::string captured;
+        };
+
+        struct result {
+            std::vector<std::pair<std::string, uint64_t>> inputs;
+            // Globals the statement left behind, with the versions they got
+            std::vector<std::pair<std::string, uint64_t>> output_versions;
+            std::vector<std::shared_ptr<camaroo_object>> output_values;
+            std::string printed;
+        };
+    private:
+        thread_pool& pool;
+        capture_buffer buffer;
+        std::ostream captured_out;
+        output_stream output;
+        std::unique_ptr<evaluator> globals;
+        // Keyed by statement text, a statement that appears more than once has a result per copy
+        std::unordered_map<std::string, std::vector<result>> results;
+        uint64_t last_version = 0;
+    };
+
+    // camaroo --watch: runs the file at path and again every time it is saved, until the process is stopped.
+    // Returns only when path can't be read to begin with.
+    int watch(const std::string& path, const Engine& engine, const ast_cache::settings& cache);
+}
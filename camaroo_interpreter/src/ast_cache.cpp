@@ -0,0 +1,577 @@
+#include <ast_cache.h>
+#include <hash.h>
+#include <version.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace camaroo_core {
+
+    namespace {
+
+        constexpr char magic[4] = {'C', 'M', 'R', 'C'};
+
+        bool is_type_keyword(TokenType type) {
+            return type == TokenType::num_type || type == TokenType::fnum_type || type == TokenType::toggle_type ||
+                   type == TokenType::text_type || type == TokenType::letter_type || type == TokenType::list_type ||
+                   type == TokenType::channel_type || type == TokenType::map_type;
+        }
+
+        // Whether the parser makes nodes of kind with this token type
+        bool token_fits(NodeKind kind, TokenType type) {
+            switch (kind) {
+                case NodeKind::identifier: return type == TokenType::identifier;
+                case NodeKind::text: return type == TokenType::text;
+                case NodeKind::letter: return type == TokenType::letter;
+                case NodeKind::toggle: return type == TokenType::toggle;
+                case NodeKind::num: return type == TokenType::num;
+                case NodeKind::fnum: return type == TokenType::fnum;
+                case NodeKind::format: return type == TokenType::format;
+                case NodeKind::prefix: return type == TokenType::subtract;
+                case NodeKind::infix:
+                    switch (type) {
+                        case TokenType::add: case TokenType::subtract: case TokenType::multiply: case TokenType::division:
+                        case TokenType::modulo: case TokenType::equal_operator: case TokenType::not_equal_operator:
+                        case TokenType::less_operator: case TokenType::less_equal_operator: case TokenType::greater_operator:
+                        case TokenType::greater_equal_operator: case TokenType::to_keyword:
+                            return true;
+                        default:
+                            return false;
+                    }
+                case NodeKind::list: return type == TokenType::LSquareBracket;
+                case NodeKind::channel: return type == TokenType::channel_type;
+                case NodeKind::map: return type == TokenType::map_type;
+                case NodeKind::call: return type == TokenType::LParen;
+                case NodeKind::assign: return type == TokenType::equal || is_type_keyword(type);
+                case NodeKind::return_stmnt: return type == TokenType::return_keyword;
+                case NodeKind::yield_stmnt: return type == TokenType::yield_keyword;
+                case NodeKind::block: return type == TokenType::LCurlyBrace;
+                case NodeKind::for_loop: return type == TokenType::for_keyword;
+                case NodeKind::spawn: return type == TokenType::spawn_keyword;
+                case NodeKind::use_stmnt: return type == TokenType::use_keyword;
+                case NodeKind::function: return type == TokenType::func_type || type == TokenType::gen_type;
+                case NodeKind::print:
+                case NodeKind::println:
+                case NodeKind::expression_stmnt:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        class writer {
+        public:
+            void byte(uint8_t value) { data.push_back(static_cast<char>(value)); }
+            void u32(uint32_t value) { data.append(reinterpret_cast<const char*>(&value), sizeof(value)); }
+            void u64(uint64_t value) { data.append(reinterpret_cast<const char*>(&value), sizeof(value)); }
+            void text(const std::string& value) {
+                u32(static_cast<uint32_t>(value.size()));
+                data += value;
+            }
+            void token(const Token& value) {
+                u32(static_cast<uint32_t>(value.type));
+                text(value.value);
+            }
+
+            void node(ASTNode* node);
+            void statements(const std::vector<std::unique_ptr<StatementNode>>& body) {
+                u32(static_cast<uint32_t>(body.size()));
+                for (const auto& statement : body)
+                    node(statement.get());
+            }
+            void expressions(const std::vector<std::unique_ptr<ExpressionNode>>& items) {
+                u32(static_cast<uint32_t>(items.size()));
+                for (const auto& item : items)
+                    node(item.get());
+            }
+
+            std::string data;
+        };
+
+        // The token of nodes that keep it as their value
+        Token node_token(ASTNode* node) {
+            return Token{node->token_type(), std::get<std::string>(node->token_value())};
+        }
+
+        void writer::node(ASTNode* node) {
+            if (!node) {
+                byte(static_cast<uint8_t>(NodeKind::none));
+                return;
+            }
+            byte(static_cast<uint8_t>(node->node_kind()));
+
+            switch (node->node_kind()) {
+                case NodeKind::identifier:
+                case NodeKind::text:
+                case NodeKind::letter:
+                    token(node_token(node));
+                    return;
+                case NodeKind::toggle:
+                case NodeKind::num:
+                case NodeKind::fnum:
+                    // Literals are rebuilt from the text they were written as
+                    token(Token{node->token_type(), node->to_string()});
+                    return;
+                case NodeKind::prefix:
+                    token(node_token(node));
+                    this->node(node->get_right());
+                    return;
+                case NodeKind::infix:
+                    token(node_token(node));
+                    this->node(node->get_left());
+                    this->node(node->get_right());
+                    return;
+                case NodeKind::list:
+                    token(node_token(node));
+                    expressions(static_cast<ListExpr*>(node)->get_elements());
+                    return;
+                case NodeKind::format: {
+                    auto* format = static_cast<FormatExpr*>(node);
+                    token(node_token(node));
+                    u32(static_cast<uint32_t>(format->get_pieces().size()));
+                    for (const camaroo_text& piece : format->get_pieces())
+                        text(piece.str());
+                    expressions(format->get_slots());
+                    return;
+                }
+                case NodeKind::channel:
+                    token(node_token(node));
+                    token(static_cast<ChannelExpr*>(node)->get_element_type());
+                    this->node(node->get_right());
+                    return;
+                case NodeKind::map:
+                    token(node_token(node));
+                    token(static_cast<MapExpr*>(node)->get_key_type());
+                    token(static_cast<MapExpr*>(node)->get_value_type());
+                    return;
+                case NodeKind::call:
+                    token(node_token(node));
+                    this->node(node->get_left());
+                    expressions(static_cast<CallExpr*>(node)->get_arguments());
+                    return;
+                case NodeKind::assign:
+                    token(node_token(node));
+                    this->node(node->get_left());
+                    this->node(node->get_right());
+                    return;
+                case NodeKind::print:
+                case NodeKind::println:
+                case NodeKind::expression_stmnt:
+                    this->node(node->get_right());
+                    return;
+                case NodeKind::return_stmnt:
+                case NodeKind::yield_stmnt:
+                    token(node_token(node));
+                    this->node(node->get_right());
+                    return;
+                case NodeKind::block: {
+                    auto* block = static_cast<BlockStmnt*>(node);
+                    token(node_token(node));
+                    byte(block->has_yield());
+                    statements(block->get_statements());
+                    return;
+                }
+                case NodeKind::for_loop: {
+                    auto* loop = static_cast<ForStmnt*>(node);
+                    token(node_token(node));
+                    token(loop->get_variable_type());
+                    this->node(loop->get_left());
+                    this->node(loop->get_iterable());
+                    this->node(loop->get_body());
+                    byte(loop->is_parallel());
+                    u32(static_cast<uint32_t>(loop->get_reductions().size()));
+                    for (const auto& clause : loop->get_reductions()) {
+                        token(clause.op);
+                        text(clause.variable);
+                    }
+                    return;
+                }
+                case NodeKind::spawn:
+                    token(node_token(node));
+                    this->node(node->get_right());
+                    return;
+                case NodeKind::use_stmnt:
+                    token(node_token(node));
+                    text(static_cast<UseStmnt*>(node)->get_module());
+                    return;
+                case NodeKind::function: {
+                    const FunctionDef& definition = *static_cast<FuncStmnt*>(node)->get_definition();
+                    token(definition.kind);
+                    text(definition.name);
+                    u32(static_cast<uint32_t>(definition.parameters.size()));
+                    for (const auto& parameter : definition.parameters) {
+                        token(parameter.type);
+                        text(parameter.name);
+                    }
+                    token(definition.return_type);
+                    // Skipped bodies stay skipped, their source goes in the cache instead
+                    byte(definition.is_deferred() ? 1 : 0);
+                    if (definition.is_deferred())
+                        text(std::string(definition.body_source()));
+                    else
+                        this->node(definition.body.get());
+                    return;
+                }
+                case NodeKind::shared:
+                case NodeKind::arith_chain:
+                case NodeKind::hoisted:
+                case NodeKind::induction:
+                case NodeKind::slot:
+                case NodeKind::inlined:
+                    throw std::runtime_error("Error: only parsed trees go in a cache file, this one was optimized");
+                case NodeKind::none:
+                    return;
+            }
+        }
+
+        // Every read checks the bounds, a file cut short throws and is treated as stale
+        class reader {
+        public:
+            reader(const char* data, size_t size)
+                :data(data), size(size) {}
+
+            const char* take(size_t count) {
+                if (count > size - offset)
+                    throw std::runtime_error("cache file is cut short");
+                const char* at = data + offset;
+                offset += count;
+                return at;
+            }
+            uint8_t byte() { return static_cast<uint8_t>(*take(1)); }
+            uint32_t u32() {
+                uint32_t value;
+                std::memcpy(&value, take(sizeof(value)), sizeof(value));
+                return value;
+            }
+            uint64_t u64() {
+                uint64_t value;
+                std::memcpy(&value, take(sizeof(value)), sizeof(value));
+                return value;
+            }
+            std::string text() {
+                uint32_t length = u32();
+                return std::string(take(length), length);
+            }
+            Token token() {
+                TokenType type = static_cast<TokenType>(u32());
+                return Token{type, text()};
+            }
+            // The type keyword of a declaration, a parameter or what a channel or map holds
+            Token type_token() {
+                Token read = token();
+                if (!is_type_keyword(read.type))
+                    throw std::runtime_error("cache file has a bad type");
+                return read;
+            }
+            // Element counts, every element takes at least a byte so a count past the end of the data is corrupt
+            size_t count() {
+                uint32_t value = u32();
+                if (value > size - offset)
+                    throw std::runtime_error("cache file has a bad count");
+                return value;
+            }
+            bool done() const { return offset == size; }
+            std::string_view rest() const { return std::string_view(data + offset, size - offset); }
+
+            // Never null, with expected none any node that is a T will do
+            template <typename T>
+            std::unique_ptr<T> node_as(NodeKind expected = NodeKind::none);
+            std::unique_ptr<ExpressionNode> expression() { return node_as<ExpressionNode>(); }
+            std::unique_ptr<ExpressionNode> optional_expression();
+            std::unique_ptr<StatementNode> statement() { return node_as<StatementNode>(); }
+
+        private:
+            std::unique_ptr<ASTNode> node();
+            std::unique_ptr<ASTNode> node_of(NodeKind kind);
+
+            const char* data;
+            size_t size;
+            size_t offset = 0;
+        };
+
+        template <typename T>
+        std::unique_ptr<T> reader::node_as(NodeKind expected) {
+            std::unique_ptr<ASTNode> found = node();
+            T* typed = found ? dynamic_cast<T*>(found.get()) : nullptr;
+            if (!typed || (expected != NodeKind::none && found->node_kind() != expected))
+                throw std::runtime_error("cache file has the wrong node");
+            found.release();
+            return std::unique_ptr<T>(typed);
+        }
+
+        // Expressions that may be left out, like the value of return; in a gen
+        std::unique_ptr<ExpressionNode> reader::optional_expression() {
+            if (offset < size && static_cast<NodeKind>(data[offset]) == NodeKind::none) {
+                ++offset;
+                return nullptr;
+            }
+            return expression();
+        }
+
+        // The evaluator picks what to do with a node by its token type, so every node has to carry one the parser
+        // would have given a node of its kind
+        std::unique_ptr<ASTNode> reader::node() {
+            std::unique_ptr<ASTNode> read = node_of(static_cast<NodeKind>(byte()));
+            if (read && !token_fits(read->node_kind(), read->token_type()))
+                throw std::runtime_error("cache file has a node with the wrong token");
+            return read;
+        }
+
+        std::unique_ptr<ASTNode> reader::node_of(NodeKind kind) {
+            switch (kind) {
+                case NodeKind::none:
+                    return nullptr;
+                case NodeKind::identifier:
+                    return std::make_unique<IdentifierNode>(token());
+                case NodeKind::text:
+                    return std::make_unique<TextExpr>(token());
+                case NodeKind::letter:
+                    return std::make_unique<LetterExpr>(token());
+                case NodeKind::toggle:
+                    return std::make_unique<ToggleExpr>(token());
+                case NodeKind::num:
+                    return std::make_unique<NumExpr>(token());
+                case NodeKind::fnum:
+                    return std::make_unique<FNumExpr>(token());
+                case NodeKind::prefix: {
+                    Token op = token();
+                    return std::make_unique<PrefixExpr>(op, expression());
+                }
+                case NodeKind::infix: {
+                    Token op = token();
+                    std::unique_ptr<ExpressionNode> left = expression();
+                    return std::make_unique<InfixExpr>(op, std::move(left), expression());
+                }
+                case NodeKind::list: {
+                    Token open = token();
+                    std::vector<std::unique_ptr<ExpressionNode>> elements(count());
+                    for (auto& element : elements)
+                        element = expression();
+                    return std::make_unique<ListExpr>(open, std::move(elements));
+                }
+                case NodeKind::format: {
+                    Token literal = token();
+                    std::vector<camaroo_text> pieces;
+                    for (size_t i = count(); i > 0; --i)
+                        pieces.emplace_back(text());
+                    std::vector<std::unique_ptr<ExpressionNode>> slots(count());
+                    for (auto& slot : slots)
+                        slot = expression();
+                    if (pieces.size() != slots.size() + 1)
+                        throw std::runtime_error("cache file has a bad text format");
+                    return std::make_unique<FormatExpr>(literal, std::move(pieces), std::move(slots));
+                }
+                case NodeKind::channel: {
+                    Token channel = token();
+                    Token element_type = type_token();
+                    return std::make_unique<ChannelExpr>(channel, element_type, expression());
+                }
+                case NodeKind::map: {
+                    Token map = token();
+                    Token key_type = type_token();
+                    Token value_type = type_token();
+                    return std::make_unique<MapExpr>(map, key_type, value_type);
+                }
+                case NodeKind::call: {
+                    Token open = token();
+                    std::unique_ptr<ExpressionNode> callee = node_as<IdentifierNode>(NodeKind::identifier);
+                    std::vector<std::unique_ptr<ExpressionNode>> arguments(count());
+                    for (auto& argument : arguments)
+                        argument = expression();
+                    return std::make_unique<CallExpr>(open, std::move(callee), std::move(arguments));
+                }
+                case NodeKind::assign: {
+                    Token type = token();
+                    std::unique_ptr<IdentifierNode> name = node_as<IdentifierNode>(NodeKind::identifier);
+                    return std::make_unique<AssignStmnt>(type, std::move(name), expression());
+                }
+                case NodeKind::print:
+                    return std::make_unique<PrintStmnt>(expression());
+                case NodeKind::println:
+                    return std::make_unique<PrintlnStmnt>(expression());
+                case NodeKind::expression_stmnt:
+                    return std::make_unique<ExprStmnt>(expression());
+                case NodeKind::return_stmnt: {
+                    Token keyword = token();
+                    return std::make_unique<ReturnStmnt>(keyword, optional_expression());
+                }
+                case NodeKind::yield_stmnt: {
+                    Token keyword = token();
+                    return std::make_unique<YieldStmnt>(keyword, optional_expression());
+                }
+                case NodeKind::block: {
+                    Token open = token();
+                    bool has_yield = byte() != 0;
+                    std::vector<std::unique_ptr<StatementNode>> body(count());
+                    for (auto& item : body)
+                        item = statement();
+                    return std::make_unique<BlockStmnt>(open, std::move(body), has_yield);
+                }
+                case NodeKind::for_loop: {
+                    Token keyword = token();
+                    Token variable_type = type_token();
+                    std::unique_ptr<IdentifierNode> variable = node_as<IdentifierNode>(NodeKind::identifier);
+                    std::unique_ptr<ExpressionNode> iterable = expression();
+                    std::unique_ptr<BlockStmnt> body = node_as<BlockStmnt>(NodeKind::block);
+                    bool parallel = byte() != 0;
+                    std::vector<ReductionClause> reductions(count());
+                    for (auto& clause : reductions) {
+                        clause.op = token();
+                        clause.variable = text();
+                        if (clause.op.type != TokenType::add && clause.op.type != TokenType::multiply &&
+                            clause.op.value != "min" && clause.op.value != "max")
+                            throw std::runtime_error("cache file has a bad reduce clause");
+                    }
+                    return std::make_unique<ForStmnt>(keyword, variable_type, std::move(variable), std::move(iterable),
+                                                      std::move(body), parallel, std::move(reductions));
+                }
+                case NodeKind::spawn: {
+                    Token keyword = token();
+                    return std::make_unique<SpawnStmnt>(keyword, node_as<BlockStmnt>(NodeKind::block));
+                }
+                case NodeKind::use_stmnt: {
+                    Token keyword = token();
+                    return std::make_unique<UseStmnt>(keyword, text());
+                }
+                case NodeKind::function: {
+                    auto definition = std::make_shared<FunctionDef>();
+                    definition->kind = token();
+                    definition->name = text();
+                    definition->parameters.resize(count());
+                    for (auto& parameter : definition->parameters) {
+                        parameter.type = type_token();
+                        parameter.name = text();
+                    }
+                    definition->return_type = type_token();
+                    if (byte() == 1) {
+                        auto body = std::make_shared<const std::string>(text());
+                        definition->body_end = body->size();
+                        definition->source = std::move(body);
+                    }
+                    else {
+                        definition->body = node_as<BlockStmnt>(NodeKind::block);
+                    }
+                    return std::make_unique<FuncStmnt>(std::move(definition));
+                }
+                case NodeKind::shared:
+                case NodeKind::arith_chain:
+                case NodeKind::hoisted:
+                case NodeKind::induction:
+                case NodeKind::slot:
+                case NodeKind::inlined:
+                    break;
+            }
+            throw std::runtime_error("cache file has an unknown node");
+        }
+
+        // The body's hash comes last, a file that was damaged after it was written doesn't match it
+        void write_header(writer& out, uint64_t source_hash, std::string_view body) {
+            out.data.append(magic, sizeof(magic));
+            out.u32(ast_cache::format_version);
+            out.text(camaroo_version);
+            out.u64(source_hash);
+            out.u64(content_hash(body));
+        }
+
+        bool header_matches(reader& in, uint64_t source_hash) {
+            if (std::memcmp(in.take(sizeof(magic)), magic, sizeof(magic)) != 0 || in.u32() != ast_cache::format_version ||
+                in.text() != camaroo_version || in.u64() != source_hash)
+                return false;
+            uint64_t body_hash = in.u64();
+            return body_hash == content_hash(in.rest());
+        }
+    }
+
+    namespace ast_cache {
+
+        std::string serialize(const Program& program, uint64_t source_hash) {
+            writer body;
+            body.statements(program.statements);
+            writer out;
+            write_header(out, source_hash, body.data);
+            return out.data + body.data;
+        }
+
+        std::optional<Program> deserialize(const char* data, size_t size, uint64_t source_hash) {
+            try {
+                reader in(data, size);
+                if (!header_matches(in, source_hash))
+                    return std::nullopt;
+
+                Program program;
+                program.statements.resize(in.count());
+                for (auto& statement : program.statements)
+                    statement = in.statement();
+                if (!in.done())
+                    return std::nullopt;
+                return program;
+            }
+            catch (const std::exception&) {
+                return std::nullopt;
+            }
+        }
+
+        std::string cache_path(const std::string& source_path, const std::string& cache_dir) {
+            if (cache_dir.empty())
+                return source_path + "c";
+
+            char name[32];
+            std::snprintf(name, sizeof(name), "%016llx.cmrc", static_cast<unsigned long long>(content_hash(source_path)));
+            return cache_dir + ((cache_dir.back() == '/') ? "" : "/") + name;
+        }
+
+        std::optional<Program> load(const std::string& cache_file, uint64_t source_hash) {
+#ifndef _WIN32
+            int fd = ::open(cache_file.c_str(), O_RDONLY);
+            if (fd < 0)
+                return std::nullopt;
+
+            struct stat info;
+            if (::fstat(fd, &info) != 0 || info.st_size == 0) {
+                ::close(fd);
+                return std::nullopt;
+            }
+            size_t size = static_cast<size_t>(info.st_size);
+            void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (mapped == MAP_FAILED)
+                return std::nullopt;
+
+            std::optional<Program> program = deserialize(static_cast<const char*>(mapped), size, source_hash);
+            ::munmap(mapped, size);
+            return program;
+#else
+            std::ifstream file(cache_file, std::ios::binary);
+            if (!file)
+                return std::nullopt;
+            std::string data(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>{});
+            return deserialize(data.data(), data.size(), source_hash);
+#endif
+        }
+
+        bool store(const std::string& cache_file, const Program& program, uint64_t source_hash) {
+            std::string data = serialize(program, source_hash);
+            std::string temporary = cache_file + ".tmp" + std::to_string(content_hash(data));
+            bool written;
+            {
+                std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+                written = file && file.write(data.data(), static_cast<std::streamsize>(data.size())) && file.flush();
+            }
+            if (!written || std::rename(temporary.c_str(), cache_file.c_str()) != 0) {
+                std::remove(temporary.c_str());
+                return false;
+            }
+            return true;
+        }
+    }
+}
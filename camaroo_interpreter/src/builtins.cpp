@@ -0,0 +1,416 @@
+#include <builtins.h>
+#include <channel.h>
+#include <evaluator.h>
+#include <generator.h>
+#include <list.h>
+#include <map.h>
+#include <pattern.h>
+#include <simd.h>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace camaroo_core {
+
+    namespace {
+
+        void expect_arguments(const std::string& name, const Arguments& args, size_t count) {
+            if (args.size() != count)
+                throw std::runtime_error("Error: " + name + " expects " + std::to_string(count) +
+                                         " argument(s) but found " + std::to_string(args.size()));
+        }
+
+        const camaroo_list& expect_list(const std::string& name, const std::shared_ptr<camaroo_object>& arg) {
+            if (!arg || arg->variable_type != TokenType::list)
+                throw std::runtime_error("Error: " + name + " expects a list");
+            return *std::get<std::shared_ptr<camaroo_list>>(arg->variable_value);
+        }
+
+        camaroo_channel& expect_channel(const std::string& name, const std::shared_ptr<camaroo_object>& arg) {
+            if (!arg || arg->variable_type != TokenType::channel)
+                throw std::runtime_error("Error: " + name + " expects a channel");
+            return *std::get<std::shared_ptr<camaroo_channel>>(arg->variable_value);
+        }
+
+        camaroo_map& expect_map(const std::string& name, const std::shared_ptr<camaroo_object>& arg) {
+            if (!arg || arg->variable_type != TokenType::map)
+                throw std::runtime_error("Error: " + name + " expects a map");
+            return *std::get<std::shared_ptr<camaroo_map>>(arg->variable_value);
+        }
+
+        const camaroo_text& expect_text(const std::string& name, const std::shared_ptr<camaroo_object>& arg) {
+            if (!arg || arg->variable_type != TokenType::text)
+                throw std::runtime_error("Error: " + name + " expects text");
+            return std::get<camaroo_text>(arg->variable_value);
+        }
+
+        // Offset of needle in haystack from offset on, haystack.size() when it isn't there
+        size_t find_from(std::string_view haystack, std::string_view needle, size_t offset) {
+            return offset + simd::find(haystack.data() + offset, haystack.size() - offset, needle.data(), needle.size());
+        }
+
+        std::shared_ptr<camaroo_object> builtin_len(evaluator&, const Arguments& args) {
+            expect_arguments("len", args, 1);
+            if (args[0] && args[0]->variable_type == TokenType::text)
+                return make_object(TokenType::num, static_cast<int64_t>(std::get<camaroo_text>(args[0]->variable_value).size()));
+            if (args[0] && args[0]->variable_type == TokenType::map) {
+                camaroo_map& map = expect_map("len", args[0]);
+                std::lock_guard<std::mutex> held(map.guard());
+                return make_object(TokenType::num, static_cast<int64_t>(map.size()));
+            }
+            return make_object(TokenType::num, static_cast<int64_t>(expect_list("len", args[0]).size()));
+        }
+
+        std::shared_ptr<camaroo_object> builtin_sum(evaluator& context, const Arguments& args) {
+            expect_arguments("sum", args, 1);
+            return list_sum(context.get_pool(), expect_list("sum", args[0]));
+        }
+
+        std::shared_ptr<camaroo_object> builtin_min(evaluator& context, const Arguments& args) {
+            expect_arguments("min", args, 1);
+            return list_min(context.get_pool(), expect_list("min", args[0]));
+        }
+
+        std::shared_ptr<camaroo_object> builtin_max(evaluator& context, const Arguments& args) {
+            expect_arguments("max", args, 1);
+            return list_max(context.get_pool(), expect_list("max", args[0]));
+        }
+
+        std::shared_ptr<camaroo_object> builtin_dot(evaluator& context, const Arguments& args) {
+            expect_arguments("dot", args, 2);
+            return list_dot(context.get_pool(), expect_list("dot", args[0]), expect_list("dot", args[1]));
+        }
+
+        std::shared_ptr<camaroo_object> builtin_sort(evaluator& context, const Arguments& args) {
+            expect_arguments("sort", args, 1);
+            return list_sort(context.get_pool(), expect_list("sort", args[0]));
+        }
+
+        // filter(xs, xs > 3) keeps the elements of xs where the toggle list is true
+        std::shared_ptr<camaroo_object> builtin_filter(evaluator& context, const Arguments& args) {
+            expect_arguments("filter", args, 2);
+            return list_filter(context.get_pool(), expect_list("filter", args[0]), expect_list("filter", args[1]));
+        }
+
+        // send(jobs, value) waits while jobs is full
+        std::shared_ptr<camaroo_object> builtin_send(evaluator&, const Arguments& args) {
+            expect_arguments("send", args, 2);
+            camaroo_channel& channel = expect_channel("send", args[0]);
+            if (!args[1] || args[1]->variable_type != channel.element_type())
+                throw std::runtime_error(std::string("Error: send expects a ") + type_name(channel.element_type()) + " for this channel");
+            if (!channel.send(args[1]))
+                throw std::runtime_error("Error: send on a closed channel");
+            return make_object(TokenType::toggle, true);
+        }
+
+        // receive(jobs) waits while jobs is empty
+        std::shared_ptr<camaroo_object> builtin_receive(evaluator&, const Arguments& args) {
+            expect_arguments("receive", args, 1);
+            std::shared_ptr<camaroo_object> value = expect_channel("receive", args[0]).receive();
+            if (!value)
+                throw std::runtime_error("Error: receive on a closed channel");
+            return value;
+        }
+
+        // Receivers get what is left and then stop, for loops over the channel end
+        std::shared_ptr<camaroo_object> builtin_close(evaluator&, const Arguments& args) {
+            expect_arguments("close", args, 1);
+            expect_channel("close", args[0]).close();
+            return make_object(TokenType::toggle, true);
+        }
+
+        // find(t, "ab") is the byte offset of the first "ab" in t, -1 when there isn't one
+        std::shared_ptr<camaroo_object> builtin_find(evaluator&, const Arguments& args) {
+            expect_arguments("find", args, 2);
+            std::string_view haystack = expect_text("find", args[0]).view();
+            std::string_view needle = expect_text("find", args[1]).view();
+            size_t found = find_from(haystack, needle, 0);
+            return make_object(TokenType::num, (found == haystack.size() && !needle.empty()) ? int64_t(-1) : static_cast<int64_t>(found));
+        }
+
+        std::shared_ptr<camaroo_object> builtin_contains(evaluator&, const Arguments& args) {
+            expect_arguments("contains", args, 2);
+            std::string_view haystack = expect_text("contains", args[0]).view();
+            std::string_view needle = expect_text("contains", args[1]).view();
+            return make_object(TokenType::toggle, needle.empty() || find_from(haystack, needle, 0) != haystack.size());
+        }
+
+        std::shared_ptr<camaroo_object> builtin_startswith(evaluator&, const Arguments& args) {
+            expect_arguments("startswith", args, 2);
+            std::string_view text = expect_text("startswith", args[0]).view();
+            return make_object(TokenType::toggle, text.starts_with(expect_text("startswith", args[1]).view()));
+        }
+
+        // Occurrences that don't overlap, counted from the left
+        std::shared_ptr<camaroo_object> builtin_count(evaluator&, const Arguments& args) {
+            expect_arguments("count", args, 2);
+            std::string_view haystack = expect_text("count", args[0]).view();
+            std::string_view needle = expect_text("count", args[1]).view();
+            if (needle.empty())
+                throw std::runtime_error("Error: count expects text to look for");
+            int64_t found = 0;
+            for (size_t at = find_from(haystack, needle, 0); at != haystack.size(); at = find_from(haystack, needle, at + needle.size()))
+                ++found;
+            return make_object(TokenType::num, found);
+        }
+
+        // replace(t, old, new) puts new in place of every old, left to right
+        std::shared_ptr<camaroo_object> builtin_replace(evaluator&, const Arguments& args) {
+            expect_arguments("replace", args, 3);
+            const camaroo_text& original = expect_text("replace", args[0]);
+            std::string_view haystack = original.view();
+            std::string_view needle = expect_text("replace", args[1]).view();
+            std::string_view replacement = expect_text("replace", args[2]).view();
+            if (needle.empty())
+                throw std::runtime_error("Error: replace expects text to look for");
+            size_t at = find_from(haystack, needle, 0);
+            if (at == haystack.size())
+                return make_object(TokenType::text, original);
+            std::string replaced;
+            replaced.reserve(haystack.size());
+            size_t from = 0;
+            for (; at != haystack.size(); at = find_from(haystack, needle, from)) {
+                replaced.append(haystack.substr(from, at - from)).append(replacement);
+                from = at + needle.size();
+            }
+            replaced.append(haystack.substr(from));
+            return make_object(TokenType::text, camaroo_text(replaced));
+        }
+
+        generator<std::shared_ptr<camaroo_object>> split_text(camaroo_text text, camaroo_text separator) {
+            std::string_view whole = text.view();
+            std::string_view between = separator.view();
+            size_t from = 0;
+            for (size_t at = find_from(whole, between, 0); at != whole.size(); at = find_from(whole, between, from)) {
+                co_yield make_object(TokenType::text, text.slice(from, at - from));
+                from = at + between.size();
+            }
+            co_yield make_object(TokenType::text, text.slice(from, whole.size() - from));
+        }
+
+        // The parts of t between separators, one at a time. Long parts point into t instead of copying it
+        std::shared_ptr<camaroo_object> builtin_split(evaluator&, const Arguments& args) {
+            expect_arguments("split", args, 2);
+            const camaroo_text& text = expect_text("split", args[0]);
+            const camaroo_text& separator = expect_text("split", args[1]);
+            if (separator.empty())
+                throw std::runtime_error("Error: split expects a separator");
+            return make_object(TokenType::generator, std::make_shared<camaroo_generator>(TokenType::text, split_text(text, separator)));
+        }
+
+        // regex(t, "err(or)?: \\d+") is whether some part of t matches, patterns in use are compiled once. Counted repeats
+        // are written \{2,3\} in a literal, where braces mark slots
+        std::shared_ptr<camaroo_object> builtin_regex(evaluator&, const Arguments& args) {
+            expect_arguments("regex", args, 2);
+            std::string_view text = expect_text("regex", args[0]).view();
+            std::shared_ptr<const camaroo_regex> pattern = camaroo_regex::compile(expect_text("regex", args[1]).str());
+            return make_object(TokenType::toggle, pattern->search(text));
+        }
+
+        // The letters of UTF-8 text as a list, a byte each
+        std::shared_ptr<camaroo_object> builtin_letters(evaluator&, const Arguments& args) {
+            expect_arguments("letters", args, 1);
+            std::string_view text = expect_text("letters", args[0]).view();
+            std::vector<uint8_t> letters;
+            letters.reserve(text.size());
+            for (size_t at = 0, used = 0; at < text.size(); at += used)
+                letters.push_back(list_letter(decode_utf8(text, at, used)));
+            return make_object(TokenType::list, std::make_shared<camaroo_list>(camaroo_list{TokenType::letter, std::move(letters)}));
+        }
+
+        // Calls use with key the way the map keys on it, nums as they are and text as its bytes
+        template <typename Use>
+        decltype(auto) with_key(const std::string& name, camaroo_map& map, const std::shared_ptr<camaroo_object>& key, Use use) {
+            if (!key || key->variable_type != map.key_type())
+                throw std::runtime_error("Error: " + name + " expects a " + type_name(map.key_type()) + " key for this map");
+            if (map.key_type() == TokenType::num)
+                return use(std::get<int64_t>(key->variable_value));
+            return use(std::get<camaroo_text>(key->variable_value).view());
+        }
+
+        // value as the map holds it, nums widen to fnum
+        Value map_value(const std::string& name, const camaroo_map& map, const std::shared_ptr<camaroo_object>& value) {
+            if (value && value->variable_type == TokenType::num && map.value_type() == TokenType::fnum)
+                return static_cast<double>(std::get<int64_t>(value->variable_value));
+            if (!value || value->variable_type != map.value_type())
+                throw std::runtime_error("Error: " + name + " expects a " + type_name(map.value_type()) + " value for this map");
+            return value->variable_value;
+        }
+
+        generator<std::shared_ptr<camaroo_object>> each_of(std::vector<std::shared_ptr<camaroo_object>> items) {
+            for (auto& item : items)
+                co_yield std::move(item);
+        }
+
+        // put(ages, name, 30) sets the value under a key, a key keeps the place it was first put in
+        std::shared_ptr<camaroo_object> builtin_put(evaluator&, const Arguments& args) {
+            expect_arguments("put", args, 3);
+            camaroo_map& map = expect_map("put", args[0]);
+            Value value = map_value("put", map, args[2]);
+            std::lock_guard<std::mutex> held(map.guard());
+            with_key("put", map, args[1], [&](auto key) -> Value& { return map.insert(key, value) = value; });
+            return make_object(TokenType::toggle, true);
+        }
+
+        // get(ages, name) is the value under a key, get(ages, name, 0) gives 0 when there's none
+        std::shared_ptr<camaroo_object> builtin_get(evaluator&, const Arguments& args) {
+            if (args.size() != 2 && args.size() != 3)
+                throw std::runtime_error("Error: get expects 2 or 3 argument(s) but found " + std::to_string(args.size()));
+            camaroo_map& map = expect_map("get", args[0]);
+            Value fallback = (args.size() == 3) ? map_value("get", map, args[2]) : Value{};
+            std::lock_guard<std::mutex> held(map.guard());
+            if (Value* found = with_key("get", map, args[1], [&](auto key) { return map.find(key); }))
+                return make_object(map.value_type(), *found);
+            if (args.size() == 3)
+                return make_object(map.value_type(), std::move(fallback));
+            std::string key;
+            append_object(key, *args[1]);
+            throw std::runtime_error("Error: the map has nothing under " + key);
+        }
+
+        std::shared_ptr<camaroo_object> builtin_has(evaluator&, const Arguments& args) {
+            expect_arguments("has", args, 2);
+            camaroo_map& map = expect_map("has", args[0]);
+            std::lock_guard<std::mutex> held(map.guard());
+            return make_object(TokenType::toggle, with_key("has", map, args[1], [&](auto key) { return map.find(key) != nullptr; }));
+        }
+
+        // Whether there was anything under the key
+        std::shared_ptr<camaroo_object> builtin_remove(evaluator&, const Arguments& args) {
+            expect_arguments("remove", args, 2);
+            camaroo_map& map = expect_map("remove", args[0]);
+            std::lock_guard<std::mutex> held(map.guard());
+            return make_object(TokenType::toggle, with_key("remove", map, args[1], [&](auto key) { return map.erase(key); }));
+        }
+
+        // add(totals, key, amount) adds to the value under a key, starting from 0. Counts and sums per group take one
+        // lookup this way instead of a get and a put
+        std::shared_ptr<camaroo_object> builtin_add(evaluator&, const Arguments& args) {
+            expect_arguments("add", args, 3);
+            camaroo_map& map = expect_map("add", args[0]);
+            if (map.value_type() != TokenType::num && map.value_type() != TokenType::fnum)
+                throw std::runtime_error("Error: add needs a map of num or fnum values");
+            Value amount = map_value("add", map, args[2]);
+            Value zero = (map.value_type() == TokenType::num) ? Value(int64_t(0)) : Value(0.0);
+            std::lock_guard<std::mutex> held(map.guard());
+            Value& total = with_key("add", map, args[1], [&](auto key) -> Value& { return map.insert(key, zero); });
+            if (map.value_type() == TokenType::num)
+                total = static_cast<int64_t>(static_cast<uint64_t>(std::get<int64_t>(total)) + static_cast<uint64_t>(std::get<int64_t>(amount)));
+            else
+                total = std::get<double>(total) + std::get<double>(amount);
+            return make_object(map.value_type(), total);
+        }
+
+        // reserve(counts, 100000) makes room up front so filling the map doesn't rehash on the way
+        std::shared_ptr<camaroo_object> builtin_reserve(evaluator&, const Arguments& args) {
+            expect_arguments("reserve", args, 2);
+            camaroo_map& map = expect_map("reserve", args[0]);
+            if (!args[1] || args[1]->variable_type != TokenType::num || std::get<int64_t>(args[1]->variable_value) < 0)
+                throw std::runtime_error("Error: reserve expects a count of at least 0");
+            std::lock_guard<std::mutex> held(map.guard());
+            map.reserve(static_cast<size_t>(std::get<int64_t>(args[1]->variable_value)));
+            return make_object(TokenType::toggle, true);
+        }
+
+        // The keys in the order they were put in, a list of num or a gen of text as lists can't hold text. Both are
+        // taken when keys is called, changing the map afterwards doesn't change them
+        std::shared_ptr<camaroo_object> builtin_keys(evaluator&, const Arguments& args) {
+            expect_arguments("keys", args, 1);
+            camaroo_map& map = expect_map("keys", args[0]);
+            std::lock_guard<std::mutex> held(map.guard());
+            if (map.key_type() == TokenType::num) {
+                std::vector<int64_t> keys;
+                keys.reserve(map.size());
+                for (size_t entry = 0; entry < map.entry_count(); ++entry)
+                    if (map.has_entry(entry))
+                        keys.push_back(std::get<int64_t>(map.key_at(entry)->variable_value));
+                return make_object(TokenType::list, std::make_shared<camaroo_list>(camaroo_list{TokenType::num, std::move(keys)}));
+            }
+            std::vector<std::shared_ptr<camaroo_object>> keys;
+            keys.reserve(map.size());
+            for (size_t entry = 0; entry < map.entry_count(); ++entry)
+                if (map.has_entry(entry))
+                    keys.push_back(map.key_at(entry));
+            return make_object(TokenType::generator, std::make_shared<camaroo_generator>(TokenType::text, each_of(std::move(keys))));
+        }
+
+        // The values in the same order as keys, a gen for text values and a list for the rest
+        std::shared_ptr<camaroo_object> builtin_values(evaluator&, const Arguments& args) {
+            expect_arguments("values", args, 1);
+            camaroo_map& map = expect_map("values", args[0]);
+            std::lock_guard<std::mutex> held(map.guard());
+            std::vector<std::shared_ptr<camaroo_object>> values;
+            values.reserve(map.size());
+            for (size_t entry = 0; entry < map.entry_count(); ++entry)
+                if (map.has_entry(entry))
+                    values.push_back(make_object(map.value_type(), map.value_at(entry)));
+            if (map.value_type() == TokenType::text)
+                return make_object(TokenType::generator, std::make_shared<camaroo_generator>(TokenType::text, each_of(std::move(values))));
+            return make_list(values);
+        }
+
+        generator<std::shared_ptr<camaroo_object>> read_lines() {
+            std::string line;
+            while (std::getline(std::cin, line))
+                co_yield make_object(TokenType::text, camaroo_text(line));
+        }
+
+        // Standard input one line at a time, only the current line is ever held in memory
+        std::shared_ptr<camaroo_object> builtin_lines(evaluator&, const Arguments& args) {
+            expect_arguments("lines", args, 0);
+            return make_object(TokenType::generator, std::make_shared<camaroo_generator>(TokenType::text, read_lines()));
+        }
+
+        struct builtin_entry {
+            builtin_fn function;
+            // What it gives back, unknown when that depends on the arguments, like sum of a num or an fnum list
+            TokenType result;
+        };
+
+        const builtin_entry* find_entry(const std::string& name) {
+            static const std::unordered_map<std::string, builtin_entry> builtins = {
+                {"len", {builtin_len, TokenType::num}},
+                {"sum", {builtin_sum, TokenType::unknown}},
+                {"min", {builtin_min, TokenType::unknown}},
+                {"max", {builtin_max, TokenType::unknown}},
+                {"dot", {builtin_dot, TokenType::unknown}},
+                {"filter", {builtin_filter, TokenType::list}},
+                {"sort", {builtin_sort, TokenType::list}},
+                {"send", {builtin_send, TokenType::toggle}},
+                {"receive", {builtin_receive, TokenType::unknown}},
+                {"close", {builtin_close, TokenType::toggle}},
+                {"lines", {builtin_lines, TokenType::generator}},
+                {"find", {builtin_find, TokenType::num}},
+                {"contains", {builtin_contains, TokenType::toggle}},
+                {"startswith", {builtin_startswith, TokenType::toggle}},
+                {"count", {builtin_count, TokenType::num}},
+                {"replace", {builtin_replace, TokenType::text}},
+                {"split", {builtin_split, TokenType::generator}},
+                {"regex", {builtin_regex, TokenType::toggle}},
+                {"letters", {builtin_letters, TokenType::list}},
+                {"put", {builtin_put, TokenType::toggle}},
+                {"get", {builtin_get, TokenType::unknown}},
+                {"has", {builtin_has, TokenType::toggle}},
+                {"remove", {builtin_remove, TokenType::toggle}},
+                {"add", {builtin_add, TokenType::unknown}},
+                {"reserve", {builtin_reserve, TokenType::toggle}},
+                {"keys", {builtin_keys, TokenType::unknown}},
+                {"values", {builtin_values, TokenType::unknown}},
+            };
+
+            auto it = builtins.find(name);
+            return (it != builtins.end()) ? &it->second : nullptr;
+        }
+    }
+
+    builtin_fn find_builtin(const std::string& name) {
+        const builtin_entry* entry = find_entry(name);
+        return entry ? entry->function : nullptr;
+    }
+
+    TokenType builtin_result(const std::string& name) {
+        const builtin_entry* entry = find_entry(name);
+        return entry ? entry->result : TokenType::unknown;
+    }
+}
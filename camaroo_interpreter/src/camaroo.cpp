@@ -0,0 +1,107 @@
+#include <camaroo.h>
+#include <engine.h>
+#include <cstdlib>
+#include <cstring>
+#include <streambuf>
+
+struct camaroo_engine {
+    std::unique_ptr<camaroo_core::Engine> engine;
+};
+
+struct camaroo_script {
+    std::shared_ptr<const camaroo_core::Script> script;
+};
+
+namespace {
+
+    // Hands everything written to it straight to a C callback, output_stream already writes whole lines at once
+    class callback_buffer : public std::streambuf {
+    public:
+        callback_buffer(camaroo_write_fn write, void* user_data)
+            :write(write), user_data(user_data) {}
+    protected:
+        std::streamsize xsputn(const char* text, std::streamsize length) override {
+            if (write)
+                write(user_data, text, static_cast<size_t>(length));
+            return length;
+        }
+
+        int_type overflow(int_type c) override {
+            if (!traits_type::eq_int_type(c, traits_type::eof())) {
+                char value = traits_type::to_char_type(c);
+                xsputn(&value, 1);
+            }
+            return traits_type::not_eof(c);
+        }
+    private:
+        camaroo_write_fn write;
+        void* user_data;
+    };
+
+    char* copy_string(const std::string& text) {
+        char* copy = static_cast<char*>(std::malloc(text.size() + 1));
+        if (copy)
+            std::memcpy(copy, text.c_str(), text.size() + 1);
+        return copy;
+    }
+}
+
+extern "C" {
+
+camaroo_engine* camaroo_engine_new(size_t thread_count) {
+    try {
+        auto engine = (thread_count == 0) ? std::make_unique<camaroo_core::Engine>()
+                                          : std::make_unique<camaroo_core::Engine>(thread_count);
+        return new camaroo_engine{std::move(engine)};
+    }
+    catch (...) {
+        return nullptr;
+    }
+}
+
+void camaroo_engine_free(camaroo_engine* engine) {
+    delete engine;
+}
+
+camaroo_script* camaroo_compile(const camaroo_engine* engine, const char* source, char** error) {
+    if (error)
+        *error = nullptr;
+    if (!engine || !source)
+        return nullptr;
+    try {
+        return new camaroo_script{engine->engine->compile(source)};
+    }
+    catch (const std::exception& e) {
+        if (error)
+            *error = copy_string(e.what());
+        return nullptr;
+    }
+}
+
+void camaroo_script_free(camaroo_script* script) {
+    delete script;
+}
+
+int camaroo_run(const camaroo_engine* engine, const camaroo_script* script,
+                camaroo_write_fn out, camaroo_write_fn err, void* user_data) {
+    if (!engine || !script)
+        return -1;
+    try {
+        callback_buffer out_buffer(out, user_data);
+        callback_buffer err_buffer(err, user_data);
+        std::ostream out_stream(&out_buffer);
+        std::ostream err_stream(&err_buffer);
+
+        camaroo_core::Context context(*engine->engine, out_stream, err_stream);
+        return engine->engine->run(*script->script, context) ? 0 : -1;
+    }
+    catch (...) {
+        return -1;
+    }
+}
+
+void camaroo_string_free(char* text) {
+    std::free(text);
+}
+
+}
@@ -0,0 +1,86 @@
+#include <channel.h>
+#include <thread>
+
+namespace camaroo_core {
+
+    namespace {
+        // Tries before a blocked side goes to sleep, a handoff between two running tasks usually lands by then
+        constexpr int spin_limit = 64;
+    }
+
+    camaroo_channel::camaroo_channel(TokenType element_type, size_t capacity)
+        :ring(capacity), type(element_type) {}
+
+    void camaroo_channel::wake(std::atomic<uint32_t>& counter, std::atomic<uint32_t>& waiting,
+                               task_scheduler::wait_list& parked) {
+        counter.fetch_add(1);
+        if (waiting.load() > 0)
+            counter.notify_all();
+        // One value moved, so one task on the other side can go on. If it loses the race for it, whoever won moved one too
+        parked.wake_one();
+    }
+
+    void camaroo_channel::sleep(std::atomic<uint32_t>& counter, uint32_t seen, std::atomic<uint32_t>& waiting,
+                                task_scheduler::wait_list& parked) {
+        if (parked.park([&]() { return counter.load() == seen; }))
+            return;
+        task_scheduler::blocking_scope blocking;
+        waiting.fetch_add(1);
+        // Returns right away if the other side moved since seen was read, so no wakeup gets lost
+        counter.wait(seen);
+        waiting.fetch_sub(1);
+    }
+
+    bool camaroo_channel::send(std::shared_ptr<camaroo_object> value) {
+        for (int attempt = 0;; ++attempt) {
+            if (closed.load())
+                return false;
+
+            uint32_t seen = received.load();
+            if (ring.try_push(value)) {
+                wake(sent, waiting_receivers, parked_receivers);
+                return true;
+            }
+
+            if (attempt < spin_limit)
+                std::this_thread::yield();
+            else
+                sleep(received, seen, waiting_senders, parked_senders);
+        }
+    }
+
+    std::shared_ptr<camaroo_object> camaroo_channel::receive() {
+        std::shared_ptr<camaroo_object> value;
+        for (int attempt = 0;; ++attempt) {
+            uint32_t seen = sent.load();
+            if (ring.try_pop(value)) {
+                wake(received, waiting_senders, parked_senders);
+                return value;
+            }
+
+            if (closed.load()) {
+                // Values sent right before the close are still handed out
+                if (ring.try_pop(value)) {
+                    wake(received, waiting_senders, parked_senders);
+                    return value;
+                }
+                return nullptr;
+            }
+
+            if (attempt < spin_limit)
+                std::this_thread::yield();
+            else
+                sleep(sent, seen, waiting_receivers, parked_receivers);
+        }
+    }
+
+    void camaroo_channel::close() {
+        closed.store(true);
+        sent.fetch_add(1);
+        received.fetch_add(1);
+        sent.notify_all();
+        received.notify_all();
+        parked_senders.wake_all();
+        parked_receivers.wake_all();
+    }
+}
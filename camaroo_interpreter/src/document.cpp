@@ -0,0 +1,128 @@
+#include <document.h>
+#include <algorithm>
+#include <limits>
+
+namespace camaroo_core {
+
+    namespace {
+        // Source is lexed a window at a time so an edit doesn't copy the rest of the buffer into a tokenizer
+        constexpr size_t first_window = 256;
+    }
+
+    Document::Document(std::string source)
+        :source(std::move(source))
+    {
+        scan(0, std::numeric_limits<size_t>::max(), [](size_t) { return false; }, spans);
+        reparsed = spans.size();
+    }
+
+    void Document::edit(size_t offset, size_t removed, const std::string& inserted) {
+        offset = std::min(offset, source.size());
+        removed = std::min(removed, source.size() - offset);
+        source.replace(offset, removed, inserted);
+        ptrdiff_t delta = static_cast<ptrdiff_t>(inserted.size()) - static_cast<ptrdiff_t>(removed);
+
+        // The span the edit lands in, or the one right after it when the edit is on a boundary
+        auto first = std::partition_point(spans.begin(), spans.end(), [&](const span& s) { return s.end < offset; });
+        size_t begin = (first != spans.end()) ? first->begin : (spans.empty() ? 0 : spans.back().end);
+
+        // Past the edit, a new boundary where an old one was means the rest of the source lexes like before
+        size_t edit_end = offset + removed;
+        auto last = spans.end();
+        auto was_boundary = [&](size_t position) {
+            size_t old_position = static_cast<size_t>(static_cast<ptrdiff_t>(position) - delta);
+            if (old_position < edit_end)
+                return false;
+            auto it = std::lower_bound(first, spans.end(), old_position, [](const span& s, size_t end) { return s.end < end; });
+            if (it == spans.end() || it->end != old_position)
+                return false;
+            last = it + 1;
+            return true;
+        };
+
+        std::vector<span> found;
+        scan(begin, offset + inserted.size(), was_boundary, found);
+        reparsed = found.size();
+
+        for (auto it = last; it != spans.end(); ++it) {
+            it->begin += delta;
+            it->end += delta;
+        }
+        size_t first_index = static_cast<size_t>(first - spans.begin());
+        spans.erase(first, last);
+        spans.insert(spans.begin() + static_cast<ptrdiff_t>(first_index),
+                     std::make_move_iterator(found.begin()), std::make_move_iterator(found.end()));
+    }
+
+    bool Document::scan(size_t begin, size_t resync_from, const std::function<bool(size_t)>& was_boundary,
+                        std::vector<span>& found) const {
+        size_t span_begin = begin;
+        size_t lexed = begin;
+        int64_t depth = 0;
+        size_t window = first_window;
+
+        while (lexed < source.size()) {
+            size_t window_begin = lexed;
+            size_t window_end = std::min(source.size(), lexed + window);
+            bool at_end = window_end == source.size();
+            Tokenizer tokenizer(source.substr(window_begin, window_end - window_begin));
+
+            bool cut = false;
+            while (std::optional<Token> token = tokenizer.next_token()) {
+                size_t token_end = window_begin + tokenizer.position();
+                // Tokens look one character ahead, one that reaches the end of the window may go on past it
+                if (!at_end && token_end + 1 >= window_end) {
+                    cut = true;
+                    break;
+                }
+                lexed = token_end;
+
+                TokenType type = token->type;
+                if (type == TokenType::LCurlyBrace || type == TokenType::LParen || type == TokenType::LSquareBracket)
+                    ++depth;
+                else if (type == TokenType::RCurlyBrace || type == TokenType::RParen || type == TokenType::RSquareBracket)
+                    --depth;
+
+                bool ends_statement = (type == TokenType::semicolon && depth <= 0) ||
+                                      (type == TokenType::RCurlyBrace && depth <= 0);
+                if (!ends_statement)
+                    continue;
+                depth = 0;
+                found.push_back(parse_span(span_begin, lexed));
+                span_begin = lexed;
+                if (lexed >= resync_from && was_boundary(lexed))
+                    return true;
+            }
+
+            if (at_end && !cut)
+                break;
+            // Whatever is left of the window is a token or a comment cut in half, lex it again with more room
+            window *= 2;
+        }
+
+        if (span_begin < source.size())
+            found.push_back(parse_span(span_begin, source.size()));
+        return false;
+    }
+
+    Document::span Document::parse_span(size_t begin, size_t end) const {
+        Parser parser(source.substr(begin, end - begin));
+        return span{begin, end, parser.parse_program()};
+    }
+
+    std::vector<StatementNode*> Document::statements() const {
+        std::vector<StatementNode*> result;
+        for (const auto& s : spans) {
+            for (const auto& statement : s.program.statements)
+                result.push_back(statement.get());
+        }
+        return result;
+    }
+
+    std::vector<std::string> Document::errors() const {
+        std::vector<std::string> result;
+        for (const auto& s : spans)
+            result.insert(result.end(), s.program.errors.begin(), s.program.errors.end());
+        return result;
+    }
+}
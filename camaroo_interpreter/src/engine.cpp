@@ -0,0 +1,102 @@
+#include <engine.h>
+#include <module.h>
+#include <optimize.h>
+#include <type_check.h>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace camaroo_core {
+
+    Context::Context(const Engine& engine, std::ostream& out, std::ostream& err)
+        :output(out, err), state(engine.get_pool(), output) {}
+
+    Engine::Engine()
+        :pool(&thread_pool::shared()) {}
+
+    Engine::Engine(size_t thread_count)
+        :owned_pool(std::make_unique<thread_pool>(thread_count)), pool(owned_pool.get()) {}
+
+    namespace {
+        std::shared_ptr<const Script> compiled_or_throw(Program program, const specializations& fixed,
+                                                        std::vector<modules::source_file> sources) {
+            if (program.has_compiled) {
+                if (!fixed.empty())
+                    specialize(program.statements, fixed);
+                program.errors = check_types(program.statements);
+                program.has_compiled = program.errors.empty();
+            }
+            if (!program.has_compiled) {
+                std::string message;
+                for (const auto& error : program.errors)
+                    message += (message.empty() ? "" : "\n") + error;
+                throw std::runtime_error(message);
+            }
+            optimize(program.statements);
+            return std::make_shared<const Script>(std::move(program), std::move(sources));
+        }
+    }
+
+    std::shared_ptr<const Script> Engine::compile(const std::string& source, const specializations& fixed) const {
+        std::vector<modules::source_file> sources;
+        Program program = modules::link(source, "", *pool, {}, &sources);
+        return compiled_or_throw(std::move(program), fixed, std::move(sources));
+    }
+
+    std::shared_ptr<const Script> Engine::compile_file(const std::string& path, const ast_cache::settings& cache,
+                                                       const specializations& fixed) const {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            throw std::runtime_error("Error: couldn't open " + path);
+        std::string source(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>{});
+        std::vector<modules::source_file> sources;
+        Program program = modules::link(source, path, *pool, cache, &sources);
+        return compiled_or_throw(std::move(program), fixed, std::move(sources));
+    }
+
+    bool Engine::run(const Script& script, Context& context) const {
+        return context.state.evaluate_program(script.get_program());
+    }
+
+    Repl::Repl(const Engine& engine, std::ostream& out, std::ostream& err)
+        :engine(engine), err(err), context(engine, out, err) {}
+
+    bool Repl::feed(const std::string& line) {
+        std::string text = line + '\n';
+        Tokenizer tokenizer(text);
+        while (std::optional<Token> token = tokenizer.next_token()) {
+            switch (token->type) {
+                case TokenType::LCurlyBrace:
+                case TokenType::LParen:
+                case TokenType::LSquareBracket:
+                    ++open_brackets;
+                    break;
+                case TokenType::RCurlyBrace:
+                case TokenType::RParen:
+                case TokenType::RSquareBracket:
+                    --open_brackets;
+                    break;
+                default:
+                    break;
+            }
+        }
+        pending += text;
+        if (open_brackets > 0)
+            return false;
+
+        std::string source = std::move(pending);
+        discard();
+        try {
+            engine.run(*engine.compile(source), context);
+        }
+        catch (const std::exception& e) {
+            err << e.what() << '\n';
+        }
+        return true;
+    }
+
+    void Repl::discard() {
+        pending.clear();
+        open_brackets = 0;
+    }
+}
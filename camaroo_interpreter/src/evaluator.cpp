@@ -1,150 +1,974 @@
 #include "parser.h"
 #include "evaluator.h"
+#include <builtins.h>
+#include <channel.h>
+#include <map.h>
+#include <list.h>
 
 #include <iostream>
+#include <sstream>
 #include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
 
 namespace camaroo_core {
 
-    void evaluator::evaluate_program(const Program& program) {
-        std::vector<TokenType> types = {TokenType::num_type, TokenType::text_type};
+    namespace {
 
-        for (const auto& statement : program.statements) {
-            // TODO: Should be moved into evaluate_statement
-            const auto& it = std::find(types.begin(), types.end(), statement->token_type());
-            if (it != types.end()) {
-                ASTNode* id = statement->get_left();
-                std::string variable_name = std::get<std::string>(id->token_value());
-                std::shared_ptr<camaroo_object> variable_value = evaluate_expression(statement->get_right());
-                declared_variables.insert({variable_name, variable_value});
-                continue;
+        std::optional<simd::arith_op> to_arith_op(TokenType type) {
+            switch (type) {
+                case TokenType::add: return simd::arith_op::add;
+                case TokenType::subtract: return simd::arith_op::subtract;
+                case TokenType::multiply: return simd::arith_op::multiply;
+                case TokenType::division: return simd::arith_op::divide;
+                case TokenType::modulo: return simd::arith_op::modulo;
+                default: return std::nullopt;
             }
+        }
 
-            if (statement->token_type() == TokenType::equal) {
-                ASTNode* id = statement->get_left();
-                std::string variable_name = std::get<std::string>(id->token_value());
-                std::shared_ptr<camaroo_object> variable_value = evaluate_expression(statement->get_right());
-                declared_variables[variable_name] = variable_value;
-                continue;
+        std::optional<simd::compare_op> to_compare_op(TokenType type) {
+            switch (type) {
+                case TokenType::equal_operator: return simd::compare_op::equal;
+                case TokenType::not_equal_operator: return simd::compare_op::not_equal;
+                case TokenType::less_operator: return simd::compare_op::less;
+                case TokenType::less_equal_operator: return simd::compare_op::less_equal;
+                case TokenType::greater_operator: return simd::compare_op::greater;
+                case TokenType::greater_equal_operator: return simd::compare_op::greater_equal;
+                default: return std::nullopt;
             }
+        }
 
-            if (statement->token_type() == TokenType::print) {
-                std::shared_ptr<camaroo_object> value = evaluate_expression(statement->get_right());
-                if (value->variable_type == TokenType::num) {
-                    printf("%i", std::get<int64_t>(value->variable_value));
-                } else if (value->variable_type == TokenType::text) {
-                    std::cout << std::get<std::string>(value->variable_value);
+        bool is_number(const camaroo_object& object) {
+            return object.variable_type == TokenType::num || object.variable_type == TokenType::fnum;
+        }
+
+        double as_fnum(const camaroo_object& object) {
+            if (object.variable_type == TokenType::num)
+                return static_cast<double>(std::get<int64_t>(object.variable_value));
+            return std::get<double>(object.variable_value);
+        }
+
+        std::shared_ptr<camaroo_object> num_arithmetic(simd::arith_op op, int64_t left, int64_t right) {
+            // Wraps on overflow like the list kernels do
+            uint64_t a = static_cast<uint64_t>(left);
+            uint64_t b = static_cast<uint64_t>(right);
+            switch (op) {
+                case simd::arith_op::add: return make_object(TokenType::num, static_cast<int64_t>(a + b));
+                case simd::arith_op::subtract: return make_object(TokenType::num, static_cast<int64_t>(a - b));
+                case simd::arith_op::multiply: return make_object(TokenType::num, static_cast<int64_t>(a * b));
+                case simd::arith_op::divide: {
+                    if (right == 0)
+                        throw std::runtime_error("Error: division by zero");
+                    if (right == -1)
+                        return make_object(TokenType::num, static_cast<int64_t>(0 - a));
+                    return make_object(TokenType::num, left / right);
+                }
+                default: {
+                    if (right == 0)
+                        throw std::runtime_error("Error: division by zero");
+                    // The remainder takes the sign of the left operand, like C++
+                    if (right == -1)
+                        return make_object(TokenType::num, int64_t(0));
+                    return make_object(TokenType::num, left % right);
                 }
-                continue;
             }
+        }
 
-            if (statement->token_type() == TokenType::println) {
-                std::shared_ptr<camaroo_object> value = evaluate_expression(statement->get_right());
-                if (value->variable_type == TokenType::num) {
-                    printf("%i\n", std::get<int64_t>(value->variable_value));
-                } else if (value->variable_type == TokenType::text) {
-                    std::cout << std::get<std::string>(value->variable_value) << '\n';
+        std::shared_ptr<camaroo_object> fnum_arithmetic(simd::arith_op op, double a, double b) {
+            switch (op) {
+                case simd::arith_op::add: return make_object(TokenType::fnum, a + b);
+                case simd::arith_op::subtract: return make_object(TokenType::fnum, a - b);
+                case simd::arith_op::multiply: return make_object(TokenType::fnum, a * b);
+                case simd::arith_op::modulo: return make_object(TokenType::fnum, std::fmod(a, b));
+                default: return make_object(TokenType::fnum, a / b);
+            }
+        }
+
+        // A text, or a letter as the text of just that letter
+        camaroo_text text_of(const camaroo_object& value) {
+            if (value.variable_type == TokenType::text)
+                return std::get<camaroo_text>(value.variable_value);
+            std::string letter;
+            append_utf8(letter, std::get<char32_t>(value.variable_value));
+            return camaroo_text(letter);
+        }
+
+        std::shared_ptr<camaroo_object> arithmetic(thread_pool& pool, simd::arith_op op, const camaroo_object& left, const camaroo_object& right) {
+            if (left.variable_type == TokenType::list || right.variable_type == TokenType::list)
+                return list_arith(pool, op, left, right);
+
+            if (op == simd::arith_op::add && left.variable_type == TokenType::text && right.variable_type == TokenType::text)
+                return make_object(TokenType::text, std::get<camaroo_text>(left.variable_value) + std::get<camaroo_text>(right.variable_value));
+            // A letter joins onto text on either side
+            if (op == simd::arith_op::add && (left.variable_type == TokenType::text || left.variable_type == TokenType::letter) &&
+                (right.variable_type == TokenType::text || right.variable_type == TokenType::letter) && left.variable_type != right.variable_type)
+                return make_object(TokenType::text, text_of(left) + text_of(right));
+            if (!is_number(left) || !is_number(right))
+                throw std::runtime_error("Error: arithmetic needs num or fnum operands");
+
+            if (left.variable_type == TokenType::num && right.variable_type == TokenType::num)
+                return num_arithmetic(op, std::get<int64_t>(left.variable_value), std::get<int64_t>(right.variable_value));
+            return fnum_arithmetic(op, as_fnum(left), as_fnum(right));
+        }
+
+        // order is below, at or above zero as the left operand is less than, equal to or more than the right one
+        std::shared_ptr<camaroo_object> ordered(simd::compare_op op, int order) {
+            switch (op) {
+                case simd::compare_op::equal: return make_object(TokenType::toggle, order == 0);
+                case simd::compare_op::not_equal: return make_object(TokenType::toggle, order != 0);
+                case simd::compare_op::less: return make_object(TokenType::toggle, order < 0);
+                case simd::compare_op::less_equal: return make_object(TokenType::toggle, order <= 0);
+                case simd::compare_op::greater: return make_object(TokenType::toggle, order > 0);
+                default: return make_object(TokenType::toggle, order >= 0);
+            }
+        }
+
+        // Numbers, letters and toggles compare with their own operators, so a NaN fnum is unequal and unordered to everything
+        // the same way the list kernels treat it
+        template <typename Number>
+        std::shared_ptr<camaroo_object> compared(simd::compare_op op, Number a, Number b) {
+            switch (op) {
+                case simd::compare_op::equal: return make_object(TokenType::toggle, a == b);
+                case simd::compare_op::not_equal: return make_object(TokenType::toggle, a != b);
+                case simd::compare_op::less: return make_object(TokenType::toggle, a < b);
+                case simd::compare_op::less_equal: return make_object(TokenType::toggle, a <= b);
+                case simd::compare_op::greater: return make_object(TokenType::toggle, a > b);
+                default: return make_object(TokenType::toggle, a >= b);
+            }
+        }
+
+        std::shared_ptr<camaroo_object> comparison(thread_pool& pool, simd::compare_op op, const camaroo_object& left, const camaroo_object& right) {
+            if (left.variable_type == TokenType::list || right.variable_type == TokenType::list)
+                return list_compare(pool, op, left, right);
+            if (left.variable_type == TokenType::num && right.variable_type == TokenType::num)
+                return compared(op, std::get<int64_t>(left.variable_value), std::get<int64_t>(right.variable_value));
+            if (is_number(left) && is_number(right))
+                return compared(op, as_fnum(left), as_fnum(right));
+            if (left.variable_type == right.variable_type && left.variable_type == TokenType::letter)
+                return compared(op, std::get<char32_t>(left.variable_value), std::get<char32_t>(right.variable_value));
+            if (left.variable_type == right.variable_type && left.variable_type == TokenType::toggle)
+                return compared(op, std::get<bool>(left.variable_value), std::get<bool>(right.variable_value));
+            if (left.variable_type != right.variable_type || left.variable_type != TokenType::text)
+                throw std::runtime_error("Error: can't compare values of different types");
+            return ordered(op, std::get<camaroo_text>(left.variable_value).compare(std::get<camaroo_text>(right.variable_value)));
+        }
+
+        // Runaway recursion, through func calls or gens pulling from themselves, stops with an error
+        // before the native stack runs out
+        constexpr size_t max_call_depth = 256;
+
+        struct depth_guard {
+            depth_guard() {
+                size_t& call_depth = task_scheduler::call_depth();
+                if (call_depth == max_call_depth)
+                    throw std::runtime_error("Error: calls are nested too deep");
+                ++call_depth;
+            }
+            // Looked up again, a task that parked in between may be on another thread now
+            ~depth_guard() { --task_scheduler::call_depth(); }
+        };
+
+        // What a for loop walks over, an (a to b) range is never turned into a list
+        struct iteration_space {
+            TokenType element_type = TokenType::num;
+            int64_t first = 0;
+            size_t count = 0;
+            std::shared_ptr<camaroo_object> list;
+            // Channels and generators have no count, the loop pulls until they run dry
+            std::shared_ptr<camaroo_channel> channel;
+            std::shared_ptr<camaroo_generator> sequence;
+
+            bool is_counted() const { return !channel && !sequence; }
+
+            std::shared_ptr<camaroo_object> at(size_t index) const {
+                if (!list)
+                    return make_object(TokenType::num, static_cast<int64_t>(static_cast<uint64_t>(first) + index));
+
+                const camaroo_list& values = *std::get<std::shared_ptr<camaroo_list>>(list->variable_value);
+                if (values.element_type == TokenType::num)
+                    return make_object(TokenType::num, std::get<std::vector<int64_t>>(values.elements)[index]);
+                if (values.element_type == TokenType::fnum)
+                    return make_object(TokenType::fnum, std::get<std::vector<double>>(values.elements)[index]);
+                if (values.element_type == TokenType::letter)
+                    return make_object(TokenType::letter, static_cast<char32_t>(std::get<std::vector<uint8_t>>(values.elements)[index]));
+                return make_object(TokenType::toggle, std::get<std::vector<uint8_t>>(values.elements)[index] != 0);
+            }
+
+            // Next value of a sequential loop, nullptr once there are no more
+            std::shared_ptr<camaroo_object> pull(size_t& index) const {
+                if (channel)
+                    return channel->receive();
+                if (sequence) {
+                    depth_guard depth;
+                    return sequence->next();
+                }
+                return (index < count) ? at(index++) : nullptr;
+            }
+        };
+
+        int64_t range_bound(const camaroo_object& bound) {
+            if (bound.variable_type != TokenType::num)
+                throw std::runtime_error("Error: range bounds have to be num");
+            return std::get<int64_t>(bound.variable_value);
+        }
+
+        size_t range_length(int64_t first, int64_t last) {
+            return (last > first) ? static_cast<size_t>(static_cast<uint64_t>(last) - static_cast<uint64_t>(first)) : 0;
+        }
+
+        // value as something declared to hold expected keeps it, nums widen to fnum
+        std::shared_ptr<camaroo_object> widened(TokenType expected, std::shared_ptr<camaroo_object> value) {
+            if (expected == TokenType::fnum && value && value->variable_type == TokenType::num)
+                return make_object(TokenType::fnum, as_fnum(*value));
+            return value;
+        }
+
+        // value as a variable declared to hold expected, verb says how it got there for the error when it doesn't fit
+        std::shared_ptr<camaroo_object> checked_value(const std::string& name, TokenType expected, std::shared_ptr<camaroo_object> value,
+                                                      const char* verb) {
+            value = widened(expected, std::move(value));
+            if (!value || value->variable_type != expected)
+                throw std::runtime_error("Error: " + name + " is declared as " + type_name(expected) + " but is " + verb + " " +
+                                         (value ? type_name(value->variable_type) : "nothing"));
+            return value;
+        }
+
+        // An argument as the parameter it is for
+        std::shared_ptr<camaroo_object> bind_argument(const FunctionDef& definition, size_t index, std::shared_ptr<camaroo_object> arg) {
+            const Parameter& parameter = definition.parameters[index];
+            TokenType expected = declared_kind(parameter.type.type);
+            arg = widened(expected, std::move(arg));
+            if (arg->variable_type != expected)
+                throw std::runtime_error("Error: " + definition.name + " expects " + parameter.name + " to be " + parameter.type.value +
+                                         " but found " + type_name(arg->variable_type));
+            return arg;
+        }
+
+        std::shared_ptr<camaroo_object> checked_result(const FunctionDef& definition, std::shared_ptr<camaroo_object> result) {
+            TokenType expected = declared_kind(definition.return_type.type);
+            result = widened(expected, std::move(result));
+            if (result->variable_type != expected)
+                throw std::runtime_error("Error: " + definition.name + " returns " + definition.return_type.value +
+                                         " but returned " + type_name(result->variable_type));
+            return result;
+        }
+
+        // Starting value of every chunk's private copy of a reduction variable
+        std::shared_ptr<camaroo_object> reduction_identity(const Token& op, TokenType type) {
+            if (type == TokenType::num) {
+                if (op.type == TokenType::add)
+                    return make_object(TokenType::num, int64_t(0));
+                if (op.type == TokenType::multiply)
+                    return make_object(TokenType::num, int64_t(1));
+                if (op.value == "min")
+                    return make_object(TokenType::num, std::numeric_limits<int64_t>::max());
+                return make_object(TokenType::num, std::numeric_limits<int64_t>::min());
+            }
+
+            if (op.type == TokenType::add)
+                return make_object(TokenType::fnum, 0.0);
+            if (op.type == TokenType::multiply)
+                return make_object(TokenType::fnum, 1.0);
+            if (op.value == "min")
+                return make_object(TokenType::fnum, std::numeric_limits<double>::infinity());
+            return make_object(TokenType::fnum, -std::numeric_limits<double>::infinity());
+        }
+
+        std::shared_ptr<camaroo_object> reduction_combine(thread_pool& pool, const Token& op,
+                                                          const std::shared_ptr<camaroo_object>& left,
+                                                          const std::shared_ptr<camaroo_object>& right) {
+            if (op.type == TokenType::add)
+                return arithmetic(pool, simd::arith_op::add, *left, *right);
+            if (op.type == TokenType::multiply)
+                return arithmetic(pool, simd::arith_op::multiply, *left, *right);
+
+            simd::compare_op keep_right = (op.value == "min") ? simd::compare_op::less : simd::compare_op::greater;
+            return std::get<bool>(comparison(pool, keep_right, *right, *left)->variable_value) ? right : left;
+        }
+
+        iteration_space make_iteration_space(evaluator& context, ForStmnt* loop) {
+            ExpressionNode* iterable = loop->get_iterable();
+            iteration_space space;
+            if (iterable->token_type() == TokenType::to_keyword) {
+                space.first = range_bound(*context.evaluate_expression(iterable->get_left()));
+                space.count = range_length(space.first, range_bound(*context.evaluate_expression(iterable->get_right())));
+            } else {
+                space.list = context.evaluate_expression(iterable);
+                if (space.list->variable_type == TokenType::channel) {
+                    space.channel = std::get<std::shared_ptr<camaroo_channel>>(space.list->variable_value);
+                    space.element_type = space.channel->element_type();
+                } else if (space.list->variable_type == TokenType::generator) {
+                    space.sequence = std::get<std::shared_ptr<camaroo_generator>>(space.list->variable_value);
+                    space.element_type = space.sequence->element_type();
+                } else if (space.list->variable_type == TokenType::list) {
+                    const camaroo_list& values = *std::get<std::shared_ptr<camaroo_list>>(space.list->variable_value);
+                    space.count = values.size();
+                    space.element_type = values.element_type;
+                } else {
+                    throw std::runtime_error("Error: for loops go over a range, a list, a channel or a gen");
                 }
-                continue;
             }
+
+            if (space.element_type != declared_kind(loop->get_variable_type().type))
+                throw std::runtime_error("Error: loop variable is declared as " + loop->get_variable_type().value +
+                                         " but the loop goes over " + type_name(space.element_type) + " values");
+            return space;
         }
+
+        // Pops the scope it pushed even when the block throws
+        template <typename Scopes>
+        struct scope_guard {
+            Scopes& scopes;
+            explicit scope_guard(Scopes& owner) :scopes(owner) { scopes.emplace_back(); }
+            ~scope_guard() { scopes.pop_back(); }
+        };
     }
 
-    std::shared_ptr<camaroo_object> evaluator::evaluate_expression(ASTNode* statement) {
-        if (!statement) {
-            return nullptr;
+    void output_stream::write(const std::string& text) {
+        std::lock_guard<std::mutex> guard(lock);
+        out << text;
+    }
+
+    void output_stream::report(const std::string& error) {
+        ++errors;
+        std::lock_guard<std::mutex> guard(lock);
+        err << error << '\n';
+    }
+
+    struct evaluator::loop_frame_guard {
+        evaluator& owner;
+        size_t at;
+
+        // Loops nothing was taken out of don't get a frame
+        loop_frame_guard(evaluator& state, ForStmnt* loop)
+            :owner(state), at(SIZE_MAX) {
+            if (loop->hoisted_count() == 0 && loop->induction_count() == 0)
+                return;
+            at = owner.loop_frames.size();
+            loop_frame& frame = owner.loop_frames.emplace_back();
+            frame.loop = loop;
+            frame.hoisted.resize(loop->hoisted_count());
+            frame.inductions.resize(loop->induction_count());
+        }
+        ~loop_frame_guard() {
+            if (at != SIZE_MAX)
+                owner.loop_frames.pop_back();
         }
 
-        if (statement->token_type() == TokenType::identifier) {
+        void set_iteration(size_t iteration) {
+            if (at != SIZE_MAX)
+                owner.loop_frames[at].iteration = iteration;
+        }
+    };
+
+    output_stream& output_stream::standard() {
+        static output_stream stream(std::cout, std::cerr);
+        return stream;
+    }
+
+    bool evaluator::evaluate_program(const Program& program) {
+        size_t errors_before = output->error_count();
+        for (const auto& statement : program.statements) {
             try {
-                return declared_variables[std::get<std::string>(statement->token_value())];
+                evaluate_statement(statement.get());
             }
             catch (const std::exception& e) {
-                std::cerr << e.what() << '\n';
+                output->report(e.what());
             }
         }
+        // Tasks still point into the program's tree, so they have to finish before it can go away
+        tasks.wait();
+        return output->error_count() == errors_before;
+    }
 
-        if (statement->token_type() == TokenType::num) {
-            std::shared_ptr<camaroo_object> new_object = std::make_shared<camaroo_object>();
-            new_object->variable_type = TokenType::num;
-            new_object->variable_value = std::get<int64_t>(statement->token_value());
-            return new_object;
+    void evaluator::evaluate_statement(ASTNode* statement) {
+        switch (statement->token_type()) {
+            case TokenType::num_type:
+            case TokenType::fnum_type:
+            case TokenType::text_type:
+            case TokenType::letter_type:
+            case TokenType::toggle_type:
+            case TokenType::list_type:
+            case TokenType::channel_type:
+            case TokenType::map_type: {
+                std::string variable_name = std::get<std::string>(statement->get_left()->token_value());
+                declare_variable(variable_name, checked_value(variable_name, declared_kind(statement->token_type()),
+                                                              evaluate_expression(statement->get_right()), "given"));
+                return;
+            }
+            case TokenType::equal: {
+                std::string variable_name = std::get<std::string>(statement->get_left()->token_value());
+                assign_variable(variable_name, evaluate_expression(statement->get_right()));
+                return;
+            }
+            case TokenType::print:
+            case TokenType::println: {
+                if (statement->get_right() && statement->get_right()->node_kind() == NodeKind::format) {
+                    // Rendered straight into the line that gets written, without a text value in between
+                    std::string text;
+                    render(static_cast<FormatExpr*>(statement->get_right()), text);
+                    if (statement->token_type() == TokenType::println)
+                        text += '\n';
+                    output->write(text);
+                    return;
+                }
+                std::shared_ptr<camaroo_object> value = evaluate_expression(statement->get_right());
+                // One write per statement so lines printed from parallel loops don't interleave
+                std::ostringstream text;
+                write_object(text, *value);
+                if (statement->token_type() == TokenType::println)
+                    text << '\n';
+                output->write(text.str());
+                return;
+            }
+            case TokenType::semicolon:
+                evaluate_expression(statement->get_right());
+                return;
+            case TokenType::LCurlyBrace:
+                evaluate_block(static_cast<BlockStmnt*>(statement));
+                return;
+            case TokenType::spawn_keyword:
+                evaluate_spawn(static_cast<SpawnStmnt*>(statement));
+                return;
+            case TokenType::func_type:
+            case TokenType::gen_type: {
+                const std::shared_ptr<FunctionDef>& definition = static_cast<FuncStmnt*>(statement)->get_definition();
+                functions[definition->name] = {definition, this};
+                return;
+            }
+            case TokenType::use_keyword:
+                // Modules were linked in ahead of the statements that use them
+                return;
+            case TokenType::return_keyword:
+                return_value = statement->get_right() ? evaluate_expression(statement->get_right()) : nullptr;
+                returning = true;
+                return;
+            case TokenType::for_keyword: {
+                ForStmnt* loop = static_cast<ForStmnt*>(statement);
+                if (loop->is_parallel())
+                    evaluate_parallel_for(loop);
+                else
+                    evaluate_for(loop);
+                return;
+            }
+            default:
+                return;
         }
+    }
 
-        if (statement->token_type() == TokenType::text) {
-            std::shared_ptr<camaroo_object> new_object = std::make_shared<camaroo_object>();
-            new_object->variable_type = TokenType::text;
-            new_object->variable_value = std::get<std::string>(statement->token_value());
-            return new_object;
+    std::shared_ptr<camaroo_object> evaluator::find_variable(const std::string& name) const {
+        for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+            auto it = scope->find(name);
+            if (it != scope->end())
+                return it->second;
         }
 
-        if (statement->token_type() == TokenType::add) {
-            std::shared_ptr<camaroo_object> left = evaluate_expression(statement->get_left());
-            std::shared_ptr<camaroo_object> right = evaluate_expression(statement->get_right());
-            int64_t value;
-            try {
-                value = std::get<int64_t>(left->variable_value) + std::get<int64_t>(right->variable_value);
+        auto it = declared_variables.find(name);
+        if (it != declared_variables.end())
+            return it->second;
+        return parent ? parent->find_variable(name) : nullptr;
+    }
+
+    void evaluator::declare_variable(const std::string& name, std::shared_ptr<camaroo_object> value) {
+        Scope& scope = scopes.empty() ? declared_variables : scopes.back();
+        scope[name] = std::move(value);
+    }
+
+    void evaluator::assign_variable(const std::string& name, std::shared_ptr<camaroo_object> value) {
+        // A variable keeps the kind it was declared with, an fnum stays one when a num is put in it and anything
+        // else that isn't that kind is an error
+        auto kept = [&](const std::shared_ptr<camaroo_object>& current) {
+            return current ? checked_value(name, current->variable_type, std::move(value), "assigned") : std::move(value);
+        };
+        for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+            auto it = scope->find(name);
+            if (it != scope->end()) {
+                it->second = kept(it->second);
+                return;
             }
-            catch (const std::exception& e) {
-                std::cerr << e.what() << '\n';
+        }
+
+        auto it = declared_variables.find(name);
+        if (it != declared_variables.end()) {
+            it->second = kept(it->second);
+            return;
+        }
+        std::shared_ptr<camaroo_object> outer = parent ? parent->find_variable(name) : nullptr;
+        if (outer && parallel_chunk)
+            throw std::runtime_error("Error: parallel for can't write to outer variable " + name + ", add a reduce clause for it");
+        if (outer)
+            throw std::runtime_error("Error: funcs can't write to outer variable " + name + ", return the new value instead");
+        declared_variables[name] = kept(outer);
+    }
+
+    const evaluator::function_entry* evaluator::find_function(const std::string& name) const {
+        auto it = functions.find(name);
+        if (it != functions.end())
+            return &it->second;
+        return parent ? parent->find_function(name) : nullptr;
+    }
+
+    std::shared_ptr<camaroo_object> evaluator::call_function(const function_entry& function,
+                                                             const std::vector<std::shared_ptr<camaroo_object>>& args) {
+        const FunctionDef& definition = *function.definition;
+        if (args.size() != definition.parameters.size())
+            throw std::runtime_error("Error: " + definition.name + " expects " + std::to_string(definition.parameters.size()) +
+                                     " argument(s) but found " + std::to_string(args.size()));
+        BlockStmnt* body = function.definition->get_body();
+
+        // Calls get a frame of their own on top of the evaluator the function was declared in
+        auto frame = std::make_shared<evaluator>(*pool, *function.owner);
+        for (size_t i = 0; i < args.size(); ++i)
+            frame->declare_variable(definition.parameters[i].name, bind_argument(definition, i, args[i]));
+
+        if (definition.kind.type == TokenType::gen_type) {
+            // Nothing runs until the first value is pulled, the generator keeps the frame and the body alive
+            generator<std::shared_ptr<camaroo_object>> values = frame->yield_block(body);
+            auto state = std::make_shared<std::pair<std::shared_ptr<evaluator>, std::shared_ptr<FunctionDef>>>(frame, function.definition);
+            return make_object(TokenType::generator, std::make_shared<camaroo_generator>(
+                declared_kind(definition.return_type.type), std::move(values), std::move(state)));
+        }
+
+        depth_guard depth;
+        frame->evaluate_block(body);
+        if (!frame->returning)
+            throw std::runtime_error("Error: " + definition.name + " ended without returning a value");
+
+        return checked_result(definition, frame->return_value);
+    }
+
+    void evaluator::render(FormatExpr* format, std::string& into) {
+        const std::vector<camaroo_text>& pieces = format->get_pieces();
+        const std::vector<std::unique_ptr<ExpressionNode>>& slots = format->get_slots();
+        std::vector<std::shared_ptr<camaroo_object>> values;
+        values.reserve(slots.size());
+        // Room for the newline println adds, numbers are guessed at
+        size_t size = into.size() + 1;
+        for (const camaroo_text& piece : pieces)
+            size += piece.size();
+        for (const auto& slot : slots) {
+            std::shared_ptr<camaroo_object> value = evaluate_expression(slot.get());
+            if (!value)
+                throw std::runtime_error("Error: couldn't evaluate {" + slot->to_string() + "} in text");
+            size += (value->variable_type == TokenType::text) ? std::get<camaroo_text>(value->variable_value).size() : 16;
+            values.push_back(std::move(value));
+        }
+
+        into.reserve(size);
+        into += pieces[0].view();
+        for (size_t i = 0; i < values.size(); ++i) {
+            append_object(into, *values[i]);
+            into += pieces[i + 1].view();
+        }
+    }
+
+    std::shared_ptr<camaroo_object> evaluator::evaluate_inlined(InlinedCallExpr* inlined) {
+        FunctionDef& definition = *inlined->get_definition();
+        const function_entry* declared = find_function(definition.name);
+        const InlineBody* body = declared && declared->definition.get() == &definition ? definition.get_inline_body() : nullptr;
+        if (!body)
+            return evaluate_expression(inlined->get_call());
+
+        Arguments args;
+        for (const auto& argument : inlined->get_call()->get_arguments())
+            args.push_back(evaluate_expression(argument.get()));
+
+        // The body's slots go on top of those of any inlined call still being worked out around this one
+        struct slot_guard {
+            evaluator& owner;
+            size_t base;
+            size_t outer_base;
+            slot_guard(evaluator& state)
+                :owner(state), base(state.inline_values.size()), outer_base(state.inline_base) {}
+            ~slot_guard() {
+                owner.inline_values.resize(base);
+                owner.inline_base = outer_base;
             }
+        } slots(*this);
+        for (size_t i = 0; i < args.size(); ++i)
+            inline_values.push_back(bind_argument(definition, i, std::move(args[i])));
+
+        depth_guard depth;
+        inline_base = slots.base;
+        for (size_t i = 0; i < body->locals.size(); ++i)
+            inline_values.push_back(widened(declared_kind(body->local_types[i]), evaluate_expression(body->locals[i].get())));
+        return checked_result(definition, evaluate_expression(body->result.get()));
+    }
 
-            std::shared_ptr<camaroo_object> new_object = std::make_shared<camaroo_object>();
-            new_object->variable_type = TokenType::num;
-            new_object->variable_value = value;
-            return new_object;
+    void evaluator::evaluate_block(BlockStmnt* block) {
+        scope_guard<std::vector<Scope>> guard(scopes);
+        for (const auto& statement : block->get_statements()) {
+            evaluate_statement(statement.get());
+            if (returning)
+                return;
         }
+    }
 
-        if (statement->token_type() == TokenType::subtract) {
-            std::shared_ptr<camaroo_object> left = evaluate_expression(statement->get_left());
-            std::shared_ptr<camaroo_object> right = evaluate_expression(statement->get_right());
-            int64_t value;
+    generator<std::shared_ptr<camaroo_object>> evaluator::yield_block(BlockStmnt* block) {
+        // Statements without a yield inside run normally, only the path down to a yield is resumable
+        scope_guard<std::vector<Scope>> guard(scopes);
+        for (const auto& statement : block->get_statements()) {
+            TokenType type = statement->token_type();
+            if (type == TokenType::yield_keyword) {
+                co_yield evaluate_expression(statement->get_right());
+            } else if (type == TokenType::LCurlyBrace && static_cast<BlockStmnt*>(statement.get())->has_yield()) {
+                generator<std::shared_ptr<camaroo_object>> inner = yield_block(static_cast<BlockStmnt*>(statement.get()));
+                while (inner.next())
+                    co_yield std::move(inner.value());
+            } else if (type == TokenType::for_keyword && static_cast<ForStmnt*>(statement.get())->get_body()->has_yield()) {
+                ForStmnt* loop = static_cast<ForStmnt*>(statement.get());
+                iteration_space space = make_iteration_space(*this, loop);
+                std::string variable_name = std::get<std::string>(loop->get_left()->token_value());
+
+                scope_guard<std::vector<Scope>> loop_guard(scopes);
+                size_t index = 0;
+                while (std::shared_ptr<camaroo_object> value = space.pull(index)) {
+                    declare_variable(variable_name, std::move(value));
+                    generator<std::shared_ptr<camaroo_object>> inner = yield_block(loop->get_body());
+                    while (inner.next())
+                        co_yield std::move(inner.value());
+                    if (returning)
+                        break;
+                }
+            } else {
+                evaluate_statement(statement.get());
+            }
+
+            if (returning)
+                co_return;
+        }
+    }
+
+    void evaluator::collect_visible(Scope& into, Functions& functions_into) const {
+        if (parent)
+            parent->collect_visible(into, functions_into);
+        for (const auto& [name, function] : functions)
+            functions_into[name] = function;
+        for (const auto& [name, value] : declared_variables)
+            into[name] = value;
+        for (const auto& scope : scopes) {
+            for (const auto& [name, value] : scope)
+                into[name] = value;
+        }
+    }
+
+    void evaluator::evaluate_spawn(SpawnStmnt* spawn) {
+        // Tasks start from a copy of the variables they can see, values are never changed in place
+        // so the copy is cheap and the task's writes stay its own. Channels are how tasks talk.
+        auto frame = std::make_shared<evaluator>(*pool, *output);
+        collect_visible(frame->declared_variables, frame->functions);
+        // Functions read the task's copy from now on, not the variables the spawning side keeps changing
+        for (auto& [name, function] : frame->functions)
+            function.owner = frame.get();
+
+        BlockStmnt* body = spawn->get_body();
+        tasks.spawn(task_scheduler::shared(), [frame, body]() {
             try {
-                value = std::get<int64_t>(left->variable_value) - std::get<int64_t>(right->variable_value);
+                frame->evaluate_block(body);
             }
             catch (const std::exception& e) {
-                std::cerr << e.what() << '\n';
+                frame->output->report(e.what());
             }
+            frame->tasks.wait();
+        });
+    }
+
+    void evaluator::evaluate_for(ForStmnt* loop) {
+        iteration_space space = make_iteration_space(*this, loop);
+        std::string variable_name = std::get<std::string>(loop->get_left()->token_value());
 
-            std::shared_ptr<camaroo_object> new_object = std::make_shared<camaroo_object>();
-            new_object->variable_type = TokenType::num;
-            new_object->variable_value = value;
-            return new_object;
+        scope_guard<std::vector<Scope>> guard(scopes);
+        loop_frame_guard frame(*this, loop);
+        size_t index = 0;
+        size_t iteration = 0;
+        while (std::shared_ptr<camaroo_object> value = space.pull(index)) {
+            frame.set_iteration(iteration++);
+            declare_variable(variable_name, std::move(value));
+            evaluate_block(loop->get_body());
+            if (returning)
+                return;
         }
+    }
 
-        if (statement->token_type() == TokenType::multiply) {
-            std::shared_ptr<camaroo_object> left = evaluate_expression(statement->get_left());
-            std::shared_ptr<camaroo_object> right = evaluate_expression(statement->get_right());
-            int64_t value;
-            try {
-                value = std::get<int64_t>(left->variable_value) * std::get<int64_t>(right->variable_value);
+    void evaluator::evaluate_parallel_for(ForStmnt* loop) {
+        iteration_space space = make_iteration_space(*this, loop);
+        std::string variable_name = std::get<std::string>(loop->get_left()->token_value());
+        if (!space.is_counted())
+            throw std::runtime_error("Error: parallel for only goes over ranges and lists, spawn tasks that pull from channels instead");
+        if (space.count == 0)
+            return;
+
+        const std::vector<ReductionClause>& reductions = loop->get_reductions();
+        std::vector<std::shared_ptr<camaroo_object>> initial;
+        for (const auto& clause : reductions) {
+            std::shared_ptr<camaroo_object> value = find_variable(clause.variable);
+            if (!value)
+                throw std::runtime_error("Error: " + clause.variable + " is not declared");
+            if (!is_number(*value))
+                throw std::runtime_error("Error: reduce needs " + clause.variable + " to be a num or fnum");
+            initial.push_back(value);
+        }
+
+        // Chunk size only depends on the iteration count so the combined result doesn't change with the thread count,
+        // and there are enough chunks for idle workers to steal when iterations take uneven time
+        size_t grain = std::max<size_t>(1, (space.count + 1023) / 1024);
+        std::vector<std::vector<std::shared_ptr<camaroo_object>>> partials((space.count + grain - 1) / grain);
+
+        pool->parallel_for(space.count, grain, [&](size_t begin, size_t end) {
+            evaluator frame(*pool, *this, true);
+            for (size_t r = 0; r < reductions.size(); ++r)
+                frame.declare_variable(reductions[r].variable, reduction_identity(reductions[r].op, initial[r]->variable_type));
+
+            loop_frame_guard hoisted(frame, loop);
+            for (size_t i = begin; i < end; ++i) {
+                hoisted.set_iteration(i);
+                frame.declare_variable(variable_name, space.at(i));
+                frame.evaluate_block(loop->get_body());
             }
-            catch (const std::exception& e) {
-                std::cerr << e.what() << '\n';
+
+            std::vector<std::shared_ptr<camaroo_object>>& partial = partials[begin / grain];
+            for (const auto& clause : reductions)
+                partial.push_back(frame.find_variable(clause.variable));
+        });
+
+        for (size_t r = 0; r < reductions.size(); ++r) {
+            std::shared_ptr<camaroo_object> result = initial[r];
+            for (const auto& partial : partials)
+                result = reduction_combine(*pool, reductions[r].op, result, partial[r]);
+            assign_variable(reductions[r].variable, result);
+        }
+    }
+
+    std::shared_ptr<camaroo_object> evaluator::evaluate_shared(SharedExpr* shared) {
+        ExpressionNode* target = shared->get_target();
+        if (!shared->is_memoized())
+            return evaluate_expression(target);
+
+        auto found = shared_values.find(target);
+        if (found != shared_values.end())
+            return found->second;
+        std::shared_ptr<camaroo_object> value = evaluate_expression(target);
+        shared_values.emplace(target, value);
+        return value;
+    }
+
+    evaluator::loop_frame* evaluator::find_loop_frame(ForStmnt* loop) {
+        for (auto frame = loop_frames.rbegin(); frame != loop_frames.rend(); ++frame) {
+            if (frame->loop == loop)
+                return &*frame;
+        }
+        return nullptr;
+    }
+
+    std::shared_ptr<camaroo_object> evaluator::evaluate_hoisted(HoistedExpr* hoisted) {
+        loop_frame* frame = find_loop_frame(hoisted->get_loop());
+        if (!frame)
+            return evaluate_expression(hoisted->get_target());
+
+        // Hoisted expressions are pure, working one out never runs a loop, so frame stays where it is
+        std::shared_ptr<camaroo_object>& kept = frame->hoisted[hoisted->get_slot()];
+        if (!kept)
+            kept = evaluate_expression(hoisted->get_target());
+        return kept;
+    }
+
+    std::shared_ptr<camaroo_object> evaluator::evaluate_induction(InductionExpr* induction) {
+        loop_frame* frame = find_loop_frame(induction->get_loop());
+        if (!frame)
+            return evaluate_expression(induction->get_target());
+
+        auto& [iteration, kept] = frame->inductions[induction->get_slot()];
+        if (kept && iteration == frame->iteration)
+            return kept;
+        if (kept && iteration + 1 == frame->iteration) {
+            int64_t stride = induction->get_stride();
+            bool known = induction->has_constant_stride();
+            if (!known) {
+                std::shared_ptr<camaroo_object> side = evaluate_expression(induction->get_stride_side());
+                known = side && side->variable_type == TokenType::num;
+                if (known)
+                    stride = std::get<int64_t>(side->variable_value);
             }
+            if (known) {
+                uint64_t next = static_cast<uint64_t>(std::get<int64_t>(kept->variable_value)) + static_cast<uint64_t>(stride);
+                kept = make_object(TokenType::num, static_cast<int64_t>(next));
+                iteration = frame->iteration;
+                return kept;
+            }
+        }
+
+        // First iteration, or a stride that isn't a num, fnum strides round differently when added up
+        std::shared_ptr<camaroo_object> value = evaluate_expression(induction->get_target());
+        kept = (value && value->variable_type == TokenType::num) ? value : nullptr;
+        iteration = frame->iteration;
+        return value;
+    }
+
+    std::shared_ptr<camaroo_object> evaluator::evaluate_expression(ASTNode* statement) {
+        if (!statement) {
+            return nullptr;
+        }
+
+        // A memoised value only holds while the variables it read can't change, which is until the outermost call returns
+        if (expression_depth == 0 && !shared_values.empty())
+            shared_values.clear();
+        struct depth_guard {
+            size_t& depth;
+            ~depth_guard() { --depth; }
+        } guard{++expression_depth};
+
+        NodeKind kind = statement->node_kind();
+        if (kind == NodeKind::shared)
+            return evaluate_shared(static_cast<SharedExpr*>(statement));
 
-            std::shared_ptr<camaroo_object> new_object = std::make_shared<camaroo_object>();
-            new_object->variable_type = TokenType::num;
-            new_object->variable_value = value;
-            return new_object;
+        if (kind == NodeKind::slot)
+            return inline_values[inline_base + static_cast<SlotExpr*>(statement)->get_slot()];
+        if (kind == NodeKind::inlined)
+            return evaluate_inlined(static_cast<InlinedCallExpr*>(statement));
+        if (kind == NodeKind::hoisted)
+            return evaluate_hoisted(static_cast<HoistedExpr*>(statement));
+        if (kind == NodeKind::induction)
+            return evaluate_induction(static_cast<InductionExpr*>(statement));
+
+        if (kind == NodeKind::arith_chain) {
+            ArithChainExpr* chain = static_cast<ArithChainExpr*>(statement);
+            std::shared_ptr<camaroo_object> value = evaluate_expression(chain->get_operand());
+            if (value && value->variable_type == TokenType::num) {
+                if (chain->get_plan().ops.empty())
+                    return value;
+                return make_object(TokenType::num, chain->get_plan().apply(std::get<int64_t>(value->variable_value)));
+            }
+            // fnums, lists and values the steps reject take the steps one at a time
+            for (const ArithStep& step : chain->get_steps()) {
+                std::shared_ptr<camaroo_object> constant = make_object(TokenType::num, step.value);
+                simd::arith_op op = *to_arith_op(step.op.type);
+                value = step.constant_left ? arithmetic(*pool, op, *constant, *value) : arithmetic(*pool, op, *value, *constant);
+            }
+            return value;
+        }
+
+        if (statement->token_type() == TokenType::identifier) {
+            std::string name = std::get<std::string>(statement->token_value());
+            std::shared_ptr<camaroo_object> value = find_variable(name);
+            if (!value)
+                throw std::runtime_error("Error: " + name + " is not declared");
+            return value;
+        }
+
+        if (statement->token_type() == TokenType::num) {
+            return make_object(TokenType::num, std::get<int64_t>(statement->token_value()));
+        }
+
+        if (statement->token_type() == TokenType::fnum) {
+            return make_object(TokenType::fnum, std::get<double>(statement->token_value()));
+        }
+
+        if (statement->token_type() == TokenType::toggle) {
+            return make_object(TokenType::toggle, std::get<bool>(statement->token_value()));
+        }
+
+        if (statement->token_type() == TokenType::text) {
+            return make_object(TokenType::text, static_cast<TextExpr*>(statement)->get_text());
         }
 
-        if (statement->token_type() == TokenType::division) {
+        if (kind == NodeKind::letter) {
+            return make_object(TokenType::letter, static_cast<LetterExpr*>(statement)->get_letter());
+        }
+
+        if (kind == NodeKind::format) {
+            std::string text;
+            render(static_cast<FormatExpr*>(statement), text);
+            return make_object(TokenType::text, camaroo_text::take(std::move(text)));
+        }
+
+        if (statement->token_type() == TokenType::LSquareBracket) {
+            std::vector<std::shared_ptr<camaroo_object>> elements;
+            for (const auto& element : static_cast<ListExpr*>(statement)->get_elements())
+                elements.push_back(evaluate_expression(element.get()));
+            return make_list(elements);
+        }
+
+        if (statement->token_type() == TokenType::LParen) {
+            std::string name = std::get<std::string>(statement->get_left()->token_value());
+            const function_entry* declared = find_function(name);
+            builtin_fn builtin = declared ? nullptr : find_builtin(name);
+            if (!declared && !builtin)
+                throw std::runtime_error("Error: " + name + " is not a function");
+
+            Arguments args;
+            for (const auto& argument : static_cast<CallExpr*>(statement)->get_arguments())
+                args.push_back(evaluate_expression(argument.get()));
+            return declared ? call_function(*declared, args) : builtin(*this, args);
+        }
+
+        if (kind == NodeKind::map) {
+            MapExpr* map = static_cast<MapExpr*>(statement);
+            return make_object(TokenType::map, std::make_shared<camaroo_map>(
+                declared_kind(map->get_key_type().type), declared_kind(map->get_value_type().type)));
+        }
+
+        if (statement->token_type() == TokenType::channel_type) {
+            ChannelExpr* channel = static_cast<ChannelExpr*>(statement);
+            std::shared_ptr<camaroo_object> capacity = evaluate_expression(channel->get_right());
+            if (capacity->variable_type != TokenType::num || std::get<int64_t>(capacity->variable_value) < 1)
+                throw std::runtime_error("Error: channel capacity has to be a num of at least 1");
+            return make_object(TokenType::channel, std::make_shared<camaroo_channel>(
+                declared_kind(channel->get_element_type().type), static_cast<size_t>(std::get<int64_t>(capacity->variable_value))));
+        }
+
+        if (statement->token_type() == TokenType::to_keyword) {
+            int64_t first = range_bound(*evaluate_expression(statement->get_left()));
+            size_t count = range_length(first, range_bound(*evaluate_expression(statement->get_right())));
+            std::vector<int64_t> values(count);
+            for (size_t i = 0; i < count; ++i)
+                values[i] = static_cast<int64_t>(static_cast<uint64_t>(first) + i);
+            return make_object(TokenType::list, std::make_shared<camaroo_list>(camaroo_list{TokenType::num, std::move(values)}));
+        }
+
+        if (statement->token_type() == TokenType::subtract && !statement->get_left()) {
+            std::shared_ptr<camaroo_object> right = evaluate_expression(statement->get_right());
+            return arithmetic(*pool, simd::arith_op::subtract, *make_object(TokenType::num, int64_t(0)), *right);
+        }
+
+        // check_types marks operators whose operands are always two nums or two fnums, those go straight to the
+        // operation. Values taking another path there, a declaration that failed and left an older variable in
+        // place, still get the full checks
+        TokenType operands = kind == NodeKind::infix ? static_cast<InfixExpr*>(statement)->get_operand_kind() : TokenType::unknown;
+
+        if (auto op = to_arith_op(statement->token_type())) {
             std::shared_ptr<camaroo_object> left = evaluate_expression(statement->get_left());
             std::shared_ptr<camaroo_object> right = evaluate_expression(statement->get_right());
-            int64_t value;
-            try {
-                value = std::get<int64_t>(left->variable_value) / std::get<int64_t>(right->variable_value);
-            }
-            catch (const std::exception& e) {
-                std::cerr << e.what() << '\n';
+            if (operands == TokenType::num) {
+                const int64_t* a = std::get_if<int64_t>(&left->variable_value);
+                const int64_t* b = std::get_if<int64_t>(&right->variable_value);
+                if (a && b)
+                    return num_arithmetic(*op, *a, *b);
+            } else if (operands == TokenType::fnum) {
+                const double* a = std::get_if<double>(&left->variable_value);
+                const double* b = std::get_if<double>(&right->variable_value);
+                if (a && b)
+                    return fnum_arithmetic(*op, *a, *b);
             }
+            return arithmetic(*pool, *op, *left, *right);
+        }
 
-            std::shared_ptr<camaroo_object> new_object = std::make_shared<camaroo_object>();
-            new_object->variable_type = TokenType::num;
-            new_object->variable_value = value;
-            return new_object;
+        if (auto op = to_compare_op(statement->token_type())) {
+            std::shared_ptr<camaroo_object> left = evaluate_expression(statement->get_left());
+            std::shared_ptr<camaroo_object> right = evaluate_expression(statement->get_right());
+            if (operands == TokenType::num) {
+                const int64_t* a = std::get_if<int64_t>(&left->variable_value);
+                const int64_t* b = std::get_if<int64_t>(&right->variable_value);
+                if (a && b)
+                    return compared(*op, *a, *b);
+            } else if (operands == TokenType::fnum) {
+                const double* a = std::get_if<double>(&left->variable_value);
+                const double* b = std::get_if<double>(&right->variable_value);
+                if (a && b)
+                    return compared(*op, *a, *b);
+            }
+            return comparison(*pool, *op, *left, *right);
         }
         return nullptr;
     }
-}
\ No newline at end of file
+}
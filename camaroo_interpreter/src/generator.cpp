@@ -0,0 +1,104 @@
+#include <generator.h>
+#include <stdexcept>
+
+namespace camaroo_core {
+
+    namespace frame_allocator {
+
+        namespace {
+            constexpr size_t bucket_size = 64;
+            constexpr size_t bucket_count = 64; // frames up to 4 KiB are recycled
+
+            struct free_frame {
+                free_frame* next;
+            };
+
+            // Frames freed after the thread's lists are gone, by objects destroyed late, go straight back to the heap
+            thread_local bool lists_alive = false;
+
+            struct free_lists {
+                free_frame* heads[bucket_count] = {};
+
+                free_lists() { lists_alive = true; }
+                ~free_lists() {
+                    lists_alive = false;
+                    for (free_frame* head : heads) {
+                        while (head) {
+                            free_frame* next = head->next;
+                            ::operator delete(head);
+                            head = next;
+                        }
+                    }
+                }
+            };
+
+            thread_local free_lists lists;
+
+            size_t bucket_of(size_t size) {
+                return (size + bucket_size - 1) / bucket_size - 1;
+            }
+        }
+
+        void* allocate(size_t size) {
+            size_t bucket = bucket_of(size);
+            if (bucket >= bucket_count)
+                return ::operator new(size);
+
+            if (free_frame* frame = lists.heads[bucket]) {
+                lists.heads[bucket] = frame->next;
+                return frame;
+            }
+            return ::operator new((bucket + 1) * bucket_size);
+        }
+
+        void deallocate(void* frame, size_t size) {
+            size_t bucket = bucket_of(size);
+            if (bucket >= bucket_count || !lists_alive) {
+                ::operator delete(frame);
+                return;
+            }
+
+            // Frames freed on another thread than they came from just move to this thread's list
+            free_frame* freed = static_cast<free_frame*>(frame);
+            freed->next = lists.heads[bucket];
+            lists.heads[bucket] = freed;
+        }
+    }
+
+    camaroo_generator::camaroo_generator(TokenType element_type, generator<std::shared_ptr<camaroo_object>> body,
+                                         std::shared_ptr<void> state)
+        :type(element_type), owner(std::this_thread::get_id()), state(std::move(state)), body(std::move(body)) {}
+
+    std::shared_ptr<camaroo_object> camaroo_generator::next() {
+        if (std::this_thread::get_id() != owner)
+            throw std::runtime_error("Error: a generator can only be used by the task that made it");
+        if (running)
+            throw std::runtime_error("Error: a generator can't pull values from itself");
+        if (finished)
+            return nullptr;
+
+        running = true;
+        bool has_value = false;
+        try {
+            has_value = body.next();
+        }
+        catch (...) {
+            running = false;
+            finished = true;
+            throw;
+        }
+        running = false;
+
+        if (!has_value) {
+            finished = true;
+            return nullptr;
+        }
+
+        std::shared_ptr<camaroo_object> value = std::move(body.value());
+        if (type == TokenType::fnum && value->variable_type == TokenType::num)
+            return make_object(TokenType::fnum, static_cast<double>(std::get<int64_t>(value->variable_value)));
+        if (value->variable_type != type)
+            throw std::runtime_error(std::string("Error: generator yields ") + type_name(type) + " but got " + type_name(value->variable_type));
+        return value;
+    }
+}
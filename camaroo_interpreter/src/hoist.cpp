@@ -0,0 +1,269 @@
+#include <hoist.h>
+#include <algorithm>
+#include <string>
+#include <unordered_set>
+#include <utility>
+
+namespace camaroo_core {
+
+    namespace {
+
+        // Names a statement can give a new value to, loop variables and reduce clauses included
+        void collect_writes(ASTNode* node, std::unordered_set<std::string>& writes) {
+            if (!node)
+                return;
+            switch (node->node_kind()) {
+                case NodeKind::assign:
+                    writes.insert(std::get<std::string>(node->get_left()->token_value()));
+                    return;
+                case NodeKind::block:
+                    for (const auto& statement : static_cast<BlockStmnt*>(node)->get_statements())
+                        collect_writes(statement.get(), writes);
+                    return;
+                case NodeKind::for_loop: {
+                    auto* loop = static_cast<ForStmnt*>(node);
+                    writes.insert(std::get<std::string>(loop->get_left()->token_value()));
+                    for (const auto& clause : loop->get_reductions())
+                        writes.insert(clause.variable);
+                    collect_writes(loop->get_body(), writes);
+                    return;
+                }
+                case NodeKind::spawn:
+                    // Tasks write copies of their own, counting them anyway costs little
+                    collect_writes(static_cast<SpawnStmnt*>(node)->get_body(), writes);
+                    return;
+                default:
+                    // Function bodies declare into frames of their own and can't assign the caller's variables
+                    return;
+            }
+        }
+
+        class hoister {
+        public:
+            void statement(ASTNode* node);
+            size_t wrapped = 0;
+        private:
+            struct loop_info {
+                ForStmnt* loop;
+                std::string variable;
+                // Everything the body writes, and the loop variable
+                std::unordered_set<std::string> variant;
+                // Goes over a range and the body leaves the variable alone, so it counts up by one
+                bool counts_up = false;
+                uint32_t hoisted = 0;
+                uint32_t inductions = 0;
+            };
+
+            static constexpr size_t npos = static_cast<size_t>(-1);
+
+            void loop(ForStmnt* node);
+            void fresh(BlockStmnt* body);
+            void root(std::unique_ptr<ExpressionNode>& slot);
+            size_t expression(std::unique_ptr<ExpressionNode>& slot);
+            void hoist(std::unique_ptr<ExpressionNode>& slot, size_t level);
+            size_t level_of(const std::string& name) const;
+            size_t induction_loop(ASTNode* side) const;
+            void make_induction(std::unique_ptr<ExpressionNode>& slot, const size_t* levels, size_t count);
+
+            // Enclosing loops, outermost first. A loop's variant names include those of every loop inside it, so
+            // an expression that doesn't change in one loop doesn't change in the loops inside it either
+            std::vector<loop_info> loops;
+            // Levels of the children of the expressions being looked at, a stack shared by the whole walk
+            std::vector<size_t> child_levels;
+        };
+
+        // Levels go from 0, the same on every iteration of every enclosing loop, to loops.size(), changes in
+        // the innermost loop. An expression at level l can be worked out once per run of loops[l]
+        size_t hoister::level_of(const std::string& name) const {
+            size_t level = loops.size();
+            while (level > 0 && loops[level - 1].variant.count(name) == 0)
+                --level;
+            return level;
+        }
+
+        void hoister::hoist(std::unique_ptr<ExpressionNode>& slot, size_t level) {
+            loop_info& target = loops[level];
+            slot = std::make_unique<HoistedExpr>(std::move(slot), target.loop, target.hoisted++);
+            ++wrapped;
+        }
+
+        // Index of the loop whose counting variable side is, npos when it isn't one
+        size_t hoister::induction_loop(ASTNode* side) const {
+            if (!side || side->node_kind() != NodeKind::identifier)
+                return npos;
+            std::string name = std::get<std::string>(side->token_value());
+            for (size_t i = loops.size(); i-- > 0;) {
+                if (loops[i].variable == name)
+                    return loops[i].counts_up && level_of(name) == i + 1 ? i : npos;
+            }
+            return npos;
+        }
+
+        void hoister::make_induction(std::unique_ptr<ExpressionNode>& slot, const size_t* levels, size_t count) {
+            ExpressionNode* node = slot.get();
+            size_t at = npos;
+            bool constant = false, on_left = false;
+            int64_t stride = 0;
+
+            if (node->node_kind() == NodeKind::arith_chain) {
+                auto* chain = static_cast<ArithChainExpr*>(node);
+                const IntPlan& plan = chain->get_plan();
+                if (plan.ops.size() != 1 || plan.ops[0].what != IntPlan::kind::affine)
+                    return;
+                at = induction_loop(chain->get_operand());
+                constant = true;
+                stride = plan.ops[0].multiplier;
+            }
+            else if (node->node_kind() == NodeKind::infix && node->token_type() == TokenType::multiply && count == 2) {
+                // The stride has to stay the same for the whole loop
+                size_t left = induction_loop(node->get_left());
+                size_t right = induction_loop(node->get_right());
+                if (left != npos && levels[1] <= left)
+                    at = left;
+                else if (right != npos && levels[0] <= right) {
+                    at = right;
+                    on_left = true;
+                }
+            }
+            if (at == npos)
+                return;
+
+            loop_info& target = loops[at];
+            slot = std::make_unique<InductionExpr>(std::move(slot), target.loop, target.inductions++, constant, stride, on_left);
+            ++wrapped;
+        }
+
+        size_t hoister::expression(std::unique_ptr<ExpressionNode>& slot) {
+            size_t level = 0;
+            switch (slot->node_kind()) {
+                case NodeKind::identifier:
+                    level = level_of(std::get<std::string>(slot->token_value()));
+                    break;
+                case NodeKind::toggle:
+                case NodeKind::num:
+                case NodeKind::fnum:
+                case NodeKind::text:
+                case NodeKind::letter:
+                case NodeKind::prefix:
+                case NodeKind::infix:
+                case NodeKind::list:
+                case NodeKind::format:
+                case NodeKind::arith_chain:
+                    break;
+                default:
+                    // Calls and channels do something every time, their arguments can still move out
+                    level = loops.size();
+                    break;
+            }
+
+            size_t first = child_levels.size();
+            slot->visit_expressions([&](std::unique_ptr<ExpressionNode>& child) {
+                size_t child_level = child ? expression(child) : 0;
+                child_levels.push_back(child_level);
+                level = std::max(level, child_level);
+            });
+
+            // Children that stay the same for longer than this expression move out on their own
+            size_t at = first;
+            slot->visit_expressions([&](std::unique_ptr<ExpressionNode>& child) {
+                size_t child_level = child_levels[at++];
+                if (child && child_level < level)
+                    hoist(child, child_level);
+            });
+            if (level > 0)
+                make_induction(slot, child_levels.data() + first, child_levels.size() - first);
+            child_levels.resize(first);
+            return level;
+        }
+
+        void hoister::root(std::unique_ptr<ExpressionNode>& slot) {
+            size_t level = expression(slot);
+            if (level < loops.size())
+                hoist(slot, level);
+        }
+
+        void hoister::fresh(BlockStmnt* body) {
+            std::vector<loop_info> outer = std::exchange(loops, {});
+            statement(body);
+            loops = std::move(outer);
+        }
+
+        void hoister::loop(ForStmnt* node) {
+            BlockStmnt* body = node->get_body();
+            if (body->has_yield()) {
+                // A gen stops at its yields, and the globals it reads can change before it goes on
+                fresh(body);
+                return;
+            }
+
+            loop_info info;
+            info.loop = node;
+            info.variable = std::get<std::string>(node->get_left()->token_value());
+            collect_writes(body, info.variant);
+            info.counts_up = node->get_iterable()->token_type() == TokenType::to_keyword &&
+                             info.variant.count(info.variable) == 0;
+            info.variant.insert(info.variable);
+
+            // Chunks of a parallel loop run its body in evaluators of their own
+            std::vector<loop_info> outer;
+            if (node->is_parallel())
+                outer = std::exchange(loops, {});
+            loops.push_back(std::move(info));
+            statement(body);
+            node->set_hoisted(loops.back().hoisted, loops.back().inductions);
+            loops.pop_back();
+            if (node->is_parallel())
+                loops = std::move(outer);
+        }
+
+        void hoister::statement(ASTNode* node) {
+            if (!node)
+                return;
+            if (!loops.empty()) {
+                bool range = node->node_kind() == NodeKind::for_loop &&
+                             static_cast<ForStmnt*>(node)->get_iterable()->token_type() == TokenType::to_keyword;
+                node->visit_expressions([&](std::unique_ptr<ExpressionNode>& slot) {
+                    if (!slot)
+                        return;
+                    // A loop reads its range bound by bound, never as a list
+                    if (range)
+                        slot->visit_expressions([&](std::unique_ptr<ExpressionNode>& bound) {
+                            if (bound)
+                                root(bound);
+                        });
+                    else
+                        root(slot);
+                });
+            }
+
+            switch (node->node_kind()) {
+                case NodeKind::block:
+                    for (const auto& inner : static_cast<BlockStmnt*>(node)->get_statements())
+                        statement(inner.get());
+                    return;
+                case NodeKind::for_loop:
+                    loop(static_cast<ForStmnt*>(node));
+                    return;
+                case NodeKind::spawn:
+                    fresh(static_cast<SpawnStmnt*>(node)->get_body());
+                    return;
+                case NodeKind::function: {
+                    // Bodies parsed late go through optimize on their own
+                    BlockStmnt* body = static_cast<FuncStmnt*>(node)->get_definition()->body.get();
+                    if (body)
+                        fresh(body);
+                    return;
+                }
+                default:
+                    return;
+            }
+        }
+    }
+
+    size_t hoist_invariants(const std::vector<std::unique_ptr<StatementNode>>& statements) {
+        hoister walk;
+        for (const auto& statement : statements)
+            walk.statement(statement.get());
+        return walk.wrapped;
+    }
+}
@@ -0,0 +1,229 @@
+#include <inliner.h>
+#include <optimize.h>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace camaroo_core {
+
+    namespace {
+
+        // A skipped body longer than this has more nodes than the budget allows anyway
+        constexpr size_t inline_source_limit = 400;
+
+        // Declarations of values the copier can make, channels can't be
+        bool is_declaration(TokenType type) {
+            return type == TokenType::num_type || type == TokenType::fnum_type || type == TokenType::text_type ||
+                   type == TokenType::letter_type || type == TokenType::toggle_type || type == TokenType::list_type;
+        }
+
+        // Copies expressions, turning names into the slots they were given. Anything that can't be copied sets
+        // failed: calls, channels, names that aren't parameters or locals and the loop nodes of hoist_invariants
+        class copier {
+        public:
+            explicit copier(const std::unordered_map<std::string, uint32_t>& names)
+                :slots(names) {}
+
+            std::unique_ptr<ExpressionNode> copy(ASTNode* node);
+
+            bool failed = false;
+            size_t nodes = 0;
+        private:
+            const std::unordered_map<std::string, uint32_t>& slots;
+        };
+
+        std::unique_ptr<ExpressionNode> copier::copy(ASTNode* node) {
+            if (!node || failed) {
+                failed = true;
+                return nullptr;
+            }
+            ++nodes;
+            switch (node->node_kind()) {
+                case NodeKind::identifier: {
+                    std::string name = std::get<std::string>(node->token_value());
+                    auto found = slots.find(name);
+                    if (found != slots.end())
+                        return std::make_unique<SlotExpr>(Token{TokenType::identifier, name}, found->second);
+                    failed = true;
+                    return nullptr;
+                }
+                case NodeKind::num:
+                    return std::make_unique<NumExpr>(Token{TokenType::num, node->to_string()});
+                case NodeKind::fnum:
+                    return std::make_unique<FNumExpr>(Token{TokenType::fnum, node->to_string()});
+                case NodeKind::text:
+                    return std::make_unique<TextExpr>(Token{TokenType::text, std::get<std::string>(node->token_value())});
+                case NodeKind::letter:
+                    return std::make_unique<LetterExpr>(Token{TokenType::letter, std::get<std::string>(node->token_value())});
+                case NodeKind::toggle:
+                    return std::make_unique<ToggleExpr>(Token{TokenType::toggle, node->to_string()});
+                case NodeKind::prefix: {
+                    Token token{node->token_type(), std::get<std::string>(node->token_value())};
+                    std::unique_ptr<ExpressionNode> right = copy(node->get_right());
+                    return failed ? nullptr : std::make_unique<PrefixExpr>(token, std::move(right));
+                }
+                case NodeKind::infix: {
+                    Token token{node->token_type(), std::get<std::string>(node->token_value())};
+                    std::unique_ptr<ExpressionNode> left = copy(node->get_left());
+                    std::unique_ptr<ExpressionNode> right = copy(node->get_right());
+                    return failed ? nullptr : std::make_unique<InfixExpr>(token, std::move(left), std::move(right));
+                }
+                case NodeKind::list: {
+                    std::vector<std::unique_ptr<ExpressionNode>> elements;
+                    for (const auto& element : static_cast<ListExpr*>(node)->get_elements())
+                        elements.push_back(copy(element.get()));
+                    Token token{node->token_type(), std::get<std::string>(node->token_value())};
+                    return failed ? nullptr : std::make_unique<ListExpr>(token, std::move(elements));
+                }
+                case NodeKind::format: {
+                    auto* format = static_cast<FormatExpr*>(node);
+                    std::vector<std::unique_ptr<ExpressionNode>> slots;
+                    for (const auto& slot : format->get_slots())
+                        slots.push_back(copy(slot.get()));
+                    Token token{node->token_type(), std::get<std::string>(node->token_value())};
+                    return failed ? nullptr : std::make_unique<FormatExpr>(token, format->get_pieces(), std::move(slots));
+                }
+                case NodeKind::arith_chain: {
+                    auto* chain = static_cast<ArithChainExpr*>(node);
+                    std::unique_ptr<ExpressionNode> operand = copy(chain->get_operand());
+                    return failed ? nullptr : std::make_unique<ArithChainExpr>(std::move(operand), chain->get_steps(), chain->get_plan());
+                }
+                case NodeKind::shared:
+                    // Bodies parsed late have been through optimize already
+                    --nodes;
+                    return copy(static_cast<SharedExpr*>(node)->get_target());
+                default:
+                    failed = true;
+                    return nullptr;
+            }
+        }
+
+        // Skipped bodies wait for the first call to be parsed, so a call to one is inlined on the chance it qualifies
+        bool might_inline(FunctionDef& definition) {
+            if (definition.kind.type != TokenType::func_type)
+                return false;
+            if (definition.is_deferred())
+                return definition.body_source().size() <= inline_source_limit;
+            return definition.get_inline_body() != nullptr;
+        }
+    }
+
+    const InlineBody* FunctionDef::get_inline_body() {
+        std::call_once(inline_checked, [this]() {
+            if (kind.type != TokenType::func_type)
+                return;
+            BlockStmnt* parsed = body.get();
+            if (is_deferred()) {
+                if (body_source().size() > inline_source_limit)
+                    return;
+                try {
+                    parsed = get_body();
+                }
+                catch (const std::exception&) {
+                    // Left to the call, which reports it
+                    return;
+                }
+            }
+            if (!parsed)
+                return;
+
+            const auto& statements = parsed->get_statements();
+            if (statements.empty() || statements.back()->node_kind() != NodeKind::return_stmnt || !statements.back()->get_right())
+                return;
+
+            // Later parameters and locals with the same name shadow earlier ones, like declaring them in order does
+            std::unordered_map<std::string, uint32_t> slots;
+            uint32_t next = 0;
+            for (const Parameter& parameter : parameters)
+                slots[parameter.name] = next++;
+
+            copier copy(slots);
+            auto result = std::make_unique<InlineBody>();
+            for (size_t i = 0; i + 1 < statements.size(); ++i) {
+                StatementNode* statement = statements[i].get();
+                if (statement->node_kind() != NodeKind::assign || !is_declaration(statement->token_type()))
+                    return;
+                result->locals.push_back(copy.copy(statement->get_right()));
+                result->local_types.push_back(statement->token_type());
+                slots[std::get<std::string>(statement->get_left()->token_value())] = next++;
+            }
+            result->result = copy.copy(statements.back()->get_right());
+            if (!copy.failed && copy.nodes <= inline_budget)
+                inline_body = std::move(result);
+        });
+        return inline_body.get();
+    }
+
+    namespace {
+
+        class inliner {
+        public:
+            void collect(ASTNode* node);
+            void rewrite(std::unique_ptr<ExpressionNode>& slot);
+            size_t replaced = 0;
+        private:
+            // Null for names declared more than once, which call depends on where it is made from
+            std::unordered_map<std::string, std::shared_ptr<FunctionDef>> functions;
+        };
+
+        void inliner::collect(ASTNode* node) {
+            if (!node)
+                return;
+            switch (node->node_kind()) {
+                case NodeKind::block:
+                    for (const auto& statement : static_cast<BlockStmnt*>(node)->get_statements())
+                        collect(statement.get());
+                    return;
+                case NodeKind::for_loop:
+                    collect(static_cast<ForStmnt*>(node)->get_body());
+                    return;
+                case NodeKind::spawn:
+                    collect(static_cast<SpawnStmnt*>(node)->get_body());
+                    return;
+                case NodeKind::function: {
+                    const std::shared_ptr<FunctionDef>& definition = static_cast<FuncStmnt*>(node)->get_definition();
+                    auto [it, inserted] = functions.try_emplace(definition->name, definition);
+                    if (!inserted)
+                        it->second = nullptr;
+                    collect(definition->body.get());
+                    return;
+                }
+                default:
+                    return;
+            }
+        }
+
+        void inliner::rewrite(std::unique_ptr<ExpressionNode>& slot) {
+            slot->visit_expressions([&](std::unique_ptr<ExpressionNode>& child) {
+                if (child)
+                    rewrite(child);
+            });
+            if (slot->node_kind() != NodeKind::call || slot->get_left()->node_kind() != NodeKind::identifier)
+                return;
+
+            auto function = functions.find(std::get<std::string>(slot->get_left()->token_value()));
+            if (function == functions.end() || !function->second)
+                return;
+            const std::shared_ptr<FunctionDef>& definition = function->second;
+            // A call with the wrong number of arguments stays one, for the error it reports
+            if (static_cast<CallExpr*>(slot.get())->get_arguments().size() != definition->parameters.size())
+                return;
+
+            if (!might_inline(*definition))
+                return;
+
+            std::unique_ptr<CallExpr> call(static_cast<CallExpr*>(slot.release()));
+            slot = std::make_unique<InlinedCallExpr>(std::move(call), definition);
+            ++replaced;
+        }
+    }
+
+    size_t inline_calls(const std::vector<std::unique_ptr<StatementNode>>& statements) {
+        inliner pass;
+        for (const auto& statement : statements)
+            pass.collect(statement.get());
+        for (const auto& statement : statements)
+            visit_expression_roots(statement.get(), [&](std::unique_ptr<ExpressionNode>& slot) { pass.rewrite(slot); });
+        return pass.replaced;
+    }
+}
@@ -0,0 +1,466 @@
+#include <list.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace camaroo_core {
+
+    namespace {
+
+        const camaroo_list& as_list(const camaroo_object& object) {
+            return *std::get<std::shared_ptr<camaroo_list>>(object.variable_value);
+        }
+
+        std::shared_ptr<camaroo_object> wrap_list(TokenType element_type, ListStorage elements) {
+            auto list = std::make_shared<camaroo_list>(camaroo_list{element_type, std::move(elements)});
+            return make_object(TokenType::list, std::move(list));
+        }
+
+        std::vector<double> to_fnums(const camaroo_list& list) {
+            if (list.element_type == TokenType::fnum)
+                return std::get<std::vector<double>>(list.elements);
+            const auto& nums = std::get<std::vector<int64_t>>(list.elements);
+            return std::vector<double>(nums.begin(), nums.end());
+        }
+
+        void require_numeric(const camaroo_list& list) {
+            if (list.element_type == TokenType::toggle || list.element_type == TokenType::letter)
+                throw std::runtime_error(std::string("Error: expected a list of num or fnum but found a list of ") +
+                                         type_name(list.element_type));
+        }
+
+        void require_same_size(const camaroo_list& left, const camaroo_list& right) {
+            if (left.size() != right.size())
+                throw std::runtime_error("Error: list sizes don't match, " + std::to_string(left.size()) +
+                                         " and " + std::to_string(right.size()));
+        }
+
+        void reject_zero_divisor(const std::vector<int64_t>& divisors) {
+            if (std::find(divisors.begin(), divisors.end(), 0) != divisors.end())
+                throw std::runtime_error("Error: division by zero");
+        }
+
+        size_t chunk_count(size_t n) {
+            return (n + list_parallel_grain - 1) / list_parallel_grain;
+        }
+
+        // Flips a comparison so that "scalar op list" can run as "list op' scalar"
+        simd::compare_op mirrored(simd::compare_op op) {
+            switch (op) {
+                case simd::compare_op::less: return simd::compare_op::greater;
+                case simd::compare_op::less_equal: return simd::compare_op::greater_equal;
+                case simd::compare_op::greater: return simd::compare_op::less;
+                case simd::compare_op::greater_equal: return simd::compare_op::less_equal;
+                default: return op;
+            }
+        }
+
+        template <typename T>
+        std::vector<T> parallel_arith(thread_pool& pool, simd::arith_op op, const std::vector<T>& a, const std::vector<T>& b) {
+            std::vector<T> out(a.size());
+            pool.parallel_for(a.size(), list_parallel_grain, [&](size_t begin, size_t end) {
+                simd::arith(op, a.data() + begin, b.data() + begin, out.data() + begin, end - begin);
+            });
+            return out;
+        }
+
+        template <typename T>
+        std::vector<T> parallel_arith_scalar(thread_pool& pool, simd::arith_op op, const std::vector<T>& a, T b, bool scalar_left) {
+            std::vector<T> out(a.size());
+            pool.parallel_for(a.size(), list_parallel_grain, [&](size_t begin, size_t end) {
+                simd::arith_scalar(op, a.data() + begin, b, out.data() + begin, end - begin, scalar_left);
+            });
+            return out;
+        }
+
+        template <typename T>
+        std::vector<uint8_t> parallel_compare(thread_pool& pool, simd::compare_op op, const std::vector<T>& a, const std::vector<T>& b) {
+            std::vector<uint8_t> mask(a.size());
+            pool.parallel_for(a.size(), list_parallel_grain, [&](size_t begin, size_t end) {
+                simd::compare(op, a.data() + begin, b.data() + begin, mask.data() + begin, end - begin);
+            });
+            return mask;
+        }
+
+        template <typename T>
+        std::vector<uint8_t> parallel_compare_scalar(thread_pool& pool, simd::compare_op op, const std::vector<T>& a, T b) {
+            std::vector<uint8_t> mask(a.size());
+            pool.parallel_for(a.size(), list_parallel_grain, [&](size_t begin, size_t end) {
+                simd::compare_scalar(op, a.data() + begin, b, mask.data() + begin, end - begin);
+            });
+            return mask;
+        }
+
+        // Runs reduce on every chunk and folds the partial results in chunk order
+        template <typename T, typename Reduce, typename Combine>
+        T parallel_reduce(thread_pool& pool, size_t n, Reduce reduce, Combine combine) {
+            std::vector<T> partials(chunk_count(n));
+            pool.parallel_for(n, list_parallel_grain, [&](size_t begin, size_t end) {
+                partials[begin / list_parallel_grain] = reduce(begin, end);
+            });
+            T result = partials[0];
+            for (size_t i = 1; i < partials.size(); ++i)
+                result = combine(result, partials[i]);
+            return result;
+        }
+
+        template <typename T>
+        std::vector<T> parallel_compress(thread_pool& pool, const std::vector<T>& values, const std::vector<uint8_t>& keep) {
+            // Chunks compress in place into a scratch copy first: the vector kernels store whole
+            // registers past the last kept element, which would race with the neighbouring chunk
+            size_t n = values.size();
+            std::vector<T> scratch(n);
+            std::vector<size_t> kept(chunk_count(n));
+            pool.parallel_for(n, list_parallel_grain, [&](size_t begin, size_t end) {
+                kept[begin / list_parallel_grain] = simd::compress(values.data() + begin, keep.data() + begin, scratch.data() + begin, end - begin);
+            });
+
+            std::vector<size_t> offsets(kept.size() + 1, 0);
+            for (size_t i = 0; i < kept.size(); ++i)
+                offsets[i + 1] = offsets[i] + kept[i];
+
+            std::vector<T> out(offsets.back());
+            pool.parallel_for(n, list_parallel_grain, [&](size_t begin, size_t) {
+                size_t chunk = begin / list_parallel_grain;
+                std::copy_n(scratch.begin() + begin, kept[chunk], out.begin() + offsets[chunk]);
+            });
+            return out;
+        }
+
+        template <typename T, typename Less>
+        void parallel_sort(thread_pool& pool, std::vector<T>& values, Less less) {
+            size_t n = values.size();
+            if (chunk_count(n) <= 1 || pool.size() == 1) {
+                std::sort(values.begin(), values.end(), less);
+                return;
+            }
+
+            pool.parallel_for(n, list_parallel_grain, [&](size_t begin, size_t end) {
+                std::sort(values.begin() + begin, values.begin() + end, less);
+            });
+
+            std::vector<T> buffer(n);
+            for (size_t run = list_parallel_grain; run < n; run *= 2) {
+                size_t pairs = (n + 2 * run - 1) / (2 * run);
+                pool.parallel_for(pairs, 1, [&](size_t first, size_t last) {
+                    for (size_t pair = first; pair < last; ++pair) {
+                        size_t low = pair * 2 * run;
+                        size_t middle = std::min(low + run, n);
+                        size_t high = std::min(low + 2 * run, n);
+                        std::merge(values.begin() + low, values.begin() + middle, values.begin() + middle,
+                                   values.begin() + high, buffer.begin() + low, less);
+                    }
+                });
+                values.swap(buffer);
+            }
+        }
+
+        std::shared_ptr<camaroo_object> arith_lists(thread_pool& pool, simd::arith_op op, const camaroo_list& left, const camaroo_list& right) {
+            require_numeric(left);
+            require_numeric(right);
+            require_same_size(left, right);
+
+            if (left.element_type == TokenType::num && right.element_type == TokenType::num) {
+                const auto& a = std::get<std::vector<int64_t>>(left.elements);
+                const auto& b = std::get<std::vector<int64_t>>(right.elements);
+                if (op == simd::arith_op::divide || op == simd::arith_op::modulo)
+                    reject_zero_divisor(b);
+                return wrap_list(TokenType::num, parallel_arith(pool, op, a, b));
+            }
+
+            return wrap_list(TokenType::fnum, parallel_arith(pool, op, to_fnums(left), to_fnums(right)));
+        }
+
+        std::shared_ptr<camaroo_object> arith_scalar(thread_pool& pool, simd::arith_op op, const camaroo_list& list,
+                                                     const camaroo_object& scalar, bool scalar_left) {
+            require_numeric(list);
+            if (list.element_type == TokenType::num && scalar.variable_type == TokenType::num) {
+                const auto& a = std::get<std::vector<int64_t>>(list.elements);
+                int64_t b = std::get<int64_t>(scalar.variable_value);
+                if (op == simd::arith_op::divide || op == simd::arith_op::modulo) {
+                    if (scalar_left)
+                        reject_zero_divisor(a);
+                    else if (b == 0)
+                        throw std::runtime_error("Error: division by zero");
+                }
+                return wrap_list(TokenType::num, parallel_arith_scalar(pool, op, a, b, scalar_left));
+            }
+
+            if (scalar.variable_type != TokenType::num && scalar.variable_type != TokenType::fnum)
+                throw std::runtime_error("Error: lists can only be combined with num or fnum values");
+
+            double b = (scalar.variable_type == TokenType::num) ? static_cast<double>(std::get<int64_t>(scalar.variable_value))
+                                                                : std::get<double>(scalar.variable_value);
+            return wrap_list(TokenType::fnum, parallel_arith_scalar(pool, op, to_fnums(list), b, scalar_left));
+        }
+
+        std::shared_ptr<camaroo_object> compare_lists(thread_pool& pool, simd::compare_op op, const camaroo_list& left, const camaroo_list& right) {
+            if (left.element_type == TokenType::letter && right.element_type == TokenType::letter) {
+                require_same_size(left, right);
+                const auto& a = std::get<std::vector<uint8_t>>(left.elements);
+                const auto& b = std::get<std::vector<uint8_t>>(right.elements);
+                return wrap_list(TokenType::toggle, parallel_compare(pool, op, a, b));
+            }
+            require_numeric(left);
+            require_numeric(right);
+            require_same_size(left, right);
+
+            if (left.element_type == TokenType::num && right.element_type == TokenType::num) {
+                const auto& a = std::get<std::vector<int64_t>>(left.elements);
+                const auto& b = std::get<std::vector<int64_t>>(right.elements);
+                return wrap_list(TokenType::toggle, parallel_compare(pool, op, a, b));
+            }
+            return wrap_list(TokenType::toggle, parallel_compare(pool, op, to_fnums(left), to_fnums(right)));
+        }
+
+        std::shared_ptr<camaroo_object> compare_scalar(thread_pool& pool, simd::compare_op op, const camaroo_list& list, const camaroo_object& scalar) {
+            if (list.element_type == TokenType::letter && scalar.variable_type == TokenType::letter) {
+                // A letter past the ones a list can hold is past every letter in it
+                char32_t letter = std::get<char32_t>(scalar.variable_value);
+                const auto& a = std::get<std::vector<uint8_t>>(list.elements);
+                if (letter > max_list_letter) {
+                    bool below = op == simd::compare_op::less || op == simd::compare_op::less_equal || op == simd::compare_op::not_equal;
+                    return wrap_list(TokenType::toggle, std::vector<uint8_t>(a.size(), below ? 1 : 0));
+                }
+                return wrap_list(TokenType::toggle, parallel_compare_scalar(pool, op, a, static_cast<uint8_t>(letter)));
+            }
+            require_numeric(list);
+            if (list.element_type == TokenType::num && scalar.variable_type == TokenType::num) {
+                const auto& a = std::get<std::vector<int64_t>>(list.elements);
+                return wrap_list(TokenType::toggle, parallel_compare_scalar(pool, op, a, std::get<int64_t>(scalar.variable_value)));
+            }
+
+            if (scalar.variable_type != TokenType::num && scalar.variable_type != TokenType::fnum)
+                throw std::runtime_error("Error: lists can only be compared with num or fnum values");
+
+            double b = (scalar.variable_type == TokenType::num) ? static_cast<double>(std::get<int64_t>(scalar.variable_value))
+                                                                : std::get<double>(scalar.variable_value);
+            return wrap_list(TokenType::toggle, parallel_compare_scalar(pool, op, to_fnums(list), b));
+        }
+    }
+
+    uint8_t list_letter(char32_t letter) {
+        if (letter > max_list_letter)
+            throw std::runtime_error("Error: lists only hold letters up to U+00FF");
+        return static_cast<uint8_t>(letter);
+    }
+
+    std::shared_ptr<camaroo_object> make_list(const std::vector<std::shared_ptr<camaroo_object>>& elements) {
+        TokenType element_type = elements.empty() ? TokenType::num : elements.front()->variable_type;
+        for (const auto& element : elements) {
+            TokenType type = element->variable_type;
+            if (type == TokenType::fnum && element_type == TokenType::num) {
+                element_type = TokenType::fnum;
+                continue;
+            }
+            if (type == TokenType::num && element_type == TokenType::fnum)
+                continue;
+            if (type != element_type || (type != TokenType::num && type != TokenType::fnum && type != TokenType::toggle &&
+                                         type != TokenType::letter))
+                throw std::runtime_error("Error: list elements must all be num, fnum, toggle or letter");
+        }
+
+        if (element_type == TokenType::num) {
+            std::vector<int64_t> values;
+            values.reserve(elements.size());
+            for (const auto& element : elements)
+                values.push_back(std::get<int64_t>(element->variable_value));
+            return wrap_list(TokenType::num, std::move(values));
+        }
+
+        if (element_type == TokenType::fnum) {
+            std::vector<double> values;
+            values.reserve(elements.size());
+            for (const auto& element : elements) {
+                if (element->variable_type == TokenType::num)
+                    values.push_back(static_cast<double>(std::get<int64_t>(element->variable_value)));
+                else
+                    values.push_back(std::get<double>(element->variable_value));
+            }
+            return wrap_list(TokenType::fnum, std::move(values));
+        }
+
+        std::vector<uint8_t> values;
+        values.reserve(elements.size());
+        if (element_type == TokenType::letter) {
+            for (const auto& element : elements)
+                values.push_back(list_letter(std::get<char32_t>(element->variable_value)));
+            return wrap_list(TokenType::letter, std::move(values));
+        }
+        for (const auto& element : elements)
+            values.push_back(std::get<bool>(element->variable_value) ? 1 : 0);
+        return wrap_list(TokenType::toggle, std::move(values));
+    }
+
+    std::shared_ptr<camaroo_object> list_arith(thread_pool& pool, simd::arith_op op, const camaroo_object& left, const camaroo_object& right) {
+        bool left_is_list = left.variable_type == TokenType::list;
+        bool right_is_list = right.variable_type == TokenType::list;
+        if (left_is_list && right_is_list)
+            return arith_lists(pool, op, as_list(left), as_list(right));
+        if (left_is_list)
+            return arith_scalar(pool, op, as_list(left), right, false);
+        return arith_scalar(pool, op, as_list(right), left, true);
+    }
+
+    std::shared_ptr<camaroo_object> list_compare(thread_pool& pool, simd::compare_op op, const camaroo_object& left, const camaroo_object& right) {
+        bool left_is_list = left.variable_type == TokenType::list;
+        bool right_is_list = right.variable_type == TokenType::list;
+        if (left_is_list && right_is_list)
+            return compare_lists(pool, op, as_list(left), as_list(right));
+        if (left_is_list)
+            return compare_scalar(pool, op, as_list(left), right);
+        return compare_scalar(pool, mirrored(op), as_list(right), left);
+    }
+
+    std::shared_ptr<camaroo_object> list_filter(thread_pool& pool, const camaroo_list& values, const camaroo_list& mask) {
+        if (mask.element_type != TokenType::toggle)
+            throw std::runtime_error("Error: filter expects a list of toggle as its mask");
+        require_same_size(values, mask);
+
+        const auto& keep = std::get<std::vector<uint8_t>>(mask.elements);
+        if (values.element_type == TokenType::num)
+            return wrap_list(TokenType::num, parallel_compress(pool, std::get<std::vector<int64_t>>(values.elements), keep));
+        if (values.element_type == TokenType::fnum)
+            return wrap_list(TokenType::fnum, parallel_compress(pool, std::get<std::vector<double>>(values.elements), keep));
+
+        const auto& source = std::get<std::vector<uint8_t>>(values.elements);
+        std::vector<uint8_t> out;
+        out.reserve(simd::count(keep.data(), keep.size()));
+        for (size_t i = 0; i < source.size(); ++i) {
+            if (keep[i])
+                out.push_back(source[i]);
+        }
+        return wrap_list(values.element_type, std::move(out));
+    }
+
+    std::shared_ptr<camaroo_object> list_sum(thread_pool& pool, const camaroo_list& values) {
+        if (values.element_type == TokenType::letter)
+            require_numeric(values);
+        if (values.size() == 0)
+            return (values.element_type == TokenType::fnum) ? make_object(TokenType::fnum, 0.0) : make_object(TokenType::num, int64_t(0));
+
+        if (values.element_type == TokenType::toggle) {
+            const auto& toggles = std::get<std::vector<uint8_t>>(values.elements);
+            size_t count = parallel_reduce<size_t>(pool, toggles.size(),
+                [&](size_t begin, size_t end) { return simd::count(toggles.data() + begin, end - begin); },
+                [](size_t a, size_t b) { return a + b; });
+            return make_object(TokenType::num, static_cast<int64_t>(count));
+        }
+        if (values.element_type == TokenType::num) {
+            const auto& nums = std::get<std::vector<int64_t>>(values.elements);
+            int64_t total = parallel_reduce<int64_t>(pool, nums.size(),
+                [&](size_t begin, size_t end) { return simd::sum(nums.data() + begin, end - begin); },
+                [](int64_t a, int64_t b) { return static_cast<int64_t>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b)); });
+            return make_object(TokenType::num, total);
+        }
+        const auto& fnums = std::get<std::vector<double>>(values.elements);
+        double total = parallel_reduce<double>(pool, fnums.size(),
+            [&](size_t begin, size_t end) { return simd::sum(fnums.data() + begin, end - begin); },
+            [](double a, double b) { return a + b; });
+        return make_object(TokenType::fnum, total);
+    }
+
+    std::shared_ptr<camaroo_object> list_min(thread_pool& pool, const camaroo_list& values) {
+        require_numeric(values);
+        if (values.size() == 0)
+            throw std::runtime_error("Error: min of an empty list");
+        if (values.element_type == TokenType::num) {
+            const auto& nums = std::get<std::vector<int64_t>>(values.elements);
+            return make_object(TokenType::num, parallel_reduce<int64_t>(pool, nums.size(),
+                [&](size_t begin, size_t end) { return simd::min(nums.data() + begin, end - begin); },
+                [](int64_t a, int64_t b) { return std::min(a, b); }));
+        }
+        const auto& fnums = std::get<std::vector<double>>(values.elements);
+        return make_object(TokenType::fnum, parallel_reduce<double>(pool, fnums.size(),
+            [&](size_t begin, size_t end) { return simd::min(fnums.data() + begin, end - begin); },
+            [](double a, double b) { return std::min(a, b); }));
+    }
+
+    std::shared_ptr<camaroo_object> list_max(thread_pool& pool, const camaroo_list& values) {
+        require_numeric(values);
+        if (values.size() == 0)
+            throw std::runtime_error("Error: max of an empty list");
+        if (values.element_type == TokenType::num) {
+            const auto& nums = std::get<std::vector<int64_t>>(values.elements);
+            return make_object(TokenType::num, parallel_reduce<int64_t>(pool, nums.size(),
+                [&](size_t begin, size_t end) { return simd::max(nums.data() + begin, end - begin); },
+                [](int64_t a, int64_t b) { return std::max(a, b); }));
+        }
+        const auto& fnums = std::get<std::vector<double>>(values.elements);
+        return make_object(TokenType::fnum, parallel_reduce<double>(pool, fnums.size(),
+            [&](size_t begin, size_t end) { return simd::max(fnums.data() + begin, end - begin); },
+            [](double a, double b) { return std::max(a, b); }));
+    }
+
+    std::shared_ptr<camaroo_object> list_dot(thread_pool& pool, const camaroo_list& left, const camaroo_list& right) {
+        require_numeric(left);
+        require_numeric(right);
+        require_same_size(left, right);
+        bool nums_only = left.element_type == TokenType::num && right.element_type == TokenType::num;
+        if (left.size() == 0)
+            return nums_only ? make_object(TokenType::num, int64_t(0)) : make_object(TokenType::fnum, 0.0);
+
+        if (left.element_type == TokenType::num && right.element_type == TokenType::num) {
+            const auto& a = std::get<std::vector<int64_t>>(left.elements);
+            const auto& b = std::get<std::vector<int64_t>>(right.elements);
+            return make_object(TokenType::num, parallel_reduce<int64_t>(pool, a.size(),
+                [&](size_t begin, size_t end) { return simd::dot(a.data() + begin, b.data() + begin, end - begin); },
+                [](int64_t x, int64_t y) { return static_cast<int64_t>(static_cast<uint64_t>(x) + static_cast<uint64_t>(y)); }));
+        }
+        std::vector<double> a = to_fnums(left);
+        std::vector<double> b = to_fnums(right);
+        return make_object(TokenType::fnum, parallel_reduce<double>(pool, a.size(),
+            [&](size_t begin, size_t end) { return simd::dot(a.data() + begin, b.data() + begin, end - begin); },
+            [](double x, double y) { return x + y; }));
+    }
+
+    std::shared_ptr<camaroo_object> list_sort(thread_pool& pool, const camaroo_list& values) {
+        if (values.element_type == TokenType::num) {
+            std::vector<int64_t> sorted = std::get<std::vector<int64_t>>(values.elements);
+            parallel_sort(pool, sorted, std::less<int64_t>());
+            return wrap_list(TokenType::num, std::move(sorted));
+        }
+        if (values.element_type == TokenType::fnum) {
+            std::vector<double> sorted = std::get<std::vector<double>>(values.elements);
+            // NaNs go last, a plain < isn't a strict weak order once they show up
+            parallel_sort(pool, sorted, [](double a, double b) { return a < b || (!std::isnan(a) && std::isnan(b)); });
+            return wrap_list(TokenType::fnum, std::move(sorted));
+        }
+
+        if (values.element_type == TokenType::letter) {
+            // Only 256 letters fit in a list, counting them is cheaper than sorting
+            const auto& letters = std::get<std::vector<uint8_t>>(values.elements);
+            size_t counts[256] = {};
+            for (uint8_t letter : letters)
+                ++counts[letter];
+            std::vector<uint8_t> sorted;
+            sorted.reserve(letters.size());
+            for (size_t letter = 0; letter < 256; ++letter)
+                sorted.insert(sorted.end(), counts[letter], static_cast<uint8_t>(letter));
+            return wrap_list(TokenType::letter, std::move(sorted));
+        }
+
+        const auto& toggles = std::get<std::vector<uint8_t>>(values.elements);
+        size_t set = simd::count(toggles.data(), toggles.size());
+        std::vector<uint8_t> sorted(toggles.size(), 0);
+        std::fill(sorted.end() - static_cast<std::ptrdiff_t>(set), sorted.end(), 1);
+        return wrap_list(TokenType::toggle, std::move(sorted));
+    }
+
+    void write_list(std::ostream& out, const camaroo_list& list) {
+        out << '[';
+        std::visit([&](const auto& values) {
+            for (size_t i = 0; i < values.size(); ++i) {
+                if (i != 0)
+                    out << ", ";
+                if (list.element_type == TokenType::toggle)
+                    out << (values[i] ? "true" : "false");
+                else if (list.element_type == TokenType::letter)
+                    write_object(out, camaroo_object{TokenType::letter, static_cast<char32_t>(values[i])});
+                else
+                    out << values[i];
+            }
+        }, list.elements);
+        out << ']';
+    }
+}
@@ -1,14 +1,16 @@
 #include <iostream>
-#include <fstream>
-#include <iterator>
 #include <string>
+#include <thread>
+#include <algorithm>
 #include <tokenizer.h>
-#include <parser.h>
-#include <evaluator.h>
+#include <engine.h>
+#include <ast_cache.h>
+#include <version.h>
+#include <server.h>
+#include <watch.h>
+#include <thread_pool.h>
 
-const std::string version = "0.0.1";
-
-camaroo_core::Program program;
+const std::string version = camaroo_core::camaroo_version;
 
 void CLI_interface()
 {
@@ -16,12 +18,6 @@ void CLI_interface()
               << ">>> ";
 }
 
-void parse_line(const std::string &text)
-{
-    camaroo_core::Parser parser(text);
-    program = parser.parse_program();
-}
-
 void tokenize_line(const std::string &text)
 {
     camaroo_core::Tokenizer temp_tokenizer(text);
@@ -33,45 +29,156 @@ void tokenize_line(const std::string &text)
     }
 }
 
+void print_usage()
+{
+    std::cerr << "Usage: camaroo [--threads N] [--cache-dir DIR | --no-cache] [--watch] [file.cmr]" << std::endl
+              << "       camaroo [--threads N] [--cache-dir DIR | --no-cache] --specialize name=value,... file.cmr" << std::endl
+              << "       camaroo [--threads N] --serve socket" << std::endl
+              << "       camaroo --connect socket (file.cmr | -)" << std::endl;
+}
+
 int main(int argc, char **argv)
 {
-    if (argc == 2)
+    std::string source_path;
+    std::string serve_path;
+    std::string connect_path;
+    camaroo_core::ast_cache::settings cache{true, ""};
+    bool watch = false;
+    camaroo_core::specializations fixed;
+    for (int i = 1; i < argc; ++i)
     {
-        std::ifstream source_file(argv[1]);
-        std::string source_code;
+        std::string arg = argv[i];
+        if (arg == "--no-cache")
+        {
+            cache.enabled = false;
+            continue;
+        }
+        if (arg == "--watch")
+        {
+            watch = true;
+            continue;
+        }
+        if (arg == "--serve" || arg == "--connect" || arg == "--cache-dir")
+        {
+            if (i + 1 >= argc)
+            {
+                print_usage();
+                return -1;
+            }
+            (arg == "--serve" ? serve_path : arg == "--connect" ? connect_path : cache.directory) = argv[++i];
+            continue;
+        }
+        if (arg == "--specialize")
+        {
+            if (i + 1 >= argc)
+            {
+                print_usage();
+                return -1;
+            }
+            try
+            {
+                for (auto &pair : camaroo_core::parse_specializations(argv[++i]))
+                    fixed.push_back(std::move(pair));
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << e.what() << '\n';
+                return -1;
+            }
+            continue;
+        }
+        if (arg == "--threads")
+        {
+            if (i + 1 >= argc)
+            {
+                print_usage();
+                return -1;
+            }
+            try
+            {
+                std::string count = argv[++i];
+                unsigned long threads = std::stoul(count);
+                if (count[0] == '-' || threads == 0 || threads > 1024)
+                    throw std::out_of_range(count);
+                camaroo_core::thread_pool::set_shared_threads(threads);
+            }
+            catch (const std::exception &)
+            {
+                print_usage();
+                return -1;
+            }
+            continue;
+        }
+        source_path = arg;
+    }
 
-        source_file.seekg(0, std::ios::end);
-        source_code.reserve(source_file.tellg());
-        source_file.seekg(0, std::ios::beg);
+    // --specialize only applies to running a file directly
+    if (!fixed.empty() && (watch || source_path.empty() || !serve_path.empty() || !connect_path.empty()))
+    {
+        print_usage();
+        return -1;
+    }
 
-        source_code.assign(std::istreambuf_iterator<char>(source_file),
-                           std::istreambuf_iterator<char>());
+    try
+    {
+        if (!serve_path.empty())
+        {
+            camaroo_core::Engine engine;
+            return camaroo_core::serve(serve_path, engine, std::max(2u, std::thread::hardware_concurrency()));
+        }
+        if (!connect_path.empty())
+        {
+            if (source_path.empty())
+            {
+                print_usage();
+                return -1;
+            }
+            return camaroo_core::connect_and_run(connect_path, source_path);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << '\n';
+        return -1;
+    }
+
+    if (watch)
+    {
+        if (source_path.empty())
+        {
+            print_usage();
+            return -1;
+        }
+        camaroo_core::Engine engine;
+        return camaroo_core::watch(source_path, engine, cache);
+    }
 
-        camaroo_core::Parser parser(source_code);
-        program = parser.parse_program();
-        if (!program.has_compiled) {
-            return -1; // should be replaced by error
+    if (!source_path.empty())
+    {
+        camaroo_core::Engine engine;
+        std::shared_ptr<const camaroo_core::Script> script;
+        try
+        {
+            script = engine.compile_file(source_path, cache, fixed);
         }
-        camaroo_core::evaluator evalute;
-        evalute.evaluate_program(program);
-        return 0;
+        catch (const std::exception &e)
+        {
+            std::cerr << e.what() << '\n';
+            return -1;
+        }
+        camaroo_core::Context context(engine);
+        return engine.run(*script, context) ? 0 : -1;
     }
 
     CLI_interface();
-    camaroo_core::evaluator evalute;
-    while (true)
+    camaroo_core::Engine engine;
+    camaroo_core::Repl repl(engine);
+    std::string line;
+    while (getline(std::cin, line))
     {
-        std::string line;
-        getline(std::cin, line);
-
-        if (line == "exit")
+        if (line == "exit" && !repl.is_pending())
             break;
         // tokenize_line(line);
-        parse_line(line);
-        if (!program.has_compiled) {
-            return -1; // should be replaced by error
-        }
-        evalute.evaluate_program(program);
-        std::cout << ">>> ";
+        std::cout << (repl.feed(line) ? ">>> " : "... ");
     }
 }
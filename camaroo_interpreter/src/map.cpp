@@ -0,0 +1,299 @@
+#include <map.h>
+#include <bit>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+namespace camaroo_core {
+
+    namespace {
+        constexpr size_t npos = SIZE_MAX;
+        constexpr uint8_t empty_slot = 0x80;
+        constexpr uint8_t deleted_slot = 0xFE;
+
+        uint64_t mix(uint64_t x) {
+            x ^= x >> 33;
+            x *= 0xFF51AFD7ED558CCDull;
+            x ^= x >> 33;
+            x *= 0xC4CEB9FE1A85EC53ull;
+            x ^= x >> 33;
+            return x;
+        }
+
+        uint64_t hash_num(int64_t key) {
+            return mix(static_cast<uint64_t>(key));
+        }
+
+        // Eight bytes at a time, the length goes in first so texts that differ only in trailing zero bytes don't meet
+        uint64_t hash_text(std::string_view key) {
+            uint64_t hash = mix(key.size() ^ 0x9E3779B97F4A7C15ull);
+            size_t at = 0;
+            for (; at + 8 <= key.size(); at += 8) {
+                uint64_t word;
+                std::memcpy(&word, key.data() + at, 8);
+                hash = mix(hash ^ word);
+            }
+            uint64_t tail = 0;
+            std::memcpy(&tail, key.data() + at, key.size() - at);
+            return mix(hash ^ tail);
+        }
+
+        // The low 7 bits go in the control byte, the rest pick where probing starts
+        uint8_t tag_of(uint64_t hash) { return static_cast<uint8_t>(hash & 0x7F); }
+        size_t start_of(uint64_t hash) { return static_cast<size_t>(hash >> 7); }
+
+        // Tables are kept at most 7/8 full, deleted slots count as full
+        size_t max_load(size_t capacity) { return capacity - capacity / 8; }
+
+        size_t capacity_for(size_t count) {
+            size_t capacity = simd::group_width;
+            while (max_load(capacity) < count)
+                capacity *= 2;
+            return capacity;
+        }
+    }
+
+    camaroo_map::camaroo_map(TokenType key_type, TokenType value_type)
+        :keys(key_type), kind(value_type) {}
+
+    template <typename Match>
+    size_t camaroo_map::probe(uint64_t hash, Match match) const {
+        if (control.empty())
+            return npos;
+        // Groups are visited at triangular steps, which reaches every group of a power of two table
+        size_t mask = capacity() - 1;
+        uint8_t tag = tag_of(hash);
+        size_t group = start_of(hash) & mask;
+        for (size_t step = simd::group_width;; step += simd::group_width) {
+            const uint8_t* bytes = control.data() + group;
+            for (uint32_t hits = simd::match_group(bytes, tag); hits != 0; hits &= hits - 1) {
+                size_t slot = (group + static_cast<size_t>(std::countr_zero(hits))) & mask;
+                if (match(slot))
+                    return slot;
+            }
+            if (simd::match_group(bytes, empty_slot) != 0)
+                return npos;
+            group = (group + step) & mask;
+        }
+    }
+
+    template <typename Match>
+    size_t camaroo_map::probe_or_claim(uint64_t hash, Match match, bool& found) {
+        // Grown before probing so the slot it hands back is still the right one afterwards, with room for twice the
+        // keys there are so a map that keeps erasing and putting back doesn't rehash every time
+        if (used + 1 > max_load(capacity()))
+            rehash(2 * live + 1);
+        // One pass finds the key or, at the first empty slot, settles on the first open slot seen for it
+        size_t mask = capacity() - 1;
+        uint8_t tag = tag_of(hash);
+        size_t group = start_of(hash) & mask;
+        size_t open = npos;
+        for (size_t step = simd::group_width;; step += simd::group_width) {
+            const uint8_t* bytes = control.data() + group;
+            for (uint32_t hits = simd::match_group(bytes, tag); hits != 0; hits &= hits - 1) {
+                size_t slot = (group + static_cast<size_t>(std::countr_zero(hits))) & mask;
+                if (match(slot)) {
+                    found = true;
+                    return slot;
+                }
+            }
+            uint32_t empty = simd::match_group(bytes, empty_slot);
+            if (open == npos) {
+                uint32_t reusable = empty | simd::match_group(bytes, deleted_slot);
+                if (reusable != 0)
+                    open = (group + static_cast<size_t>(std::countr_zero(reusable))) & mask;
+            }
+            if (empty != 0)
+                break;
+            group = (group + step) & mask;
+        }
+        found = false;
+        if (control[open] == empty_slot)
+            ++used;
+        set_control(open, tag);
+        return open;
+    }
+
+    size_t camaroo_map::free_slot(uint64_t hash) const {
+        size_t mask = capacity() - 1;
+        size_t group = start_of(hash) & mask;
+        for (size_t step = simd::group_width;; step += simd::group_width) {
+            const uint8_t* bytes = control.data() + group;
+            uint32_t open = simd::match_group(bytes, empty_slot) | simd::match_group(bytes, deleted_slot);
+            if (open != 0)
+                return (group + static_cast<size_t>(std::countr_zero(open))) & mask;
+            group = (group + step) & mask;
+        }
+    }
+
+    void camaroo_map::set_control(size_t slot, uint8_t byte) {
+        control[slot] = byte;
+        if (slot < simd::group_width)
+            control[capacity() + slot] = byte;
+    }
+
+    size_t camaroo_map::add_entry(const Value& fill) {
+        if (values.size() == max_keys)
+            throw std::runtime_error("Error: a map holds at most " + std::to_string(max_keys) + " keys");
+        values.push_back(fill);
+        erased.push_back(0);
+        ++live;
+        return values.size() - 1;
+    }
+
+    std::string_view camaroo_map::text_key(size_t entry) const {
+        return std::string_view(key_pool).substr(text_offsets[entry], text_offsets[entry + 1] - text_offsets[entry]);
+    }
+
+    Value* camaroo_map::find(int64_t key) {
+        size_t slot = probe(hash_num(key), [&](size_t at) { return num_slots[at].key == key; });
+        return (slot == npos) ? nullptr : &values[num_slots[slot].entry];
+    }
+
+    Value* camaroo_map::find(std::string_view key) {
+        uint64_t hash = hash_text(key);
+        size_t slot = probe(hash, [&](size_t at) {
+            uint32_t entry = text_slots[at];
+            return text_hashes[entry] == hash && text_key(entry) == key;
+        });
+        return (slot == npos) ? nullptr : &values[text_slots[slot]];
+    }
+
+    Value& camaroo_map::insert(int64_t key, const Value& fill) {
+        bool found = false;
+        size_t slot = probe_or_claim(hash_num(key), [&](size_t at) { return num_slots[at].key == key; }, found);
+        if (found)
+            return values[num_slots[slot].entry];
+
+        size_t entry = add_entry(fill);
+        num_keys.push_back(key);
+        num_slots[slot] = num_slot{key, static_cast<uint32_t>(entry)};
+        return values[entry];
+    }
+
+    Value& camaroo_map::insert(std::string_view key, const Value& fill) {
+        uint64_t hash = hash_text(key);
+        bool found = false;
+        size_t slot = probe_or_claim(hash, [&](size_t at) {
+            uint32_t entry = text_slots[at];
+            return text_hashes[entry] == hash && text_key(entry) == key;
+        }, found);
+        if (found)
+            return values[text_slots[slot]];
+
+        size_t entry = add_entry(fill);
+        text_hashes.push_back(hash);
+        key_pool.append(key);
+        text_offsets.push_back(static_cast<uint32_t>(key_pool.size()));
+        text_slots[slot] = static_cast<uint32_t>(entry);
+        return values[entry];
+    }
+
+    void camaroo_map::mark_erased(size_t slot, size_t entry) {
+        // The slot may be in the middle of another key's probe sequence, so it can't go back to empty
+        set_control(slot, deleted_slot);
+        erased[entry] = 1;
+        values[entry] = Value{};
+        --live;
+    }
+
+    bool camaroo_map::erase(int64_t key) {
+        size_t slot = probe(hash_num(key), [&](size_t at) { return num_slots[at].key == key; });
+        if (slot == npos)
+            return false;
+        mark_erased(slot, num_slots[slot].entry);
+        return true;
+    }
+
+    bool camaroo_map::erase(std::string_view key) {
+        uint64_t hash = hash_text(key);
+        size_t slot = probe(hash, [&](size_t at) {
+            uint32_t entry = text_slots[at];
+            return text_hashes[entry] == hash && text_key(entry) == key;
+        });
+        if (slot == npos)
+            return false;
+        mark_erased(slot, text_slots[slot]);
+        return true;
+    }
+
+    void camaroo_map::reserve(size_t count) {
+        if (count > max_keys)
+            throw std::runtime_error("Error: reserve asks for " + std::to_string(count) + " keys, a map holds at most " +
+                                     std::to_string(max_keys));
+        if (count <= live || max_load(capacity()) >= count)
+            return;
+        try {
+            rehash(count);
+        }
+        catch (const std::bad_alloc&) {
+            throw std::runtime_error("Error: reserve couldn't make room for " + std::to_string(count) + " keys");
+        }
+    }
+
+    std::shared_ptr<camaroo_object> camaroo_map::key_at(size_t entry) const {
+        if (keys == TokenType::num)
+            return make_object(TokenType::num, num_keys[entry]);
+        return make_object(TokenType::text, camaroo_text(text_key(entry)));
+    }
+
+    void camaroo_map::rehash(size_t count) {
+        // Everything that allocates happens before the map changes, so running out of memory leaves it as it was
+        size_t slots = capacity_for(count);
+        std::vector<uint8_t> new_control(slots + simd::group_width, empty_slot);
+        std::vector<num_slot> new_num_slots;
+        std::vector<uint32_t> new_text_slots;
+        if (keys == TokenType::num)
+            new_num_slots.assign(slots, num_slot{0, 0});
+        else
+            new_text_slots.assign(slots, 0);
+
+        if (live != values.size()) {
+            std::string pool;
+            std::vector<uint32_t> offsets{0};
+            if (keys != TokenType::num) {
+                for (size_t entry = 0; entry < values.size(); ++entry) {
+                    if (erased[entry])
+                        continue;
+                    pool.append(text_key(entry));
+                    offsets.push_back(static_cast<uint32_t>(pool.size()));
+                }
+            }
+
+            size_t kept = 0;
+            for (size_t entry = 0; entry < values.size(); ++entry) {
+                if (erased[entry])
+                    continue;
+                if (keys == TokenType::num)
+                    num_keys[kept] = num_keys[entry];
+                else
+                    text_hashes[kept] = text_hashes[entry];
+                values[kept] = std::move(values[entry]);
+                ++kept;
+            }
+            values.resize(kept);
+            erased.assign(kept, 0);
+            if (keys == TokenType::num) {
+                num_keys.resize(kept);
+            } else {
+                text_hashes.resize(kept);
+                key_pool = std::move(pool);
+                text_offsets = std::move(offsets);
+            }
+        }
+
+        control = std::move(new_control);
+        num_slots = std::move(new_num_slots);
+        text_slots = std::move(new_text_slots);
+        for (size_t entry = 0; entry < values.size(); ++entry) {
+            uint64_t hash = (keys == TokenType::num) ? hash_num(num_keys[entry]) : text_hashes[entry];
+            size_t slot = free_slot(hash);
+            set_control(slot, tag_of(hash));
+            if (keys == TokenType::num)
+                num_slots[slot] = num_slot{num_keys[entry], static_cast<uint32_t>(entry)};
+            else
+                text_slots[slot] = static_cast<uint32_t>(entry);
+        }
+        used = values.size();
+    }
+}
@@ -0,0 +1,186 @@
+#include <module.h>
+#include <hash.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace camaroo_core {
+
+    namespace {
+
+        struct module_file {
+            std::string path;
+            uint64_t source_hash = 0;
+            Program program;
+            // Keys of the modules it uses, in the order it uses them
+            std::vector<std::string> uses;
+            std::vector<std::string> errors;
+        };
+
+        std::string module_key(const std::filesystem::path& path) {
+            std::error_code error;
+            std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+            return (error ? path.lexically_normal() : canonical).string();
+        }
+
+        std::filesystem::path module_path(const std::filesystem::path& directory, const std::string& name) {
+            std::filesystem::path path = directory / name;
+            if (path.extension() != ".cmr")
+                path += ".cmr";
+            return path;
+        }
+
+        Program parse_source(const std::string& source, const std::string& path, const ast_cache::settings& cache) {
+            uint64_t source_hash = content_hash(source);
+            std::string cache_file = (cache.enabled && !path.empty()) ? ast_cache::cache_path(path, cache.directory) : "";
+            if (!cache_file.empty()) {
+                if (std::optional<Program> cached = ast_cache::load(cache_file, source_hash))
+                    return std::move(*cached);
+            }
+
+            Parser parser(source, true);
+            Program program = parser.parse_program();
+            if (program.has_compiled && !cache_file.empty())
+                ast_cache::store(cache_file, program, source_hash);
+            return program;
+        }
+
+        void load_file(module_file& module, const ast_cache::settings& cache) {
+            std::ifstream file(module.path, std::ios::binary);
+            if (!file) {
+                module.errors.push_back("Error: couldn't open " + module.path);
+                return;
+            }
+            std::string source(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>{});
+            module.source_hash = content_hash(source);
+            module.program = parse_source(source, module.path, cache);
+            for (const auto& error : module.program.errors)
+                module.errors.push_back(module.path + ": " + error);
+        }
+
+        // Every module a file uses, resolved against its directory
+        std::vector<std::filesystem::path> used_modules(const Program& program, const std::filesystem::path& directory) {
+            std::vector<std::filesystem::path> used;
+            for (const auto& statement : program.statements) {
+                if (statement->node_kind() == NodeKind::use_stmnt)
+                    used.push_back(module_path(directory, static_cast<UseStmnt*>(statement.get())->get_module()));
+            }
+            return used;
+        }
+
+        class linker {
+        public:
+            explicit linker(std::unordered_map<std::string, module_file>& modules)
+                :modules(modules) {}
+
+            // Dependencies land before the modules that use them, a module already on the path is a cycle
+            void visit(const std::string& key, std::vector<std::string>& path) {
+                if (done.count(key))
+                    return;
+                for (size_t i = 0; i < path.size(); ++i) {
+                    if (path[i] != key)
+                        continue;
+                    std::string cycle;
+                    for (size_t j = i; j < path.size(); ++j)
+                        cycle += modules[path[j]].path + " -> ";
+                    throw std::runtime_error("Error: modules use each other, " + cycle + modules[key].path);
+                }
+
+                path.push_back(key);
+                for (const auto& used : modules[key].uses)
+                    visit(used, path);
+                path.pop_back();
+
+                done.insert({key, true});
+                order.push_back(key);
+            }
+
+            std::vector<std::string> order;
+        private:
+            std::unordered_map<std::string, module_file>& modules;
+            std::unordered_map<std::string, bool> done;
+        };
+    }
+
+    namespace modules {
+
+        Program link(const std::string& root_source, const std::string& root_path, thread_pool& pool,
+                     const ast_cache::settings& cache, std::vector<source_file>* sources) {
+            Program root = parse_source(root_source, root_path, cache);
+            if (!root.has_compiled)
+                return root;
+            if (sources && !root_path.empty())
+                sources->push_back(source_file{root_path, content_hash(root_source)});
+
+            std::filesystem::path root_directory = root_path.empty() ? std::filesystem::current_path()
+                                                                     : std::filesystem::path(root_path).parent_path();
+            std::vector<std::filesystem::path> root_uses = used_modules(root, root_directory);
+            if (root_uses.empty())
+                return root;
+
+            std::string root_key = root_path.empty() ? std::string() : module_key(root_path);
+            std::unordered_map<std::string, module_file> files;
+            module_file& root_file = files[root_key];
+            root_file.path = root_path.empty() ? "<source>" : root_path;
+            root_file.program = std::move(root);
+
+            // Breadth first: every file in a wave is independent of the others, so they're read and parsed at once
+            std::vector<std::string> wave;
+            auto enqueue = [&](module_file& user, const std::vector<std::filesystem::path>& used) {
+                for (const auto& path : used) {
+                    std::string key = module_key(path);
+                    user.uses.push_back(key);
+                    if (files.count(key))
+                        continue;
+                    files[key].path = path.string();
+                    wave.push_back(key);
+                }
+            };
+            enqueue(root_file, root_uses);
+
+            std::vector<std::string> errors;
+            while (!wave.empty()) {
+                std::vector<module_file*> loading;
+                for (const auto& key : wave)
+                    loading.push_back(&files[key]);
+                std::vector<std::string> keys = std::move(wave);
+                wave.clear();
+
+                pool.parallel_for(loading.size(), 1, [&](size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; ++i)
+                        load_file(*loading[i], cache);
+                });
+
+                for (size_t i = 0; i < loading.size(); ++i) {
+                    module_file& module = *loading[i];
+                    errors.insert(errors.end(), module.errors.begin(), module.errors.end());
+                    if (module.errors.empty())
+                        enqueue(module, used_modules(module.program, std::filesystem::path(module.path).parent_path()));
+                }
+            }
+
+            if (!errors.empty()) {
+                Program failed;
+                failed.has_compiled = false;
+                failed.errors = std::move(errors);
+                return failed;
+            }
+
+            linker order(files);
+            std::vector<std::string> path;
+            order.visit(root_key, path);
+
+            Program linked;
+            for (const auto& key : order.order) {
+                if (sources && key != root_key)
+                    sources->push_back(source_file{files[key].path, files[key].source_hash});
+                for (auto& statement : files[key].program.statements)
+                    linked.statements.push_back(std::move(statement));
+            }
+            return linked;
+        }
+    }
+}
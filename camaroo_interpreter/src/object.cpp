@@ -0,0 +1,129 @@
+#include <object.h>
+#include <list.h>
+#include <channel.h>
+#include <map.h>
+#include <charconv>
+#include <sstream>
+
+namespace camaroo_core {
+
+    const char* type_name(TokenType type) {
+        switch (type) {
+            case TokenType::num: return "num";
+            case TokenType::fnum: return "fnum";
+            case TokenType::toggle: return "toggle";
+            case TokenType::text: return "text";
+            case TokenType::letter: return "letter";
+            case TokenType::list: return "list";
+            case TokenType::channel: return "channel";
+            case TokenType::generator: return "gen";
+            case TokenType::map: return "map";
+            default: return "unknown";
+        }
+    }
+
+    TokenType declared_kind(TokenType keyword) {
+        switch (keyword) {
+            case TokenType::num_type: return TokenType::num;
+            case TokenType::fnum_type: return TokenType::fnum;
+            case TokenType::text_type: return TokenType::text;
+            case TokenType::letter_type: return TokenType::letter;
+            case TokenType::toggle_type: return TokenType::toggle;
+            case TokenType::list_type: return TokenType::list;
+            case TokenType::channel_type: return TokenType::channel;
+            case TokenType::map_type: return TokenType::map;
+            default: return TokenType::unknown;
+        }
+    }
+
+    void write_object(std::ostream& out, const camaroo_object& object) {
+        switch (object.variable_type) {
+            case TokenType::num:
+                out << std::get<int64_t>(object.variable_value);
+                break;
+            case TokenType::fnum:
+                out << std::get<double>(object.variable_value);
+                break;
+            case TokenType::toggle:
+                out << (std::get<bool>(object.variable_value) ? "true" : "false");
+                break;
+            case TokenType::text:
+                out << std::get<camaroo_text>(object.variable_value);
+                break;
+            case TokenType::letter: {
+                std::string letter;
+                append_utf8(letter, std::get<char32_t>(object.variable_value));
+                out << letter;
+                break;
+            }
+            case TokenType::list:
+                write_list(out, *std::get<std::shared_ptr<camaroo_list>>(object.variable_value));
+                break;
+            case TokenType::channel: {
+                const camaroo_channel& channel = *std::get<std::shared_ptr<camaroo_channel>>(object.variable_value);
+                out << "channel(" << type_name(channel.element_type()) << ", " << channel.capacity() << ")";
+                break;
+            }
+            case TokenType::generator:
+                out << "gen";
+                break;
+            case TokenType::map: {
+                // {key: value, ...} in the order the keys were put in
+                camaroo_map& map = *std::get<std::shared_ptr<camaroo_map>>(object.variable_value);
+                std::lock_guard<std::mutex> held(map.guard());
+                out << '{';
+                bool first = true;
+                for (size_t entry = 0; entry < map.entry_count(); ++entry) {
+                    if (!map.has_entry(entry))
+                        continue;
+                    if (!first)
+                        out << ", ";
+                    first = false;
+                    write_object(out, *map.key_at(entry));
+                    out << ": ";
+                    write_object(out, camaroo_object{map.value_type(), map.value_at(entry)});
+                }
+                out << '}';
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    void append_object(std::string& out, const camaroo_object& object) {
+        char digits[32];
+        switch (object.variable_type) {
+            case TokenType::num: {
+                auto written = std::to_chars(digits, digits + sizeof(digits), std::get<int64_t>(object.variable_value));
+                out.append(digits, written.ptr);
+                break;
+            }
+            case TokenType::fnum: {
+                // Six significant digits like a stream's default
+                auto written = std::to_chars(digits, digits + sizeof(digits), std::get<double>(object.variable_value),
+                                             std::chars_format::general, 6);
+                out.append(digits, written.ptr);
+                break;
+            }
+            case TokenType::toggle:
+                out += std::get<bool>(object.variable_value) ? "true" : "false";
+                break;
+            case TokenType::text:
+                out += std::get<camaroo_text>(object.variable_value).view();
+                break;
+            case TokenType::letter:
+                append_utf8(out, std::get<char32_t>(object.variable_value));
+                break;
+            case TokenType::generator:
+                out += "gen";
+                break;
+            default: {
+                std::ostringstream written;
+                write_object(written, object);
+                out += written.str();
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#include <optimize.h>
+#include <hoist.h>
+#include <inliner.h>
+#include <sharing.h>
+#include <strength.h>
+
+namespace camaroo_core {
+
+    void visit_expression_roots(ASTNode* statement, const std::function<void(std::unique_ptr<ExpressionNode>&)>& visit) {
+        if (!statement)
+            return;
+        statement->visit_expressions([&](std::unique_ptr<ExpressionNode>& slot) {
+            if (slot)
+                visit(slot);
+        });
+        switch (statement->node_kind()) {
+            case NodeKind::block:
+                for (const auto& inner : static_cast<BlockStmnt*>(statement)->get_statements())
+                    visit_expression_roots(inner.get(), visit);
+                return;
+            case NodeKind::for_loop:
+                visit_expression_roots(static_cast<ForStmnt*>(statement)->get_body(), visit);
+                return;
+            case NodeKind::spawn:
+                visit_expression_roots(static_cast<SpawnStmnt*>(statement)->get_body(), visit);
+                return;
+            case NodeKind::function:
+                visit_expression_roots(static_cast<FuncStmnt*>(statement)->get_definition()->body.get(), visit);
+                return;
+            default:
+                return;
+        }
+    }
+
+    void optimize(const std::vector<std::unique_ptr<StatementNode>>& statements) {
+        // Inlined bodies go through the other passes along with the code around them. Chains next, sharing then
+        // finds more of them equal than the trees they came from. Hoisting goes before sharing, whose copies can
+        // be reached from more than one loop
+        inline_calls(statements);
+        reduce_strength(statements);
+        hoist_invariants(statements);
+        share_subtrees(statements);
+    }
+}
@@ -1,44 +1,146 @@
 #include <parser.h>
 #include <tokenizer.h>
 #include <ast.h>
+#include <optimize.h>
+#include <type_check.h>
 #include <float.h>
 #include <memory>
 #include <string>
-#include <iostream>
+#include <unordered_set>
 
 namespace camaroo_core {
 
-    Parser::Parser(const std::string& source_code)
-        :current_token(std::nullopt), next_token(std::nullopt), tokenizer(source_code)
+    namespace {
+        bool is_declaration(TokenType type) {
+            return type == TokenType::num_type || type == TokenType::fnum_type || type == TokenType::toggle_type ||
+                   type == TokenType::text_type || type == TokenType::letter_type || type == TokenType::list_type ||
+                   type == TokenType::channel_type || type == TokenType::map_type;
+        }
+
+        // Index of the } closing the slot whose { is at open, npos when it isn't closed before end. Braces in text or
+        // letters inside the slot don't count
+        size_t slot_end(const std::string& literal, size_t open, size_t end) {
+            size_t depth = 0;
+            for (size_t at = open; at < end; ++at) {
+                char c = literal[at];
+                if (c == '\"') {
+                    ++at;
+                    while (at < end && literal[at] != '\"')
+                        at += (literal[at] == '\\') ? 2 : 1;
+                } else if (c == '\'') {
+                    // A quote, maybe a backslash, then the letter and the bytes of it that follow, the loop steps past the closing quote
+                    at += (at + 1 < end && literal[at + 1] == '\\') ? 3 : 2;
+                    while (at < end && (static_cast<unsigned char>(literal[at]) & 0xC0) == 0x80)
+                        ++at;
+                } else if (c == '{') {
+                    ++depth;
+                } else if (c == '}' && --depth == 0) {
+                    return at;
+                }
+            }
+            return std::string::npos;
+        }
+
+        // Chunks of a parallel for run in any order, so its body may only write variables it declares itself
+        // and the loop's reduction variables. Anything else would make the result depend on scheduling.
+        void check_parallel_writes(BlockStmnt* block, std::unordered_set<std::string> locals,
+                                   const std::unordered_set<std::string>& reductions, std::vector<std::string>& errors) {
+            for (const auto& statement : block->get_statements()) {
+                TokenType type = statement->token_type();
+                if (is_declaration(type)) {
+                    locals.insert(std::get<std::string>(statement->get_left()->token_value()));
+                } else if (type == TokenType::equal) {
+                    std::string name = std::get<std::string>(statement->get_left()->token_value());
+                    if (!locals.count(name) && !reductions.count(name))
+                        errors.push_back("Error: parallel for can't write to outer variable " + name + ", add a reduce clause for it");
+                } else if (type == TokenType::LCurlyBrace) {
+                    check_parallel_writes(static_cast<BlockStmnt*>(statement.get()), locals, reductions, errors);
+                } else if (type == TokenType::for_keyword) {
+                    ForStmnt* loop = static_cast<ForStmnt*>(statement.get());
+                    if (!loop->is_parallel()) {
+                        std::unordered_set<std::string> inner = locals;
+                        inner.insert(std::get<std::string>(loop->get_left()->token_value()));
+                        check_parallel_writes(loop->get_body(), inner, reductions, errors);
+                        continue;
+                    }
+                    // A nested parallel for already checked its own body, only its results land out here
+                    for (const auto& clause : loop->get_reductions()) {
+                        if (!locals.count(clause.variable) && !reductions.count(clause.variable))
+                            errors.push_back("Error: parallel for can't write to outer variable " + clause.variable + ", add a reduce clause for it");
+                    }
+                }
+            }
+        }
+    }
+
+    struct Parser::dispatch_tables {
+        std::unordered_map<TokenType, ExprOrder> precedences;
+        std::unordered_map<TokenType, std::unique_ptr<ExpressionNode> (Parser::*)()> prefix_fns;
+        std::unordered_map<TokenType, std::unique_ptr<ExpressionNode> (Parser::*)(std::unique_ptr<ExpressionNode>)> infix_fns;
+    };
+
+    // Built once and shared by every parser, the REPL and the module loader make a new parser per line or file
+    const Parser::dispatch_tables& Parser::tables() {
+        static const dispatch_tables built = []() {
+            dispatch_tables t;
+            // Identifier/Values
+            t.prefix_fns[TokenType::identifier] = &Parser::parse_id_expr;
+            t.prefix_fns[TokenType::num] = &Parser::parse_num_expr;
+            t.prefix_fns[TokenType::fnum] = &Parser::parse_fnum_expr;
+            t.prefix_fns[TokenType::toggle] = &Parser::parse_toggle_expr;
+            t.prefix_fns[TokenType::LParen] = &Parser::parse_grouped_expr;
+            t.prefix_fns[TokenType::text] = &Parser::parse_text_expr;
+            t.prefix_fns[TokenType::format] = &Parser::parse_format_expr;
+            t.prefix_fns[TokenType::letter] = &Parser::parse_letter_expr;
+            t.prefix_fns[TokenType::LSquareBracket] = &Parser::parse_list_expr;
+            //Types
+            t.prefix_fns[TokenType::num_type] = &Parser::parse_num_expr;
+            t.prefix_fns[TokenType::fnum_type] = &Parser::parse_fnum_expr;
+            t.prefix_fns[TokenType::toggle_type] = &Parser::parse_toggle_expr;
+            t.prefix_fns[TokenType::subtract] = &Parser::parse_prefix_expr;
+            t.prefix_fns[TokenType::text_type] = &Parser::parse_text_expr;
+            t.prefix_fns[TokenType::letter_type] = &Parser::parse_letter_expr;
+            t.prefix_fns[TokenType::list_type] = &Parser::parse_list_expr;
+            t.prefix_fns[TokenType::channel_type] = &Parser::parse_channel_expr;
+            t.prefix_fns[TokenType::map_type] = &Parser::parse_map_expr;
+            // Operations
+            t.infix_fns[TokenType::add] = &Parser::parse_infix_expr;
+            t.infix_fns[TokenType::subtract] = &Parser::parse_infix_expr;
+            t.infix_fns[TokenType::multiply] = &Parser::parse_infix_expr;
+            t.infix_fns[TokenType::division] = &Parser::parse_infix_expr;
+            t.infix_fns[TokenType::modulo] = &Parser::parse_infix_expr;
+            t.infix_fns[TokenType::equal_operator] = &Parser::parse_infix_expr;
+            t.infix_fns[TokenType::not_equal_operator] = &Parser::parse_infix_expr;
+            t.infix_fns[TokenType::less_operator] = &Parser::parse_infix_expr;
+            t.infix_fns[TokenType::less_equal_operator] = &Parser::parse_infix_expr;
+            t.infix_fns[TokenType::greater_operator] = &Parser::parse_infix_expr;
+            t.infix_fns[TokenType::greater_equal_operator] = &Parser::parse_infix_expr;
+            t.infix_fns[TokenType::LParen] = &Parser::parse_call_expr;
+            t.infix_fns[TokenType::to_keyword] = &Parser::parse_infix_expr;
+
+            t.precedences[TokenType::to_keyword] = ExprOrder::range;
+            t.precedences[TokenType::equal_operator] = ExprOrder::equals;
+            t.precedences[TokenType::not_equal_operator] = ExprOrder::equals;
+            t.precedences[TokenType::less_operator] = ExprOrder::less_greater;
+            t.precedences[TokenType::less_equal_operator] = ExprOrder::less_greater;
+            t.precedences[TokenType::greater_operator] = ExprOrder::less_greater;
+            t.precedences[TokenType::greater_equal_operator] = ExprOrder::less_greater;
+            t.precedences[TokenType::add] = ExprOrder::sum_diff;
+            t.precedences[TokenType::subtract] = ExprOrder::sum_diff;
+            t.precedences[TokenType::multiply] = ExprOrder::product_div;
+            t.precedences[TokenType::division] = ExprOrder::product_div;
+            t.precedences[TokenType::modulo] = ExprOrder::product_div;
+            t.precedences[TokenType::LParen] = ExprOrder::call;
+            return t;
+        }();
+        return built;
+    }
+
+    Parser::Parser(const std::string& source_code, bool lazy_bodies)
+        :current_token(std::nullopt), next_token(std::nullopt), tokenizer(source_code),
+         source(lazy_bodies ? std::make_shared<const std::string>(source_code) : nullptr)
     {
         advance_token();
-        using expr_ptr = std::unique_ptr<ExpressionNode>;
-        
-        // Identifier/Values
-        prefix_fns[TokenType::identifier] = [this]() -> expr_ptr { return this->parse_id_expr(); };
-        prefix_fns[TokenType::num] = [this]() -> expr_ptr { return this->parse_num_expr(); };
-        prefix_fns[TokenType::fnum] = [this]() -> expr_ptr { return this->parse_fnum_expr(); };
-        prefix_fns[TokenType::toggle] = [this]() -> expr_ptr { return this->parse_toggle_expr(); };
-        prefix_fns[TokenType::LParen] = [this]() -> expr_ptr { return this->parse_grouped_expr(); };
-        prefix_fns[TokenType::text] = [this]() -> expr_ptr { return this->parse_text_expr(); };
-        //Types
-        prefix_fns[TokenType::num_type] = [this]() -> expr_ptr { return this->parse_num_expr(); };
-        prefix_fns[TokenType::fnum_type] = [this]() -> expr_ptr { return this->parse_fnum_expr(); };
-        prefix_fns[TokenType::toggle_type] = [this]() -> expr_ptr { return this->parse_toggle_expr(); };
-        prefix_fns[TokenType::subtract] = [this]() -> expr_ptr { return this->parse_prefix_expr(); };
-        prefix_fns[TokenType::text_type] = [this]() -> expr_ptr { return this->parse_text_expr(); };
-        // Operations
-        infix_fns[TokenType::add] = [this](expr_ptr expr) -> expr_ptr { return this->parse_infix_expr(std::move(expr)); };
-        infix_fns[TokenType::subtract] = [this](expr_ptr expr) -> expr_ptr { return this->parse_infix_expr(std::move(expr)); };
-        infix_fns[TokenType::multiply] = [this](expr_ptr expr) -> expr_ptr { return this->parse_infix_expr(std::move(expr)); };
-        infix_fns[TokenType::division] = [this](expr_ptr expr) -> expr_ptr { return this->parse_infix_expr(std::move(expr)); };
-        infix_fns[TokenType::equal_operator] = [this](expr_ptr expr) -> expr_ptr { return this->parse_infix_expr(std::move(expr)); };
-
-        precedences[TokenType::equal_operator] = ExprOrder::equals;
-        precedences[TokenType::add] = ExprOrder::sum_diff;
-        precedences[TokenType::subtract] = ExprOrder::sum_diff;
-        precedences[TokenType::multiply] = ExprOrder::product_div;
-        precedences[TokenType::division] = ExprOrder::product_div;
     }
 
     bool Parser::validate_in_tokens(std::vector<Token>& expected_tokens) {
@@ -54,7 +156,7 @@ namespace camaroo_core {
         }
 
         std::string msg = "Expected next token to be one of [";
-        for (const auto token : expected_tokens)
+        for (const auto& token : expected_tokens)
             msg += token.value + " ";
         msg += "] but found, " + current_token.value().value;
         errors.push_back(msg);
@@ -84,9 +186,10 @@ namespace camaroo_core {
     }
 
     ExprOrder Parser::current_precedence() {
+        const auto& precedences = tables().precedences;
         auto it = precedences.find(current_token.value().type);
         if (it != precedences.end())
-            return precedences[current_token.value().type];
+            return it->second;
         return ExprOrder::lowest;
     }
 
@@ -94,9 +197,10 @@ namespace camaroo_core {
         if (!next_token.has_value())
             return ExprOrder::lowest;
 
+        const auto& precedences = tables().precedences;
         auto it = precedences.find(next_token.value().type);
         if (it != precedences.end())
-            return precedences[next_token.value().type];
+            return it->second;
         return ExprOrder::lowest;
     }
 
@@ -109,28 +213,7 @@ namespace camaroo_core {
         Program program;
 
         while (current_token.has_value()) {
-            std::unique_ptr<StatementNode> stmnt = nullptr;
-            switch (current_token.value().type) {
-                case TokenType::unknown:
-                    errors.push_back("Unknown token: " + current_token.value().value);
-                    break;
-                case TokenType::num_type:
-                case TokenType::fnum_type:
-                case TokenType::toggle_type:
-                case TokenType::identifier:
-                    stmnt = parse_assign_stmnt();
-                    break;
-                case TokenType::print:
-                case TokenType::println:
-                    stmnt = parse_print_stmnt();
-                    break;
-                case TokenType::LCurlyBrace:
-                    stmnt = parse_block_stmnt();
-                    break;
-                default:
-                    break;
-            }
-
+            std::unique_ptr<StatementNode> stmnt = parse_statement();
             if (stmnt) {
                 program.statements.push_back(std::move(stmnt));
             }
@@ -138,15 +221,55 @@ namespace camaroo_core {
         }
 
         if (!errors.empty()) {
-            for (const auto& err : errors) {
-                std::cerr << err << '\n';
-            }
+            program.errors = errors;
             program.has_compiled = false;
         }
 
         return program;
     }
 
+    std::unique_ptr<StatementNode> Parser::parse_statement() {
+        switch (current_token.value().type) {
+            case TokenType::unknown:
+                errors.push_back("Unknown token: " + current_token.value().value);
+                return nullptr;
+            case TokenType::num_type:
+            case TokenType::fnum_type:
+            case TokenType::toggle_type:
+            case TokenType::text_type:
+            case TokenType::letter_type:
+            case TokenType::list_type:
+            case TokenType::channel_type:
+            case TokenType::map_type:
+                return parse_assign_stmnt();
+            case TokenType::identifier:
+                if (next_token.has_value() && next_token.value().type == TokenType::LParen)
+                    return parse_expression_stmnt();
+                return parse_assign_stmnt();
+            case TokenType::print:
+            case TokenType::println:
+                return parse_print_stmnt();
+            case TokenType::LCurlyBrace:
+                return parse_block_stmnt();
+            case TokenType::for_keyword:
+            case TokenType::parallel_keyword:
+                return parse_for_stmnt();
+            case TokenType::spawn_keyword:
+                return parse_spawn_stmnt();
+            case TokenType::func_type:
+            case TokenType::gen_type:
+                return parse_func_stmnt();
+            case TokenType::return_keyword:
+                return parse_return_stmnt();
+            case TokenType::yield_keyword:
+                return parse_yield_stmnt();
+            case TokenType::use_keyword:
+                return parse_use_stmnt();
+            default:
+                return nullptr;
+        }
+    }
+
     std::unique_ptr<PrintStmnt> Parser::parse_print_stmnt() {
         TokenType type = current_token.value().type;
         advance_token();
@@ -180,20 +303,26 @@ namespace camaroo_core {
             }
         }
 
-        std::unique_ptr<IdentifierNode> id = nullptr;
+        if (!validate_token(Token{TokenType::identifier, "identifier"}))
+            return nullptr;
+        current_token.value().type = TokenType::identifier;
+        std::unique_ptr<IdentifierNode> id = std::make_unique<IdentifierNode>(current_token.value());
         std::unique_ptr<ExpressionNode> value = nullptr;
-        if (validate_token(Token{TokenType::identifier, "identifier"})) {
-            current_token.value().type = TokenType::identifier;
-            id = std::make_unique<IdentifierNode>(current_token.value());
-            advance_token();
-        }
+        advance_token();
 
         std::vector valid_tokens = {Token({TokenType::semicolon, ";"}), Token({TokenType::equal, "="})};
         if (!validate_in_tokens(valid_tokens))
             return nullptr;
 
         if (current_token.value().type == TokenType::semicolon) {
-                value = prefix_fns[assign_type.type]();
+            // Only declarations have a default value, a bare name followed by ; has nothing to assign
+            const auto& prefix_fns = tables().prefix_fns;
+            auto default_it = prefix_fns.find(assign_type.type);
+            if (default_it == prefix_fns.end()) {
+                errors.push_back("Error: expected = but found, ;");
+                return nullptr;
+            }
+            value = (this->*default_it->second)();
         } else {
             advance_token();
             value = parse_expression(ExprOrder::lowest);
@@ -212,14 +341,15 @@ namespace camaroo_core {
             return nullptr;
         }
 
-        auto prefix_it = prefix_fns.find(current_token.value().type);
-        if (prefix_it == prefix_fns.end()) {
+        const dispatch_tables& dispatch = tables();
+        auto prefix_it = dispatch.prefix_fns.find(current_token.value().type);
+        if (prefix_it == dispatch.prefix_fns.end()) {
             errors.push_back("Error: couldn't parse " + current_token.value().value);
             return nullptr;
         }
 
         Token token_to_parse = current_token.value();
-        std::unique_ptr<ExpressionNode> left = prefix_fns[token_to_parse.type]();
+        std::unique_ptr<ExpressionNode> left = (this->*prefix_it->second)();
         if (!left) {
             errors.push_back("Error: coudln't parse expression at " + token_to_parse.value);
             return nullptr;
@@ -235,8 +365,8 @@ namespace camaroo_core {
                 return nullptr;
             }
 
-            auto infix_it = infix_fns.find(current_token.value().type);
-            if (infix_it == infix_fns.end()) {
+            auto infix_it = dispatch.infix_fns.find(current_token.value().type);
+            if (infix_it == dispatch.infix_fns.end()) {
                 errors.push_back("Error: couldn't parse " + current_token.value().value);
                 return nullptr;
             }
@@ -247,7 +377,7 @@ namespace camaroo_core {
             }
 
             token_to_parse = current_token.value();
-            left = infix_fns[token_to_parse.type](std::move(left));
+            left = (this->*infix_it->second)(std::move(left));
 
             if (!left) {
                 errors.push_back("Error: coudln't parse expression at " + token_to_parse.value);
@@ -260,12 +390,14 @@ namespace camaroo_core {
 
     std::unique_ptr<ExpressionNode> Parser::parse_prefix_expr() {
         Token token = current_token.value();
-        ExprOrder precedence = current_precedence();
         advance_token();
         if (!current_token.has_value())
             return nullptr;
 
-        std::unique_ptr<ExpressionNode> right_expr = parse_expression(precedence);
+        // Binds tighter than any infix operator, the minus of -3 isn't the one in a - b
+        std::unique_ptr<ExpressionNode> right_expr = parse_expression(ExprOrder::prefix);
+        if (!right_expr)
+            return nullptr;
         return std::unique_ptr<PrefixExpr>(new PrefixExpr(token, std::move(right_expr)));
     }
 
@@ -277,6 +409,8 @@ namespace camaroo_core {
             return nullptr;
 
         std::unique_ptr<ExpressionNode> right_expr = parse_expression(precedence);
+        if (!right_expr)
+            return nullptr;
         return std::unique_ptr<ExpressionNode>(new InfixExpr(infix_type, std::move(left_expr), std::move(right_expr)));
     }
 
@@ -306,7 +440,20 @@ namespace camaroo_core {
         if (current_token.value().type == TokenType::semicolon)
             return std::unique_ptr<NumExpr>(new NumExpr(Token({TokenType::num, "0"})));
 
-        size_t val = std::stoll(current_token.value().value);
+        // The type keyword only stands for a value as the default of a declaration
+        if (current_token.value().type != TokenType::num) {
+            errors.push_back("Error: couldn't parse " + current_token.value().value);
+            return nullptr;
+        }
+
+        size_t val = 0;
+        try {
+            val = std::stoll(current_token.value().value);
+        }
+        catch (const std::out_of_range&) {
+            errors.push_back("Error: couldn't convert number literal to correct size");
+            return nullptr;
+        }
         if (static_cast<int64_t>(val) < INT64_MAX && static_cast<int64_t>(val) > INT64_MIN)
             return std::unique_ptr<NumExpr>(new NumExpr(current_token.value()));
 
@@ -318,8 +465,20 @@ namespace camaroo_core {
         if (current_token.value().type == TokenType::semicolon)
             return std::unique_ptr<FNumExpr>(new FNumExpr(Token({TokenType::fnum, "0"})));
 
-        size_t val = std::stof(current_token.value().value);
-        if (static_cast<double>(val) < DBL_MAX && static_cast<double>(val) > DBL_MIN)
+        if (current_token.value().type != TokenType::fnum) {
+            errors.push_back("Error: couldn't parse " + current_token.value().value);
+            return nullptr;
+        }
+
+        double val = 0;
+        try {
+            val = std::stod(current_token.value().value);
+        }
+        catch (const std::out_of_range&) {
+            errors.push_back("Error: couldn't convert float literal to correct size");
+            return nullptr;
+        }
+        if (val < DBL_MAX && val >= 0)
             return std::unique_ptr<FNumExpr>(new FNumExpr(current_token.value()));
 
         errors.push_back("Error: couldn't convert float literal to correct size");
@@ -334,10 +493,501 @@ namespace camaroo_core {
         return std::unique_ptr<TextExpr>(new TextExpr(newToken));
     }
 
-    std::unique_ptr<StatementNode> Parser::parse_block_stmnt() {
-        if(current_token.has_value())
-            return std::unique_ptr<BlockStmnt>(new BlockStmnt(current_token.value()));
-        else 
-            return nullptr; 
+    std::unique_ptr<ExpressionNode> Parser::parse_letter_expr() {
+        if (current_token.value().type == TokenType::semicolon)
+            return std::unique_ptr<LetterExpr>(new LetterExpr(Token({TokenType::letter, std::string(1, '\0')})));
+
+        if (current_token.value().type != TokenType::letter) {
+            errors.push_back("Error: couldn't parse " + current_token.value().value);
+            return nullptr;
+        }
+
+        Token newToken = {TokenType::letter, current_token.value().value.substr(1, current_token.value().value.size()-2)};
+        return std::unique_ptr<LetterExpr>(new LetterExpr(newToken));
+    }
+
+    // The text between slots goes in as it is, each slot is parsed on its own as one expression
+    std::unique_ptr<ExpressionNode> Parser::parse_format_expr() {
+        const Token& token = current_token.value();
+        const std::string& literal = token.value;
+        size_t end = (literal.size() > 1 && literal.back() == '\"') ? literal.size() - 1 : literal.size();
+
+        std::vector<camaroo_text> pieces;
+        std::vector<std::unique_ptr<ExpressionNode>> slots;
+        std::string piece;
+        for (size_t at = 1; at < end;) {
+            char c = literal[at];
+            if (c != '{' || (at + 1 < end && literal[at + 1] == '{')) {
+                // Braces that stand for themselves come doubled
+                piece += c;
+                at += (c == '{' || c == '}') ? 2 : 1;
+                continue;
+            }
+            size_t close = slot_end(literal, at, end);
+            if (close == std::string::npos) {
+                errors.push_back("Error: text has a { without a closing }");
+                return nullptr;
+            }
+            std::string source = literal.substr(at + 1, close - at - 1);
+            Parser inner(source);
+            std::unique_ptr<ExpressionNode> slot = inner.current_token.has_value() ? inner.parse_expression(ExprOrder::lowest) : nullptr;
+            if (!slot || inner.next_token.has_value() || !inner.errors.empty()) {
+                errors.insert(errors.end(), inner.errors.begin(), inner.errors.end());
+                errors.push_back("Error: couldn't parse {" + source + "} in text");
+                return nullptr;
+            }
+            pieces.emplace_back(piece);
+            piece.clear();
+            slots.push_back(std::move(slot));
+            at = close + 1;
+        }
+        pieces.emplace_back(piece);
+        return std::make_unique<FormatExpr>(token, std::move(pieces), std::move(slots));
+    }
+
+    std::unique_ptr<BlockStmnt> Parser::parse_block_stmnt() {
+        Token block_token = current_token.value();
+        std::vector<std::unique_ptr<StatementNode>> statements;
+        size_t yields_before = yield_count;
+        advance_token();
+
+        ++block_depth;
+        while (current_token.has_value() && current_token.value().type != TokenType::RCurlyBrace) {
+            std::unique_ptr<StatementNode> stmnt = parse_statement();
+            if (stmnt)
+                statements.push_back(std::move(stmnt));
+            advance_token();
+        }
+        --block_depth;
+
+        if (!validate_token({TokenType::RCurlyBrace, "}"}))
+            return nullptr;
+        return std::make_unique<BlockStmnt>(block_token, std::move(statements), yield_count != yields_before);
+    }
+
+    std::unique_ptr<BlockStmnt> Parser::parse_function_body(TokenType kind) {
+        std::unique_ptr<BlockStmnt> body = parse_body(kind);
+        if (!errors.empty())
+            return nullptr;
+        return body;
+    }
+
+    BlockStmnt* FunctionDef::get_body() {
+        std::call_once(body_parsed, [this]() {
+            if (body || !source)
+                return;
+            Parser parser{std::string(body_source())};
+            std::unique_ptr<BlockStmnt> parsed = parser.parse_function_body(kind.type);
+            if (!parsed) {
+                std::string message = "Error: " + kind.value + " " + name + " doesn't parse";
+                for (const auto& error : parser.errors)
+                    message += "\n" + error;
+                throw std::runtime_error(message);
+            }
+            // Nothing is kept until the body is known to be good, so the next call reports the same errors
+            std::vector<std::string> mistakes = check_body(*this, parsed->get_statements());
+            if (checked && !mistakes.empty()) {
+                std::string message = "Error: " + kind.value + " " + name + " doesn't type check";
+                for (const auto& mistake : mistakes)
+                    message += "\n" + mistake;
+                throw std::runtime_error(message);
+            }
+            optimize(parsed->get_statements());
+            body = std::move(parsed);
+        });
+        return body.get();
+    }
+
+    std::unique_ptr<BlockStmnt> Parser::parse_body(TokenType kind) {
+        body_kinds.push_back(kind);
+        std::unique_ptr<BlockStmnt> body = parse_block_stmnt();
+        body_kinds.pop_back();
+        return body;
+    }
+
+    TokenType Parser::enclosing_body() {
+        return body_kinds.empty() ? TokenType::unknown : body_kinds.back();
+    }
+
+    std::unique_ptr<StatementNode> Parser::parse_for_stmnt() {
+        bool parallel = current_token.value().type == TokenType::parallel_keyword;
+        if (parallel) {
+            advance_token();
+            if (!validate_token({TokenType::for_keyword, "for"}))
+                return nullptr;
+        }
+
+        Token for_token = current_token.value();
+        advance_token();
+        if (!validate_token({TokenType::LParen, "("}))
+            return nullptr;
+
+        advance_token();
+        std::vector type_tokens = {Token({TokenType::num_type, "num"}), Token({TokenType::fnum_type, "fnum"}),
+                                   Token({TokenType::toggle_type, "toggle"}), Token({TokenType::text_type, "text"}),
+                                   Token({TokenType::letter_type, "letter"}),
+                                   Token({TokenType::list_type, "list"})};
+        if (!validate_in_tokens(type_tokens))
+            return nullptr;
+        Token variable_type = current_token.value();
+
+        advance_token();
+        if (!validate_token({TokenType::identifier, "identifier"}))
+            return nullptr;
+        std::unique_ptr<IdentifierNode> variable = std::make_unique<IdentifierNode>(current_token.value());
+
+        advance_token();
+        if (!validate_token({TokenType::comma, ","}))
+            return nullptr;
+        advance_token();
+        if (!validate_token({TokenType::in_keyword, "in"}))
+            return nullptr;
+        advance_token();
+
+        std::unique_ptr<ExpressionNode> iterable = parse_expression(ExprOrder::lowest);
+        if (!iterable)
+            return nullptr;
+        advance_token();
+
+        std::vector<ReductionClause> reductions;
+        while (current_token.has_value() && current_token.value().type == TokenType::comma) {
+            advance_token();
+            if (!validate_token({TokenType::reduce_keyword, "reduce"}))
+                return nullptr;
+            if (!parallel) {
+                errors.push_back("Error: reduce clauses are only allowed on a parallel for");
+                return nullptr;
+            }
+
+            advance_token();
+            if (!current_token.has_value() ||
+                !(current_token.value().type == TokenType::add || current_token.value().type == TokenType::multiply ||
+                  current_token.value().value == "min" || current_token.value().value == "max")) {
+                found_error("+, *, min or max");
+                return nullptr;
+            }
+            Token op = current_token.value();
+
+            advance_token();
+            if (!validate_token({TokenType::identifier, "identifier"}))
+                return nullptr;
+            reductions.push_back({op, current_token.value().value});
+            advance_token();
+        }
+
+        if (!validate_token({TokenType::RParen, ")"}))
+            return nullptr;
+        advance_token();
+        if (!validate_token({TokenType::LCurlyBrace, "{"}))
+            return nullptr;
+
+        std::unique_ptr<BlockStmnt> body = parallel ? parse_body(TokenType::parallel_keyword) : parse_block_stmnt();
+        if (!body)
+            return nullptr;
+
+        if (parallel) {
+            size_t error_count = errors.size();
+            std::unordered_set<std::string> reduced;
+            for (const auto& clause : reductions)
+                reduced.insert(clause.variable);
+            check_parallel_writes(body.get(), {std::get<std::string>(variable->token_value())}, reduced, errors);
+            if (errors.size() != error_count)
+                return nullptr;
+        }
+
+        return std::make_unique<ForStmnt>(for_token, variable_type, std::move(variable), std::move(iterable),
+                                          std::move(body), parallel, std::move(reductions));
+    }
+
+    std::unique_ptr<StatementNode> Parser::parse_spawn_stmnt() {
+        Token spawn_token = current_token.value();
+        advance_token();
+        if (!validate_token({TokenType::LCurlyBrace, "{"}))
+            return nullptr;
+
+        std::unique_ptr<BlockStmnt> body = parse_body(TokenType::spawn_keyword);
+        if (!body)
+            return nullptr;
+        return std::make_unique<SpawnStmnt>(spawn_token, std::move(body));
+    }
+
+    std::unique_ptr<StatementNode> Parser::parse_func_stmnt() {
+        auto definition = std::make_shared<FunctionDef>();
+        definition->kind = current_token.value();
+
+        advance_token();
+        if (!validate_token({TokenType::identifier, "identifier"}))
+            return nullptr;
+        definition->name = current_token.value().value;
+
+        advance_token();
+        if (!validate_token({TokenType::LParen, "("}))
+            return nullptr;
+
+        std::vector type_tokens = {Token({TokenType::num_type, "num"}), Token({TokenType::fnum_type, "fnum"}),
+                                   Token({TokenType::toggle_type, "toggle"}), Token({TokenType::text_type, "text"}),
+                                   Token({TokenType::letter_type, "letter"}),
+                                   Token({TokenType::list_type, "list"}), Token({TokenType::channel_type, "channel"}),
+                                   Token({TokenType::map_type, "map"})};
+        advance_token();
+        while (current_token.has_value() && current_token.value().type != TokenType::RParen) {
+            if (!validate_in_tokens(type_tokens))
+                return nullptr;
+            Token type = current_token.value();
+
+            advance_token();
+            if (!validate_token({TokenType::identifier, "identifier"}))
+                return nullptr;
+            definition->parameters.push_back({type, current_token.value().value});
+
+            advance_token();
+            if (current_token.has_value() && current_token.value().type == TokenType::comma)
+                advance_token();
+        }
+
+        if (!validate_token({TokenType::RParen, ")"}))
+            return nullptr;
+        advance_token();
+        if (!validate_token({TokenType::arrow, "->"}))
+            return nullptr;
+
+        advance_token();
+        if (!validate_in_tokens(type_tokens))
+            return nullptr;
+        definition->return_type = current_token.value();
+
+        advance_token();
+        if (!validate_token({TokenType::LCurlyBrace, "{"}))
+            return nullptr;
+        // Nested functions are parsed with the block around them, skipping only pays off for library code
+        if (source && block_depth == 0) {
+            size_t begin = tokenizer.position() - 1;
+            if (tokenizer.skip_block()) {
+                definition->source = source;
+                definition->body_begin = begin;
+                definition->body_end = tokenizer.position();
+                current_token = Token{TokenType::RCurlyBrace, "}"};
+                next_token = tokenizer.peek_next_token();
+                return std::make_unique<FuncStmnt>(std::move(definition));
+            }
+        }
+        definition->body = parse_body(definition->kind.type);
+        if (!definition->body)
+            return nullptr;
+
+        return std::make_unique<FuncStmnt>(std::move(definition));
+    }
+
+    std::unique_ptr<StatementNode> Parser::parse_return_stmnt() {
+        Token return_token = current_token.value();
+        TokenType enclosing = enclosing_body();
+        if (enclosing != TokenType::func_type && enclosing != TokenType::gen_type) {
+            errors.push_back(enclosing == TokenType::unknown ? "Error: return outside of a func or gen"
+                                                             : "Error: return can't leave a parallel for or spawn block");
+            return nullptr;
+        }
+
+        std::unique_ptr<ExpressionNode> value = nullptr;
+        advance_token();
+        if (current_token.has_value() && current_token.value().type != TokenType::semicolon) {
+            value = parse_expression(ExprOrder::lowest);
+            if (!value)
+                return nullptr;
+            advance_token();
+        }
+
+        if (!validate_token({TokenType::semicolon, ";"}))
+            return nullptr;
+        if (enclosing == TokenType::func_type && !value) {
+            errors.push_back("Error: return in a func needs a value");
+            return nullptr;
+        }
+        if (enclosing == TokenType::gen_type && value) {
+            errors.push_back("Error: a gen hands out values with yield, its return takes none");
+            return nullptr;
+        }
+        return std::make_unique<ReturnStmnt>(return_token, std::move(value));
+    }
+
+    std::unique_ptr<StatementNode> Parser::parse_yield_stmnt() {
+        Token yield_token = current_token.value();
+        if (enclosing_body() != TokenType::gen_type) {
+            errors.push_back("Error: yield is only allowed in a gen");
+            return nullptr;
+        }
+
+        advance_token();
+        std::unique_ptr<ExpressionNode> value = parse_expression(ExprOrder::lowest);
+        if (!value)
+            return nullptr;
+        advance_token();
+
+        if (!validate_token({TokenType::semicolon, ";"}))
+            return nullptr;
+        ++yield_count;
+        return std::make_unique<YieldStmnt>(yield_token, std::move(value));
+    }
+
+    std::unique_ptr<StatementNode> Parser::parse_use_stmnt() {
+        Token use_token = current_token.value();
+        if (block_depth != 0) {
+            errors.push_back("Error: use is only allowed outside of blocks");
+            return nullptr;
+        }
+        advance_token();
+
+        // Module names are paths like lib/camaro-ideas-2, glued back together from the tokens they lex into
+        std::string module;
+        if (current_token.has_value() && current_token.value().type == TokenType::text) {
+            module = current_token.value().value.substr(1, current_token.value().value.size() - 2);
+            advance_token();
+        } else {
+            while (current_token.has_value() && (current_token.value().type == TokenType::identifier ||
+                                                 current_token.value().type == TokenType::num ||
+                                                 current_token.value().type == TokenType::subtract ||
+                                                 current_token.value().type == TokenType::division)) {
+                module += current_token.value().value;
+                advance_token();
+            }
+        }
+
+        if (module.empty()) {
+            errors.push_back("Error: expected a module name after use");
+            return nullptr;
+        }
+        if (!validate_token({TokenType::semicolon, ";"}))
+            return nullptr;
+        return std::make_unique<UseStmnt>(use_token, module);
+    }
+
+    std::unique_ptr<StatementNode> Parser::parse_expression_stmnt() {
+        std::unique_ptr<ExpressionNode> expr = parse_expression(ExprOrder::lowest);
+        if (!expr)
+            return nullptr;
+        advance_token();
+
+        if (!validate_token({TokenType::semicolon, ";"}))
+            return nullptr;
+        return std::make_unique<ExprStmnt>(std::move(expr));
+    }
+
+    std::unique_ptr<ExpressionNode> Parser::parse_channel_expr() {
+        if (current_token.value().type == TokenType::semicolon) {
+            errors.push_back("Error: a channel needs an element type and a capacity, channel(num, 16)");
+            return nullptr;
+        }
+
+        Token channel_token = current_token.value();
+        advance_token();
+        if (!validate_token({TokenType::LParen, "("}))
+            return nullptr;
+
+        advance_token();
+        std::vector type_tokens = {Token({TokenType::num_type, "num"}), Token({TokenType::fnum_type, "fnum"}),
+                                   Token({TokenType::toggle_type, "toggle"}), Token({TokenType::text_type, "text"}),
+                                   Token({TokenType::letter_type, "letter"}),
+                                   Token({TokenType::list_type, "list"})};
+        if (!validate_in_tokens(type_tokens))
+            return nullptr;
+        Token element_type = current_token.value();
+
+        advance_token();
+        if (!validate_token({TokenType::comma, ","}))
+            return nullptr;
+        advance_token();
+
+        std::unique_ptr<ExpressionNode> capacity = parse_expression(ExprOrder::lowest);
+        if (!capacity)
+            return nullptr;
+        advance_token();
+
+        if (!validate_token({TokenType::RParen, ")"}))
+            return nullptr;
+        return std::make_unique<ChannelExpr>(channel_token, element_type, std::move(capacity));
+    }
+
+    std::unique_ptr<ExpressionNode> Parser::parse_map_expr() {
+        if (current_token.value().type == TokenType::semicolon) {
+            errors.push_back("Error: a map needs a key type and a value type, map(text, num)");
+            return nullptr;
+        }
+
+        Token map_token = current_token.value();
+        advance_token();
+        if (!validate_token({TokenType::LParen, "("}))
+            return nullptr;
+
+        advance_token();
+        std::vector key_tokens = {Token({TokenType::num_type, "num"}), Token({TokenType::text_type, "text"})};
+        if (!validate_in_tokens(key_tokens))
+            return nullptr;
+        Token key_type = current_token.value();
+
+        advance_token();
+        if (!validate_token({TokenType::comma, ","}))
+            return nullptr;
+
+        advance_token();
+        std::vector value_tokens = {Token({TokenType::num_type, "num"}), Token({TokenType::fnum_type, "fnum"}),
+                                    Token({TokenType::toggle_type, "toggle"}), Token({TokenType::text_type, "text"}),
+                                    Token({TokenType::letter_type, "letter"})};
+        if (!validate_in_tokens(value_tokens))
+            return nullptr;
+        Token value_type = current_token.value();
+
+        advance_token();
+        if (!validate_token({TokenType::RParen, ")"}))
+            return nullptr;
+        return std::make_unique<MapExpr>(map_token, key_type, value_type);
+    }
+
+    std::vector<std::unique_ptr<ExpressionNode>> Parser::parse_expression_list(TokenType end) {
+        std::vector<std::unique_ptr<ExpressionNode>> items;
+        advance_token();
+        if (current_token.has_value() && current_token.value().type == end)
+            return items;
+
+        while (current_token.has_value()) {
+            std::unique_ptr<ExpressionNode> item = parse_expression(ExprOrder::lowest);
+            if (!item)
+                return {};
+            items.push_back(std::move(item));
+            advance_token();
+
+            if (!current_token.has_value() || current_token.value().type != TokenType::comma)
+                break;
+            advance_token();
+        }
+
+        Token end_token = {end, end == TokenType::RParen ? ")" : "]"};
+        if (!validate_token(end_token))
+            return {};
+        return items;
+    }
+
+    std::unique_ptr<ExpressionNode> Parser::parse_list_expr() {
+        Token list_token = {TokenType::LSquareBracket, "["};
+        if (current_token.value().type == TokenType::semicolon)
+            return std::unique_ptr<ListExpr>(new ListExpr(list_token, {}));
+
+        size_t error_count = errors.size();
+        std::vector<std::unique_ptr<ExpressionNode>> elements = parse_expression_list(TokenType::RSquareBracket);
+        if (errors.size() != error_count)
+            return nullptr;
+        return std::unique_ptr<ListExpr>(new ListExpr(list_token, std::move(elements)));
+    }
+
+    std::unique_ptr<ExpressionNode> Parser::parse_call_expr(std::unique_ptr<ExpressionNode> function) {
+        Token call_token = current_token.value();
+        if (function->token_type() != TokenType::identifier) {
+            errors.push_back("Error: only named functions can be called, found " + function->to_string());
+            return nullptr;
+        }
+
+        size_t error_count = errors.size();
+        std::vector<std::unique_ptr<ExpressionNode>> arguments = parse_expression_list(TokenType::RParen);
+        if (errors.size() != error_count)
+            return nullptr;
+        return std::unique_ptr<CallExpr>(new CallExpr(call_token, std::move(function), std::move(arguments)));
     }
 }
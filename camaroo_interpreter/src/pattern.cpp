@@ -0,0 +1,431 @@
+#include <pattern.h>
+#include <algorithm>
+#include <cctype>
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace camaroo_core {
+
+    namespace {
+        // Most NFA states one pattern compiles to, counted repeats of large groups get there fast
+        constexpr size_t nfa_limit = 1 << 16;
+        // Largest count in {n,m}
+        constexpr int count_limit = 1000;
+
+        // Compiled patterns split by hash, so threads matching different patterns don't wait on one lock
+        struct cache_shard {
+            struct entry {
+                std::shared_ptr<const camaroo_regex> regex;
+                uint64_t last_used;
+            };
+            std::mutex lock;
+            std::unordered_map<std::string, entry> patterns;
+            uint64_t clock = 0;
+        };
+        constexpr size_t shard_count = 8;
+    }
+
+    // A pattern as written, before it becomes NFA states
+    struct camaroo_regex::term {
+        enum kind_type { bytes, sequence, either, repeat } kind = sequence;
+        std::bitset<256> accepts;
+        std::vector<term> parts;
+        int least = 0;
+        // -1 for no limit
+        int most = -1;
+    };
+
+    class camaroo_regex::parser {
+    public:
+        explicit parser(std::string pattern)
+            :pattern(std::move(pattern)) {}
+
+        bool done() const { return at == pattern.size(); }
+
+        term alternatives() {
+            term first = sequence();
+            if (done() || pattern[at] != '|')
+                return first;
+            term either;
+            either.kind = term::either;
+            either.parts.push_back(std::move(first));
+            while (!done() && pattern[at] == '|') {
+                ++at;
+                either.parts.push_back(sequence());
+            }
+            return either;
+        }
+
+        [[noreturn]] void fail(const std::string& why) const {
+            throw std::runtime_error("Error: regex " + pattern + " " + why);
+        }
+    private:
+        term sequence() {
+            term all;
+            while (!done() && pattern[at] != '|' && pattern[at] != ')')
+                all.parts.push_back(repeated());
+            return all;
+        }
+
+        term repeated() {
+            term repeating = atom();
+            while (!done()) {
+                int least = 0, most = -1;
+                char c = pattern[at];
+                if (c == '*') {
+                    ++at;
+                } else if (c == '+') {
+                    ++at;
+                    least = 1;
+                } else if (c == '?') {
+                    ++at;
+                    most = 1;
+                } else if (c == '{') {
+                    ++at;
+                    least = most = number();
+                    if (!done() && pattern[at] == ',') {
+                        ++at;
+                        most = (!done() && pattern[at] == '}') ? -1 : number();
+                    }
+                    if (done() || pattern[at] != '}')
+                        fail("has an unmatched {");
+                    ++at;
+                    if (most >= 0 && most < least)
+                        fail("repeats at most fewer times than at least");
+                } else {
+                    break;
+                }
+                term wrapped;
+                wrapped.kind = term::repeat;
+                wrapped.least = least;
+                wrapped.most = most;
+                wrapped.parts.push_back(std::move(repeating));
+                repeating = std::move(wrapped);
+            }
+            return repeating;
+        }
+
+        term atom() {
+            char c = pattern[at++];
+            term single;
+            single.kind = term::bytes;
+            switch (c) {
+                case '(': {
+                    if (pattern.compare(at, 2, "?:") == 0)
+                        at += 2;
+                    term group = alternatives();
+                    if (done() || pattern[at] != ')')
+                        fail("has an unmatched (");
+                    ++at;
+                    return group;
+                }
+                case '[':
+                    single.accepts = set_class();
+                    break;
+                case '.':
+                    single.accepts.set();
+                    single.accepts.reset('\n');
+                    break;
+                case '\\':
+                    single.accepts = escape();
+                    break;
+                case '*': case '+': case '?': case '{':
+                    fail("has nothing to repeat");
+                case '^': case '$':
+                    fail("can only have ^ and $ at its ends");
+                default:
+                    single.accepts.set(static_cast<uint8_t>(c));
+            }
+            return single;
+        }
+
+        std::bitset<256> escape() {
+            if (done())
+                fail("ends with \\");
+            char c = pattern[at++];
+            std::bitset<256> set;
+            auto add = [&](auto&& belongs) {
+                for (int byte = 0; byte < 128; ++byte)
+                    if (belongs(byte))
+                        set.set(byte);
+            };
+            switch (c) {
+                case 'd': case 'D':
+                    add([](int byte) { return byte >= '0' && byte <= '9'; });
+                    break;
+                case 'w': case 'W':
+                    add([](int byte) { return std::isalnum(byte) || byte == '_'; });
+                    break;
+                case 's': case 'S':
+                    add([](int byte) { return byte == ' ' || (byte >= '\t' && byte <= '\r'); });
+                    break;
+                case 'n':
+                    set.set('\n');
+                    break;
+                case 't':
+                    set.set('\t');
+                    break;
+                case 'r':
+                    set.set('\r');
+                    break;
+                default:
+                    set.set(static_cast<uint8_t>(c));
+            }
+            if (c == 'D' || c == 'W' || c == 'S')
+                set.flip();
+            return set;
+        }
+
+        std::bitset<256> set_class() {
+            std::bitset<256> set;
+            bool negated = !done() && pattern[at] == '^';
+            if (negated)
+                ++at;
+            bool first = true;
+            while (!done() && (pattern[at] != ']' || first)) {
+                first = false;
+                if (pattern[at] == '\\') {
+                    ++at;
+                    set |= escape();
+                    continue;
+                }
+                uint8_t low = static_cast<uint8_t>(pattern[at++]);
+                uint8_t high = low;
+                if (at + 1 < pattern.size() && pattern[at] == '-' && pattern[at + 1] != ']') {
+                    high = static_cast<uint8_t>(pattern[at + 1]);
+                    at += 2;
+                    if (high < low)
+                        fail("has a backwards range");
+                }
+                for (int byte = low; byte <= high; ++byte)
+                    set.set(byte);
+            }
+            if (done())
+                fail("has an unmatched [");
+            ++at;
+            return negated ? ~set : set;
+        }
+
+        int number() {
+            size_t begin = at;
+            int value = 0;
+            while (!done() && pattern[at] >= '0' && pattern[at] <= '9') {
+                value = value * 10 + (pattern[at++] - '0');
+                if (value > count_limit)
+                    fail("repeats more than " + std::to_string(count_limit) + " times");
+            }
+            if (at == begin)
+                fail("has a { without a count");
+            return value;
+        }
+    private:
+        std::string pattern;
+        size_t at = 0;
+    };
+
+    std::shared_ptr<const camaroo_regex> camaroo_regex::compile(const std::string& pattern) {
+        static cache_shard shards[shard_count];
+        cache_shard& shard = shards[std::hash<std::string>()(pattern) % shard_count];
+        {
+            std::lock_guard<std::mutex> guard(shard.lock);
+            auto found = shard.patterns.find(pattern);
+            if (found != shard.patterns.end()) {
+                found->second.last_used = ++shard.clock;
+                return found->second.regex;
+            }
+        }
+
+        // Compiled outside the lock so one big pattern doesn't hold up the others, patterns that don't compile aren't kept
+        auto regex = std::make_shared<const camaroo_regex>(pattern);
+        std::lock_guard<std::mutex> guard(shard.lock);
+        if (shard.patterns.size() >= cache_limit / shard_count && shard.patterns.find(pattern) == shard.patterns.end()) {
+            auto oldest = shard.patterns.begin();
+            for (auto it = shard.patterns.begin(); it != shard.patterns.end(); ++it) {
+                if (it->second.last_used < oldest->second.last_used)
+                    oldest = it;
+            }
+            shard.patterns.erase(oldest);
+        }
+        shard.patterns[pattern] = {regex, ++shard.clock};
+        return regex;
+    }
+
+    camaroo_regex::camaroo_regex(const std::string& pattern) {
+        std::string_view body(pattern);
+        anchored_start = body.starts_with('^');
+        if (anchored_start)
+            body.remove_prefix(1);
+        if (body.ends_with('$')) {
+            // \$ is a dollar sign, \\$ a backslash at the end
+            size_t escapes = 0;
+            while (escapes + 1 < body.size() && body[body.size() - 2 - escapes] == '\\')
+                ++escapes;
+            anchored_end = escapes % 2 == 0;
+            if (anchored_end)
+                body.remove_suffix(1);
+        }
+
+        parser reading{std::string(body)};
+        term whole = reading.alternatives();
+        if (!reading.done())
+            reading.fail("has an unmatched )");
+        match_state = add_state(nfa_state{});
+        start = closure({emit(whole, match_state)});
+    }
+
+    int camaroo_regex::add_state(nfa_state state) {
+        if (nfa.size() >= nfa_limit)
+            throw std::runtime_error("Error: regex pattern is too big");
+        nfa.push_back(state);
+        return static_cast<int>(nfa.size() - 1);
+    }
+
+    // Builds from the end of the pattern back, so every state's next one already exists
+    int camaroo_regex::emit(const term& node, int next) {
+        nfa_state state;
+        switch (node.kind) {
+            case term::bytes:
+                state.kind = nfa_state::bytes;
+                state.accepts = node.accepts;
+                state.out = next;
+                return add_state(state);
+            case term::sequence:
+                for (auto part = node.parts.rbegin(); part != node.parts.rend(); ++part)
+                    next = emit(*part, next);
+                return next;
+            case term::either: {
+                int entry = emit(node.parts.back(), next);
+                for (size_t i = node.parts.size() - 1; i-- > 0;) {
+                    state.kind = nfa_state::split;
+                    state.out = emit(node.parts[i], next);
+                    state.out1 = entry;
+                    entry = add_state(state);
+                }
+                return entry;
+            }
+            case term::repeat: {
+                const term& body = node.parts.front();
+                int rest = next;
+                if (node.most < 0) {
+                    state.kind = nfa_state::split;
+                    int loop = add_state(state);
+                    int entry = emit(body, loop);
+                    nfa[loop].out = entry;
+                    nfa[loop].out1 = next;
+                    rest = loop;
+                } else {
+                    // x{1,3} is x(x(x)?)?, the optional copies each skip straight to next
+                    for (int i = node.least; i < node.most; ++i) {
+                        state.kind = nfa_state::split;
+                        state.out = emit(body, rest);
+                        state.out1 = next;
+                        rest = add_state(state);
+                    }
+                }
+                for (int i = 0; i < node.least; ++i)
+                    rest = emit(body, rest);
+                return rest;
+            }
+        }
+        return next;
+    }
+
+    std::vector<int> camaroo_regex::closure(std::vector<int> pending) const {
+        std::vector<bool> seen(nfa.size(), false);
+        std::vector<int> reached;
+        while (!pending.empty()) {
+            int current = pending.back();
+            pending.pop_back();
+            if (current < 0 || seen[current])
+                continue;
+            seen[current] = true;
+            if (nfa[current].kind == nfa_state::split) {
+                pending.push_back(nfa[current].out1);
+                pending.push_back(nfa[current].out);
+            } else {
+                reached.push_back(current);
+            }
+        }
+        std::sort(reached.begin(), reached.end());
+        return reached;
+    }
+
+    std::vector<int> camaroo_regex::step(const std::vector<int>& from, uint8_t byte) const {
+        std::vector<int> targets;
+        for (int state : from)
+            if (nfa[state].kind == nfa_state::bytes && nfa[state].accepts.test(byte))
+                targets.push_back(nfa[state].out);
+        // Unanchored patterns can start matching at any byte
+        if (!anchored_start)
+            targets.insert(targets.end(), start.begin(), start.end());
+        return closure(std::move(targets));
+    }
+
+    bool camaroo_regex::matches(const std::vector<int>& set) const {
+        return std::binary_search(set.begin(), set.end(), match_state);
+    }
+
+    bool camaroo_regex::simulate(std::string_view text) const {
+        return simulate(start, text);
+    }
+
+    bool camaroo_regex::simulate(std::vector<int> set, std::string_view text) const {
+        for (char c : text) {
+            if (!anchored_end && matches(set))
+                return true;
+            if (set.empty())
+                return false;
+            set = step(set, static_cast<uint8_t>(c));
+        }
+        return matches(set);
+    }
+
+    int camaroo_regex::dfa_state_for(std::vector<int> set) const {
+        auto found = dfa_ids.find(set);
+        if (found != dfa_ids.end())
+            return found->second;
+        dfa_state state;
+        state.matched = matches(set);
+        state.next.fill(-1);
+        state.nfa = set;
+        dfa.push_back(std::move(state));
+        int id = static_cast<int>(dfa.size() - 1);
+        dfa_ids.emplace(std::move(set), id);
+        return id;
+    }
+
+    bool camaroo_regex::search(std::string_view text) const {
+        std::unique_lock<std::mutex> lock(building, std::try_to_lock);
+        if (!lock.owns_lock())
+            return simulate(start, text);
+
+        int current = dfa_state_for(start);
+        size_t resets = 0;
+        for (size_t i = 0; i < text.size(); ++i) {
+            if (!anchored_end && dfa[current].matched)
+                return true;
+            if (dfa[current].nfa.empty())
+                return false;
+            uint8_t byte = static_cast<uint8_t>(text[i]);
+            int next = dfa[current].next[byte];
+            if (next < 0) {
+                std::vector<int> set = step(dfa[current].nfa, byte);
+                if (dfa.size() >= state_limit) {
+                    // Text that keeps reaching new states would spend its time building the DFA
+                    if (++resets > reset_limit)
+                        return simulate(std::move(set), text.substr(i + 1));
+                    dfa.clear();
+                    dfa_ids.clear();
+                    next = dfa_state_for(std::move(set));
+                } else {
+                    next = dfa_state_for(std::move(set));
+                    dfa[current].next[byte] = next;
+                }
+            }
+            current = next;
+        }
+        return dfa[current].matched;
+    }
+}
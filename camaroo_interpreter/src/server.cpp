@@ -0,0 +1,430 @@
+#include <server.h>
+#include <hash.h>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <climits>
+#include <cstdlib>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace camaroo_core {
+
+    namespace {
+        // Whether every file the script was linked from still has the text it was compiled from
+        bool sources_unchanged(const Script& script) {
+            for (const auto& source : script.get_sources()) {
+                std::ifstream file(source.path, std::ios::binary);
+                if (!file)
+                    return false;
+                std::string text(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>{});
+                if (content_hash(text) != source.hash)
+                    return false;
+            }
+            return true;
+        }
+
+        // Paths hash from a different start than sources so the two never share a key by design
+        uint64_t path_key(const std::string& path) {
+            return content_hash(path, content_hash("path "));
+        }
+    }
+
+    std::shared_ptr<const Script> script_cache::find(uint64_t key, const std::string& origin, bool from_file) {
+        std::shared_ptr<const Script> script;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            auto it = scripts.find(key);
+            if (it == scripts.end() || it->second.from_file != from_file || it->second.origin != origin)
+                return nullptr;
+            it->second.last_used = ++clock;
+            script = it->second.script;
+        }
+        // Files are read outside the lock, a stale script is replaced by the caller
+        return sources_unchanged(*script) ? script : nullptr;
+    }
+
+    void script_cache::insert(uint64_t key, entry added) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (scripts.size() >= capacity && scripts.find(key) == scripts.end()) {
+            auto oldest = scripts.begin();
+            for (auto it = scripts.begin(); it != scripts.end(); ++it) {
+                if (it->second.last_used < oldest->second.last_used)
+                    oldest = it;
+            }
+            scripts.erase(oldest);
+        }
+        added.last_used = ++clock;
+        scripts[key] = std::move(added);
+    }
+
+    std::shared_ptr<const Script> script_cache::get(const std::string& source) {
+        uint64_t key = content_hash(source);
+        if (std::shared_ptr<const Script> script = find(key, source, false))
+            return script;
+
+        // Compiled outside the lock so one big script doesn't hold up every other request
+        std::shared_ptr<const Script> script = engine.compile(source);
+        insert(key, entry{source, false, script, 0});
+        return script;
+    }
+
+    std::shared_ptr<const Script> script_cache::get_file(const std::string& path) {
+        uint64_t key = path_key(path);
+        if (std::shared_ptr<const Script> script = find(key, path, true))
+            return script;
+
+        std::shared_ptr<const Script> script = engine.compile_file(path);
+        insert(key, entry{path, true, script, 0});
+        return script;
+    }
+
+    size_t script_cache::size() {
+        std::lock_guard<std::mutex> guard(lock);
+        return scripts.size();
+    }
+
+#ifndef _WIN32
+
+    namespace {
+
+        std::atomic<bool> stop_requested{false};
+        // Write end of a pipe the accept loop polls next to the listener, so a stop that comes in on any thread and
+        // at any point wakes it up
+        int stop_pipe = -1;
+
+        void request_stop(int) {
+            stop_requested = true;
+            char wake = 1;
+            if (::write(stop_pipe, &wake, 1) < 0) {
+                // Full, the loop is woken up already
+            }
+        }
+
+        using deadline_clock = std::chrono::steady_clock;
+
+        // Whether fd has something to read before deadline
+        bool readable_by(int fd, deadline_clock::time_point deadline) {
+            while (true) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - deadline_clock::now()).count();
+                if (left <= 0)
+                    return false;
+                pollfd waiting{fd, POLLIN, 0};
+                int ready = ::poll(&waiting, 1, static_cast<int>(std::min<long long>(left, INT_MAX)));
+                if (ready > 0)
+                    return true;
+                if (ready == 0 || errno != EINTR)
+                    return false;
+            }
+        }
+
+        bool write_all(int fd, const char* data, size_t length) {
+            while (length > 0) {
+                ssize_t written = ::send(fd, data, length, MSG_NOSIGNAL);
+                if (written < 0 && errno == EINTR)
+                    continue;
+                if (written <= 0)
+                    return false;
+                data += written;
+                length -= static_cast<size_t>(written);
+            }
+            return true;
+        }
+
+        // Without a deadline it waits for as long as it takes, the client waits on scripts that run for a long time
+        bool read_all(int fd, char* data, size_t length, std::optional<deadline_clock::time_point> deadline = std::nullopt) {
+            while (length > 0) {
+                if (deadline && !readable_by(fd, *deadline))
+                    return false;
+                ssize_t got = ::recv(fd, data, length, 0);
+                if (got < 0 && errno == EINTR)
+                    continue;
+                if (got <= 0)
+                    return false;
+                data += got;
+                length -= static_cast<size_t>(got);
+            }
+            return true;
+        }
+
+        bool read_line(int fd, std::string& line, std::optional<deadline_clock::time_point> deadline = std::nullopt) {
+            line.clear();
+            char c;
+            while (line.size() < protocol::max_header) {
+                if (!read_all(fd, &c, 1, deadline))
+                    return false;
+                if (c == '\n')
+                    return true;
+                line += c;
+            }
+            return false;
+        }
+
+        bool send_frame(int fd, char kind, const std::string& payload) {
+            std::string header = kind + std::to_string(payload.size()) + '\n';
+            return write_all(fd, header.data(), header.size()) && write_all(fd, payload.data(), payload.size());
+        }
+
+        // Turns every write into a frame on the connection, output_stream already writes whole statements at once.
+        // Once the client is gone the rest of the output is dropped and the script still runs to the end.
+        class frame_buffer : public std::streambuf {
+        public:
+            frame_buffer(int fd, char kind)
+                :fd(fd), kind(kind) {}
+        protected:
+            std::streamsize xsputn(const char* text, std::streamsize length) override {
+                if (connected)
+                    connected = send_frame(fd, kind, std::string(text, static_cast<size_t>(length)));
+                return length;
+            }
+
+            int_type overflow(int_type c) override {
+                if (!traits_type::eq_int_type(c, traits_type::eof())) {
+                    char value = traits_type::to_char_type(c);
+                    xsputn(&value, 1);
+                }
+                return traits_type::not_eof(c);
+            }
+        private:
+            int fd;
+            char kind;
+            bool connected = true;
+        };
+
+        sockaddr_un socket_address(const std::string& path) {
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            if (path.size() >= sizeof(address.sun_path))
+                throw std::runtime_error("Error: socket path is too long, " + path);
+            path.copy(address.sun_path, path.size());
+            return address;
+        }
+
+        void handle_connection(int fd, const Engine& engine, script_cache& cache, std::chrono::milliseconds timeout) {
+            frame_buffer out_buffer(fd, 'o');
+            frame_buffer err_buffer(fd, 'e');
+            std::ostream out(&out_buffer);
+            std::ostream err(&err_buffer);
+
+            // A client that is slow to send its request is dropped, so idle connections can't hold on to every worker
+            deadline_clock::time_point deadline = deadline_clock::now() + timeout;
+            int exit_code = 0;
+            try {
+                std::string header;
+                if (!read_line(fd, header, deadline))
+                    return;
+
+                std::shared_ptr<const Script> script;
+                if (header.rfind("path ", 0) == 0) {
+                    script = cache.get_file(header.substr(5));
+                }
+                else if (header.rfind("source ", 0) == 0) {
+                    std::string_view count(header);
+                    count.remove_prefix(7);
+                    size_t length = 0;
+                    auto [parsed, failure] = std::from_chars(count.data(), count.data() + count.size(), length);
+                    if (failure != std::errc() || parsed != count.data() + count.size())
+                        throw std::runtime_error("Error: bad source length, " + header);
+                    if (length > protocol::max_source)
+                        throw std::runtime_error("Error: source is longer than the server takes, " + std::to_string(length) + " bytes");
+                    std::string source(length, '\0');
+                    if (!read_all(fd, source.data(), source.size(), deadline))
+                        return;
+                    script = cache.get(source);
+                }
+                else {
+                    throw std::runtime_error("Error: unknown request, " + header);
+                }
+
+                Context context(engine, out, err);
+                if (!engine.run(*script, context))
+                    exit_code = -1;
+            }
+            catch (const std::exception& e) {
+                err << e.what() << '\n';
+                exit_code = -1;
+            }
+            std::string end = 'x' + std::to_string(exit_code) + '\n';
+            write_all(fd, end.data(), end.size());
+        }
+    }
+
+    int serve(const std::string& socket_path, const Engine& engine, size_t worker_count, std::chrono::milliseconds timeout) {
+        sockaddr_un address = socket_address(socket_path);
+
+        // A socket file nobody answers on is left over from a server that died, anything else is a live server
+        int probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (probe >= 0 && ::connect(probe, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0) {
+            ::close(probe);
+            std::cerr << "Error: a server is already listening on " << socket_path << '\n';
+            return -1;
+        }
+        if (probe >= 0)
+            ::close(probe);
+        ::unlink(socket_path.c_str());
+
+        // Non-blocking, a connection that goes away between poll() and accept() can't leave the loop stuck
+        int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        int wake_pipe[2];
+        if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            ::listen(listener, SOMAXCONN) != 0 || ::fcntl(listener, F_SETFL, O_NONBLOCK) != 0 || ::pipe(wake_pipe) != 0) {
+            std::cerr << "Error: couldn't listen on " << socket_path << '\n';
+            if (listener >= 0)
+                ::close(listener);
+            return -1;
+        }
+        ::fcntl(wake_pipe[1], F_SETFL, O_NONBLOCK);
+        stop_pipe = wake_pipe[1];
+        stop_requested = false;
+
+        struct sigaction action{};
+        action.sa_handler = request_stop;
+        sigemptyset(&action.sa_mask);
+        ::sigaction(SIGINT, &action, nullptr);
+        ::sigaction(SIGTERM, &action, nullptr);
+
+        script_cache cache(engine, 256);
+        std::mutex queue_lock;
+        std::condition_variable queue_ready;
+        std::deque<int> connections;
+        bool closing = false;
+
+        // Workers start with the stop signals blocked and keep them that way, so they always land on the accept loop
+        sigset_t stop_signals, accept_mask;
+        sigemptyset(&stop_signals);
+        sigaddset(&stop_signals, SIGINT);
+        sigaddset(&stop_signals, SIGTERM);
+        ::pthread_sigmask(SIG_BLOCK, &stop_signals, &accept_mask);
+
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < std::max<size_t>(worker_count, 1); ++i) {
+            workers.emplace_back([&]() {
+                while (true) {
+                    int fd;
+                    {
+                        std::unique_lock<std::mutex> guard(queue_lock);
+                        queue_ready.wait(guard, [&]() { return closing || !connections.empty(); });
+                        if (connections.empty())
+                            return;
+                        fd = connections.front();
+                        connections.pop_front();
+                    }
+                    handle_connection(fd, engine, cache, timeout);
+                    ::close(fd);
+                }
+            });
+        }
+        ::pthread_sigmask(SIG_SETMASK, &accept_mask, nullptr);
+
+        while (!stop_requested.load()) {
+            pollfd waiting[2] = {{listener, POLLIN, 0}, {wake_pipe[0], POLLIN, 0}};
+            if (::poll(waiting, 2, -1) <= 0 || !(waiting[0].revents & POLLIN))
+                continue;
+            int fd = ::accept(listener, nullptr, nullptr);
+            if (fd < 0)
+                continue;
+            // Some platforms hand the listener's O_NONBLOCK down, answers are written blocking but only for so long
+            ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+            timeval send_limit{static_cast<time_t>(timeout.count() / 1000), static_cast<suseconds_t>(timeout.count() % 1000 * 1000)};
+            ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &send_limit, sizeof(send_limit));
+            {
+                std::lock_guard<std::mutex> guard(queue_lock);
+                connections.push_back(fd);
+            }
+            queue_ready.notify_one();
+        }
+
+        // Requests that were already accepted still get their answer
+        {
+            std::lock_guard<std::mutex> guard(queue_lock);
+            closing = true;
+        }
+        queue_ready.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+        ::close(listener);
+        stop_pipe = -1;
+        ::close(wake_pipe[0]);
+        ::close(wake_pipe[1]);
+        ::unlink(socket_path.c_str());
+        return 0;
+    }
+
+    int connect_and_run(const std::string& socket_path, const std::string& script_path) {
+        std::string request;
+        if (script_path == "-") {
+            std::string source(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>{});
+            request = "source " + std::to_string(source.size()) + '\n' + source;
+        }
+        else {
+            // The server has its own working directory, so it gets the absolute path
+            char resolved[PATH_MAX];
+            if (!::realpath(script_path.c_str(), resolved)) {
+                std::cerr << "Error: couldn't open " << script_path << '\n';
+                return -1;
+            }
+            request = std::string("path ") + resolved + '\n';
+        }
+
+        sockaddr_un address = socket_address(socket_path);
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            std::cerr << "Error: no server is listening on " << socket_path << '\n';
+            if (fd >= 0)
+                ::close(fd);
+            return -1;
+        }
+
+        int exit_code = -1;
+        std::string header;
+        if (write_all(fd, request.data(), request.size())) {
+            std::string payload;
+            while (read_line(fd, header) && !header.empty()) {
+                if (header[0] == 'x') {
+                    exit_code = std::atoi(header.c_str() + 1);
+                    break;
+                }
+                payload.resize(std::strtoul(header.c_str() + 1, nullptr, 10));
+                if (!read_all(fd, payload.data(), payload.size()))
+                    break;
+                std::ostream& target = (header[0] == 'e') ? std::cerr : std::cout;
+                target.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+                target.flush();
+            }
+        }
+        ::close(fd);
+        return exit_code;
+    }
+
+#else
+
+    int serve(const std::string&, const Engine&, size_t, std::chrono::milliseconds) {
+        std::cerr << "Error: --serve needs Unix domain sockets, which this platform doesn't have\n";
+        return -1;
+    }
+
+    int connect_and_run(const std::string&, const std::string&) {
+        std::cerr << "Error: --connect needs Unix domain sockets, which this platform doesn't have\n";
+        return -1;
+    }
+
+#endif
+}
@@ -0,0 +1,179 @@
+#include <sharing.h>
+#include <optimize.h>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace camaroo_core {
+
+    namespace {
+
+        class sharer {
+        public:
+            size_t run(const std::vector<std::unique_ptr<StatementNode>>& statements);
+        private:
+            struct info {
+                uint32_t id;
+                uint32_t size;  // nodes in the subtree, so walks can step over it
+                bool shareable; // pure and more than a name or a literal
+            };
+
+            bool number(ExpressionNode* node);
+            void count(ExpressionNode* node, size_t& at, uint64_t root);
+            void replace(std::unique_ptr<ExpressionNode>& slot, size_t& at, uint64_t root);
+
+            // Every expression in the order the walks below visit them. Structurally equal expressions get the same id,
+            // anything impure gets one of its own
+            std::vector<info> nodes;
+            std::unordered_map<std::string, uint32_t> interned;
+            uint32_t next_id = 0;
+
+            std::vector<uint32_t> uses;
+            std::vector<uint64_t> last_root;
+            // Id and root pairs, the id in the high half, where an expression repeats inside one root
+            std::unordered_set<uint64_t> repeated_in_root;
+            std::vector<std::shared_ptr<ExpressionNode>> canonical;
+            size_t removed = 0;
+        };
+
+        // Returns whether node is pure
+        bool sharer::number(ExpressionNode* node) {
+            size_t at = nodes.size();
+            nodes.emplace_back();
+
+            // Kind, token type and then the literal or the ids of the children, short enough for the small string
+            // buffer in the common case
+            std::string key(1, static_cast<char>(node->node_kind()));
+            uint32_t type = static_cast<uint32_t>(node->token_type());
+            key.append(reinterpret_cast<const char*>(&type), sizeof(type));
+
+            bool pure = true;
+            bool compound = false;
+            switch (node->node_kind()) {
+                case NodeKind::identifier:
+                case NodeKind::text:
+                case NodeKind::letter:
+                    key += std::get<std::string>(node->token_value());
+                    break;
+                case NodeKind::toggle:
+                case NodeKind::num:
+                case NodeKind::fnum:
+                    key += node->to_string();
+                    break;
+                case NodeKind::prefix:
+                case NodeKind::infix:
+                case NodeKind::list:
+                    compound = true;
+                    break;
+                case NodeKind::format:
+                    compound = true;
+                    key += std::get<std::string>(node->token_value());
+                    break;
+                case NodeKind::arith_chain:
+                    compound = true;
+                    for (const ArithStep& step : static_cast<ArithChainExpr*>(node)->get_steps()) {
+                        uint32_t op = static_cast<uint32_t>(step.op.type);
+                        key.append(reinterpret_cast<const char*>(&op), sizeof(op));
+                        key.append(reinterpret_cast<const char*>(&step.value), sizeof(step.value));
+                        key += step.constant_left ? '<' : '>';
+                    }
+                    break;
+                default:
+                    // Calls and channels do something every time, shared copies are left alone
+                    pure = false;
+                    break;
+            }
+
+            node->visit_expressions([&](std::unique_ptr<ExpressionNode>& child) {
+                uint32_t id = UINT32_MAX;
+                if (child) {
+                    size_t child_at = nodes.size();
+                    pure = number(child.get()) && pure;
+                    id = nodes[child_at].id;
+                }
+                key.append(reinterpret_cast<const char*>(&id), sizeof(id));
+            });
+
+            info& result = nodes[at];
+            result.size = static_cast<uint32_t>(nodes.size() - at);
+            if (!pure) {
+                result.id = next_id++;
+                return false;
+            }
+            auto [it, inserted] = interned.try_emplace(std::move(key), next_id);
+            if (inserted)
+                ++next_id;
+            result.id = it->second;
+            result.shareable = compound;
+            return true;
+        }
+
+        void sharer::count(ExpressionNode* node, size_t& at, uint64_t root) {
+            const info found = nodes[at];
+            if (found.shareable) {
+                if (last_root[found.id] == root)
+                    repeated_in_root.insert((static_cast<uint64_t>(found.id) << 32) | root);
+                last_root[found.id] = root;
+                // Only the first copy is looked into, the others go away with everything under them
+                if (++uses[found.id] > 1) {
+                    at += found.size;
+                    return;
+                }
+            }
+            ++at;
+            node->visit_expressions([&](std::unique_ptr<ExpressionNode>& child) {
+                if (child)
+                    count(child.get(), at, root);
+            });
+        }
+
+        void sharer::replace(std::unique_ptr<ExpressionNode>& slot, size_t& at, uint64_t root) {
+            const info found = nodes[at];
+            ExpressionNode* node = slot.get();
+            if (found.shareable && uses[found.id] > 1) {
+                bool memoize = repeated_in_root.count((static_cast<uint64_t>(found.id) << 32) | root) != 0;
+                std::shared_ptr<ExpressionNode>& copy = canonical[found.id];
+                if (copy) {
+                    removed += found.size - 1;
+                    at += found.size;
+                    slot = std::make_unique<SharedExpr>(copy, memoize);
+                    return;
+                }
+                copy = std::shared_ptr<ExpressionNode>(slot.release());
+                slot = std::make_unique<SharedExpr>(copy, memoize);
+                // The kept copy costs one node more, the wrapper in front of it
+                --removed;
+            }
+            ++at;
+            node->visit_expressions([&](std::unique_ptr<ExpressionNode>& child) {
+                if (child)
+                    replace(child, at, root);
+            });
+        }
+
+        size_t sharer::run(const std::vector<std::unique_ptr<StatementNode>>& statements) {
+            for (const auto& statement : statements)
+                visit_expression_roots(statement.get(), [&](std::unique_ptr<ExpressionNode>& slot) { number(slot.get()); });
+            uses.assign(next_id, 0);
+            last_root.assign(next_id, UINT64_MAX);
+            canonical.resize(next_id);
+
+            // Counting and replacing walk the roots in the order they were numbered in, so the first copy counted
+            // is the one kept
+            size_t at = 0;
+            uint64_t root = 0;
+            for (const auto& statement : statements)
+                visit_expression_roots(statement.get(), [&](std::unique_ptr<ExpressionNode>& slot) { count(slot.get(), at, root++); });
+            at = 0;
+            root = 0;
+            for (const auto& statement : statements)
+                visit_expression_roots(statement.get(), [&](std::unique_ptr<ExpressionNode>& slot) { replace(slot, at, root++); });
+            return removed;
+        }
+    }
+
+    size_t share_subtrees(const std::vector<std::unique_ptr<StatementNode>>& statements) {
+        return sharer().run(statements);
+    }
+}
@@ -0,0 +1,803 @@
+#include <simd.h>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #define CAMAROO_X86 1
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #endif
+#else
+    #define CAMAROO_X86 0
+#endif
+
+// GCC and Clang only emit AVX2 instructions inside functions that ask for them,
+// MSVC accepts the intrinsics anywhere.
+#if CAMAROO_X86 && (defined(__GNUC__) || defined(__clang__))
+    #define CAMAROO_AVX2 __attribute__((target("avx2")))
+#else
+    #define CAMAROO_AVX2
+#endif
+
+namespace camaroo_core::simd {
+
+    namespace {
+
+        enum class kernel_level { scalar, sse2, avx2 };
+
+        kernel_level detect_level() {
+#if CAMAROO_X86
+    #if defined(_MSC_VER)
+            int info[4];
+            __cpuid(info, 1);
+            bool os_saves_ymm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 0x6) == 0x6);
+            if (os_saves_ymm) {
+                __cpuidex(info, 7, 0);
+                if (info[1] & (1 << 5))
+                    return kernel_level::avx2;
+            }
+    #else
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2"))
+                return kernel_level::avx2;
+    #endif
+            return kernel_level::sse2;
+#else
+            return kernel_level::scalar;
+#endif
+        }
+
+        kernel_level level() {
+            static const kernel_level detected = detect_level();
+            return detected;
+        }
+
+        // Integer arithmetic goes through uint64_t so overflow wraps instead of being undefined
+        inline int64_t wrap_add(int64_t a, int64_t b) { return static_cast<int64_t>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b)); }
+        inline int64_t wrap_sub(int64_t a, int64_t b) { return static_cast<int64_t>(static_cast<uint64_t>(a) - static_cast<uint64_t>(b)); }
+        inline int64_t wrap_mul(int64_t a, int64_t b) { return static_cast<int64_t>(static_cast<uint64_t>(a) * static_cast<uint64_t>(b)); }
+        inline int64_t wrap_div(int64_t a, int64_t b) { return (b == -1) ? wrap_sub(0, a) : a / b; }
+        inline int64_t wrap_mod(int64_t a, int64_t b) { return (b == -1) ? 0 : a % b; }
+
+        template <typename T>
+        T scalar_arith(arith_op op, T a, T b) {
+            if constexpr (std::is_same_v<T, int64_t>) {
+                switch (op) {
+                    case arith_op::add: return wrap_add(a, b);
+                    case arith_op::subtract: return wrap_sub(a, b);
+                    case arith_op::multiply: return wrap_mul(a, b);
+                    case arith_op::divide: return wrap_div(a, b);
+                    case arith_op::modulo: return wrap_mod(a, b);
+                }
+            } else {
+                switch (op) {
+                    case arith_op::add: return a + b;
+                    case arith_op::subtract: return a - b;
+                    case arith_op::multiply: return a * b;
+                    case arith_op::divide: return a / b;
+                    case arith_op::modulo: return std::fmod(a, b);
+                }
+            }
+            return T();
+        }
+
+        template <typename T>
+        bool scalar_compare(compare_op op, T a, T b) {
+            switch (op) {
+                case compare_op::equal: return a == b;
+                case compare_op::not_equal: return a != b;
+                case compare_op::less: return a < b;
+                case compare_op::less_equal: return a <= b;
+                case compare_op::greater: return a > b;
+                case compare_op::greater_equal: return a >= b;
+            }
+            return false;
+        }
+
+        // Operand sources let one kernel body serve both list-list and list-scalar forms
+        template <typename T>
+        struct array_src {
+            const T* data;
+            T get(size_t i) const { return data[i]; }
+        };
+
+        template <typename T>
+        struct scalar_src {
+            T value;
+            T get(size_t) const { return value; }
+        };
+
+        template <typename T, typename A, typename B>
+        void binary_scalar(arith_op op, A a, B b, T* out, size_t from, size_t n) {
+            for (size_t i = from; i < n; ++i)
+                out[i] = scalar_arith<T>(op, a.get(i), b.get(i));
+        }
+
+        template <typename T, typename A, typename B>
+        void compare_scalar_loop(compare_op op, A a, B b, uint8_t* mask, size_t from, size_t n) {
+            for (size_t i = from; i < n; ++i)
+                mask[i] = scalar_compare<T>(op, a.get(i), b.get(i)) ? 1 : 0;
+        }
+
+        size_t find_scalar(const char* haystack, size_t n, const char* needle, size_t m, size_t from) {
+            size_t found = std::string_view(haystack, n).find(std::string_view(needle, m), from);
+            return (found == std::string_view::npos) ? n : found;
+        }
+
+#if CAMAROO_X86
+        // --- sse2, always present on x86-64 ---
+
+        inline __m128i load2(array_src<int64_t> s, size_t i) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(s.data + i)); }
+        inline __m128i load2(scalar_src<int64_t> s, size_t) { return _mm_set1_epi64x(s.value); }
+        inline __m128d load2(array_src<double> s, size_t i) { return _mm_loadu_pd(s.data + i); }
+        inline __m128d load2(scalar_src<double> s, size_t) { return _mm_set1_pd(s.value); }
+        inline __m128i load16(array_src<uint8_t> s, size_t i) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(s.data + i)); }
+        inline __m128i load16(scalar_src<uint8_t> s, size_t) { return _mm_set1_epi8(static_cast<char>(s.value)); }
+
+        inline __m128i mul_epi64_sse2(__m128i a, __m128i b) {
+            __m128i lo = _mm_mul_epu32(a, b);
+            __m128i cross = _mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(a, 32), b), _mm_mul_epu32(a, _mm_srli_epi64(b, 32)));
+            return _mm_add_epi64(lo, _mm_slli_epi64(cross, 32));
+        }
+
+        template <typename A, typename B>
+        void arith_i64_sse2(arith_op op, A a, B b, int64_t* out, size_t n) {
+            size_t i = 0;
+            if (op != arith_op::divide && op != arith_op::modulo) {
+                for (; i + 2 <= n; i += 2) {
+                    __m128i va = load2(a, i), vb = load2(b, i), r;
+                    if (op == arith_op::add) r = _mm_add_epi64(va, vb);
+                    else if (op == arith_op::subtract) r = _mm_sub_epi64(va, vb);
+                    else r = mul_epi64_sse2(va, vb);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), r);
+                }
+            }
+            binary_scalar<int64_t>(op, a, b, out, i, n);
+        }
+
+        template <typename A, typename B>
+        void arith_f64_sse2(arith_op op, A a, B b, double* out, size_t n) {
+            size_t i = 0;
+            // fmod has no vector instruction, modulo stays scalar
+            for (; op != arith_op::modulo && i + 2 <= n; i += 2) {
+                __m128d va = load2(a, i), vb = load2(b, i), r;
+                switch (op) {
+                    case arith_op::add: r = _mm_add_pd(va, vb); break;
+                    case arith_op::subtract: r = _mm_sub_pd(va, vb); break;
+                    case arith_op::multiply: r = _mm_mul_pd(va, vb); break;
+                    default: r = _mm_div_pd(va, vb); break;
+                }
+                _mm_storeu_pd(out + i, r);
+            }
+            binary_scalar<double>(op, a, b, out, i, n);
+        }
+
+        template <typename A, typename B>
+        void compare_f64_sse2(compare_op op, A a, B b, uint8_t* mask, size_t n) {
+            size_t i = 0;
+            for (; i + 2 <= n; i += 2) {
+                __m128d va = load2(a, i), vb = load2(b, i), r;
+                switch (op) {
+                    case compare_op::equal: r = _mm_cmpeq_pd(va, vb); break;
+                    case compare_op::not_equal: r = _mm_cmpneq_pd(va, vb); break;
+                    case compare_op::less: r = _mm_cmplt_pd(va, vb); break;
+                    case compare_op::less_equal: r = _mm_cmple_pd(va, vb); break;
+                    case compare_op::greater: r = _mm_cmpgt_pd(va, vb); break;
+                    default: r = _mm_cmpge_pd(va, vb); break;
+                }
+                int bits = _mm_movemask_pd(r);
+                mask[i] = bits & 1;
+                mask[i + 1] = (bits >> 1) & 1;
+            }
+            compare_scalar_loop<double>(op, a, b, mask, i, n);
+        }
+
+        // Sixteen bytes at a time, the lanes come out as 0 or 1 already so they're stored as they are. sse2 has
+        // no unsigned byte compare but a <= b exactly when min(a, b) == a
+        template <typename A, typename B>
+        void compare_u8_sse2(compare_op op, A a, B b, uint8_t* mask, size_t n) {
+            const __m128i ones = _mm_set1_epi8(1);
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16) {
+                __m128i va = load16(a, i), vb = load16(b, i), r;
+                bool negate = false;
+                switch (op) {
+                    case compare_op::equal: r = _mm_cmpeq_epi8(va, vb); break;
+                    case compare_op::not_equal: r = _mm_cmpeq_epi8(va, vb); negate = true; break;
+                    case compare_op::less_equal: r = _mm_cmpeq_epi8(_mm_min_epu8(va, vb), va); break;
+                    case compare_op::greater: r = _mm_cmpeq_epi8(_mm_min_epu8(va, vb), va); negate = true; break;
+                    case compare_op::greater_equal: r = _mm_cmpeq_epi8(_mm_min_epu8(va, vb), vb); break;
+                    default: r = _mm_cmpeq_epi8(_mm_min_epu8(va, vb), vb); negate = true; break;
+                }
+                r = negate ? _mm_andnot_si128(r, ones) : _mm_and_si128(r, ones);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(mask + i), r);
+            }
+            compare_scalar_loop<uint8_t>(op, a, b, mask, i, n);
+        }
+
+        int64_t sum_i64_sse2(const int64_t* a, size_t n) {
+            __m128i acc = _mm_setzero_si128();
+            size_t i = 0;
+            for (; i + 2 <= n; i += 2)
+                acc = _mm_add_epi64(acc, _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+            int64_t lanes[2];
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+            int64_t result = wrap_add(lanes[0], lanes[1]);
+            for (; i < n; ++i)
+                result = wrap_add(result, a[i]);
+            return result;
+        }
+
+        double sum_f64_sse2(const double* a, size_t n) {
+            __m128d acc = _mm_setzero_pd();
+            size_t i = 0;
+            for (; i + 2 <= n; i += 2)
+                acc = _mm_add_pd(acc, _mm_loadu_pd(a + i));
+            double lanes[2];
+            _mm_storeu_pd(lanes, acc);
+            double result = lanes[0] + lanes[1];
+            for (; i < n; ++i)
+                result += a[i];
+            return result;
+        }
+
+        double dot_f64_sse2(const double* a, const double* b, size_t n) {
+            __m128d acc = _mm_setzero_pd();
+            size_t i = 0;
+            for (; i + 2 <= n; i += 2)
+                acc = _mm_add_pd(acc, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+            double lanes[2];
+            _mm_storeu_pd(lanes, acc);
+            double result = lanes[0] + lanes[1];
+            for (; i < n; ++i)
+                result += a[i] * b[i];
+            return result;
+        }
+
+        template <bool Min>
+        double extreme_f64_sse2(const double* a, size_t n) {
+            size_t i = 1;
+            double result = a[0];
+            if (n >= 2) {
+                __m128d acc = _mm_loadu_pd(a);
+                for (i = 2; i + 2 <= n; i += 2) {
+                    __m128d v = _mm_loadu_pd(a + i);
+                    acc = Min ? _mm_min_pd(acc, v) : _mm_max_pd(acc, v);
+                }
+                double lanes[2];
+                _mm_storeu_pd(lanes, acc);
+                result = Min ? std::min(lanes[0], lanes[1]) : std::max(lanes[0], lanes[1]);
+            }
+            for (; i < n; ++i)
+                result = Min ? std::min(result, a[i]) : std::max(result, a[i]);
+            return result;
+        }
+
+        // Needles of at least two bytes, bits has a bit for every position from i on whose first and last bytes match
+        inline bool find_in(const char* haystack, size_t i, uint32_t bits, const char* needle, size_t m, size_t& found) {
+            for (; bits; bits &= bits - 1) {
+                size_t at = i + static_cast<size_t>(std::countr_zero(bits));
+                if (std::memcmp(haystack + at + 1, needle + 1, m - 2) == 0) {
+                    found = at;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        size_t find_sse2(const char* haystack, size_t n, const char* needle, size_t m) {
+            const __m128i first = _mm_set1_epi8(needle[0]);
+            const __m128i last = _mm_set1_epi8(needle[m - 1]);
+            size_t i = 0;
+            size_t found;
+            for (; i + m - 1 + 16 <= n; i += 16) {
+                __m128i starts = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i));
+                __m128i ends = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i + m - 1));
+                __m128i both = _mm_and_si128(_mm_cmpeq_epi8(first, starts), _mm_cmpeq_epi8(last, ends));
+                if (find_in(haystack, i, static_cast<uint32_t>(_mm_movemask_epi8(both)), needle, m, found))
+                    return found;
+            }
+            return find_scalar(haystack, n, needle, m, i);
+        }
+
+        // --- avx2 ---
+
+        CAMAROO_AVX2 inline __m256i load4(array_src<int64_t> s, size_t i) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s.data + i)); }
+        CAMAROO_AVX2 inline __m256i load4(scalar_src<int64_t> s, size_t) { return _mm256_set1_epi64x(s.value); }
+        CAMAROO_AVX2 inline __m256d load4(array_src<double> s, size_t i) { return _mm256_loadu_pd(s.data + i); }
+        CAMAROO_AVX2 inline __m256d load4(scalar_src<double> s, size_t) { return _mm256_set1_pd(s.value); }
+
+        // avx2 has no 64-bit multiply, build it from the 32x32->64 one
+        CAMAROO_AVX2 inline __m256i mul_epi64_avx2(__m256i a, __m256i b) {
+            __m256i lo = _mm256_mul_epu32(a, b);
+            __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b), _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+            return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+        }
+
+        // Spreads the low four bits of a movemask into four 0/1 bytes
+        inline void store_mask4(uint8_t* mask, int bits) {
+            uint32_t spread = static_cast<uint32_t>(bits & 1) | (static_cast<uint32_t>((bits >> 1) & 1) << 8) |
+                              (static_cast<uint32_t>((bits >> 2) & 1) << 16) | (static_cast<uint32_t>((bits >> 3) & 1) << 24);
+            std::memcpy(mask, &spread, 4);
+        }
+
+        // Inverse of store_mask4, mask bytes must be 0 or 1
+        inline int load_mask4(const uint8_t* mask) {
+            uint32_t bytes;
+            std::memcpy(&bytes, mask, 4);
+            return static_cast<int>((bytes * 0x01020408u) >> 24);
+        }
+
+        template <typename A, typename B>
+        CAMAROO_AVX2 void arith_i64_avx2(arith_op op, A a, B b, int64_t* out, size_t n) {
+            size_t i = 0;
+            if (op != arith_op::divide && op != arith_op::modulo) {
+                for (; i + 4 <= n; i += 4) {
+                    __m256i va = load4(a, i), vb = load4(b, i), r;
+                    if (op == arith_op::add) r = _mm256_add_epi64(va, vb);
+                    else if (op == arith_op::subtract) r = _mm256_sub_epi64(va, vb);
+                    else r = mul_epi64_avx2(va, vb);
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), r);
+                }
+            }
+            binary_scalar<int64_t>(op, a, b, out, i, n);
+        }
+
+        template <typename A, typename B>
+        CAMAROO_AVX2 void arith_f64_avx2(arith_op op, A a, B b, double* out, size_t n) {
+            size_t i = 0;
+            for (; op != arith_op::modulo && i + 4 <= n; i += 4) {
+                __m256d va = load4(a, i), vb = load4(b, i), r;
+                switch (op) {
+                    case arith_op::add: r = _mm256_add_pd(va, vb); break;
+                    case arith_op::subtract: r = _mm256_sub_pd(va, vb); break;
+                    case arith_op::multiply: r = _mm256_mul_pd(va, vb); break;
+                    default: r = _mm256_div_pd(va, vb); break;
+                }
+                _mm256_storeu_pd(out + i, r);
+            }
+            binary_scalar<double>(op, a, b, out, i, n);
+        }
+
+        template <typename A, typename B>
+        CAMAROO_AVX2 void compare_i64_avx2(compare_op op, A a, B b, uint8_t* mask, size_t n) {
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m256i va = load4(a, i), vb = load4(b, i), r;
+                bool negate = false;
+                switch (op) {
+                    case compare_op::equal: r = _mm256_cmpeq_epi64(va, vb); break;
+                    case compare_op::not_equal: r = _mm256_cmpeq_epi64(va, vb); negate = true; break;
+                    case compare_op::greater: r = _mm256_cmpgt_epi64(va, vb); break;
+                    case compare_op::less_equal: r = _mm256_cmpgt_epi64(va, vb); negate = true; break;
+                    case compare_op::less: r = _mm256_cmpgt_epi64(vb, va); break;
+                    default: r = _mm256_cmpgt_epi64(vb, va); negate = true; break;
+                }
+                int bits = _mm256_movemask_pd(_mm256_castsi256_pd(r));
+                store_mask4(mask + i, negate ? bits ^ 0xF : bits);
+            }
+            compare_scalar_loop<int64_t>(op, a, b, mask, i, n);
+        }
+
+        template <int Predicate, typename A, typename B>
+        CAMAROO_AVX2 size_t compare_f64_avx2_loop(A a, B b, uint8_t* mask, size_t n) {
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4)
+                store_mask4(mask + i, _mm256_movemask_pd(_mm256_cmp_pd(load4(a, i), load4(b, i), Predicate)));
+            return i;
+        }
+
+        template <typename A, typename B>
+        CAMAROO_AVX2 void compare_f64_avx2(compare_op op, A a, B b, uint8_t* mask, size_t n) {
+            size_t i;
+            switch (op) {
+                case compare_op::equal: i = compare_f64_avx2_loop<_CMP_EQ_OQ>(a, b, mask, n); break;
+                case compare_op::not_equal: i = compare_f64_avx2_loop<_CMP_NEQ_UQ>(a, b, mask, n); break;
+                case compare_op::less: i = compare_f64_avx2_loop<_CMP_LT_OQ>(a, b, mask, n); break;
+                case compare_op::less_equal: i = compare_f64_avx2_loop<_CMP_LE_OQ>(a, b, mask, n); break;
+                case compare_op::greater: i = compare_f64_avx2_loop<_CMP_GT_OQ>(a, b, mask, n); break;
+                default: i = compare_f64_avx2_loop<_CMP_GE_OQ>(a, b, mask, n); break;
+            }
+            compare_scalar_loop<double>(op, a, b, mask, i, n);
+        }
+
+        CAMAROO_AVX2 int64_t sum_i64_avx2(const int64_t* a, size_t n) {
+            __m256i acc = _mm256_setzero_si256();
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4)
+                acc = _mm256_add_epi64(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)));
+            int64_t lanes[4];
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+            int64_t result = wrap_add(wrap_add(lanes[0], lanes[1]), wrap_add(lanes[2], lanes[3]));
+            for (; i < n; ++i)
+                result = wrap_add(result, a[i]);
+            return result;
+        }
+
+        CAMAROO_AVX2 double sum_f64_avx2(const double* a, size_t n) {
+            __m256d acc = _mm256_setzero_pd();
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4)
+                acc = _mm256_add_pd(acc, _mm256_loadu_pd(a + i));
+            double lanes[4];
+            _mm256_storeu_pd(lanes, acc);
+            double result = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+            for (; i < n; ++i)
+                result += a[i];
+            return result;
+        }
+
+        CAMAROO_AVX2 int64_t dot_i64_avx2(const int64_t* a, const int64_t* b, size_t n) {
+            __m256i acc = _mm256_setzero_si256();
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+                __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+                acc = _mm256_add_epi64(acc, mul_epi64_avx2(va, vb));
+            }
+            int64_t lanes[4];
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+            int64_t result = wrap_add(wrap_add(lanes[0], lanes[1]), wrap_add(lanes[2], lanes[3]));
+            for (; i < n; ++i)
+                result = wrap_add(result, wrap_mul(a[i], b[i]));
+            return result;
+        }
+
+        CAMAROO_AVX2 double dot_f64_avx2(const double* a, const double* b, size_t n) {
+            __m256d acc = _mm256_setzero_pd();
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4)
+                acc = _mm256_add_pd(acc, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+            double lanes[4];
+            _mm256_storeu_pd(lanes, acc);
+            double result = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+            for (; i < n; ++i)
+                result += a[i] * b[i];
+            return result;
+        }
+
+        template <bool Min>
+        CAMAROO_AVX2 int64_t extreme_i64_avx2(const int64_t* a, size_t n) {
+            size_t i = 1;
+            int64_t result = a[0];
+            if (n >= 4) {
+                __m256i acc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+                for (i = 4; i + 4 <= n; i += 4) {
+                    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+                    __m256i take = Min ? _mm256_cmpgt_epi64(acc, v) : _mm256_cmpgt_epi64(v, acc);
+                    acc = _mm256_blendv_epi8(acc, v, take);
+                }
+                int64_t lanes[4];
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+                result = lanes[0];
+                for (int lane = 1; lane < 4; ++lane)
+                    result = Min ? std::min(result, lanes[lane]) : std::max(result, lanes[lane]);
+            }
+            for (; i < n; ++i)
+                result = Min ? std::min(result, a[i]) : std::max(result, a[i]);
+            return result;
+        }
+
+        template <bool Min>
+        CAMAROO_AVX2 double extreme_f64_avx2(const double* a, size_t n) {
+            size_t i = 1;
+            double result = a[0];
+            if (n >= 4) {
+                __m256d acc = _mm256_loadu_pd(a);
+                for (i = 4; i + 4 <= n; i += 4) {
+                    __m256d v = _mm256_loadu_pd(a + i);
+                    acc = Min ? _mm256_min_pd(acc, v) : _mm256_max_pd(acc, v);
+                }
+                double lanes[4];
+                _mm256_storeu_pd(lanes, acc);
+                result = lanes[0];
+                for (int lane = 1; lane < 4; ++lane)
+                    result = Min ? std::min(result, lanes[lane]) : std::max(result, lanes[lane]);
+            }
+            for (; i < n; ++i)
+                result = Min ? std::min(result, a[i]) : std::max(result, a[i]);
+            return result;
+        }
+
+        // For every 4-bit keep mask, the 32-bit lane indices that pack the kept 64-bit lanes to the front
+        constexpr std::array<std::array<int32_t, 8>, 16> make_compress_table() {
+            std::array<std::array<int32_t, 8>, 16> table{};
+            for (int bits = 0; bits < 16; ++bits) {
+                int slot = 0;
+                for (int lane = 0; lane < 4; ++lane) {
+                    if (bits & (1 << lane)) {
+                        table[bits][slot * 2] = lane * 2;
+                        table[bits][slot * 2 + 1] = lane * 2 + 1;
+                        ++slot;
+                    }
+                }
+            }
+            return table;
+        }
+
+        constexpr auto compress_table = make_compress_table();
+
+        // Works on the raw 64-bit pattern so it serves both num and fnum lists
+        CAMAROO_AVX2 size_t compress64_avx2(const void* source, const uint8_t* mask, void* destination, size_t n) {
+            const uint64_t* a = static_cast<const uint64_t*>(source);
+            uint64_t* out = static_cast<uint64_t*>(destination);
+            size_t kept = 0;
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                int bits = load_mask4(mask + i);
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+                __m256i order = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(compress_table[bits].data()));
+                // out has room for n elements and kept <= i, so the full 4-lane store stays in bounds
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + kept), _mm256_permutevar8x32_epi32(v, order));
+                kept += static_cast<size_t>((bits & 1) + ((bits >> 1) & 1) + ((bits >> 2) & 1) + ((bits >> 3) & 1));
+            }
+            for (; i < n; ++i) {
+                out[kept] = a[i];
+                kept += mask[i] ? 1 : 0;
+            }
+            return kept;
+        }
+
+        CAMAROO_AVX2 size_t count_avx2(const uint8_t* mask, size_t n) {
+            __m256i acc = _mm256_setzero_si256();
+            size_t i = 0;
+            for (; i + 32 <= n; i += 32)
+                acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(mask + i)), _mm256_setzero_si256()));
+            uint64_t lanes[4];
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+            size_t result = static_cast<size_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+            for (; i < n; ++i)
+                result += mask[i] ? 1 : 0;
+            return result;
+        }
+
+        CAMAROO_AVX2 size_t find_avx2(const char* haystack, size_t n, const char* needle, size_t m) {
+            const __m256i first = _mm256_set1_epi8(needle[0]);
+            const __m256i last = _mm256_set1_epi8(needle[m - 1]);
+            size_t i = 0;
+            size_t found;
+            for (; i + m - 1 + 32 <= n; i += 32) {
+                __m256i starts = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i));
+                __m256i ends = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i + m - 1));
+                __m256i both = _mm256_and_si256(_mm256_cmpeq_epi8(first, starts), _mm256_cmpeq_epi8(last, ends));
+                if (find_in(haystack, i, static_cast<uint32_t>(_mm256_movemask_epi8(both)), needle, m, found))
+                    return found;
+            }
+            return find_scalar(haystack, n, needle, m, i);
+        }
+#endif
+
+        template <typename T, typename A, typename B>
+        void dispatch_arith(arith_op op, A a, B b, T* out, size_t n) {
+#if CAMAROO_X86
+            if constexpr (std::is_same_v<T, int64_t>) {
+                if (level() == kernel_level::avx2)
+                    return arith_i64_avx2(op, a, b, out, n);
+                return arith_i64_sse2(op, a, b, out, n);
+            } else {
+                if (level() == kernel_level::avx2)
+                    return arith_f64_avx2(op, a, b, out, n);
+                return arith_f64_sse2(op, a, b, out, n);
+            }
+#else
+            binary_scalar<T>(op, a, b, out, 0, n);
+#endif
+        }
+
+        template <typename T, typename A, typename B>
+        void dispatch_compare(compare_op op, A a, B b, uint8_t* mask, size_t n) {
+#if CAMAROO_X86
+            if constexpr (std::is_same_v<T, int64_t>) {
+                // 64-bit integer compares need sse4.2, so below avx2 this stays scalar
+                if (level() == kernel_level::avx2)
+                    return compare_i64_avx2(op, a, b, mask, n);
+            } else if constexpr (std::is_same_v<T, uint8_t>) {
+                return compare_u8_sse2(op, a, b, mask, n);
+            } else {
+                if (level() == kernel_level::avx2)
+                    return compare_f64_avx2(op, a, b, mask, n);
+                return compare_f64_sse2(op, a, b, mask, n);
+            }
+#endif
+            compare_scalar_loop<T>(op, a, b, mask, 0, n);
+        }
+
+        template <typename T>
+        size_t compress_scalar(const T* a, const uint8_t* mask, T* out, size_t n) {
+            size_t kept = 0;
+            for (size_t i = 0; i < n; ++i) {
+                out[kept] = a[i];
+                kept += mask[i] ? 1 : 0;
+            }
+            return kept;
+        }
+    }
+
+    const char* active_kernels() {
+        switch (level()) {
+            case kernel_level::avx2: return "avx2";
+            case kernel_level::sse2: return "sse2";
+            default: return "scalar";
+        }
+    }
+
+    void arith(arith_op op, const int64_t* a, const int64_t* b, int64_t* out, size_t n) {
+        dispatch_arith<int64_t>(op, array_src<int64_t>{a}, array_src<int64_t>{b}, out, n);
+    }
+
+    void arith(arith_op op, const double* a, const double* b, double* out, size_t n) {
+        dispatch_arith<double>(op, array_src<double>{a}, array_src<double>{b}, out, n);
+    }
+
+    void arith_scalar(arith_op op, const int64_t* a, int64_t b, int64_t* out, size_t n, bool scalar_left) {
+        if (scalar_left)
+            return dispatch_arith<int64_t>(op, scalar_src<int64_t>{b}, array_src<int64_t>{a}, out, n);
+        dispatch_arith<int64_t>(op, array_src<int64_t>{a}, scalar_src<int64_t>{b}, out, n);
+    }
+
+    void arith_scalar(arith_op op, const double* a, double b, double* out, size_t n, bool scalar_left) {
+        if (scalar_left)
+            return dispatch_arith<double>(op, scalar_src<double>{b}, array_src<double>{a}, out, n);
+        dispatch_arith<double>(op, array_src<double>{a}, scalar_src<double>{b}, out, n);
+    }
+
+    int64_t sum(const int64_t* a, size_t n) {
+#if CAMAROO_X86
+        if (level() == kernel_level::avx2)
+            return sum_i64_avx2(a, n);
+        return sum_i64_sse2(a, n);
+#else
+        int64_t result = 0;
+        for (size_t i = 0; i < n; ++i)
+            result = wrap_add(result, a[i]);
+        return result;
+#endif
+    }
+
+    double sum(const double* a, size_t n) {
+#if CAMAROO_X86
+        if (level() == kernel_level::avx2)
+            return sum_f64_avx2(a, n);
+        return sum_f64_sse2(a, n);
+#else
+        double result = 0;
+        for (size_t i = 0; i < n; ++i)
+            result += a[i];
+        return result;
+#endif
+    }
+
+    int64_t min(const int64_t* a, size_t n) {
+#if CAMAROO_X86
+        if (level() == kernel_level::avx2)
+            return extreme_i64_avx2<true>(a, n);
+#endif
+        return *std::min_element(a, a + n);
+    }
+
+    double min(const double* a, size_t n) {
+#if CAMAROO_X86
+        if (level() == kernel_level::avx2)
+            return extreme_f64_avx2<true>(a, n);
+        return extreme_f64_sse2<true>(a, n);
+#else
+        return *std::min_element(a, a + n);
+#endif
+    }
+
+    int64_t max(const int64_t* a, size_t n) {
+#if CAMAROO_X86
+        if (level() == kernel_level::avx2)
+            return extreme_i64_avx2<false>(a, n);
+#endif
+        return *std::max_element(a, a + n);
+    }
+
+    double max(const double* a, size_t n) {
+#if CAMAROO_X86
+        if (level() == kernel_level::avx2)
+            return extreme_f64_avx2<false>(a, n);
+        return extreme_f64_sse2<false>(a, n);
+#else
+        return *std::max_element(a, a + n);
+#endif
+    }
+
+    int64_t dot(const int64_t* a, const int64_t* b, size_t n) {
+#if CAMAROO_X86
+        if (level() == kernel_level::avx2)
+            return dot_i64_avx2(a, b, n);
+#endif
+        int64_t result = 0;
+        for (size_t i = 0; i < n; ++i)
+            result = wrap_add(result, wrap_mul(a[i], b[i]));
+        return result;
+    }
+
+    double dot(const double* a, const double* b, size_t n) {
+#if CAMAROO_X86
+        if (level() == kernel_level::avx2)
+            return dot_f64_avx2(a, b, n);
+        return dot_f64_sse2(a, b, n);
+#else
+        double result = 0;
+        for (size_t i = 0; i < n; ++i)
+            result += a[i] * b[i];
+        return result;
+#endif
+    }
+
+    void compare_scalar(compare_op op, const int64_t* a, int64_t b, uint8_t* mask, size_t n) {
+        dispatch_compare<int64_t>(op, array_src<int64_t>{a}, scalar_src<int64_t>{b}, mask, n);
+    }
+
+    void compare_scalar(compare_op op, const double* a, double b, uint8_t* mask, size_t n) {
+        dispatch_compare<double>(op, array_src<double>{a}, scalar_src<double>{b}, mask, n);
+    }
+
+    void compare(compare_op op, const int64_t* a, const int64_t* b, uint8_t* mask, size_t n) {
+        dispatch_compare<int64_t>(op, array_src<int64_t>{a}, array_src<int64_t>{b}, mask, n);
+    }
+
+    void compare(compare_op op, const double* a, const double* b, uint8_t* mask, size_t n) {
+        dispatch_compare<double>(op, array_src<double>{a}, array_src<double>{b}, mask, n);
+    }
+
+    void compare_scalar(compare_op op, const uint8_t* a, uint8_t b, uint8_t* mask, size_t n) {
+        dispatch_compare<uint8_t>(op, array_src<uint8_t>{a}, scalar_src<uint8_t>{b}, mask, n);
+    }
+
+    void compare(compare_op op, const uint8_t* a, const uint8_t* b, uint8_t* mask, size_t n) {
+        dispatch_compare<uint8_t>(op, array_src<uint8_t>{a}, array_src<uint8_t>{b}, mask, n);
+    }
+
+    size_t compress(const int64_t* a, const uint8_t* mask, int64_t* out, size_t n) {
+#if CAMAROO_X86
+        if (level() == kernel_level::avx2)
+            return compress64_avx2(a, mask, out, n);
+#endif
+        return compress_scalar(a, mask, out, n);
+    }
+
+    size_t compress(const double* a, const uint8_t* mask, double* out, size_t n) {
+#if CAMAROO_X86
+        if (level() == kernel_level::avx2)
+            return compress64_avx2(a, mask, out, n);
+#endif
+        return compress_scalar(a, mask, out, n);
+    }
+
+    size_t count(const uint8_t* mask, size_t n) {
+#if CAMAROO_X86
+        if (level() == kernel_level::avx2)
+            return count_avx2(mask, n);
+#endif
+        size_t result = 0;
+        for (size_t i = 0; i < n; ++i)
+            result += mask[i] ? 1 : 0;
+        return result;
+    }
+
+    size_t find(const char* haystack, size_t n, const char* needle, size_t m) {
+        if (m == 0)
+            return 0;
+        if (m > n)
+            return n;
+        if (m == 1) {
+            const void* found = std::memchr(haystack, needle[0], n);
+            return found ? static_cast<size_t>(static_cast<const char*>(found) - haystack) : n;
+        }
+#if CAMAROO_X86
+        if (level() == kernel_level::avx2)
+            return find_avx2(haystack, n, needle, m);
+        return find_sse2(haystack, n, needle, m);
+#endif
+        return find_scalar(haystack, n, needle, m, 0);
+    }
+}
@@ -0,0 +1,520 @@
+#include <specialize.h>
+#include <evaluator.h>
+#include <algorithm>
+#include <cstdio>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace camaroo_core {
+
+    namespace {
+
+        using Statements = std::vector<std::unique_ptr<StatementNode>>;
+
+        // Nodes the unrolled copies of one program may add together
+        constexpr size_t unroll_budget = 4096;
+
+        std::string name_of(ASTNode* node) {
+            return std::get<std::string>(node->token_value());
+        }
+
+        Token token_of(ASTNode* node) {
+            return Token{node->token_type(), std::get<std::string>(node->token_value())};
+        }
+
+        bool is_literal(ASTNode* node) {
+            if (!node)
+                return false;
+            NodeKind kind = node->node_kind();
+            return kind == NodeKind::num || kind == NodeKind::fnum || kind == NodeKind::text || kind == NodeKind::toggle ||
+                   kind == NodeKind::letter;
+        }
+
+        std::unique_ptr<ExpressionNode> copy_literal(ASTNode* node) {
+            switch (node->node_kind()) {
+                case NodeKind::num:
+                    return std::make_unique<NumExpr>(Token{TokenType::num, node->to_string()});
+                case NodeKind::fnum:
+                    return std::make_unique<FNumExpr>(Token{TokenType::fnum, node->to_string()});
+                case NodeKind::text:
+                    return std::make_unique<TextExpr>(Token{TokenType::text, std::get<std::string>(node->token_value())});
+                case NodeKind::letter:
+                    return std::make_unique<LetterExpr>(Token{TokenType::letter, std::get<std::string>(node->token_value())});
+                default:
+                    return std::make_unique<ToggleExpr>(Token{TokenType::toggle, node->to_string()});
+            }
+        }
+
+        // The literal giving value, nullptr for values no literal can
+        std::unique_ptr<ExpressionNode> literal_of(const camaroo_object& value) {
+            switch (value.variable_type) {
+                case TokenType::num:
+                    return std::make_unique<NumExpr>(Token{TokenType::num, std::to_string(std::get<int64_t>(value.variable_value))});
+                case TokenType::fnum: {
+                    // The shortest text that reads back as the same double
+                    double number = std::get<double>(value.variable_value);
+                    char text[32];
+                    for (int precision = 1; precision <= 17; ++precision) {
+                        std::snprintf(text, sizeof(text), "%.*g", precision, number);
+                        if (std::stod(text) == number)
+                            break;
+                    }
+                    return std::make_unique<FNumExpr>(Token{TokenType::fnum, text});
+                }
+                case TokenType::text:
+                    return std::make_unique<TextExpr>(Token{TokenType::text, std::get<camaroo_text>(value.variable_value).str()});
+                case TokenType::toggle:
+                    return std::make_unique<ToggleExpr>(Token{TokenType::toggle, std::get<bool>(value.variable_value) ? "true" : "false"});
+                case TokenType::letter: {
+                    std::string letter;
+                    append_utf8(letter, std::get<char32_t>(value.variable_value));
+                    return std::make_unique<LetterExpr>(Token{TokenType::letter, letter});
+                }
+                default:
+                    return nullptr;
+            }
+        }
+
+        // The value of a fixed variable, read as the type it is declared with
+        std::unique_ptr<ExpressionNode> fixed_value(const Token& type, const std::string& name, const std::string& text) {
+            try {
+                size_t used = 0;
+                switch (type.type) {
+                    case TokenType::num_type:
+                        std::stoll(text, &used);
+                        if (used == text.size())
+                            return std::make_unique<NumExpr>(Token{TokenType::num, text});
+                        break;
+                    case TokenType::fnum_type:
+                        std::stod(text, &used);
+                        if (used == text.size())
+                            return std::make_unique<FNumExpr>(Token{TokenType::fnum, text});
+                        break;
+                    case TokenType::toggle_type:
+                        if (text == "true" || text == "false")
+                            return std::make_unique<ToggleExpr>(Token{TokenType::toggle, text});
+                        break;
+                    case TokenType::text_type:
+                        return std::make_unique<TextExpr>(Token{TokenType::text, text});
+                    case TokenType::letter_type:
+                        // Exactly one character
+                        if (!text.empty())
+                            decode_utf8(text, 0, used);
+                        if (!text.empty() && used == text.size())
+                            return std::make_unique<LetterExpr>(Token{TokenType::letter, text});
+                        break;
+                    default:
+                        throw std::runtime_error("Error: " + name + " is a " + type.value +
+                                                 ", only num, fnum, toggle, letter and text variables can be specialized");
+                }
+            }
+            catch (const std::logic_error&) {
+                // stoll and stod found no number or one out of range
+            }
+            throw std::runtime_error("Error: " + name + " is declared as " + type.value + " but is specialized to " + text);
+        }
+
+        struct usage {
+            bool read = false;
+            // Assigned, declared again, named by a loop or a reduce clause
+            bool changed = false;
+        };
+
+        bool mentioned_in(std::string_view source, const std::string& name) {
+            try {
+                Tokenizer tokenizer{std::string(source)};
+                while (std::optional<Token> token = tokenizer.next_token()) {
+                    if (token->type == TokenType::identifier && token->value == name)
+                        return true;
+                    // Slots sit inside the literal, reading all of it as code can only find too much
+                    if (token->type == TokenType::format && mentioned_in(std::string_view(token->value).substr(1), name))
+                        return true;
+                }
+                return false;
+            }
+            catch (const std::exception&) {
+                return true;
+            }
+        }
+
+        void scan(ASTNode* node, const std::string& name, usage& use) {
+            if (!node)
+                return;
+            switch (node->node_kind()) {
+                case NodeKind::identifier:
+                    use.read = use.read || name_of(node) == name;
+                    return;
+                case NodeKind::assign:
+                    use.changed = use.changed || name_of(node->get_left()) == name;
+                    break;
+                case NodeKind::block:
+                    for (const auto& statement : static_cast<BlockStmnt*>(node)->get_statements())
+                        scan(statement.get(), name, use);
+                    return;
+                case NodeKind::for_loop: {
+                    auto* loop = static_cast<ForStmnt*>(node);
+                    use.changed = use.changed || name_of(loop->get_left()) == name;
+                    for (const auto& clause : loop->get_reductions())
+                        use.changed = use.changed || clause.variable == name;
+                    scan(loop->get_iterable(), name, use);
+                    scan(loop->get_body(), name, use);
+                    return;
+                }
+                case NodeKind::spawn:
+                    scan(static_cast<SpawnStmnt*>(node)->get_body(), name, use);
+                    return;
+                case NodeKind::function: {
+                    // Bodies run in frames of their own, whatever they do with the name can only read the variable
+                    FunctionDef& definition = *static_cast<FuncStmnt*>(node)->get_definition();
+                    if (definition.is_deferred()) {
+                        use.read = use.read || mentioned_in(definition.body_source(), name);
+                    } else {
+                        usage inside;
+                        scan(definition.body.get(), name, inside);
+                        use.read = use.read || inside.read || inside.changed;
+                    }
+                    return;
+                }
+                default:
+                    break;
+            }
+            node->visit_expressions([&](std::unique_ptr<ExpressionNode>& child) {
+                scan(child.get(), name, use);
+            });
+        }
+
+        // Replaces reads of name with copies of value, func and gen bodies are left alone
+        void substitute(ASTNode* node, const std::string& name, ASTNode* value) {
+            if (!node)
+                return;
+            node->visit_expressions([&](std::unique_ptr<ExpressionNode>& child) {
+                if (child && child->node_kind() == NodeKind::identifier && name_of(child.get()) == name)
+                    child = copy_literal(value);
+                else
+                    substitute(child.get(), name, value);
+            });
+            switch (node->node_kind()) {
+                case NodeKind::block:
+                    for (const auto& statement : static_cast<BlockStmnt*>(node)->get_statements())
+                        substitute(statement.get(), name, value);
+                    return;
+                case NodeKind::for_loop:
+                    substitute(static_cast<ForStmnt*>(node)->get_body(), name, value);
+                    return;
+                case NodeKind::spawn:
+                    substitute(static_cast<SpawnStmnt*>(node)->get_body(), name, value);
+                    return;
+                default:
+                    return;
+            }
+        }
+
+        // Copies statements as the parser makes them. Anything that can't run once per iteration in a block of its
+        // own sets failed: returns, yields, uses and the nodes optimize makes
+        class cloner {
+        public:
+            std::unique_ptr<StatementNode> statement(ASTNode* node);
+            std::unique_ptr<ExpressionNode> expression(ASTNode* node);
+            std::unique_ptr<BlockStmnt> block(BlockStmnt* node);
+
+            bool failed = false;
+            size_t nodes = 0;
+        };
+
+        std::unique_ptr<ExpressionNode> cloner::expression(ASTNode* node) {
+            // Some operators have no left side
+            if (!node || failed)
+                return nullptr;
+            ++nodes;
+            if (is_literal(node))
+                return copy_literal(node);
+            switch (node->node_kind()) {
+                case NodeKind::identifier:
+                    return std::make_unique<IdentifierNode>(token_of(node));
+                case NodeKind::prefix:
+                    return std::make_unique<PrefixExpr>(token_of(node), expression(node->get_right()));
+                case NodeKind::infix: {
+                    std::unique_ptr<ExpressionNode> left = expression(node->get_left());
+                    return std::make_unique<InfixExpr>(token_of(node), std::move(left), expression(node->get_right()));
+                }
+                case NodeKind::list: {
+                    std::vector<std::unique_ptr<ExpressionNode>> elements;
+                    for (const auto& element : static_cast<ListExpr*>(node)->get_elements())
+                        elements.push_back(expression(element.get()));
+                    return std::make_unique<ListExpr>(token_of(node), std::move(elements));
+                }
+                case NodeKind::format: {
+                    auto* format = static_cast<FormatExpr*>(node);
+                    std::vector<std::unique_ptr<ExpressionNode>> slots;
+                    for (const auto& slot : format->get_slots())
+                        slots.push_back(expression(slot.get()));
+                    return std::make_unique<FormatExpr>(token_of(node), format->get_pieces(), std::move(slots));
+                }
+                case NodeKind::channel: {
+                    auto* channel = static_cast<ChannelExpr*>(node);
+                    return std::make_unique<ChannelExpr>(token_of(node), channel->get_element_type(), expression(channel->get_right()));
+                }
+                case NodeKind::map: {
+                    auto* map = static_cast<MapExpr*>(node);
+                    return std::make_unique<MapExpr>(token_of(node), map->get_key_type(), map->get_value_type());
+                }
+                case NodeKind::call: {
+                    auto* call = static_cast<CallExpr*>(node);
+                    std::unique_ptr<ExpressionNode> callee = expression(call->get_left());
+                    std::vector<std::unique_ptr<ExpressionNode>> arguments;
+                    for (const auto& argument : call->get_arguments())
+                        arguments.push_back(expression(argument.get()));
+                    return std::make_unique<CallExpr>(token_of(node), std::move(callee), std::move(arguments));
+                }
+                default:
+                    failed = true;
+                    return nullptr;
+            }
+        }
+
+        std::unique_ptr<BlockStmnt> cloner::block(BlockStmnt* node) {
+            ++nodes;
+            Statements statements;
+            for (const auto& inner : node->get_statements())
+                statements.push_back(statement(inner.get()));
+            return std::make_unique<BlockStmnt>(token_of(node), std::move(statements), node->has_yield());
+        }
+
+        std::unique_ptr<StatementNode> cloner::statement(ASTNode* node) {
+            if (failed)
+                return nullptr;
+            ++nodes;
+            switch (node->node_kind()) {
+                case NodeKind::assign:
+                    return std::make_unique<AssignStmnt>(token_of(node), std::make_unique<IdentifierNode>(token_of(node->get_left())),
+                                                         expression(node->get_right()));
+                case NodeKind::print:
+                    return std::make_unique<PrintStmnt>(expression(node->get_right()));
+                case NodeKind::println:
+                    return std::make_unique<PrintlnStmnt>(expression(node->get_right()));
+                case NodeKind::expression_stmnt:
+                    return std::make_unique<ExprStmnt>(expression(node->get_right()));
+                case NodeKind::block:
+                    --nodes;
+                    return block(static_cast<BlockStmnt*>(node));
+                case NodeKind::for_loop: {
+                    auto* loop = static_cast<ForStmnt*>(node);
+                    std::unique_ptr<ExpressionNode> iterable = expression(loop->get_iterable());
+                    return std::make_unique<ForStmnt>(token_of(node), loop->get_variable_type(),
+                                                      std::make_unique<IdentifierNode>(token_of(loop->get_left())),
+                                                      std::move(iterable), block(loop->get_body()),
+                                                      loop->is_parallel(), loop->get_reductions());
+                }
+                case NodeKind::spawn:
+                    return std::make_unique<SpawnStmnt>(token_of(node), block(static_cast<SpawnStmnt*>(node)->get_body()));
+                case NodeKind::function:
+                    // Declaring the same definition again is what running the loop did
+                    return std::make_unique<FuncStmnt>(static_cast<FuncStmnt*>(node)->get_definition());
+                default:
+                    failed = true;
+                    return nullptr;
+            }
+        }
+
+        class specializer {
+        public:
+            void statements(Statements& list);
+
+            size_t unrolled = 0;
+        private:
+            void fold(std::unique_ptr<ExpressionNode>& slot);
+            // Iterations of a sequential loop over a range with literal bounds
+            std::optional<size_t> literal_count(ForStmnt* loop);
+            bool unroll(ForStmnt* loop, size_t count, Statements& into);
+
+            // Works out the value of expressions on literals, which never read or print anything
+            evaluator constants;
+            size_t budget = unroll_budget;
+        };
+
+        void specializer::fold(std::unique_ptr<ExpressionNode>& slot) {
+            if (!slot)
+                return;
+            slot->visit_expressions([&](std::unique_ptr<ExpressionNode>& child) {
+                fold(child);
+            });
+            NodeKind kind = slot->node_kind();
+            if (kind == NodeKind::format) {
+                // Slots filled with fixed values leave plain text
+                for (const auto& part : static_cast<FormatExpr*>(slot.get())->get_slots())
+                    if (!is_literal(part.get()))
+                        return;
+                if (std::unique_ptr<ExpressionNode> literal = literal_of(*constants.evaluate_expression(slot.get())))
+                    slot = std::move(literal);
+                return;
+            }
+            if ((kind != NodeKind::prefix && kind != NodeKind::infix) || slot->token_type() == TokenType::to_keyword)
+                return;
+            if ((slot->get_left() && !is_literal(slot->get_left())) || !is_literal(slot->get_right()))
+                return;
+            try {
+                if (std::unique_ptr<ExpressionNode> literal = literal_of(*constants.evaluate_expression(slot.get())))
+                    slot = std::move(literal);
+            }
+            catch (const std::exception&) {
+                // Left for the run to report, as it would have
+            }
+        }
+
+        std::optional<size_t> specializer::literal_count(ForStmnt* loop) {
+            ExpressionNode* iterable = loop->get_iterable();
+            if (loop->is_parallel() || loop->get_variable_type().type != TokenType::num_type ||
+                iterable->token_type() != TokenType::to_keyword)
+                return std::nullopt;
+            ASTNode* first = iterable->get_left();
+            ASTNode* last = iterable->get_right();
+            if (!first || !last || first->node_kind() != NodeKind::num || last->node_kind() != NodeKind::num)
+                return std::nullopt;
+            int64_t from = std::get<int64_t>(first->token_value());
+            int64_t to = std::get<int64_t>(last->token_value());
+            return (to > from) ? static_cast<size_t>(static_cast<uint64_t>(to) - static_cast<uint64_t>(from)) : 0;
+        }
+
+        bool specializer::unroll(ForStmnt* loop, size_t count, Statements& into) {
+            if (count > unroll_limit)
+                return false;
+            cloner copy;
+            std::unique_ptr<BlockStmnt> first = copy.block(loop->get_body());
+            if (copy.failed || copy.nodes * count > budget)
+                return false;
+            budget -= copy.nodes * count;
+
+            std::string variable = name_of(loop->get_left());
+            int64_t from = std::get<int64_t>(loop->get_iterable()->get_left()->token_value());
+            for (size_t i = 0; i < count; ++i) {
+                std::unique_ptr<BlockStmnt> body = i ? cloner().block(loop->get_body()) : std::move(first);
+                auto value = std::make_unique<NumExpr>(Token{TokenType::num, std::to_string(from + static_cast<int64_t>(i))});
+                usage use;
+                scan(body.get(), variable, use);
+                if (!use.changed) {
+                    substitute(body.get(), variable, value.get());
+                    use = usage{};
+                    scan(body.get(), variable, use);
+                }
+                // The loop variable is only declared when something still reads it, its block then takes the place
+                // of the scope the loop pushed
+                if (use.read || use.changed) {
+                    Statements iteration;
+                    iteration.push_back(std::make_unique<AssignStmnt>(loop->get_variable_type(),
+                        std::make_unique<IdentifierNode>(Token{TokenType::identifier, variable}), std::move(value)));
+                    iteration.push_back(std::move(body));
+                    body = std::make_unique<BlockStmnt>(Token{TokenType::LCurlyBrace, "{"}, std::move(iteration));
+                }
+                statements(body->edit_statements());
+                into.push_back(std::move(body));
+            }
+            ++unrolled;
+            return true;
+        }
+
+        void specializer::statements(Statements& list) {
+            Statements kept;
+            kept.reserve(list.size());
+            for (auto& statement : list) {
+                statement->visit_expressions([&](std::unique_ptr<ExpressionNode>& slot) {
+                    fold(slot);
+                });
+                switch (statement->node_kind()) {
+                    case NodeKind::block:
+                        statements(static_cast<BlockStmnt*>(statement.get())->edit_statements());
+                        break;
+                    case NodeKind::spawn:
+                        statements(static_cast<SpawnStmnt*>(statement.get())->get_body()->edit_statements());
+                        break;
+                    case NodeKind::for_loop: {
+                        auto* loop = static_cast<ForStmnt*>(statement.get());
+                        std::optional<size_t> count = literal_count(loop);
+                        if (count && (*count == 0 || unroll(loop, *count, kept)))
+                            continue;
+                        statements(loop->get_body()->edit_statements());
+                        break;
+                    }
+                    case NodeKind::expression_stmnt:
+                        if (is_literal(statement->get_right()))
+                            continue;
+                        break;
+                    default:
+                        break;
+                }
+                kept.push_back(std::move(statement));
+            }
+            list = std::move(kept);
+        }
+
+        std::optional<size_t> top_level_declaration(const Statements& statements, const std::string& name) {
+            for (size_t i = 0; i < statements.size(); ++i) {
+                StatementNode* statement = statements[i].get();
+                if (statement->node_kind() == NodeKind::assign && statement->token_type() != TokenType::equal &&
+                    name_of(statement->get_left()) == name)
+                    return i;
+            }
+            return std::nullopt;
+        }
+
+        usage use_outside(const Statements& statements, size_t declaration, const std::string& name) {
+            usage use;
+            for (size_t i = 0; i < statements.size(); ++i)
+                if (i != declaration)
+                    scan(statements[i].get(), name, use);
+            return use;
+        }
+    }
+
+    specializations parse_specializations(const std::string& list) {
+        specializations result;
+        size_t begin = 0;
+        while (begin <= list.size()) {
+            size_t end = std::min(list.find(',', begin), list.size());
+            std::string pair = list.substr(begin, end - begin);
+            size_t equals = pair.find('=');
+            if (equals == std::string::npos || equals == 0)
+                throw std::runtime_error("Error: expected name=value but found, " + pair);
+            result.emplace_back(pair.substr(0, equals), pair.substr(equals + 1));
+            begin = end + 1;
+        }
+        return result;
+    }
+
+    size_t specialize(Statements& statements, const specializations& fixed) {
+        for (size_t f = 0; f < fixed.size(); ++f) {
+            const auto& [name, text] = fixed[f];
+            // A name given again later gets the later value
+            if (std::any_of(fixed.begin() + static_cast<std::ptrdiff_t>(f) + 1, fixed.end(), [&](const auto& other) { return other.first == name; }))
+                continue;
+            std::optional<size_t> declaration = top_level_declaration(statements, name);
+            if (!declaration)
+                throw std::runtime_error("Error: " + name + " isn't declared at the top level of the script");
+
+            StatementNode* statement = statements[*declaration].get();
+            std::unique_ptr<ExpressionNode> value = fixed_value(token_of(statement), name, text);
+            ASTNode* literal = value.get();
+            statement->visit_expressions([&](std::unique_ptr<ExpressionNode>& slot) {
+                slot = std::move(value);
+            });
+            if (use_outside(statements, *declaration, name).changed)
+                continue;
+            for (size_t i = *declaration + 1; i < statements.size(); ++i)
+                substitute(statements[i].get(), name, literal);
+        }
+
+        specializer pass;
+        pass.statements(statements);
+
+        for (const auto& [name, text] : fixed) {
+            std::optional<size_t> declaration = top_level_declaration(statements, name);
+            if (!declaration)
+                continue;
+            usage use = use_outside(statements, *declaration, name);
+            if (!use.read && !use.changed)
+                statements.erase(statements.begin() + static_cast<std::ptrdiff_t>(*declaration));
+        }
+        return pass.unrolled;
+    }
+}
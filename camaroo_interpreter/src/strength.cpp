@@ -0,0 +1,319 @@
+#include <strength.h>
+#include <optimize.h>
+#include <stdexcept>
+#include <string>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace camaroo_core {
+
+    namespace {
+
+        using plan_kind = IntPlan::kind;
+
+        // Everything wraps, like the evaluator's integer arithmetic
+        int64_t wrap(uint64_t value) { return static_cast<int64_t>(value); }
+        uint64_t bits(int64_t value) { return static_cast<uint64_t>(value); }
+
+        uint64_t magnitude(int64_t value) {
+            return value < 0 ? 0 - bits(value) : bits(value);
+        }
+
+        bool is_power_of_two(uint64_t value) {
+            return value != 0 && (value & (value - 1)) == 0;
+        }
+
+        uint8_t log2(uint64_t value) {
+            uint8_t result = 0;
+            while (value >>= 1)
+                ++result;
+            return result;
+        }
+
+        // High half of the 128-bit product
+        int64_t multiply_high(int64_t a, int64_t b) {
+#if defined(_MSC_VER)
+            return __mulh(a, b);
+#else
+            return static_cast<int64_t>((static_cast<__int128>(a) * b) >> 64);
+#endif
+        }
+
+        // Magic number and shift for signed division by a constant, Hacker's Delight 10-1. |divisor| >= 2
+        void find_magic(int64_t divisor, int64_t& magic, uint8_t& shift) {
+            const uint64_t two63 = uint64_t(1) << 63;
+            uint64_t absolute = magnitude(divisor);
+            uint64_t t = two63 + (bits(divisor) >> 63);
+            uint64_t absolute_nc = t - 1 - t % absolute;
+            int p = 63;
+            uint64_t q1 = two63 / absolute_nc, r1 = two63 - q1 * absolute_nc;
+            uint64_t q2 = two63 / absolute, r2 = two63 - q2 * absolute;
+            uint64_t delta;
+            do {
+                ++p;
+                q1 *= 2;
+                r1 *= 2;
+                if (r1 >= absolute_nc) {
+                    ++q1;
+                    r1 -= absolute_nc;
+                }
+                q2 *= 2;
+                r2 *= 2;
+                if (r2 >= absolute) {
+                    ++q2;
+                    r2 -= absolute;
+                }
+                delta = absolute - r2;
+            } while (q1 < delta || (q1 == delta && r1 == 0));
+
+            magic = divisor < 0 ? wrap(0 - (q2 + 1)) : wrap(q2 + 1);
+            shift = static_cast<uint8_t>(p - 64);
+        }
+
+        // Rounds toward zero like /, negative values get 2^shift - 1 added before the shift
+        int64_t divide_pow2(int64_t value, uint8_t shift) {
+            int64_t bias = wrap(bits(value >> 63) >> (64 - shift));
+            return (value + bias) >> shift;
+        }
+
+        int64_t divide_magic(int64_t value, const IntPlan::op& step) {
+            uint64_t quotient = bits(multiply_high(step.magic, value));
+            if (step.divisor > 0 && step.magic < 0)
+                quotient += bits(value);
+            else if (step.divisor < 0 && step.magic > 0)
+                quotient -= bits(value);
+            int64_t shifted = wrap(quotient) >> step.shift;
+            return shifted + wrap(bits(shifted) >> 63);
+        }
+
+        // Divisions and remainders by divisor, which isn't 0, 1, -1 or INT64_MIN
+        IntPlan::op by_constant(int64_t divisor, bool remainder) {
+            IntPlan::op step{};
+            step.divisor = divisor;
+            uint64_t absolute = magnitude(divisor);
+            if (is_power_of_two(absolute)) {
+                step.what = remainder ? plan_kind::modulo_pow2 : plan_kind::divide_pow2;
+                step.shift = log2(absolute);
+            }
+            else {
+                step.what = remainder ? plan_kind::modulo_magic : plan_kind::divide_magic;
+                find_magic(divisor, step.magic, step.shift);
+            }
+            return step;
+        }
+
+        class plan_builder {
+        public:
+            void add(int64_t constant) { addend += bits(constant); }
+            // constant - value
+            void subtract_from(int64_t constant) {
+                multiplier = 0 - multiplier;
+                addend = bits(constant) - addend;
+            }
+            void multiply(int64_t constant) {
+                multiplier *= bits(constant);
+                addend *= bits(constant);
+            }
+
+            void divide(int64_t divisor) {
+                if (divisor == 1)
+                    return;
+                if (divisor == -1) {
+                    // Wraps for INT64_MIN the same way the evaluator does
+                    multiply(-1);
+                    return;
+                }
+                flush();
+                if (divisor == 0) {
+                    plan.ops.push_back(IntPlan::op{plan_kind::zero_divisor});
+                    return;
+                }
+                if (divisor == INT64_MIN) {
+                    IntPlan::op step{plan_kind::divide};
+                    step.divisor = divisor;
+                    plan.ops.push_back(step);
+                    return;
+                }
+                // (x / a) / b is x / (a * b) for positive a and b, as long as a * b fits
+                if (!plan.ops.empty() && divisor > 0) {
+                    const IntPlan::op& last = plan.ops.back();
+                    bool divides = last.what == plan_kind::divide_pow2 || last.what == plan_kind::divide_magic;
+                    if (divides && last.divisor > 0 && last.divisor <= INT64_MAX / divisor) {
+                        int64_t combined = last.divisor * divisor;
+                        plan.ops.pop_back();
+                        plan.ops.push_back(by_constant(combined, false));
+                        return;
+                    }
+                }
+                plan.ops.push_back(by_constant(divisor, false));
+            }
+
+            void modulo(int64_t divisor) {
+                if (divisor == 1 || divisor == -1) {
+                    multiplier = 0;
+                    addend = 0;
+                    return;
+                }
+                flush();
+                if (divisor == 0) {
+                    plan.ops.push_back(IntPlan::op{plan_kind::zero_divisor});
+                    return;
+                }
+                if (divisor == INT64_MIN) {
+                    IntPlan::op step{plan_kind::modulo};
+                    step.divisor = divisor;
+                    plan.ops.push_back(step);
+                    return;
+                }
+                plan.ops.push_back(by_constant(divisor, true));
+            }
+
+            IntPlan finish() {
+                flush();
+                return std::move(plan);
+            }
+        private:
+            // Every run of + - * is one value * multiplier + addend
+            void flush() {
+                if (multiplier == 1 && addend == 0)
+                    return;
+                IntPlan::op step{plan_kind::affine};
+                step.multiplier = wrap(multiplier);
+                step.addend = wrap(addend);
+                if (multiplier > 1 && is_power_of_two(multiplier))
+                    step.shift = log2(multiplier);
+                plan.ops.push_back(step);
+                multiplier = 1;
+                addend = 0;
+            }
+
+            IntPlan plan;
+            uint64_t multiplier = 1;
+            uint64_t addend = 0;
+        };
+
+        bool is_chain_op(TokenType type) {
+            return type == TokenType::add || type == TokenType::subtract || type == TokenType::multiply ||
+                   type == TokenType::division || type == TokenType::modulo;
+        }
+
+        void reduce(std::unique_ptr<ExpressionNode>& slot, size_t& chains) {
+            slot->visit_expressions([&](std::unique_ptr<ExpressionNode>& child) {
+                if (child)
+                    reduce(child, chains);
+            });
+            if (slot->node_kind() != NodeKind::infix || !is_chain_op(slot->token_type()))
+                return;
+
+            std::unique_ptr<ExpressionNode>* sides[2] = {nullptr, nullptr};
+            size_t side = 0;
+            slot->visit_expressions([&](std::unique_ptr<ExpressionNode>& child) { sides[side++] = &child; });
+            if (!*sides[0] || !*sides[1])
+                return;
+
+            // 2 * 3 takes the left literal as its operand
+            bool constant_left = (*sides[0])->node_kind() == NodeKind::num && (*sides[1])->node_kind() != NodeKind::num;
+            if (!constant_left && (*sides[1])->node_kind() != NodeKind::num)
+                return;
+            TokenType type = slot->token_type();
+            // 8 / x divides by the value, nothing to plan
+            if (constant_left && (type == TokenType::division || type == TokenType::modulo))
+                return;
+
+            std::unique_ptr<ExpressionNode>& constant = constant_left ? *sides[0] : *sides[1];
+            std::unique_ptr<ExpressionNode>& operand = constant_left ? *sides[1] : *sides[0];
+            ArithStep step{Token{type, std::get<std::string>(slot->token_value())},
+                           Token{TokenType::num, constant->to_string()},
+                           std::get<int64_t>(constant->token_value()), constant_left};
+
+            std::vector<ArithStep> steps;
+            std::unique_ptr<ExpressionNode> inner;
+            if (operand->node_kind() == NodeKind::arith_chain) {
+                steps = static_cast<ArithChainExpr*>(operand.get())->get_steps();
+                operand->visit_expressions([&](std::unique_ptr<ExpressionNode>& chained) { inner = std::move(chained); });
+                --chains;
+            }
+            else {
+                inner = std::move(operand);
+            }
+            steps.push_back(std::move(step));
+
+            IntPlan plan = plan_steps(steps);
+            slot = std::make_unique<ArithChainExpr>(std::move(inner), std::move(steps), std::move(plan));
+            ++chains;
+        }
+    }
+
+    int64_t IntPlan::apply(int64_t value) const {
+        for (const op& step : ops) {
+            switch (step.what) {
+                case kind::affine: {
+                    uint64_t scaled = step.shift ? bits(value) << step.shift : bits(value) * bits(step.multiplier);
+                    value = wrap(scaled + bits(step.addend));
+                    break;
+                }
+                case kind::divide_pow2: {
+                    int64_t quotient = divide_pow2(value, step.shift);
+                    value = step.divisor < 0 ? wrap(0 - bits(quotient)) : quotient;
+                    break;
+                }
+                case kind::divide_magic:
+                    value = divide_magic(value, step);
+                    break;
+                case kind::modulo_pow2:
+                    value = wrap(bits(value) - (bits(divide_pow2(value, step.shift)) << step.shift));
+                    break;
+                case kind::modulo_magic:
+                    value = wrap(bits(value) - bits(divide_magic(value, step)) * bits(step.divisor));
+                    break;
+                case kind::divide:
+                    value = value / step.divisor;
+                    break;
+                case kind::modulo:
+                    value = value % step.divisor;
+                    break;
+                case kind::zero_divisor:
+                    throw std::runtime_error("Error: division by zero");
+            }
+        }
+        return value;
+    }
+
+    IntPlan plan_steps(const std::vector<ArithStep>& steps) {
+        plan_builder builder;
+        for (const ArithStep& step : steps) {
+            switch (step.op.type) {
+                case TokenType::add:
+                    builder.add(step.value);
+                    break;
+                case TokenType::subtract:
+                    if (step.constant_left)
+                        builder.subtract_from(step.value);
+                    else
+                        builder.add(wrap(0 - bits(step.value)));
+                    break;
+                case TokenType::multiply:
+                    builder.multiply(step.value);
+                    break;
+                case TokenType::division:
+                    builder.divide(step.value);
+                    break;
+                case TokenType::modulo:
+                    builder.modulo(step.value);
+                    break;
+                default:
+                    throw std::runtime_error("Error: " + step.op.value + " can't be part of an arithmetic chain");
+            }
+        }
+        return builder.finish();
+    }
+
+    size_t reduce_strength(const std::vector<std::unique_ptr<StatementNode>>& statements) {
+        size_t chains = 0;
+        for (const auto& statement : statements)
+            visit_expression_roots(statement.get(), [&](std::unique_ptr<ExpressionNode>& slot) { reduce(slot, chains); });
+        return chains;
+    }
+}
@@ -0,0 +1,324 @@
+#include <task_scheduler.h>
+#include <thread_pool.h>
+#include <cstdint>
+#include <new>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+#endif
+
+namespace camaroo_core {
+
+    struct task_scheduler::task {
+        std::function<void()> body;
+        task_scheduler* owner = nullptr;
+        size_t call_depth = 0;
+        // Set by a task on its way to park, its runner puts it on the list once it is off the task's stack
+        wait_list* parking_on = nullptr;
+        const std::function<bool()>* still_blocked = nullptr;
+        bool finished = false;
+#ifndef _WIN32
+        void* stack = nullptr;
+        ucontext_t context;
+#endif
+    };
+
+    namespace {
+        thread_local task_scheduler* current_scheduler = nullptr;
+        thread_local task_scheduler::task* current_task = nullptr;
+        thread_local size_t current_depth = 0;
+
+        // Past this many runners a program that blocks every one of them is deadlocked for real
+        constexpr size_t max_runners = 256;
+        constexpr size_t max_spare_stacks = 64;
+
+#ifndef _WIN32
+        // As much as a main thread gets, only the pages a task's calls reach are ever committed
+        constexpr size_t stack_size = 8 << 20;
+
+        thread_local ucontext_t runner_context;
+
+        // A task can be resumed on another runner than the one it left, and compilers keep thread_local
+        // addresses around within a function, so code on a task's stack looks its runner up through a call
+        [[gnu::noinline]] ucontext_t* this_runner() {
+            return &runner_context;
+        }
+
+        size_t guard_size() {
+            return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        }
+
+        void task_entry(unsigned high, unsigned low) {
+            auto* current = reinterpret_cast<task_scheduler::task*>(
+                static_cast<uintptr_t>((static_cast<uint64_t>(high) << 32) | low));
+            try {
+                current->body();
+            }
+            catch (...) {
+                // Tasks report their own errors, nobody is left to rethrow to
+            }
+            // Whatever the task captured may wait while it is destroyed, so that happens here where it can still park
+            current->body = nullptr;
+            current->finished = true;
+            setcontext(this_runner());
+        }
+#endif
+    }
+
+    task_scheduler::task_scheduler(size_t runner_count)
+        :base_count(runner_count ? runner_count : 1) {}
+
+    task_scheduler::~task_scheduler() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        ready.notify_all();
+        for (auto& runner : runners)
+            runner.join();
+#ifndef _WIN32
+        for (void* stack : spare_stacks)
+            munmap(stack, stack_size + guard_size());
+#endif
+    }
+
+    task_scheduler& task_scheduler::shared() {
+        static task_scheduler scheduler(thread_pool::shared().size());
+        return scheduler;
+    }
+
+    size_t& task_scheduler::call_depth() {
+        return current_depth;
+    }
+
+    void task_scheduler::start_runner() {
+        runners.emplace_back([this]() { runner_loop(); });
+    }
+
+    void task_scheduler::spawn(std::function<void()> body) {
+        auto* created = new task();
+        created->body = std::move(body);
+        created->owner = this;
+        resume(created);
+    }
+
+    void task_scheduler::resume(task* parked) {
+        std::lock_guard<std::mutex> guard(lock);
+        queue.push_back(parked);
+        if (idle > 0) {
+            ready.notify_one();
+        } else if (runners.size() < base_count ||
+                   (runners.size() == blocked && runners.size() < max_runners)) {
+            start_runner();
+        }
+    }
+
+    void task_scheduler::runner_loop() {
+        current_scheduler = this;
+        std::unique_lock<std::mutex> guard(lock);
+        while (true) {
+            while (queue.empty() && !stopping) {
+                ++idle;
+                ready.wait(guard);
+                --idle;
+            }
+            if (queue.empty())
+                return;
+
+            task* next = queue.front();
+            queue.pop_front();
+            guard.unlock();
+            run(next);
+            guard.lock();
+        }
+    }
+
+    void task_scheduler::run(task* current) {
+#ifndef _WIN32
+        if (!current->stack) {
+            current->stack = take_stack();
+            getcontext(&current->context);
+            current->context.uc_stack.ss_sp = static_cast<char*>(current->stack) + guard_size();
+            current->context.uc_stack.ss_size = stack_size;
+            current->context.uc_link = nullptr;
+            auto address = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(current));
+            makecontext(&current->context, reinterpret_cast<void (*)()>(&task_entry), 2,
+                        static_cast<unsigned>(address >> 32), static_cast<unsigned>(address));
+        }
+
+        size_t runner_depth = current_depth;
+        current_depth = current->call_depth;
+        current_task = current;
+        swapcontext(&runner_context, &current->context);
+        current_task = nullptr;
+        current->call_depth = current_depth;
+        current_depth = runner_depth;
+
+        if (current->finished) {
+            give_back_stack(current->stack);
+            delete current;
+            return;
+        }
+
+        // Parked only now that nothing runs on its stack, a wake_all can't resume it while it is still leaving
+        wait_list* list = current->parking_on;
+        current->parking_on = nullptr;
+        {
+            std::lock_guard<std::mutex> guard(list->lock);
+            // Counted before the check, and wakers bump what they change before reading the count, so one side always sees the other
+            list->count.fetch_add(1);
+            if ((*current->still_blocked)()) {
+                list->parked.push_back(current);
+                return;
+            }
+            list->count.fetch_sub(1);
+        }
+        resume(current);
+#else
+        try {
+            current->body();
+        }
+        catch (...) {
+        }
+        current->body = nullptr;
+        delete current;
+#endif
+    }
+
+    void* task_scheduler::take_stack() {
+#ifndef _WIN32
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (!spare_stacks.empty()) {
+                void* stack = spare_stacks.back();
+                spare_stacks.pop_back();
+                return stack;
+            }
+        }
+        // The lowest page stays unmapped so a task overrunning its stack faults instead of writing over something else
+        void* stack = mmap(nullptr, stack_size + guard_size(), PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+        if (stack == MAP_FAILED)
+            throw std::bad_alloc();
+        mprotect(stack, guard_size(), PROT_NONE);
+        return stack;
+#else
+        return nullptr;
+#endif
+    }
+
+    void task_scheduler::give_back_stack(void* stack) {
+#ifndef _WIN32
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (spare_stacks.size() < max_spare_stacks) {
+                spare_stacks.push_back(stack);
+                return;
+            }
+        }
+        munmap(stack, stack_size + guard_size());
+#else
+        (void)stack;
+#endif
+    }
+
+    bool task_scheduler::wait_list::park(const std::function<bool()>& still_blocked) {
+#ifndef _WIN32
+        task* current = current_task;
+        if (!current)
+            return false;
+        current->parking_on = this;
+        current->still_blocked = &still_blocked;
+        swapcontext(&current->context, this_runner());
+        return true;
+#else
+        (void)still_blocked;
+        return false;
+#endif
+    }
+
+    void task_scheduler::wait_list::wake_one() {
+        if (count.load() == 0)
+            return;
+        task* woken = nullptr;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (parked.empty())
+                return;
+            woken = parked.front();
+            parked.pop_front();
+            count.fetch_sub(1);
+        }
+        woken->owner->resume(woken);
+    }
+
+    void task_scheduler::wait_list::wake_all() {
+        if (count.load() == 0)
+            return;
+        std::deque<task*> woken;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            woken.swap(parked);
+            count.store(0);
+        }
+        for (task* parked_task : woken)
+            parked_task->owner->resume(parked_task);
+    }
+
+    task_scheduler::blocking_scope::blocking_scope()
+        :owner(current_scheduler)
+    {
+        if (!owner)
+            return;
+        std::lock_guard<std::mutex> guard(owner->lock);
+        ++owner->blocked;
+        if (!owner->queue.empty() && owner->idle == 0 &&
+            owner->runners.size() == owner->blocked && owner->runners.size() < max_runners)
+            owner->start_runner();
+    }
+
+    task_scheduler::blocking_scope::~blocking_scope() {
+        if (!owner)
+            return;
+        std::lock_guard<std::mutex> guard(owner->lock);
+        --owner->blocked;
+    }
+
+    void task_group::spawn(task_scheduler& scheduler, std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            ++pending;
+        }
+        scheduler.spawn([this, task = std::move(task)]() {
+            try {
+                task();
+            }
+            catch (...) {
+            }
+            // Notifying under the lock keeps the group alive until wait() has seen the last task finish
+            std::lock_guard<std::mutex> guard(lock);
+            if (--pending == 0) {
+                finished.notify_all();
+                waiters.wake_all();
+            }
+        });
+    }
+
+    void task_group::wait() {
+        // A task waiting on the ones it spawned parks and leaves its runner to them
+        while (pending.load() != 0 && waiters.park([this]() { return pending.load() != 0; })) {
+        }
+
+        std::unique_lock<std::mutex> guard(lock, std::defer_lock);
+        if (pending.load() == 0) {
+            // The last task may still be on its way out of wake_all
+            guard.lock();
+            return;
+        }
+        task_scheduler::blocking_scope blocking;
+        guard.lock();
+        finished.wait(guard, [this]() { return pending.load() == 0; });
+    }
+}
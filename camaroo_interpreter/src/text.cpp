@@ -0,0 +1,172 @@
+#include <text.h>
+#include <algorithm>
+#include <vector>
+
+namespace camaroo_core {
+
+    camaroo_text::node::~node() {
+        if (!left && !right)
+            return;
+        // Text built a piece at a time is a long chain of nodes, taking it apart here a node at a time keeps the
+        // destructors from recursing down the whole chain. Only the last owner of a node can take it apart
+        std::vector<std::shared_ptr<const node>> pending;
+        pending.push_back(std::move(left));
+        pending.push_back(std::move(right));
+        while (!pending.empty()) {
+            std::shared_ptr<const node> current = std::move(pending.back());
+            pending.pop_back();
+            if (current && current.use_count() == 1) {
+                node& last = const_cast<node&>(*current);
+                if (last.left)
+                    pending.push_back(std::move(last.left));
+                if (last.right)
+                    pending.push_back(std::move(last.right));
+            }
+        }
+    }
+
+    camaroo_text::camaroo_text(std::string_view text) {
+        if (text.size() <= inline_capacity) {
+            length = static_cast<uint8_t>(text.size());
+            text.copy(small, text.size());
+        } else {
+            shared = std::make_shared<const node>(text);
+        }
+    }
+
+    camaroo_text camaroo_text::take(std::string&& text) {
+        if (text.size() <= inline_capacity)
+            return camaroo_text(std::string_view(text));
+        return camaroo_text(std::make_shared<const node>(std::move(text)));
+    }
+
+    std::shared_ptr<const camaroo_text::node> camaroo_text::as_node() const {
+        return shared ? shared : std::make_shared<const node>(std::string_view(small, length));
+    }
+
+    template <typename Visit>
+    void camaroo_text::for_each_piece(const node& root, Visit&& visit) {
+        std::vector<const node*> pending{&root};
+        while (!pending.empty()) {
+            const node* current = pending.back();
+            pending.pop_back();
+            if (current->flat.load(std::memory_order_acquire)) {
+                visit(current->span);
+                continue;
+            }
+            pending.push_back(current->right.get());
+            pending.push_back(current->left.get());
+        }
+    }
+
+    std::string_view camaroo_text::view() const {
+        if (!shared)
+            return std::string_view(small, length);
+        const node& whole = *shared;
+        if (!whole.flat.load(std::memory_order_acquire)) {
+            std::call_once(whole.joining, [&]() {
+                std::string text;
+                text.reserve(whole.length);
+                for_each_piece(whole, [&](std::string_view piece) { text.append(piece); });
+                whole.text = std::move(text);
+                whole.span = whole.text;
+                whole.flat.store(true, std::memory_order_release);
+            });
+        }
+        return whole.span;
+    }
+
+    camaroo_text camaroo_text::slice(size_t offset, size_t count) const {
+        std::string_view whole = view();
+        offset = std::min(offset, whole.size());
+        count = std::min(count, whole.size() - offset);
+        if (count == whole.size())
+            return *this;
+        if (count <= inline_capacity)
+            return camaroo_text(whole.substr(offset, count));
+        // Slices of slices point into the same text as their parent, so a slice never keeps a chain alive
+        std::shared_ptr<const node> base = shared->base ? shared->base : shared;
+        return camaroo_text(std::make_shared<const node>(std::move(base), whole.substr(offset, count)));
+    }
+
+    void camaroo_text::write(std::ostream& out) const {
+        if (!shared) {
+            out.write(small, length);
+            return;
+        }
+        for_each_piece(*shared, [&](std::string_view piece) {
+            out.write(piece.data(), static_cast<std::streamsize>(piece.size()));
+        });
+    }
+
+    camaroo_text operator+(const camaroo_text& left, const camaroo_text& right) {
+        if (right.empty())
+            return left;
+        if (left.empty())
+            return right;
+
+        size_t total = left.size() + right.size();
+        // Texts this short are never joined nodes, so view() doesn't join anything
+        if (total <= camaroo_text::flat_limit) {
+            std::string joined;
+            joined.reserve(total);
+            joined.append(left.view()).append(right.view());
+            return camaroo_text(std::string_view(joined));
+        }
+
+        auto joined = std::make_shared<camaroo_text::node>();
+        joined->length = total;
+        const camaroo_text::node* last = left.shared ? left.shared->right.get() : nullptr;
+        if (last && !last->left && last->length + right.size() <= camaroo_text::flat_limit) {
+            // A short piece going on the end joins the chunk left ends with. The old chain stays as it was for
+            // whoever still has it, the new one shares everything but the last chunk
+            std::string chunk;
+            chunk.reserve(last->length + right.size());
+            chunk.append(last->span).append(right.view());
+            joined->left = left.shared->left;
+            joined->right = std::make_shared<const camaroo_text::node>(std::string_view(chunk));
+        } else {
+            joined->left = left.as_node();
+            joined->right = right.as_node();
+        }
+        return camaroo_text(std::shared_ptr<const camaroo_text::node>(std::move(joined)));
+    }
+
+    char32_t decode_utf8(std::string_view text, size_t offset, size_t& used) {
+        unsigned char lead = static_cast<unsigned char>(text[offset]);
+        size_t length = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 0;
+        if (length <= 1 || offset + length > text.size()) {
+            used = 1;
+            return lead;
+        }
+        char32_t letter = lead & (0x7F >> length);
+        for (size_t i = 1; i < length; ++i) {
+            unsigned char next = static_cast<unsigned char>(text[offset + i]);
+            if ((next & 0xC0) != 0x80) {
+                used = 1;
+                return lead;
+            }
+            letter = (letter << 6) | (next & 0x3F);
+        }
+        used = length;
+        return letter;
+    }
+
+    void append_utf8(std::string& out, char32_t letter) {
+        if (letter < 0x80) {
+            out += static_cast<char>(letter);
+        } else if (letter < 0x800) {
+            out += static_cast<char>(0xC0 | (letter >> 6));
+            out += static_cast<char>(0x80 | (letter & 0x3F));
+        } else if (letter < 0x10000) {
+            out += static_cast<char>(0xE0 | (letter >> 12));
+            out += static_cast<char>(0x80 | ((letter >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (letter & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (letter >> 18));
+            out += static_cast<char>(0x80 | ((letter >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((letter >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (letter & 0x3F));
+        }
+    }
+}
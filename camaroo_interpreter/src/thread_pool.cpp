@@ -0,0 +1,198 @@
+#include <thread_pool.h>
+#include <algorithm>
+
+namespace camaroo_core {
+
+    namespace {
+        // Lets a thread find its own queue, threads outside of any pool use the pool's shared queue
+        thread_local const thread_pool* worker_pool = nullptr;
+        thread_local size_t worker_index = 0;
+
+        std::atomic<size_t> shared_thread_count{0};
+    }
+
+    struct thread_pool::loop_job {
+        loop_job(thread_pool* pool, const std::function<void(size_t, size_t)>* body, size_t count, size_t grain, size_t chunks)
+            :pool(pool), body(body), count(count), grain(grain), remaining(chunks) {}
+
+        thread_pool* pool;
+        const std::function<void(size_t, size_t)>* body;
+        size_t count;
+        size_t grain;
+        std::atomic<size_t> remaining;
+        std::atomic<bool> failed{false};
+        std::mutex error_lock;
+        std::exception_ptr error;
+    };
+
+    thread_pool::thread_pool(size_t thread_count) {
+        size_t worker_count = (thread_count > 1) ? thread_count - 1 : 0;
+        for (size_t i = 0; i < worker_count + 1; ++i)
+            queues.push_back(std::make_unique<work_queue>());
+        for (size_t i = 0; i < worker_count; ++i)
+            workers.emplace_back([this, i]() { worker_loop(i); });
+    }
+
+    thread_pool::~thread_pool() {
+        wait_idle();
+        {
+            std::lock_guard<std::mutex> guard(sleep_lock);
+            stopping = true;
+        }
+        wake_up.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    thread_pool& thread_pool::shared() {
+        static thread_pool pool([]() -> size_t {
+            size_t requested = shared_thread_count.load();
+            if (requested != 0)
+                return requested;
+            return std::max<size_t>(1, std::thread::hardware_concurrency());
+        }());
+        return pool;
+    }
+
+    void thread_pool::set_shared_threads(size_t thread_count) {
+        shared_thread_count = thread_count;
+    }
+
+    void thread_pool::push(const task& new_task) {
+        size_t own = (worker_pool == this) ? worker_index : queues.size() - 1;
+        {
+            std::lock_guard<std::mutex> guard(queues[own]->lock);
+            queues[own]->tasks.push_back(new_task);
+        }
+        ++queued;
+        if (sleepers.load() > 0) {
+            std::lock_guard<std::mutex> guard(sleep_lock);
+            wake_up.notify_one();
+        }
+    }
+
+    bool thread_pool::pop_or_steal(task& found) {
+        if (queued.load() == 0)
+            return false;
+
+        size_t own = (worker_pool == this) ? worker_index : queues.size() - 1;
+        {
+            std::lock_guard<std::mutex> guard(queues[own]->lock);
+            if (!queues[own]->tasks.empty()) {
+                found = queues[own]->tasks.back();
+                queues[own]->tasks.pop_back();
+                --queued;
+                return true;
+            }
+        }
+
+        for (size_t offset = 1; offset < queues.size(); ++offset) {
+            work_queue& victim = *queues[(own + offset) % queues.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.tasks.empty()) {
+                found = victim.tasks.front();
+                victim.tasks.pop_front();
+                --queued;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool thread_pool::run_one() {
+        task found;
+        if (!pop_or_steal(found))
+            return false;
+        found.run(found.context, found.first, found.last);
+        return true;
+    }
+
+    void thread_pool::worker_loop(size_t index) {
+        worker_pool = this;
+        worker_index = index;
+        while (!stopping.load()) {
+            if (run_one())
+                continue;
+
+            ++sleepers;
+            {
+                std::unique_lock<std::mutex> guard(sleep_lock);
+                wake_up.wait(guard, [this]() { return queued.load() > 0 || stopping.load(); });
+            }
+            --sleepers;
+        }
+    }
+
+    void thread_pool::run_loop_chunks(void* context, size_t first, size_t last) {
+        loop_job* job = static_cast<loop_job*>(context);
+        // Hand the upper half to thieves until a single chunk is left, big ranges get stolen first
+        while (last - first > 1) {
+            size_t middle = first + (last - first) / 2;
+            job->pool->push(task{run_loop_chunks, job, middle, last});
+            last = middle;
+        }
+
+        if (!job->failed.load()) {
+            try {
+                size_t begin = first * job->grain;
+                (*job->body)(begin, std::min(begin + job->grain, job->count));
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> guard(job->error_lock);
+                if (!job->error)
+                    job->error = std::current_exception();
+                job->failed = true;
+            }
+        }
+        job->remaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    void thread_pool::parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body) {
+        if (count == 0)
+            return;
+        grain = std::max<size_t>(grain, 1);
+        size_t chunks = (count + grain - 1) / grain;
+
+        if (chunks == 1 || workers.empty()) {
+            for (size_t begin = 0; begin < count; begin += grain)
+                body(begin, std::min(begin + grain, count));
+            return;
+        }
+
+        loop_job job(this, &body, count, grain, chunks);
+        run_loop_chunks(&job, 0, chunks);
+        while (job.remaining.load(std::memory_order_acquire) > 0) {
+            if (!run_one())
+                std::this_thread::yield();
+        }
+
+        if (job.error)
+            std::rethrow_exception(job.error);
+    }
+
+    void thread_pool::run_submitted(void* context, size_t, size_t) {
+        std::unique_ptr<std::function<void()>> fn(static_cast<std::function<void()>*>(context));
+        (*fn)();
+    }
+
+    void thread_pool::submit(std::function<void()> fn) {
+        ++outstanding;
+        auto* boxed = new std::function<void()>([this, fn = std::move(fn)]() {
+            try {
+                fn();
+            }
+            catch (...) {
+                // Submitted work reports its own errors, nobody is left to rethrow to
+            }
+            --outstanding;
+        });
+        push(task{run_submitted, boxed, 0, 0});
+    }
+
+    void thread_pool::wait_idle() {
+        while (outstanding.load() > 0) {
+            if (!run_one())
+                std::this_thread::yield();
+        }
+    }
+}
@@ -28,9 +28,9 @@ namespace camaroo_core {
     }
 
     TokenType Tokenizer::check_std_type(const std::string& result) {
-        if (result == "num") {
+        if (result == "num" || result == "num8" || result == "num16" || result == "num32" || result == "num64") {
             return TokenType::num_type;
-        } else if (result == "fnum") {
+        } else if (result == "fnum" || result == "fnum32" || result == "fnum64") {
             return TokenType::fnum_type;
         } else if (result == "text") {
             return TokenType::text_type;
@@ -38,8 +38,24 @@ namespace camaroo_core {
             return TokenType::letter_type;
         } else if (result == "func") {
             return TokenType::func_type;
+        } else if (result == "gen") {
+            return TokenType::gen_type;
+        } else if (result == "return") {
+            return TokenType::return_keyword;
+        } else if (result == "yield") {
+            return TokenType::yield_keyword;
+        } else if (result == "use") {
+            return TokenType::use_keyword;
         } else if (result == "toggle") {
             return TokenType::toggle_type;
+        } else if (result == "list") {
+            return TokenType::list_type;
+        } else if (result == "channel") {
+            return TokenType::channel_type;
+        } else if (result == "map") {
+            return TokenType::map_type;
+        } else if (result == "spawn") {
+            return TokenType::spawn_keyword;
         } else if (result == "true" || result == "false") {
             return TokenType::toggle;
         } else if (result == "or") {
@@ -52,11 +68,107 @@ namespace camaroo_core {
             return TokenType::print;
         } else if (result == "println") {
             return TokenType::println;
+        } else if (result == "for") {
+            return TokenType::for_keyword;
+        } else if (result == "in") {
+            return TokenType::in_keyword;
+        } else if (result == "to") {
+            return TokenType::to_keyword;
+        } else if (result == "parallel") {
+            return TokenType::parallel_keyword;
+        } else if (result == "reduce") {
+            return TokenType::reduce_keyword;
         } else {
             return TokenType::identifier;
         }
     }
 
+    bool Tokenizer::copy_slot(std::string& into) {
+        size_t depth = 0;
+        while (current_char != '\0' && current_char != '\n') {
+            char c = current_char;
+            into += c;
+            advance();
+            if (c == '\"') {
+                // Text inside a slot is copied as written too, the slot is parsed again later
+                while (current_char != '\0' && current_char != '\n' && current_char != '\"') {
+                    if (current_char == '\\') {
+                        into += current_char;
+                        advance();
+                        if (current_char == '\0' || current_char == '\n')
+                            return false;
+                    }
+                    into += current_char;
+                    advance();
+                }
+                if (current_char != '\"')
+                    return false;
+                into += current_char;
+                advance();
+            } else if (c == '\'') {
+                // So is a letter, a quote, maybe a backslash, then the letter and the bytes of it that follow
+                if (current_char == '\\') {
+                    into += current_char;
+                    advance();
+                }
+                if (current_char == '\0' || current_char == '\n')
+                    return false;
+                into += current_char;
+                advance();
+                while ((static_cast<unsigned char>(current_char) & 0xC0) == 0x80) {
+                    into += current_char;
+                    advance();
+                }
+                if (current_char == '\'') {
+                    into += current_char;
+                    advance();
+                }
+            } else if (c == '{') {
+                ++depth;
+            } else if (c == '}' && --depth == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool Tokenizer::skip_block() {
+        size_t depth = 1;
+        size_t at = pos;
+        while (at < text.length()) {
+            char c = text[at];
+            if (c == '\"') {
+                // Braces in text don't count, and neither does an escaped quote
+                ++at;
+                while (at < text.length() && text[at] != '\"')
+                    at += (text[at] == '\\') ? 2 : 1;
+            }
+            else if (c == '\'') {
+                // A quote, maybe a backslash, then the letter and the bytes of it that follow
+                at += (at + 1 < text.length() && text[at + 1] == '\\') ? 3 : 2;
+                while (at < text.length() && (static_cast<unsigned char>(text[at]) & 0xC0) == 0x80)
+                    ++at;
+                ++at;
+                continue;
+            }
+            else if (c == '/' && at + 1 < text.length() && text[at + 1] == '/') {
+                while (at < text.length() && text[at] != '\n')
+                    ++at;
+                continue;
+            }
+            else if (c == '{') {
+                ++depth;
+            }
+            else if (c == '}' && --depth == 0) {
+                pos = at + 1;
+                current_char = pos < text.length() ? text[pos] : '\0';
+                return true;
+            }
+            ++at;
+        }
+        return false;
+    }
+
     std::optional<Token> Tokenizer::peek_next_token() {
         std::optional<Token> temp_token = next_token();
         pos -= token_size;
@@ -88,7 +200,7 @@ namespace camaroo_core {
             if (current_char == '/') {
                 advance();
                 if (current_char == '/') {
-                    while (current_char != '\n') {
+                    while (current_char != '\n' && current_char != '\0') {
                         advance();
                     }
                 }
@@ -98,51 +210,87 @@ namespace camaroo_core {
             }
 
             if (current_char == '\'') {
+                // Escapes are decoded here like they are in text, what's between the quotes is the letter itself,
+                // one byte or the bytes of one UTF-8 character
                 std::string result = "\'";
                 advance();
                 if (current_char == '\\') {
+                    advance();
+                    char escaped = current_char;
+                    if (current_char == 'n') {
+                        escaped = '\n';
+                    } else if (current_char == 't') {
+                        escaped = '\t';
+                    } else if (current_char == 'r') {
+                        escaped = '\r';
+                    } else if (current_char == '0') {
+                        escaped = '\0';
+                    }
+                    result += escaped;
+                    advance();
+                } else if (current_char != '\'' && current_char != '\0') {
                     result += current_char;
                     advance();
+                    while ((static_cast<unsigned char>(current_char) & 0xC0) == 0x80) {
+                        result += current_char;
+                        advance();
+                    }
                 }
-                result += current_char;
-                advance();
+                if (current_char != '\'')
+                    return(Token{TokenType::unknown, result});
                 result += current_char;
                 advance();
                 return(Token{TokenType::letter, result});
             }
 
             if (current_char == '\"') {
+                // Literals with a {slot} come out as format tokens, everything else as plain text
                 std::string result = "\"";
+                std::string format = "\"";
+                bool slots = false;
                 advance();
                 while (true) {
                     if (current_char == '\0')
                         break;
                     if (current_char == '\"') {
                         result += current_char;
+                        format += current_char;
                         advance();
                         break;
                     }
+                    if (current_char == '{') {
+                        slots = true;
+                        // An unclosed slot ends the literal with the line, the parser reports it there
+                        if (!copy_slot(format))
+                            break;
+                        continue;
+                    }
                     if (current_char == '\\') {
                         advance();
+                        char escaped = '\\';
                         if (current_char == 'n') {
-                            result += '\n';
+                            escaped = '\n';
                         } else if (current_char == 't') {
-                            result += '\t';
-                        } else if (current_char == '\"') {
-                            result += '\"';
-                        }
-                        else if (current_char == '\'') {
-                            result += '\'';
-                        } else {
-                            result += '\\';
+                            escaped = '\t';
+                        } else if (current_char == '\"' || current_char == '\'' || current_char == '{' || current_char == '}') {
+                            escaped = current_char;
                         }
+                        result += escaped;
+                        format += escaped;
+                        if (escaped == '{' || escaped == '}')
+                            format += escaped;
                         advance();
                         continue;
                     }
 
                     result += current_char;
+                    format += current_char;
+                    if (current_char == '}')
+                        format += current_char;
                     advance();
                 }
+                if (slots)
+                    return(Token{TokenType::format, format});
                 return(Token{TokenType::text, result});
             }
 
@@ -164,6 +312,10 @@ namespace camaroo_core {
             }
             if (current_char == '-') {
                 advance();
+                if (current_char == '>') {
+                    advance();
+                    return(Token{TokenType::arrow, std::string("->")});
+                }
                 return(Token{TokenType::subtract, std::string("-")});
             }
             if (current_char == '*') {
@@ -202,6 +354,31 @@ namespace camaroo_core {
                 advance();
                 return(Token{TokenType::semicolon, std::string(";")});
             }
+            if (current_char == ',') {
+                advance();
+                return(Token{TokenType::comma, std::string(",")});
+            }
+            if (current_char == '<') {
+                advance();
+                if (current_char == '=') {
+                    advance();
+                    return (Token{TokenType::less_equal_operator, std::string("<=")});
+                }
+                return(Token{TokenType::less_operator, std::string("<")});
+            }
+            if (current_char == '>') {
+                advance();
+                if (current_char == '=') {
+                    advance();
+                    return (Token{TokenType::greater_equal_operator, std::string(">=")});
+                }
+                return(Token{TokenType::greater_operator, std::string(">")});
+            }
+            if (current_char == '!' && pos + 1 < text.length() && text[pos + 1] == '=') {
+                advance();
+                advance();
+                return (Token{TokenType::not_equal_operator, std::string("!=")});
+            }
             if (current_char == '=') {
                 advance();
                 if(current_char == '='){
@@ -0,0 +1,443 @@
+#include <type_check.h>
+#include <builtins.h>
+#include <object.h>
+#include <map>
+#include <unordered_map>
+#include <utility>
+
+namespace camaroo_core {
+
+    namespace {
+
+        bool is_number(TokenType kind) {
+            return kind == TokenType::num || kind == TokenType::fnum;
+        }
+
+        bool is_arithmetic(TokenType type) {
+            return type == TokenType::add || type == TokenType::subtract || type == TokenType::multiply ||
+                   type == TokenType::division || type == TokenType::modulo;
+        }
+
+        bool is_comparison(TokenType type) {
+            return type == TokenType::equal_operator || type == TokenType::not_equal_operator ||
+                   type == TokenType::less_operator || type == TokenType::less_equal_operator ||
+                   type == TokenType::greater_operator || type == TokenType::greater_equal_operator;
+        }
+
+        // Whether a value of kind given can go where expected is declared, nums widen to fnum
+        bool fits(TokenType expected, TokenType given) {
+            return given == expected || (expected == TokenType::fnum && given == TokenType::num);
+        }
+
+        struct variable {
+            // Every value the variable can hold is one, unknown when they differ or some can't be told
+            TokenType kind = TokenType::unknown;
+            bool given = false;
+            // By the type keyword it was last declared with, unknown when it never was
+            TokenType declared = TokenType::unknown;
+        };
+
+        struct function {
+            TokenType result = TokenType::unknown;
+            // The only definition under the name, calls are checked against it
+            const FunctionDef* definition = nullptr;
+            // Declared inside a block, so calls after it can still reach another function
+            bool uncertain = false;
+            // Its declaration has been passed over, calls can't reach a function declared earlier
+            bool declared = false;
+        };
+
+        class checker {
+        public:
+            void run(const std::vector<std::unique_ptr<StatementNode>>& statements, const FunctionDef* definition);
+            std::vector<std::string> errors;
+        private:
+            struct scope {
+                const void* owner;
+                std::unordered_map<std::string, variable*> names;
+            };
+            // A program or function body, each call runs in a frame with functions of its own
+            struct frame {
+                const FunctionDef* definition;
+                // Its scopes start at first, those of its statements outside any block at top
+                size_t first;
+                size_t top;
+                std::unordered_map<std::string, function> functions;
+            };
+
+            void body(const std::vector<std::unique_ptr<StatementNode>>& statements, const FunctionDef* definition);
+            void collect_functions(const std::vector<std::unique_ptr<StatementNode>>& statements, bool nested,
+                                   std::unordered_map<std::string, function>& functions);
+            void block(const std::vector<std::unique_ptr<StatementNode>>& statements);
+            void statement(ASTNode* node);
+            void loop(ForStmnt* node);
+            TokenType expression(ASTNode* node);
+            TokenType range(ASTNode* node);
+            TokenType call(CallExpr* node);
+
+            void declare(const std::string& name, TokenType kind, TokenType declared);
+            variable* find(const std::string& name);
+            void give(variable& target, TokenType kind);
+            void report(const std::string& error);
+
+            // Kept across passes by the scope and name they belong to
+            std::map<std::pair<const void*, std::string>, variable> variables;
+            std::vector<scope> scopes;
+            std::vector<frame> frames;
+            bool reporting = false;
+            bool changed = false;
+        };
+
+        void checker::run(const std::vector<std::unique_ptr<StatementNode>>& statements, const FunctionDef* definition) {
+            // Kinds only ever go from nothing to one kind to unknown, so this settles after a few passes. Uses
+            // ahead of an assignment in a loop see what it gives on the next pass
+            do {
+                changed = false;
+                body(statements, definition);
+            } while (changed);
+            reporting = true;
+            body(statements, definition);
+        }
+
+        void checker::report(const std::string& error) {
+            if (reporting)
+                errors.push_back(error);
+        }
+
+        void checker::give(variable& target, TokenType kind) {
+            if (!target.given) {
+                target.kind = kind;
+                target.given = true;
+                changed = true;
+            } else if (target.kind != kind && target.kind != TokenType::unknown) {
+                target.kind = TokenType::unknown;
+                changed = true;
+            }
+        }
+
+        void checker::declare(const std::string& name, TokenType kind, TokenType declared) {
+            scope& current = scopes.back();
+            variable*& slot = current.names[name];
+            if (!slot)
+                slot = &variables[{current.owner, name}];
+            give(*slot, kind);
+            slot->declared = declared;
+        }
+
+        variable* checker::find(const std::string& name) {
+            // Function bodies don't see the scopes of the code around their declaration
+            for (size_t i = scopes.size(); i-- > frames.back().first;) {
+                auto found = scopes[i].names.find(name);
+                if (found != scopes[i].names.end())
+                    return found->second;
+            }
+            return nullptr;
+        }
+
+        void checker::collect_functions(const std::vector<std::unique_ptr<StatementNode>>& statements, bool nested,
+                                        std::unordered_map<std::string, function>& functions) {
+            for (const auto& node : statements) {
+                switch (node->node_kind()) {
+                    case NodeKind::function: {
+                        const std::shared_ptr<FunctionDef>& definition = static_cast<FuncStmnt*>(node.get())->get_definition();
+                        TokenType result = definition->kind.type == TokenType::gen_type ? TokenType::generator
+                                                                                           : declared_kind(definition->return_type.type);
+                        auto [it, first] = functions.try_emplace(definition->name);
+                        function& entry = it->second;
+                        if (first) {
+                            entry.result = result;
+                            entry.definition = definition.get();
+                        } else {
+                            entry.definition = nullptr;
+                            if (entry.result != result)
+                                entry.result = TokenType::unknown;
+                        }
+                        entry.uncertain = entry.uncertain || nested;
+                        break;
+                    }
+                    case NodeKind::block:
+                        collect_functions(static_cast<BlockStmnt*>(node.get())->get_statements(), true, functions);
+                        break;
+                    case NodeKind::for_loop:
+                        collect_functions(static_cast<ForStmnt*>(node.get())->get_body()->get_statements(), true, functions);
+                        break;
+                    case NodeKind::spawn:
+                        collect_functions(static_cast<SpawnStmnt*>(node.get())->get_body()->get_statements(), true, functions);
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+
+        void checker::body(const std::vector<std::unique_ptr<StatementNode>>& statements, const FunctionDef* definition) {
+            size_t outer_scopes = scopes.size();
+            if (definition) {
+                // Arguments are checked against the parameters before the body runs
+                scopes.push_back(scope{definition, {}});
+                for (const Parameter& parameter : definition->parameters) {
+                    TokenType kind = declared_kind(parameter.type.type);
+                    declare(parameter.name, kind, kind);
+                }
+            }
+            scopes.push_back(scope{&statements, {}});
+            frames.push_back(frame{definition, outer_scopes, scopes.size(), {}});
+            collect_functions(statements, false, frames.back().functions);
+
+            for (const auto& node : statements)
+                statement(node.get());
+
+            frames.pop_back();
+            scopes.resize(outer_scopes);
+        }
+
+        void checker::block(const std::vector<std::unique_ptr<StatementNode>>& statements) {
+            scopes.push_back(scope{&statements, {}});
+            for (const auto& node : statements)
+                statement(node.get());
+            scopes.pop_back();
+        }
+
+        void checker::statement(ASTNode* node) {
+            if (!node)
+                return;
+            switch (node->node_kind()) {
+                case NodeKind::assign: {
+                    std::string name = std::get<std::string>(node->get_left()->token_value());
+                    TokenType kind = expression(node->get_right());
+                    if (node->token_type() == TokenType::equal) {
+                        variable* target = find(name);
+                        if (!target) {
+                            // A call's writes stay in its frame, so one to a variable from around the func would be lost
+                            for (size_t i = frames.back().first; frames.back().definition && i-- > 0;) {
+                                if (scopes[i].names.count(name)) {
+                                    report("Error: funcs can't write to outer variable " + name + ", return the new value instead");
+                                    break;
+                                }
+                            }
+                            return;
+                        }
+                        if (target->declared != TokenType::unknown && kind != TokenType::unknown && !fits(target->declared, kind))
+                            report("Error: " + name + " is declared as " + type_name(target->declared) + " but is assigned " + type_name(kind));
+                        give(*target, kind);
+                        return;
+                    }
+
+                    TokenType declared = declared_kind(node->token_type());
+                    if (declared == TokenType::unknown)
+                        return;
+                    if (kind != TokenType::unknown && !fits(declared, kind))
+                        report("Error: " + name + " is declared as " + std::get<std::string>(node->token_value()) + " but is given " + type_name(kind));
+                    declare(name, kind, declared);
+                    return;
+                }
+                case NodeKind::block:
+                    block(static_cast<BlockStmnt*>(node)->get_statements());
+                    return;
+                case NodeKind::for_loop:
+                    loop(static_cast<ForStmnt*>(node));
+                    return;
+                case NodeKind::spawn:
+                    // Tasks start from a copy of what they can see, so reads see the same kinds
+                    block(static_cast<SpawnStmnt*>(node)->get_body()->get_statements());
+                    return;
+                case NodeKind::function: {
+                    const std::shared_ptr<FunctionDef>& definition = static_cast<FuncStmnt*>(node)->get_definition();
+                    if (scopes.size() == frames.back().top)
+                        frames.back().functions[definition->name].declared = true;
+                    if (definition->is_deferred())
+                        definition->checked = true;
+                    else if (definition->body)
+                        body(definition->body->get_statements(), definition.get());
+                    return;
+                }
+                case NodeKind::return_stmnt: {
+                    TokenType kind = expression(node->get_right());
+                    const FunctionDef* definition = frames.back().definition;
+                    if (definition && definition->kind.type == TokenType::func_type && kind != TokenType::unknown &&
+                        !fits(declared_kind(definition->return_type.type), kind))
+                        report("Error: " + definition->name + " returns " + definition->return_type.value + " but returned " + type_name(kind));
+                    return;
+                }
+                default:
+                    node->visit_expressions([&](std::unique_ptr<ExpressionNode>& child) {
+                        expression(child.get());
+                    });
+                    return;
+            }
+        }
+
+        void checker::loop(ForStmnt* node) {
+            ExpressionNode* iterable = node->get_iterable();
+            TokenType element = TokenType::unknown;
+            if (iterable->token_type() == TokenType::to_keyword) {
+                range(iterable);
+                element = TokenType::num;
+            } else {
+                TokenType kind = expression(iterable);
+                if (kind != TokenType::unknown && kind != TokenType::list && kind != TokenType::channel && kind != TokenType::generator)
+                    report("Error: for loops go over a range, a list, a channel or a gen");
+            }
+
+            const Token& type = node->get_variable_type();
+            TokenType declared = declared_kind(type.type);
+            if (element != TokenType::unknown && element != declared)
+                report("Error: loop variable is declared as " + type.value + " but the loop goes over " + type_name(element) + " values");
+            for (const ReductionClause& clause : node->get_reductions()) {
+                variable* target = find(clause.variable);
+                if (target && target->kind != TokenType::unknown && !is_number(target->kind))
+                    report("Error: reduce needs " + clause.variable + " to be a num or fnum");
+            }
+
+            // The loop checks every value against the declared type before the body sees it
+            scopes.push_back(scope{node, {}});
+            declare(std::get<std::string>(node->get_left()->token_value()), declared, declared);
+            block(node->get_body()->get_statements());
+            scopes.pop_back();
+        }
+
+        TokenType checker::range(ASTNode* node) {
+            TokenType first = expression(node->get_left());
+            TokenType last = expression(node->get_right());
+            if ((first != TokenType::unknown && first != TokenType::num) || (last != TokenType::unknown && last != TokenType::num))
+                report("Error: range bounds have to be num");
+            return TokenType::list;
+        }
+
+        TokenType checker::call(CallExpr* node) {
+            std::vector<TokenType> arguments;
+            for (const auto& argument : node->get_arguments())
+                arguments.push_back(expression(argument.get()));
+
+            std::string name = std::get<std::string>(node->get_left()->token_value());
+            auto found = frames.back().functions.find(name);
+            if (found == frames.back().functions.end()) {
+                // Built-ins give what they always do, unless a func of the program takes the name. A body checked on
+                // its own can't see the funcs declared around it, so there it can't tell
+                if (frames.front().definition)
+                    return TokenType::unknown;
+                for (const frame& outer : frames) {
+                    if (outer.functions.count(name))
+                        return TokenType::unknown;
+                }
+                return builtin_result(name);
+            }
+            if (!found->second.declared || found->second.uncertain)
+                return TokenType::unknown;
+
+            const FunctionDef* definition = found->second.definition;
+            if (definition && arguments.size() != definition->parameters.size()) {
+                report("Error: " + definition->name + " expects " + std::to_string(definition->parameters.size()) +
+                       " argument(s) but found " + std::to_string(arguments.size()));
+            } else if (definition) {
+                for (size_t i = 0; i < arguments.size(); ++i) {
+                    const Parameter& parameter = definition->parameters[i];
+                    if (arguments[i] != TokenType::unknown && !fits(declared_kind(parameter.type.type), arguments[i]))
+                        report("Error: " + definition->name + " expects " + parameter.name + " to be " + parameter.type.value +
+                               " but found " + type_name(arguments[i]));
+                }
+            }
+            return found->second.result;
+        }
+
+        TokenType checker::expression(ASTNode* node) {
+            if (!node)
+                return TokenType::unknown;
+            switch (node->node_kind()) {
+                case NodeKind::num:
+                    return TokenType::num;
+                case NodeKind::fnum:
+                    return TokenType::fnum;
+                case NodeKind::text:
+                    return TokenType::text;
+                case NodeKind::letter:
+                    return TokenType::letter;
+                case NodeKind::toggle:
+                    return TokenType::toggle;
+                case NodeKind::identifier: {
+                    variable* found = find(std::get<std::string>(node->token_value()));
+                    return (found && found->given) ? found->kind : TokenType::unknown;
+                }
+                case NodeKind::list:
+                    for (const auto& element : static_cast<ListExpr*>(node)->get_elements())
+                        expression(element.get());
+                    return TokenType::list;
+                case NodeKind::format:
+                    // Any value can go in a slot
+                    for (const auto& slot : static_cast<FormatExpr*>(node)->get_slots())
+                        expression(slot.get());
+                    return TokenType::text;
+                case NodeKind::map:
+                    return TokenType::map;
+                case NodeKind::channel: {
+                    TokenType capacity = expression(node->get_right());
+                    if (capacity != TokenType::unknown && capacity != TokenType::num)
+                        report("Error: channel capacity has to be a num of at least 1");
+                    return TokenType::channel;
+                }
+                case NodeKind::call:
+                    return call(static_cast<CallExpr*>(node));
+                case NodeKind::prefix: {
+                    TokenType operand = expression(node->get_right());
+                    if (node->token_type() != TokenType::subtract)
+                        return TokenType::unknown;
+                    if (operand != TokenType::unknown && operand != TokenType::list && !is_number(operand))
+                        report("Error: arithmetic needs num or fnum operands");
+                    return (operand == TokenType::list || is_number(operand)) ? operand : TokenType::unknown;
+                }
+                case NodeKind::infix:
+                    break;
+                default:
+                    node->visit_expressions([&](std::unique_ptr<ExpressionNode>& child) {
+                        expression(child.get());
+                    });
+                    return TokenType::unknown;
+            }
+
+            TokenType type = node->token_type();
+            if (type == TokenType::to_keyword)
+                return range(node);
+
+            auto* infix = static_cast<InfixExpr*>(node);
+            TokenType left = expression(node->get_left());
+            TokenType right = expression(node->get_right());
+            infix->set_operand_kind((left == right && is_number(left)) ? left : TokenType::unknown);
+            if (!is_arithmetic(type) && !is_comparison(type))
+                return TokenType::unknown;
+            // Lists take the operation element by element
+            if (left == TokenType::list || right == TokenType::list)
+                return TokenType::list;
+            if (left == TokenType::unknown || right == TokenType::unknown)
+                return TokenType::unknown;
+
+            if (is_arithmetic(type)) {
+                // Letters join onto text on either side
+                if (type == TokenType::add && (left == TokenType::text || right == TokenType::text) &&
+                    (left == TokenType::text || left == TokenType::letter) && (right == TokenType::text || right == TokenType::letter))
+                    return TokenType::text;
+                if (!is_number(left) || !is_number(right)) {
+                    report("Error: arithmetic needs num or fnum operands");
+                    return TokenType::unknown;
+                }
+                return (left == TokenType::num && right == TokenType::num) ? TokenType::num : TokenType::fnum;
+            }
+            bool comparable = (is_number(left) && is_number(right)) ||
+                              (left == right && (left == TokenType::text || left == TokenType::letter || left == TokenType::toggle));
+            if (!comparable)
+                report("Error: can't compare values of different types");
+            return TokenType::toggle;
+        }
+    }
+
+    std::vector<std::string> check_types(const std::vector<std::unique_ptr<StatementNode>>& statements) {
+        checker pass;
+        pass.run(statements, nullptr);
+        return std::move(pass.errors);
+    }
+
+    std::vector<std::string> check_body(const FunctionDef& definition, const std::vector<std::unique_ptr<StatementNode>>& statements) {
+        checker pass;
+        pass.run(statements, &definition);
+        return std::move(pass.errors);
+    }
+}
@@ -0,0 +1,322 @@
+#include <watch.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <thread>
+#include <unordered_set>
+
+namespace camaroo_core {
+
+    namespace {
+
+        // What a statement touches. reads holds every name it mentions, variables and called functions alike,
+        // which over-approximates but never misses an input
+        struct statement_facts {
+            std::unordered_set<std::string> reads;
+            std::unordered_set<std::string> writes;
+            // Talks to other tasks, stdin or the scheduler, so it runs every time
+            bool impure = false;
+            bool spawns = false;
+        };
+
+        bool impure_builtin(const std::string& name) {
+            return name == "send" || name == "receive" || name == "close" || name == "lines";
+        }
+
+        void collect(ASTNode* node, statement_facts& facts) {
+            if (!node)
+                return;
+            switch (node->node_kind()) {
+                case NodeKind::identifier:
+                    facts.reads.insert(std::get<std::string>(node->token_value()));
+                    return;
+                case NodeKind::prefix:
+                case NodeKind::infix:
+                case NodeKind::print:
+                case NodeKind::println:
+                case NodeKind::expression_stmnt:
+                case NodeKind::return_stmnt:
+                case NodeKind::yield_stmnt:
+                    collect(node->get_left(), facts);
+                    collect(node->get_right(), facts);
+                    return;
+                case NodeKind::shared:
+                    collect(static_cast<SharedExpr*>(node)->get_target(), facts);
+                    return;
+                case NodeKind::hoisted:
+                    collect(static_cast<HoistedExpr*>(node)->get_target(), facts);
+                    return;
+                case NodeKind::induction:
+                    collect(static_cast<InductionExpr*>(node)->get_target(), facts);
+                    return;
+                case NodeKind::inlined:
+                    // Reads the function name like the call it stands for, so editing the func reruns it
+                    collect(static_cast<InlinedCallExpr*>(node)->get_call(), facts);
+                    return;
+                case NodeKind::arith_chain:
+                    collect(node->get_left(), facts);
+                    return;
+                case NodeKind::list:
+                    for (const auto& element : static_cast<ListExpr*>(node)->get_elements())
+                        collect(element.get(), facts);
+                    return;
+                case NodeKind::format:
+                    for (const auto& slot : static_cast<FormatExpr*>(node)->get_slots())
+                        collect(slot.get(), facts);
+                    return;
+                case NodeKind::channel:
+                    facts.impure = true;
+                    collect(node->get_right(), facts);
+                    return;
+                case NodeKind::map:
+                    facts.impure = true;
+                    return;
+                case NodeKind::call: {
+                    collect(node->get_left(), facts);
+                    if (node->get_left()->node_kind() == NodeKind::identifier &&
+                        impure_builtin(std::get<std::string>(node->get_left()->token_value())))
+                        facts.impure = true;
+                    for (const auto& argument : static_cast<CallExpr*>(node)->get_arguments())
+                        collect(argument.get(), facts);
+                    return;
+                }
+                case NodeKind::assign:
+                    facts.writes.insert(std::get<std::string>(node->get_left()->token_value()));
+                    collect(node->get_left(), facts);
+                    collect(node->get_right(), facts);
+                    return;
+                case NodeKind::block:
+                    for (const auto& statement : static_cast<BlockStmnt*>(node)->get_statements())
+                        collect(statement.get(), facts);
+                    return;
+                case NodeKind::for_loop: {
+                    auto* loop = static_cast<ForStmnt*>(node);
+                    collect(loop->get_left(), facts);
+                    collect(loop->get_iterable(), facts);
+                    collect(loop->get_body(), facts);
+                    for (const auto& clause : loop->get_reductions()) {
+                        facts.reads.insert(clause.variable);
+                        facts.writes.insert(clause.variable);
+                    }
+                    return;
+                }
+                case NodeKind::spawn:
+                    facts.impure = true;
+                    facts.spawns = true;
+                    collect(node->get_right(), facts);
+                    return;
+                case NodeKind::function:
+                    // The body counts against the statements that call it, declaring it only writes the name
+                    facts.writes.insert(static_cast<FuncStmnt*>(node)->get_definition()->name);
+                    return;
+                case NodeKind::use_stmnt:
+                case NodeKind::slot:
+                case NodeKind::toggle:
+                case NodeKind::num:
+                case NodeKind::fnum:
+                case NodeKind::text:
+                case NodeKind::letter:
+                case NodeKind::none:
+                    return;
+            }
+        }
+
+        // A statement's own facts, plus what every function it calls reads, through the functions those call
+        statement_facts analyse(StatementNode* statement, const std::unordered_map<std::string, FunctionDef*>& functions) {
+            statement_facts facts;
+            collect(statement, facts);
+
+            std::unordered_set<std::string> visited;
+            std::vector<std::string> pending(facts.reads.begin(), facts.reads.end());
+            while (!pending.empty()) {
+                std::string name = std::move(pending.back());
+                pending.pop_back();
+                auto it = functions.find(name);
+                if (it == functions.end() || !visited.insert(name).second)
+                    continue;
+
+                statement_facts body;
+                try {
+                    collect(it->second->get_body(), body);
+                }
+                catch (const std::exception&) {
+                    // Calling it reports the parse error, which has to happen on every run
+                    facts.impure = true;
+                }
+                facts.impure = facts.impure || body.impure;
+                facts.spawns = facts.spawns || body.spawns;
+                for (const auto& read : body.reads) {
+                    if (facts.reads.insert(read).second)
+                        pending.push_back(read);
+                }
+                // Globals a function assigns change under the statement that called it
+                for (const auto& write : body.writes)
+                    facts.writes.insert(write);
+            }
+            return facts;
+        }
+    }
+
+    std::string watch_session::capture_buffer::take() {
+        std::lock_guard<std::mutex> guard(lock);
+        std::string result = std::move(captured);
+        captured.clear();
+        return result;
+    }
+
+    std::streamsize watch_session::capture_buffer::xsputn(const char* text, std::streamsize length) {
+        std::lock_guard<std::mutex> guard(lock);
+        captured.append(text, static_cast<size_t>(length));
+        target.write(text, length);
+        target.flush();
+        return length;
+    }
+
+    watch_session::capture_buffer::int_type watch_session::capture_buffer::overflow(int_type c) {
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            char value = traits_type::to_char_type(c);
+            xsputn(&value, 1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    watch_session::watch_session(thread_pool& pool, std::ostream& out, std::ostream& err)
+        :pool(pool), buffer(out), captured_out(&buffer), output(captured_out, err) {}
+
+    size_t watch_session::run(const Program& program) {
+        globals = std::make_unique<evaluator>(pool, output);
+
+        std::unordered_map<std::string, FunctionDef*> functions;
+        for (const auto& statement : program.statements) {
+            if (statement->node_kind() == NodeKind::function) {
+                FunctionDef* definition = static_cast<FuncStmnt*>(statement.get())->get_definition().get();
+                functions[definition->name] = definition;
+            }
+        }
+
+        std::unordered_map<std::string, uint64_t> versions;
+        std::unordered_map<std::string, std::vector<result>> next_results;
+        size_t executed = 0;
+        // Output of spawned tasks can't be told apart from the statements after them, so nothing after a spawn is kept
+        bool spawned = false;
+
+        for (const auto& statement : program.statements) {
+            StatementNode* node = statement.get();
+            statement_facts facts = analyse(node, functions);
+            std::string text = node->to_string();
+            bool is_function = node->node_kind() == NodeKind::function;
+
+            result current;
+            for (const auto& name : facts.reads) {
+                auto it = versions.find(name);
+                current.inputs.emplace_back(name, it == versions.end() ? 0 : it->second);
+            }
+            std::sort(current.inputs.begin(), current.inputs.end());
+
+            std::optional<result> cached;
+            auto found = results.find(text);
+            if (found != results.end() && !facts.impure && !spawned) {
+                auto& copies = found->second;
+                auto match = std::find_if(copies.begin(), copies.end(), [&](const result& r) { return r.inputs == current.inputs; });
+                if (match != copies.end()) {
+                    cached = std::move(*match);
+                    copies.erase(match);
+                }
+            }
+
+            if (cached && !is_function) {
+                for (size_t i = 0; i < cached->output_versions.size(); ++i) {
+                    globals->define_variable(cached->output_versions[i].first, cached->output_values[i]);
+                    versions[cached->output_versions[i].first] = cached->output_versions[i].second;
+                }
+                if (!cached->printed.empty())
+                    output.write(cached->printed);
+                buffer.take();
+                next_results[text].push_back(std::move(*cached));
+                continue;
+            }
+
+            // Declaring a function is cheap and has to happen in the new globals, but its version only moves
+            // when its text does, so callers whose inputs are otherwise the same stay cached
+            buffer.take();
+            size_t errors_before = output.error_count();
+            try {
+                globals->evaluate_statement(node);
+            }
+            catch (const std::exception& e) {
+                output.report(e.what());
+            }
+            bool failed = output.error_count() != errors_before;
+            bool stateful = false;
+            current.printed = buffer.take();
+            if (!is_function)
+                ++executed;
+            spawned = spawned || facts.spawns;
+
+            if (is_function) {
+                const std::string& name = static_cast<FuncStmnt*>(node)->get_definition()->name;
+                uint64_t version = cached ? cached->output_versions[0].second : ++last_version;
+                versions[name] = version;
+                current.output_versions.emplace_back(name, version);
+                current.output_values.push_back(nullptr);
+            }
+            else {
+                const auto& variables = globals->get_variables();
+                for (const auto& name : facts.writes) {
+                    auto it = variables.find(name);
+                    if (it == variables.end())
+                        continue;
+                    versions[name] = ++last_version;
+                    current.output_versions.emplace_back(name, last_version);
+                    current.output_values.push_back(it->second);
+                    // A generator is used up by whoever reads it, so the statement that made it runs every time
+                    if (it->second && it->second->variable_type == TokenType::generator)
+                        stateful = true;
+                }
+            }
+
+            if (!failed && !facts.impure && !spawned && !stateful)
+                next_results[text].push_back(std::move(current));
+        }
+
+        globals->wait_for_tasks();
+        results = std::move(next_results);
+        return executed;
+    }
+
+    int watch(const std::string& path, const Engine& engine, const ast_cache::settings& cache) {
+        std::error_code error;
+        std::filesystem::file_time_type seen = std::filesystem::last_write_time(path, error);
+        if (error) {
+            std::cerr << "Error: couldn't open " << path << '\n';
+            return -1;
+        }
+
+        watch_session session(engine.get_pool(), std::cout, std::cerr);
+        std::shared_ptr<const Script> script;
+        bool changed = true;
+        while (true) {
+            if (changed) {
+                try {
+                    std::shared_ptr<const Script> next = engine.compile_file(path, cache);
+                    size_t ran = session.run(next->get_program());
+                    // The old script goes only after the new run, cached values may still point into it
+                    script = std::move(next);
+                    std::cerr << "-- ran " << ran << " of " << script->get_program().statements.size()
+                              << " statements, watching " << path << std::endl;
+                }
+                catch (const std::exception& e) {
+                    std::cerr << e.what() << '\n' << "-- watching " << path << std::endl;
+                }
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            std::filesystem::file_time_type modified = std::filesystem::last_write_time(path, error);
+            changed = !error && modified != seen;
+            if (changed)
+                seen = modified;
+        }
+    }
+}
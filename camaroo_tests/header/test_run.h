@@ -0,0 +1,33 @@
+#pragma once
+
+#include <evaluator.h>
+#include <parser.h>
+#include <cstddef>
+#include <sstream>
+#include <string>
+
+// Runs program on a fresh evaluator with threads pool threads once before has set up its globals, and
+// gives back everything both streams got, errors included, in the order they were printed
+inline std::string run(const camaroo_core::Program& program, const std::string& before = "", size_t threads = 2) {
+    camaroo_core::thread_pool pool(threads);
+    std::ostringstream out;
+    camaroo_core::output_stream output(out, out);
+    camaroo_core::evaluator evaluator(pool, output);
+    evaluator.evaluate_program(camaroo_core::Parser(before).parse_program());
+    evaluator.evaluate_program(program);
+    return out.str();
+}
+
+inline std::string run(const std::string& source) {
+    return run(camaroo_core::Parser(source).parse_program());
+}
+
+// The same on one thread, with everything printed first and the errors after it
+inline std::string run_apart(const camaroo_core::Program& program) {
+    camaroo_core::thread_pool pool(1);
+    std::ostringstream out, err;
+    camaroo_core::output_stream output(out, err);
+    camaroo_core::evaluator evaluator(pool, output);
+    evaluator.evaluate_program(program);
+    return out.str() + err.str();
+}
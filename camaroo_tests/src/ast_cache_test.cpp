@@ -0,0 +1,97 @@
+#include <ast_cache.h>
+#include <evaluator.h>
+#include <hash.h>
+#include <version.h>
+#include <test_run.h>
+#include <gtest/gtest.h>
+#include <cstring>
+#include <string>
+
+std::string get_test_file(const std::string& path);
+
+namespace {
+    std::string tree_text(const camaroo_core::Program& program) {
+        std::string text;
+        for (const auto& statement : program.statements)
+            text += statement->to_string() + "\n";
+        return text;
+    }
+}
+
+TEST (ast_cache_test, round_tripping_programs) {
+    for (const char* path : {"camaroo_tests/res/generator_test.cmr", "camaroo_tests/res/parallel_for_test.cmr",
+                             "camaroo_tests/res/channel_test.cmr"}) {
+        for (bool lazy : {false, true}) {
+            std::string source = get_test_file(path);
+            camaroo_core::Parser parser(source, lazy);
+            camaroo_core::Program program = parser.parse_program();
+            ASSERT_TRUE(program.has_compiled);
+
+            uint64_t hash = camaroo_core::content_hash(source);
+            std::string data = camaroo_core::ast_cache::serialize(program, hash);
+            std::optional<camaroo_core::Program> loaded = camaroo_core::ast_cache::deserialize(data.data(), data.size(), hash);
+            ASSERT_TRUE(loaded.has_value());
+            EXPECT_TRUE(tree_text(*loaded) == tree_text(program));
+        }
+    }
+
+    std::string source = get_test_file("camaroo_tests/res/generator_test.cmr");
+    camaroo_core::Parser parser(source);
+    uint64_t hash = camaroo_core::content_hash(source);
+    std::string data = camaroo_core::ast_cache::serialize(parser.parse_program(), hash);
+    std::optional<camaroo_core::Program> loaded = camaroo_core::ast_cache::deserialize(data.data(), data.size(), hash);
+
+    camaroo_core::evaluator evaluator;
+    evaluator.evaluate_program(*loaded);
+    EXPECT_TRUE(std::get<int64_t>(evaluator.get_variable("stopped")->variable_value) == 3);
+}
+
+TEST (ast_cache_test, rejecting_stale_files) {
+    std::string source = "num a = 1;\nprintln(a);\n";
+    camaroo_core::Parser parser(source);
+    uint64_t hash = camaroo_core::content_hash(source);
+    std::string data = camaroo_core::ast_cache::serialize(parser.parse_program(), hash);
+
+    EXPECT_TRUE(camaroo_core::ast_cache::deserialize(data.data(), data.size(), hash).has_value());
+    EXPECT_TRUE(camaroo_core::ast_cache::deserialize(data.data(), data.size(), hash + 1) == std::nullopt);
+    for (size_t cut : {size_t(0), size_t(3), data.size() / 2, data.size() - 1})
+        EXPECT_TRUE(camaroo_core::ast_cache::deserialize(data.data(), cut, hash) == std::nullopt);
+
+    std::string changed_version = data;
+    changed_version[4] ^= 0x7f;
+    EXPECT_TRUE(camaroo_core::ast_cache::deserialize(changed_version.data(), changed_version.size(), hash) == std::nullopt);
+}
+
+TEST (ast_cache_test, rejecting_damaged_bodies) {
+    std::string source =
+        "func scale(num x) -> num {\n    return x * 3 - -x;\n}\n"
+        "gen evens(num n) -> num {\n    for (num i, in (0 to n)) {\n        yield i * 2;\n    }\n}\n"
+        "map m = map(text, num);\nlist xs = [1, 2, 3];\nnum total = 0;\n"
+        "for (num e, in evens(4)) {\n    total = total + scale(e);\n}\n"
+        "parallel for (num i, in (0 to 8), reduce + total) {\n    total = total + i;\n}\n"
+        "println(\"total {total} of {xs}\");\nprintln(xs == 2);\nfnum f = 1.5;\nprint(f / 2.0);\n";
+    camaroo_core::Parser parser(source);
+    camaroo_core::Program program = parser.parse_program();
+    ASSERT_TRUE(program.has_compiled);
+    uint64_t hash = camaroo_core::content_hash(source);
+    std::string data = camaroo_core::ast_cache::serialize(program, hash);
+    EXPECT_TRUE(run(*camaroo_core::ast_cache::deserialize(data.data(), data.size(), hash), "", 1) == run(program, "", 1));
+
+    // Magic, format version, interpreter version, source hash and then the hash of the body
+    size_t body_hash_at = 4 + 4 + 4 + std::strlen(camaroo_core::camaroo_version) + 8;
+    size_t body_at = body_hash_at + 8;
+    for (size_t at = body_at; at < data.size(); ++at) {
+        for (unsigned char flip : {0x01, 0x80, 0xff}) {
+            std::string damaged = data;
+            damaged[at] = static_cast<char>(damaged[at] ^ flip);
+            EXPECT_TRUE(camaroo_core::ast_cache::deserialize(damaged.data(), damaged.size(), hash) == std::nullopt) << at;
+
+            // Past the body's hash, whatever the reader still takes has to be a tree that runs without crashing
+            uint64_t body_hash = camaroo_core::content_hash(std::string_view(damaged).substr(body_at));
+            std::memcpy(damaged.data() + body_hash_at, &body_hash, sizeof(body_hash));
+            std::optional<camaroo_core::Program> loaded = camaroo_core::ast_cache::deserialize(damaged.data(), damaged.size(), hash);
+            if (loaded)
+                run(*loaded, "", 1);
+        }
+    }
+}
@@ -0,0 +1,106 @@
+#include <channel.h>
+#include <evaluator.h>
+#include <ring_buffer.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+std::string get_test_file(const std::string& path);
+
+TEST (ring_buffer_test, handling_capacity) {
+    camaroo_core::mpmc_ring<int> ring(3);
+    for (int i = 0; i < 3; ++i)
+        EXPECT_TRUE(ring.try_push(i));
+    int extra = 3;
+    EXPECT_TRUE(ring.try_push(extra) == false);
+
+    int value = -1;
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_TRUE(ring.try_pop(value));
+        EXPECT_TRUE(value == i);
+    }
+    EXPECT_TRUE(ring.try_pop(value) == false);
+
+    camaroo_core::mpmc_ring<int> single(1);
+    for (int i = 0; i < 4; ++i) {
+        int pushed = i;
+        EXPECT_TRUE(single.try_push(pushed));
+        EXPECT_TRUE(single.try_push(pushed) == false);
+        EXPECT_TRUE(single.try_pop(value) && value == i);
+    }
+}
+
+TEST (channel_test, many_senders_and_receivers) {
+    auto channel = std::make_shared<camaroo_core::camaroo_channel>(camaroo_core::TokenType::num, 8);
+    const int64_t per_sender = 5000;
+    std::atomic<int64_t> total{0};
+
+    std::vector<std::thread> threads;
+    for (int s = 0; s < 3; ++s) {
+        threads.emplace_back([&]() {
+            for (int64_t i = 1; i <= per_sender; ++i)
+                channel->send(camaroo_core::make_object(camaroo_core::TokenType::num, i));
+        });
+    }
+    for (int r = 0; r < 2; ++r) {
+        threads.emplace_back([&]() {
+            while (auto value = channel->receive())
+                total += std::get<int64_t>(value->variable_value);
+        });
+    }
+
+    for (int s = 0; s < 3; ++s)
+        threads[s].join();
+    channel->close();
+    for (size_t r = 3; r < threads.size(); ++r)
+        threads[r].join();
+
+    EXPECT_TRUE(total.load() == 3 * per_sender * (per_sender + 1) / 2);
+    EXPECT_TRUE(channel->send(camaroo_core::make_object(camaroo_core::TokenType::num, int64_t(1))) == false);
+}
+
+TEST (channel_test, handling_spawned_pipeline) {
+    std::string source = get_test_file("camaroo_tests/res/channel_test.cmr");
+    camaroo_core::Parser parser(source);
+    camaroo_core::Program program = parser.parse_program();
+    EXPECT_TRUE(program.has_compiled);
+
+    camaroo_core::evaluator evaluator;
+    evaluator.evaluate_program(program);
+
+    int64_t total = 0;
+    for (int64_t i = 0; i < 1000; ++i)
+        total += i * i;
+    EXPECT_TRUE(std::get<int64_t>(evaluator.get_variable("total")->variable_value) == total);
+}
+
+TEST (channel_test, blocked_tasks_dont_starve_the_rest) {
+    // More blocked senders than runners, they park and leave their runners to the rest
+    std::string source = "channel c = channel(num, 1);\n";
+    for (int task = 0; task < 6; ++task)
+        source += "spawn {\n    for (num i, in (0 to 50)) {\n        send(c, 1);\n    }\n}\n";
+    source += "num total = 0;\nfor (num i, in (0 to 300)) {\n    total = total + receive(c);\n}\n";
+
+    camaroo_core::Parser parser(source);
+    camaroo_core::Program program = parser.parse_program();
+    camaroo_core::evaluator evaluator;
+    evaluator.evaluate_program(program);
+    EXPECT_TRUE(std::get<int64_t>(evaluator.get_variable("total")->variable_value) == 300);
+}
+
+TEST (channel_test, parking_more_tasks_than_runners_could_hold) {
+    // Every sender blocks on the full channel before the receiver is even queued
+    std::string source = "channel c = channel(num, 1);\nchannel done = channel(num, 1);\n";
+    for (int task = 0; task < 300; ++task)
+        source += "spawn {\n    send(c, 1);\n}\n";
+    source += "spawn {\n    num total = 0;\n    for (num i, in (0 to 300)) {\n        total = total + receive(c);\n    }\n    send(done, total);\n}\n";
+    source += "num total = receive(done);\n";
+
+    camaroo_core::Parser parser(source);
+    camaroo_core::Program program = parser.parse_program();
+    camaroo_core::evaluator evaluator;
+    EXPECT_TRUE(evaluator.evaluate_program(program));
+    EXPECT_TRUE(std::get<int64_t>(evaluator.get_variable("total")->variable_value) == 300);
+}
@@ -0,0 +1,62 @@
+#include <document.h>
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+
+std::string get_test_file(const std::string& path);
+
+namespace {
+    std::string tree_text(const camaroo_core::Document& document) {
+        std::string text;
+        for (camaroo_core::StatementNode* statement : document.statements())
+            text += statement->to_string() + "\n";
+        for (const auto& error : document.errors())
+            text += error + "\n";
+        return text;
+    }
+}
+
+TEST (document_test, reparsing_only_edited_statements) {
+    camaroo_core::Document document("num a = 1;\nnum b = a + 2;\n// note\nfunc f(num x) -> num {\n    return x;\n}\nprintln(b);\n");
+    EXPECT_TRUE(document.statements().size() == 4 && document.errors().empty());
+    std::vector<camaroo_core::StatementNode*> before = document.statements();
+
+    size_t at = document.get_source().find("2;");
+    document.edit(at, 1, "40");
+    std::vector<camaroo_core::StatementNode*> after = document.statements();
+    EXPECT_TRUE(document.last_reparsed() == 1);
+    EXPECT_TRUE(after[0] == before[0] && after[1] != before[1] && after[2] == before[2] && after[3] == before[3]);
+    EXPECT_TRUE(after[1]->to_string() == camaroo_core::Document("num b = a + 40;").statements()[0]->to_string());
+
+    // Dropping a ; joins two statements, putting it back splits them again
+    at = document.get_source().find(";");
+    document.edit(at, 1, "");
+    EXPECT_TRUE(document.errors().empty() == false);
+    document.edit(at, 0, ";");
+    EXPECT_TRUE(document.errors().empty());
+    EXPECT_TRUE(document.statements().size() == 4);
+}
+
+TEST (document_test, matching_a_full_parse_after_random_edits) {
+    std::string source = get_test_file("camaroo_tests/res/generator_test.cmr");
+    const std::string pieces[] = {";", "}", "{", "\"", "//", "\n", " x ", "num q = 3;\n", "(", ")", "1", "func"};
+    std::mt19937_64 rng(5);
+
+    camaroo_core::Document document(source);
+    for (int round = 0; round < 300; ++round) {
+        const std::string& text = document.get_source();
+        size_t offset = rng() % (text.size() + 1);
+        size_t removed = (rng() % 3 == 0) ? rng() % 8 : 0;
+        std::string inserted = (rng() % 4 == 0) ? "" : pieces[rng() % std::size(pieces)];
+        document.edit(offset, removed, inserted);
+
+        camaroo_core::Document fresh(document.get_source());
+        ASSERT_TRUE(tree_text(document) == tree_text(fresh));
+
+        // Now and then put the original back, so most rounds edit a program that compiles
+        if (round % 10 == 9) {
+            document.edit(0, document.get_source().size(), source);
+            EXPECT_TRUE(document.errors().empty());
+        }
+    }
+}
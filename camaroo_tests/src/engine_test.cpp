@@ -0,0 +1,132 @@
+#include <camaroo.h>
+#include <engine.h>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    const std::string counting_source =
+        "func square(num x) -> num {\n"
+        "    return x * x;\n"
+        "}\n"
+        "num total = offset;\n"
+        "for (num i, in (0 to 10)) {\n"
+        "    total = total + square(i);\n"
+        "}\n"
+        "println(total);\n";
+
+    void append_text(void* user_data, const char* text, size_t length) {
+        static_cast<std::string*>(user_data)->append(text, length);
+    }
+}
+
+TEST (engine_test, running_one_script_concurrently) {
+    camaroo_core::Engine engine(2);
+    std::shared_ptr<const camaroo_core::Script> script = engine.compile(counting_source);
+
+    std::vector<std::thread> threads;
+    std::vector<int> failures(4, 0);
+    for (size_t t = 0; t < failures.size(); ++t) {
+        threads.emplace_back([&, t]() {
+            for (int64_t run = 0; run < 50; ++run) {
+                std::ostringstream out, err;
+                camaroo_core::Context context(engine, out, err);
+                context.set_variable("offset", camaroo_core::make_object(camaroo_core::TokenType::num, run));
+                bool ok = engine.run(*script, context);
+                if (!ok || out.str() != std::to_string(285 + run) + "\n" || !err.str().empty())
+                    ++failures[t];
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    EXPECT_TRUE(failures == std::vector<int>(4, 0));
+}
+
+TEST (engine_test, keeping_state_between_runs) {
+    camaroo_core::Engine engine;
+    std::ostringstream out, err;
+    camaroo_core::Context context(engine, out, err);
+
+    EXPECT_TRUE(engine.run(*engine.compile("num a = 40;\nfunc add(num x) -> num {\n    return x + a;\n}\n"), context));
+    EXPECT_TRUE(engine.run(*engine.compile("println(add(2));\n"), context));
+    EXPECT_TRUE(out.str() == "42\n");
+
+    EXPECT_TRUE(engine.run(*engine.compile("a = missing;\n"), context) == false);
+    EXPECT_TRUE(err.str().empty() == false);
+    EXPECT_THROW(engine.compile("num = 3;\n"), std::runtime_error);
+}
+
+TEST (engine_test, parsing_function_bodies_on_first_call) {
+    camaroo_core::Engine engine;
+    std::shared_ptr<const camaroo_core::Script> script = engine.compile(
+        "func used(num x) -> num {\n"
+        "    text braces = \"\\}\\{\";\n"
+        "    // } in a comment\n"
+        "    return x * 2;\n"
+        "}\n"
+        "func unused(num x) -> num {\n"
+        "    return x +;\n"
+        "}\n"
+        "println(used(21));\n");
+
+    const auto& statements = script->get_program().statements;
+    auto used = static_cast<camaroo_core::FuncStmnt*>(statements[0].get())->get_definition();
+    auto unused = static_cast<camaroo_core::FuncStmnt*>(statements[1].get())->get_definition();
+    EXPECT_TRUE(used->body == nullptr && unused->body == nullptr);
+
+    std::ostringstream out, err;
+    camaroo_core::Context context(engine, out, err);
+    EXPECT_TRUE(engine.run(*script, context));
+    EXPECT_TRUE(out.str() == "42\n");
+    EXPECT_TRUE(used->body != nullptr && unused->body == nullptr);
+
+    EXPECT_TRUE(engine.run(*engine.compile("println(unused(1));\n"), context) == false);
+    EXPECT_TRUE(err.str().find("func unused doesn't parse") != std::string::npos);
+}
+
+TEST (engine_test, feeding_the_repl) {
+    camaroo_core::Engine engine;
+    std::ostringstream out, err;
+    camaroo_core::Repl repl(engine, out, err);
+
+    EXPECT_TRUE(repl.feed("num a = 2;"));
+    EXPECT_TRUE(repl.feed("func twice(num x) -> num {") == false);
+    EXPECT_TRUE(repl.feed("    text t = \"\\{\"; // {") == false);
+    EXPECT_TRUE(repl.is_pending());
+    EXPECT_TRUE(repl.feed("    return x * a;") == false);
+    EXPECT_TRUE(repl.feed("}"));
+    EXPECT_TRUE(repl.is_pending() == false);
+
+    EXPECT_TRUE(repl.feed("b = ;"));
+    EXPECT_TRUE(err.str().empty() == false);
+    EXPECT_TRUE(repl.feed("println(twice(21));"));
+    EXPECT_TRUE(out.str() == "42\n");
+
+    EXPECT_TRUE(repl.feed("for (num i, in (0 to 3)) {") == false);
+    repl.discard();
+    EXPECT_TRUE(repl.feed("println(a);"));
+    EXPECT_TRUE(out.str() == "42\n2\n");
+}
+
+TEST (engine_test, handling_c_interface) {
+    camaroo_engine* engine = camaroo_engine_new(0);
+    ASSERT_TRUE(engine != nullptr);
+
+    char* error = nullptr;
+    EXPECT_TRUE(camaroo_compile(engine, "num = ;", &error) == nullptr);
+    EXPECT_TRUE(error != nullptr && std::string(error).empty() == false);
+    camaroo_string_free(error);
+
+    camaroo_script* script = camaroo_compile(engine, "text t = \"hi\";\nprintln(t);\n", nullptr);
+    ASSERT_TRUE(script != nullptr);
+    std::string output;
+    EXPECT_TRUE(camaroo_run(engine, script, append_text, nullptr, &output) == 0);
+    EXPECT_TRUE(camaroo_run(engine, script, append_text, nullptr, &output) == 0);
+    EXPECT_TRUE(output == "hi\nhi\n");
+
+    camaroo_script_free(script);
+    camaroo_engine_free(engine);
+}
@@ -0,0 +1,69 @@
+#include <evaluator.h>
+#include <type_check.h>
+#include <test_run.h>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+std::string get_test_file(const std::string& path);
+
+TEST (parallel_for_test, handling_reductions) {
+    std::string source = get_test_file("camaroo_tests/res/parallel_for_test.cmr");
+
+    camaroo_core::thread_pool single(1);
+    camaroo_core::thread_pool many(4);
+    for (auto* pool : {&single, &many}) {
+        camaroo_core::Parser parser(source);
+        camaroo_core::Program program = parser.parse_program();
+        EXPECT_TRUE(program.has_compiled);
+
+        camaroo_core::evaluator evaluator(*pool);
+        evaluator.evaluate_program(program);
+
+        int64_t total = 0;
+        for (int64_t i = 0; i < 50000; ++i)
+            total += i * i;
+        EXPECT_TRUE(std::get<int64_t>(evaluator.get_variable("total")->variable_value) == total);
+        EXPECT_TRUE(std::get<double>(evaluator.get_variable("weight")->variable_value) == 0.5 + 0.125 * 50000);
+        EXPECT_TRUE(std::get<int64_t>(evaluator.get_variable("largest")->variable_value) == 49999);
+        EXPECT_TRUE(std::get<int64_t>(evaluator.get_variable("squares")->variable_value) == 30);
+        EXPECT_TRUE(evaluator.get_variable("square") == nullptr);
+    }
+}
+
+TEST (parallel_for_test, rejecting_outer_writes) {
+    camaroo_core::Parser parser("num t = 0;\nparallel for (num i, in (0 to 5)) {\n    t = t + i;\n}\n");
+    camaroo_core::Program program = parser.parse_program();
+    EXPECT_TRUE(program.has_compiled == false);
+
+    camaroo_core::Parser allowed("num t = 0;\nparallel for (num i, in (0 to 5)) {\n    num u = i;\n    u = u + 1;\n}\n");
+    EXPECT_TRUE(allowed.parse_program().has_compiled);
+
+    // Calls are held to it as well, the write would only reach the call's own frame
+    const std::string bump = "num t = 5;\nfunc bump(num x) -> num {\n    t = t + x;\n    return t;\n}\n";
+    std::string error = "Error: funcs can't write to outer variable t, return the new value instead";
+    camaroo_core::Program calls = camaroo_core::Parser(bump + "num r = bump(2);\n").parse_program();
+    EXPECT_TRUE(camaroo_core::check_types(calls.statements) == std::vector<std::string>{error});
+    EXPECT_TRUE(run(calls) == error + "\n");
+
+    // Declaring its own t, or taking it as a parameter, is fine
+    camaroo_core::Program local = camaroo_core::Parser(
+        "num t = 5;\nfunc bump(num x) -> num {\n    num t = 1;\n    t = t + x;\n    return t;\n}\n"
+        "func step(num t) -> num {\n    t = t + 1;\n    return t;\n}\nprintln(bump(2) + step(t));\nprintln(t);\n").parse_program();
+    EXPECT_TRUE(camaroo_core::check_types(local.statements).empty());
+    EXPECT_TRUE(run(local) == "9\n5\n");
+}
+
+TEST (evaluator_test, prefix_minus_binding) {
+    camaroo_core::thread_pool pool(1);
+    camaroo_core::Parser parser("num a = 100 / -3 / -3;\nnum b = -2 * 3 + 1;\nnum c = 10 - -2 * 3;\nnum d = 7 % -4 * -1;\n");
+    camaroo_core::Program program = parser.parse_program();
+    EXPECT_TRUE(program.has_compiled);
+
+    camaroo_core::evaluator evaluator(pool);
+    evaluator.evaluate_program(program);
+    EXPECT_TRUE(std::get<int64_t>(evaluator.get_variable("a")->variable_value) == 11);
+    EXPECT_TRUE(std::get<int64_t>(evaluator.get_variable("b")->variable_value) == -5);
+    EXPECT_TRUE(std::get<int64_t>(evaluator.get_variable("c")->variable_value) == 16);
+    EXPECT_TRUE(std::get<int64_t>(evaluator.get_variable("d")->variable_value) == -3);
+}
@@ -0,0 +1,76 @@
+#include <ast_cache.h>
+#include <engine.h>
+#include <hash.h>
+#include <test_run.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+TEST (format_test, filling_slots) {
+    std::string output = run(
+        "num x = 3;\n"
+        "fnum rate = 0.25;\n"
+        "text name = \"bob\";\n"
+        "println(\"total: {x} items at {rate * 2.0} for {name + \"!\"}\");\n"
+        "text line = \"x={x + 1}, list={[1, 2]}, ok={x < 4}, \\{kept\\} }\";\n"
+        "println(line);\n"
+        "print(\"{x}{x}\");\n"
+        "println(\"\");\n"
+        "println(len(\"{name}{name}\"));\n");
+    EXPECT_TRUE(output == "total: 3 items at 0.5 for bob!\nx=4, list=[1, 2], ok=true, {kept} }\n33\n6\n");
+
+    std::vector<std::string> errors = camaroo_core::Parser("println(\"a {x\");\n").parse_program().errors;
+    EXPECT_TRUE(!errors.empty() && errors[0] == "Error: text has a { without a closing }");
+    errors = camaroo_core::Parser("println(\"a {1 2}\");\n").parse_program().errors;
+    EXPECT_TRUE(std::find(errors.begin(), errors.end(), "Error: couldn't parse {1 2} in text") != errors.end());
+}
+
+TEST (format_test, going_through_the_optimizers) {
+    // Inlined, hoisted out of the loop and specialized slots all render what the plain program does
+    std::string source =
+        "num width = 4;\n"
+        "func label(num n) -> text {\n"
+        "    return \"item {n}\";\n"
+        "}\n"
+        "for (num i, in (0 to 3)) {\n"
+        "    println(\"{label(i)} of {width * 2}: {i * i}\");\n"
+        "}\n";
+    std::string expected = "item 0 of 8: 0\nitem 1 of 8: 1\nitem 2 of 8: 4\n";
+    EXPECT_TRUE(run(source) == expected);
+
+    camaroo_core::Engine engine(1);
+    for (const camaroo_core::specializations& fixed : {camaroo_core::specializations{}, camaroo_core::specializations{{"width", "4"}}}) {
+        std::shared_ptr<const camaroo_core::Script> script = engine.compile(source, fixed);
+        std::ostringstream out;
+        camaroo_core::Context context(engine, out);
+        engine.run(*script, context);
+        EXPECT_TRUE(out.str() == expected);
+    }
+}
+
+TEST (format_test, caching_formats) {
+    std::string source = "num x = 5;\ntext shown = \"x is {x * 2} \\{not a slot\\}\";\nprintln(shown);\n";
+    camaroo_core::Program program = camaroo_core::Parser(source).parse_program();
+    ASSERT_TRUE(program.has_compiled);
+    uint64_t hash = camaroo_core::content_hash(source);
+    std::string data = camaroo_core::ast_cache::serialize(program, hash);
+    std::optional<camaroo_core::Program> loaded = camaroo_core::ast_cache::deserialize(data.data(), data.size(), hash);
+    ASSERT_TRUE(loaded.has_value());
+
+    camaroo_core::evaluator evaluator;
+    evaluator.evaluate_program(*loaded);
+    EXPECT_TRUE(std::get<camaroo_core::camaroo_text>(evaluator.get_variable("shown")->variable_value).view() == "x is 10 {not a slot}");
+}
+
+TEST (format_test, reading_letters_and_unclosed_slots) {
+    // A brace or a quote in a letter doesn't end the slot
+    EXPECT_TRUE(run("println(\"a{'}'}b\");\nprintln(\"{'\\''}{'{'}\");\n") == "a}b\n'{\n");
+
+    // An unclosed slot ends with its line, the lines after it parse as they are
+    camaroo_core::Program program = camaroo_core::Parser("text t = \"a{\"; println(t);\nnum x = 1;\nprintln(x);\n").parse_program();
+    ASSERT_TRUE(!program.errors.empty());
+    EXPECT_TRUE(program.errors[0] == "Error: text has a { without a closing }");
+    EXPECT_TRUE(program.statements.size() == 2);
+}
@@ -0,0 +1,56 @@
+#include <evaluator.h>
+#include <generator.h>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+std::string get_test_file(const std::string& path);
+
+namespace {
+    camaroo_core::generator<int> count_to(int limit) {
+        for (int i = 0; i < limit; ++i)
+            co_yield i;
+    }
+}
+
+TEST (generator_test, handling_native_generators) {
+    std::vector<int> seen;
+    camaroo_core::generator<int> numbers = count_to(5);
+    while (numbers.next())
+        seen.push_back(numbers.value());
+    EXPECT_TRUE(seen == std::vector<int>({0, 1, 2, 3, 4}));
+    EXPECT_TRUE(numbers.next() == false);
+
+    // A finished frame is handed back and the next one of the same size reuses it
+    void* frame = camaroo_core::frame_allocator::allocate(200);
+    camaroo_core::frame_allocator::deallocate(frame, 200);
+    EXPECT_TRUE(camaroo_core::frame_allocator::allocate(200) == frame);
+    camaroo_core::frame_allocator::deallocate(frame, 200);
+}
+
+TEST (generator_test, handling_gen_functions) {
+    camaroo_core::Parser parser(get_test_file("camaroo_tests/res/generator_test.cmr"));
+    camaroo_core::Program program = parser.parse_program();
+    EXPECT_TRUE(program.has_compiled);
+
+    camaroo_core::evaluator evaluator;
+    evaluator.evaluate_program(program);
+
+    int64_t total = 0;
+    for (int64_t i = 0; i < 1000; ++i)
+        total += i * i;
+    EXPECT_TRUE(std::get<int64_t>(evaluator.get_variable("total")->variable_value) == total);
+    EXPECT_TRUE(std::get<double>(evaluator.get_variable("mixed")->variable_value) == 285 + 0.5 * 10);
+    EXPECT_TRUE(std::get<int64_t>(evaluator.get_variable("stopped")->variable_value) == 3);
+}
+
+TEST (generator_test, rejecting_misplaced_yield_and_return) {
+    camaroo_core::Parser outside("yield 1;\n");
+    EXPECT_TRUE(outside.parse_program().has_compiled == false);
+
+    camaroo_core::Parser in_func("func f() -> num {\n    yield 1;\n}\n");
+    EXPECT_TRUE(in_func.parse_program().has_compiled == false);
+
+    camaroo_core::Parser in_parallel("func f() -> num {\n    parallel for (num i, in (0 to 3)) {\n        return i;\n    }\n    return 0;\n}\n");
+    EXPECT_TRUE(in_parallel.parse_program().has_compiled == false);
+}
@@ -0,0 +1,194 @@
+#include <engine.h>
+#include <hoist.h>
+#include <optimize.h>
+#include <test_run.h>
+#include <gtest/gtest.h>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    // Invariants at every depth, a variable the body assigns, loops inside functions, gens and parallel loops,
+    // and inductions over variables the inner loop doesn't touch
+    const std::string script =
+        "func scaled(num x, num by) -> num {\n"
+        "    num sum = 0;\n"
+        "    for (num i, in (0 to x)) {\n"
+        "        sum = sum + i * by + by * by;\n"
+        "    }\n"
+        "    return sum;\n"
+        "}\n"
+        "gen steps(num n, num k) -> num {\n"
+        "    for (num i, in (0 to n)) {\n"
+        "        yield i * k + k * k;\n"
+        "    }\n"
+        "}\n"
+        "num n = 6;\n"
+        "num k = 5;\n"
+        "num total = 0;\n"
+        "for (num i, in (0 to 40)) {\n"
+        "    num base = n * k + 1;\n"
+        "    total = total + base + i * k + (i * 8 + 3);\n"
+        "    for (num j, in (0 to n)) {\n"
+        "        total = total + (i * 4 + 1) * j + n * n - j * k;\n"
+        "    }\n"
+        "    n = n + i % 2;\n"
+        "}\n"
+        "for (num v, in steps(10, k)) {\n"
+        "    total = total + v;\n"
+        "}\n"
+        "fnum f = 1.5;\n"
+        "fnum s = 0.0;\n"
+        "for (num i, in (0 to 9)) {\n"
+        "    s = s + i * f + f * f;\n"
+        "}\n"
+        "parallel for (num i, in (0 to 3000), reduce + total) {\n"
+        "    total = total + i * k + k * k;\n"
+        "}\n"
+        "println(total + scaled(30, k));\n"
+        "println(s);\n";
+
+    void find(camaroo_core::ExpressionNode* node, camaroo_core::NodeKind kind, std::vector<std::string>& found) {
+        if (node->node_kind() == kind)
+            found.push_back(node->to_string());
+        node->visit_expressions([&](std::unique_ptr<camaroo_core::ExpressionNode>& child) {
+            if (child)
+                find(child.get(), kind, found);
+        });
+    }
+
+    std::vector<std::string> find(const camaroo_core::Program& program, camaroo_core::NodeKind kind) {
+        std::vector<std::string> found;
+        for (const auto& statement : program.statements)
+            camaroo_core::visit_expression_roots(statement.get(), [&](std::unique_ptr<camaroo_core::ExpressionNode>& slot) {
+                find(slot.get(), kind, found);
+            });
+        return found;
+    }
+
+    bool mentions(const std::vector<std::string>& texts, const std::string& name) {
+        for (const auto& text : texts) {
+            if (text.find("ID: " + name) != std::string::npos)
+                return true;
+        }
+        return false;
+    }
+}
+
+TEST (hoist_test, hoisting_invariants) {
+    camaroo_core::Program plain = camaroo_core::Parser(script).parse_program();
+    camaroo_core::Program hoisted = camaroo_core::Parser(script).parse_program();
+    ASSERT_TRUE(plain.has_compiled && hoisted.has_compiled);
+    camaroo_core::optimize(hoisted.statements);
+
+    std::vector<std::string> moved = find(hoisted, camaroo_core::NodeKind::hoisted);
+    std::vector<std::string> inductions = find(hoisted, camaroo_core::NodeKind::induction);
+    EXPECT_TRUE(mentions(moved, "k") && mentions(moved, "f"));
+    // n changes in the outer loop and not in the inner one, the body declares base and assigns total
+    EXPECT_TRUE(!mentions(moved, "total") && !mentions(moved, "base"));
+    // n * n moves out of the inner loop only
+    EXPECT_TRUE(mentions(moved, "n"));
+    EXPECT_TRUE(inductions.size() >= 5);
+
+    std::string expected = run(plain);
+    EXPECT_TRUE(expected.find("Error") == std::string::npos);
+    EXPECT_TRUE(run(hoisted) == expected);
+}
+
+TEST (hoist_test, keeping_errors_in_place) {
+    // The invariant division fails on the third iteration only because the loop ran at all, after two lines printed
+    const std::string failing =
+        "num zero = 0;\n"
+        "for (num i, in (0 to 5)) {\n"
+        "    println(i);\n"
+        "    println(10 / (zero * i + zero));\n"
+        "}\n"
+        "for (num i, in (0 to 0)) {\n"
+        "    println(1 / zero);\n"
+        "}\n"
+        "num limit = 3;\n"
+        "for (num i, in (0 to 4)) {\n"
+        "    println(i * 2 % limit);\n"
+        "}\n";
+    camaroo_core::Program plain = camaroo_core::Parser(failing).parse_program();
+    camaroo_core::Program hoisted = camaroo_core::Parser(failing).parse_program();
+    ASSERT_TRUE(plain.has_compiled && hoisted.has_compiled);
+    EXPECT_TRUE(camaroo_core::hoist_invariants(hoisted.statements) > 0);
+    EXPECT_TRUE(run(hoisted) == run(plain));
+}
+
+TEST (hoist_test, matching_unhoisted_loops) {
+    // Random nests of loops that read, declare and assign a handful of variables, run as parsed and optimized
+    std::mt19937_64 random(41);
+    auto pick = [&](size_t n) { return static_cast<size_t>(random() % n); };
+    const char* symbols[] = {"+", "-", "*", "/", "%"};
+
+    for (int program = 0; program < 150; ++program) {
+        std::vector<std::string> readable = {"a", "b", "c", "f"};
+        std::vector<std::string> assignable = {"a", "b", "total"};
+
+        std::function<std::string(int)> expression = [&](int depth) -> std::string {
+            if (depth == 0 || pick(3) == 0)
+                return pick(3) == 0 ? std::to_string(pick(10)) : readable[pick(readable.size())];
+            return "(" + expression(depth - 1) + " " + symbols[pick(5)] + " " + expression(depth - 1) + ")";
+        };
+
+        std::function<std::string(int, const std::string&)> body = [&](int depth, const std::string& indent) -> std::string {
+            std::string text;
+            size_t declared = readable.size();
+            size_t statements = 1 + pick(4);
+            for (size_t s = 0; s < statements; ++s) {
+                switch (pick(depth > 0 ? 5 : 4)) {
+                    case 0:
+                        text += indent + "println(" + expression(3) + ");\n";
+                        break;
+                    case 1:
+                        text += indent + assignable[pick(assignable.size())] + " = " + expression(3) + ";\n";
+                        break;
+                    case 2: {
+                        std::string name = "v" + std::to_string(readable.size());
+                        text += indent + "num " + name + " = " + expression(2) + ";\n";
+                        readable.push_back(name);
+                        break;
+                    }
+                    case 3:
+                        text += indent + "total = total + " + readable[pick(readable.size())] + " * " + std::to_string(pick(9)) + ";\n";
+                        break;
+                    default: {
+                        std::string variable = "i" + std::to_string(readable.size());
+                        std::string range = pick(2) ? std::to_string(pick(6)) : "(c % 5)";
+                        text += indent + "for (num " + variable + ", in (" + std::to_string(pick(3)) + " to " + range + ")) {\n";
+                        readable.push_back(variable);
+                        text += body(depth - 1, indent + "    ");
+                        text += indent + "}\n";
+                        break;
+                    }
+                }
+            }
+            readable.resize(declared);
+            return text;
+        };
+
+        std::string source;
+        for (int statement = 0; statement < 3; ++statement) {
+            source += "for (num i, in (0 to " + std::to_string(1 + pick(8)) + ")) {\n";
+            readable.push_back("i");
+            source += body(2, "    ");
+            readable.pop_back();
+            source += "}\n";
+        }
+        source += "println(total);\n";
+
+        camaroo_core::Program plain = camaroo_core::Parser(source).parse_program();
+        camaroo_core::Program hoisted = camaroo_core::Parser(source).parse_program();
+        ASSERT_TRUE(plain.has_compiled && hoisted.has_compiled) << source;
+        camaroo_core::optimize(hoisted.statements);
+
+        for (const char* globals : {"num a = 3; num b = 0 - 7; num c = 11; fnum f = 0.5; num total = 0;",
+                                    "num a = 9223372036854775807; num b = 2; num c = 4; fnum f = 2.0; num total = 1;",
+                                    "num a = 0; num b = 0; num c = 0; text f = \"x\"; num total = 0;"}) {
+            ASSERT_TRUE(run(hoisted, globals) == run(plain, globals)) << source << globals;
+        }
+    }
+}
@@ -0,0 +1,160 @@
+#include <engine.h>
+#include <inliner.h>
+#include <optimize.h>
+#include <test_run.h>
+#include <gtest/gtest.h>
+#include <string>
+
+namespace {
+    size_t count(camaroo_core::ExpressionNode* node, camaroo_core::NodeKind kind) {
+        size_t found = node->node_kind() == kind ? 1 : 0;
+        node->visit_expressions([&](std::unique_ptr<camaroo_core::ExpressionNode>& child) {
+            if (child)
+                found += count(child.get(), kind);
+        });
+        return found;
+    }
+
+    size_t count(const camaroo_core::Program& program, camaroo_core::NodeKind kind) {
+        size_t found = 0;
+        for (const auto& statement : program.statements)
+            camaroo_core::visit_expression_roots(statement.get(), [&](std::unique_ptr<camaroo_core::ExpressionNode>& slot) {
+                found += count(slot.get(), kind);
+            });
+        return found;
+    }
+
+    // Runs source as parsed and with optimize, eagerly and with bodies parsed on first use, and checks the outputs match
+    bool matches(const std::string& source, std::string* output = nullptr) {
+        camaroo_core::Program plain = camaroo_core::Parser(source).parse_program();
+        camaroo_core::Program eager = camaroo_core::Parser(source).parse_program();
+        camaroo_core::Program lazy = camaroo_core::Parser(source, true).parse_program();
+        camaroo_core::optimize(eager.statements);
+        camaroo_core::optimize(lazy.statements);
+        std::string expected = run(plain);
+        if (output)
+            *output = expected;
+        return run(eager) == expected && run(lazy) == expected;
+    }
+}
+
+TEST (inliner_test, inlining_small_functions) {
+    const std::string source =
+        "func calc(num a, num b) -> num {\n"
+        "    num sum = a + b;\n"
+        "    return sum * sum - a;\n"
+        "}\n"
+        "func half(fnum x) -> fnum {\n"
+        "    return x / 2.0;\n"
+        "}\n"
+        "func twice(num x) -> num {\n"
+        "    return calc(x, x);\n"
+        "}\n"
+        "num total = 0;\n"
+        "for (num i, in (0 to 10)) {\n"
+        "    total = total + calc(i, 3);\n"
+        "}\n"
+        "println(total);\n"
+        "println(half(7));\n"
+        "println(twice(4));\n";
+    camaroo_core::Program eager = camaroo_core::Parser(source).parse_program();
+    ASSERT_TRUE(eager.has_compiled);
+    // twice calls another function and stays a call, the call to calc in its body goes
+    EXPECT_TRUE(camaroo_core::inline_calls(eager.statements) == 3);
+    EXPECT_TRUE(count(eager, camaroo_core::NodeKind::inlined) == 3);
+
+    // Skipped bodies are short enough to qualify, they're left to be parsed by the first call
+    camaroo_core::Program lazy = camaroo_core::Parser(source, true).parse_program();
+    ASSERT_TRUE(lazy.has_compiled);
+    EXPECT_TRUE(camaroo_core::inline_calls(lazy.statements) == 3);
+    for (size_t i = 0; i < 3; ++i)
+        EXPECT_TRUE(static_cast<camaroo_core::FuncStmnt*>(lazy.statements[i].get())->get_definition()->body == nullptr);
+
+    std::string output;
+    EXPECT_TRUE(matches(source, &output));
+    EXPECT_TRUE(output == "600\n3.5\n60\n");
+}
+
+TEST (inliner_test, keeping_calls_that_dont_qualify) {
+    std::string large = "func large(num x) -> num {\n    return x";
+    for (int i = 0; i < 40; ++i)
+        large += " + " + std::to_string(i);
+    large += ";\n}\n";
+    const std::string source = large +
+        "func fact(num n) -> num {\n"
+        "    return n * fact(n - 1);\n"
+        "}\n"
+        "num g = 5;\n"
+        "func readsglobal(num x) -> num {\n"
+        "    return x + g;\n"
+        "}\n"
+        "func noisy(num x) -> num {\n"
+        "    println(x);\n"
+        "    return x;\n"
+        "}\n"
+        "gen values(num x) -> num {\n"
+        "    yield x;\n"
+        "}\n"
+        "println(large(1));\n"
+        "println(readsglobal(2));\n"
+        "println(noisy(3));\n"
+        "println(values(4));\n";
+    camaroo_core::Program program = camaroo_core::Parser(source).parse_program();
+    ASSERT_TRUE(program.has_compiled);
+    EXPECT_TRUE(camaroo_core::inline_calls(program.statements) == 0);
+}
+
+TEST (inliner_test, reporting_the_same_errors) {
+    // Wrong argument and return types, widening, a division by zero in a local, too few arguments and a
+    // function declared again under the same name
+    const std::string source =
+        "func calc(num a, num b) -> num {\n"
+        "    num q = a / b;\n"
+        "    return q + 1;\n"
+        "}\n"
+        "func label(num a) -> text {\n"
+        "    return a;\n"
+        "}\n"
+        "func widen(fnum a) -> fnum {\n"
+        "    return a * 2;\n"
+        "}\n"
+        "println(calc(8, 2));\n"
+        "println(calc(8, 0));\n"
+        "println(calc(\"x\", 2));\n"
+        "println(calc(8));\n"
+        "println(label(3));\n"
+        "println(widen(3));\n"
+        "func twice(num a) -> num {\n"
+        "    return a * 2;\n"
+        "}\n"
+        "println(twice(5));\n"
+        "func twice(num a) -> num {\n"
+        "    return a * 3;\n"
+        "}\n"
+        "println(twice(5));\n";
+    std::string output;
+    EXPECT_TRUE(matches(source, &output));
+    EXPECT_TRUE(output.find("calc expects a to be num but found text") != std::string::npos);
+    EXPECT_TRUE(output.find("label returns text but returned num") != std::string::npos);
+    EXPECT_TRUE(output.find("10\n15\n") != std::string::npos);
+}
+
+TEST (inliner_test, calling_functions_declared_later) {
+    // The first call is made before shape exists, the last one passes an inlined call as the argument
+    const std::string source =
+        "println(shape(2));\n"
+        "func shape(num x) -> num {\n"
+        "    num y = x * x;\n"
+        "    num z = y + x;\n"
+        "    return z - 1;\n"
+        "}\n"
+        "println(shape(3));\n"
+        "for (num i, in (0 to 3)) {\n"
+        "    println(shape(i));\n"
+        "}\n"
+        "println(shape(shape(2)));\n";
+    std::string output;
+    EXPECT_TRUE(matches(source, &output));
+    EXPECT_TRUE(output.find("shape is not a function") != std::string::npos);
+    EXPECT_TRUE(output.find("11\n-1\n1\n5\n29\n") != std::string::npos);
+}
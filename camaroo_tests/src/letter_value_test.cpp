@@ -0,0 +1,71 @@
+#include <engine.h>
+#include <list.h>
+#include <type_check.h>
+#include <test_run.h>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+TEST (letter_value_test, literals_and_escapes) {
+    camaroo_core::Tokenizer tokens("'\\t' '\xC3\xA9' '\\0' 'ab'");
+    std::optional<camaroo_core::Token> token = tokens.next_token();
+    EXPECT_TRUE(token.value().type == camaroo_core::TokenType::letter && token.value().value == "'\t'");
+    token = tokens.next_token();
+    EXPECT_TRUE(token.value().type == camaroo_core::TokenType::letter && token.value().value == "'\xC3\xA9'");
+    token = tokens.next_token();
+    EXPECT_TRUE(token.value().type == camaroo_core::TokenType::letter && token.value().value == std::string("'\0'", 3));
+    token = tokens.next_token();
+    EXPECT_TRUE(token.value().type == camaroo_core::TokenType::unknown);
+
+    camaroo_core::LetterExpr accented(camaroo_core::Token{camaroo_core::TokenType::letter, "\xC3\xA9"});
+    EXPECT_TRUE(accented.get_letter() == U'\u00E9');
+
+    std::string output = run(
+        "letter a = 'x';\n"
+        "letter q = '\\'';\n"
+        "letter e = '\xC3\xA9';\n"
+        "println(a);\n"
+        "println(\"[\" + a + \"]\" + q + e);\n"
+        "println(a < 'y');\n"
+        "println(e == '\xC3\xA9');\n"
+        "println(\"{a}{e}\");\n");
+    EXPECT_TRUE(output == "x\n[x]'\xC3\xA9\ntrue\ntrue\nx\xC3\xA9\n");
+}
+
+TEST (letter_value_test, byte_packed_lists) {
+    std::vector<std::shared_ptr<camaroo_core::camaroo_object>> elements = {
+        camaroo_core::make_object(camaroo_core::TokenType::letter, U'b'),
+        camaroo_core::make_object(camaroo_core::TokenType::letter, U'\u00E9'),
+    };
+    std::shared_ptr<camaroo_core::camaroo_object> list = camaroo_core::make_list(elements);
+    const camaroo_core::camaroo_list& values = *std::get<std::shared_ptr<camaroo_core::camaroo_list>>(list->variable_value);
+    EXPECT_TRUE(values.element_type == camaroo_core::TokenType::letter);
+    EXPECT_TRUE(std::get<std::vector<uint8_t>>(values.elements) == std::vector<uint8_t>({'b', 0xE9}));
+
+    // Long enough for the comparisons to go sixteen letters at a time
+    std::string result = run(
+        "list l = letters(\"the quick brown fox jumps over the lazy dog\");\n"
+        "println(len(l));\n"
+        "println(len(filter(l, l == 'o')));\n"
+        "println(len(filter(l, l > 's')));\n"
+        "println(sum(l == sort(l)));\n"
+        "println(filter(l, l <= 'c'));\n"
+        "num vowels = 0;\n"
+        "for (letter c, in letters(\"camaroo\")) {\n"
+        "    vowels = vowels + len(filter([c], [c] == 'a')) + len(filter([c], [c] == 'o'));\n"
+        "}\n"
+        "println(vowels);\n");
+    EXPECT_TRUE(result == "43\n4\n9\n3\n[ , c,  , b,  ,  ,  ,  ,  , a,  ]\n4\n");
+}
+
+TEST (letter_value_test, types_and_errors) {
+    camaroo_core::Program program = camaroo_core::Parser(
+        "letter c = 'a';\ntext t = \"b\" + c;\nnum n = c + 1;\ntoggle less = c < 'b';\n").parse_program();
+    EXPECT_TRUE(program.errors.empty());
+    std::vector<std::string> expected = {"Error: arithmetic needs num or fnum operands"};
+    EXPECT_TRUE(camaroo_core::check_types(program.statements) == expected);
+
+    EXPECT_TRUE(run("list l = letters(\"\xE6\x97\xA5\");\n").find("Error: lists only hold letters up to U+00FF") != std::string::npos);
+    EXPECT_TRUE(run("println(sum(letters(\"ab\")));\n").find("Error: expected a list of num or fnum but found a list of letter") != std::string::npos);
+    EXPECT_TRUE(run("println('a' < 1);\n").find("Error: can't compare values of different types") != std::string::npos);
+}
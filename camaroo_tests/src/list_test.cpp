@@ -0,0 +1,166 @@
+#include <list.h>
+#include <simd.h>
+#include <type_check.h>
+#include <test_run.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace {
+    // Sizes around the vector widths so every kernel also runs its scalar tail
+    const std::vector<size_t> test_sizes = {0, 1, 2, 3, 4, 5, 7, 8, 9, 31, 32, 33, 1000};
+
+    std::vector<int64_t> random_nums(size_t n, std::mt19937_64& rng) {
+        std::uniform_int_distribution<int64_t> dist(-1000000, 1000000);
+        std::vector<int64_t> values(n);
+        for (auto& value : values)
+            value = dist(rng);
+        return values;
+    }
+
+    std::shared_ptr<camaroo_core::camaroo_object> num_list(std::vector<int64_t> values) {
+        auto list = std::make_shared<camaroo_core::camaroo_list>(
+            camaroo_core::camaroo_list{camaroo_core::TokenType::num, std::move(values)});
+        return camaroo_core::make_object(camaroo_core::TokenType::list, list);
+    }
+
+    const camaroo_core::camaroo_list& as_list(const std::shared_ptr<camaroo_core::camaroo_object>& object) {
+        return *std::get<std::shared_ptr<camaroo_core::camaroo_list>>(object->variable_value);
+    }
+}
+
+TEST (simd_kernels_test, arith_matches_scalar) {
+    std::mt19937_64 rng(42);
+    for (size_t n : test_sizes) {
+        std::vector<int64_t> a = random_nums(n, rng);
+        std::vector<int64_t> b = random_nums(n, rng);
+        std::vector<int64_t> out(n);
+
+        camaroo_core::simd::arith(camaroo_core::simd::arith_op::multiply, a.data(), b.data(), out.data(), n);
+        for (size_t i = 0; i < n; ++i)
+            EXPECT_TRUE(out[i] == a[i] * b[i]);
+
+        camaroo_core::simd::arith_scalar(camaroo_core::simd::arith_op::subtract, a.data(), 7, out.data(), n, true);
+        for (size_t i = 0; i < n; ++i)
+            EXPECT_TRUE(out[i] == 7 - a[i]);
+    }
+}
+
+TEST (simd_kernels_test, reductions_match_scalar) {
+    std::mt19937_64 rng(7);
+    for (size_t n : test_sizes) {
+        if (n == 0)
+            continue;
+        std::vector<int64_t> a = random_nums(n, rng);
+        std::vector<int64_t> b = random_nums(n, rng);
+
+        int64_t sum = 0, dot = 0;
+        for (size_t i = 0; i < n; ++i) {
+            sum += a[i];
+            dot += a[i] * b[i];
+        }
+        EXPECT_TRUE(camaroo_core::simd::sum(a.data(), n) == sum);
+        EXPECT_TRUE(camaroo_core::simd::dot(a.data(), b.data(), n) == dot);
+        EXPECT_TRUE(camaroo_core::simd::min(a.data(), n) == *std::min_element(a.begin(), a.end()));
+        EXPECT_TRUE(camaroo_core::simd::max(a.data(), n) == *std::max_element(a.begin(), a.end()));
+
+        std::vector<double> f(a.begin(), a.end());
+        EXPECT_TRUE(camaroo_core::simd::min(f.data(), n) == *std::min_element(f.begin(), f.end()));
+        EXPECT_TRUE(camaroo_core::simd::max(f.data(), n) == *std::max_element(f.begin(), f.end()));
+    }
+}
+
+TEST (simd_kernels_test, compare_and_compress) {
+    std::mt19937_64 rng(3);
+    for (size_t n : test_sizes) {
+        std::vector<int64_t> a = random_nums(n, rng);
+        std::vector<uint8_t> mask(n);
+        std::vector<int64_t> out(n);
+
+        camaroo_core::simd::compare_scalar(camaroo_core::simd::compare_op::less_equal, a.data(), 0, mask.data(), n);
+        size_t kept = camaroo_core::simd::compress(a.data(), mask.data(), out.data(), n);
+
+        std::vector<int64_t> expected;
+        for (int64_t value : a) {
+            if (value <= 0)
+                expected.push_back(value);
+        }
+        out.resize(kept);
+        EXPECT_TRUE(out == expected);
+        EXPECT_TRUE(camaroo_core::simd::count(mask.data(), n) == expected.size());
+    }
+}
+
+TEST (list_test, handling_list_operations) {
+    camaroo_core::thread_pool pool(1);
+    auto xs = num_list({1, 2, 3, 4, 5});
+    auto two = camaroo_core::make_object(camaroo_core::TokenType::num, int64_t(2));
+    auto half = camaroo_core::make_object(camaroo_core::TokenType::fnum, 0.5);
+
+    auto doubled = camaroo_core::list_arith(pool, camaroo_core::simd::arith_op::multiply, *xs, *two);
+    EXPECT_TRUE(std::get<std::vector<int64_t>>(as_list(doubled).elements) == std::vector<int64_t>({2, 4, 6, 8, 10}));
+
+    auto halved = camaroo_core::list_arith(pool, camaroo_core::simd::arith_op::multiply, *half, *xs);
+    EXPECT_TRUE(as_list(halved).element_type == camaroo_core::TokenType::fnum);
+    EXPECT_TRUE(std::get<std::vector<double>>(as_list(halved).elements) == std::vector<double>({0.5, 1, 1.5, 2, 2.5}));
+
+    auto mask = camaroo_core::list_compare(pool, camaroo_core::simd::compare_op::less, *two, *xs);
+    auto kept = camaroo_core::list_filter(pool, as_list(xs), as_list(mask));
+    EXPECT_TRUE(std::get<std::vector<int64_t>>(as_list(kept).elements) == std::vector<int64_t>({3, 4, 5}));
+
+    EXPECT_TRUE(std::get<int64_t>(camaroo_core::list_sum(pool, as_list(xs))->variable_value) == 15);
+    EXPECT_TRUE(std::get<int64_t>(camaroo_core::list_dot(pool, as_list(xs), as_list(xs))->variable_value) == 55);
+
+    auto zero = camaroo_core::make_object(camaroo_core::TokenType::num, int64_t(0));
+    EXPECT_THROW(camaroo_core::list_arith(pool, camaroo_core::simd::arith_op::divide, *xs, *zero), std::runtime_error);
+    EXPECT_THROW(camaroo_core::list_min(pool, as_list(num_list({}))), std::runtime_error);
+}
+
+TEST (list_test, parallel_results_match_single_thread) {
+    std::mt19937_64 rng(11);
+    auto xs = num_list(random_nums(camaroo_core::list_parallel_grain * 5 + 123, rng));
+    auto limit = camaroo_core::make_object(camaroo_core::TokenType::num, int64_t(0));
+
+    camaroo_core::thread_pool single(1);
+    camaroo_core::thread_pool many(4);
+    for (auto* pool : {&single, &many}) {
+        auto sum = camaroo_core::list_sum(*pool, as_list(xs));
+        EXPECT_TRUE(std::get<int64_t>(sum->variable_value) == camaroo_core::simd::sum(
+            std::get<std::vector<int64_t>>(as_list(xs).elements).data(), as_list(xs).size()));
+
+        auto sorted = camaroo_core::list_sort(*pool, as_list(xs));
+        const auto& values = std::get<std::vector<int64_t>>(as_list(sorted).elements);
+        EXPECT_TRUE(values.size() == as_list(xs).size());
+        EXPECT_TRUE(std::is_sorted(values.begin(), values.end()));
+
+        auto mask = camaroo_core::list_compare(*pool, camaroo_core::simd::compare_op::greater, *xs, *limit);
+        auto kept = camaroo_core::list_filter(*pool, as_list(xs), as_list(mask));
+        for (int64_t value : std::get<std::vector<int64_t>>(as_list(kept).elements))
+            EXPECT_TRUE(value > 0);
+    }
+
+    auto single_filtered = camaroo_core::list_filter(single, as_list(xs),
+        as_list(camaroo_core::list_compare(single, camaroo_core::simd::compare_op::greater, *xs, *limit)));
+    auto many_filtered = camaroo_core::list_filter(many, as_list(xs),
+        as_list(camaroo_core::list_compare(many, camaroo_core::simd::compare_op::greater, *xs, *limit)));
+    EXPECT_TRUE(std::get<std::vector<int64_t>>(as_list(single_filtered).elements) ==
+                std::get<std::vector<int64_t>>(as_list(many_filtered).elements));
+}
+
+TEST (list_test, comparing_nan_like_the_kernels) {
+    // NaN is unequal and unordered to everything, one at a time as well as across a list
+    std::string source =
+        "fnum a = 0.0 / 0.0;\n"
+        "fnum b = 1.0;\n"
+        "println(a == b);\nprintln(a != a);\nprintln(a < b);\nprintln(a >= a);\n"
+        "println(a == 1);\nprintln(1 != a);\n"
+        "println([a, b] == b);\nprintln([a, b] != a);\n";
+    std::string expected = "false\ntrue\nfalse\nfalse\nfalse\ntrue\n[false, true]\n[true, true]\n";
+
+    EXPECT_TRUE(run(source) == expected);
+    // Marked operators take the direct path
+    camaroo_core::Program checked = camaroo_core::Parser(source).parse_program();
+    EXPECT_TRUE(camaroo_core::check_types(checked.statements).empty());
+    EXPECT_TRUE(run(checked) == expected);
+}
@@ -0,0 +1,123 @@
+#include <engine.h>
+#include <map.h>
+#include <type_check.h>
+#include <test_run.h>
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+    // The live keys of map in the order it keeps them
+    std::vector<std::string> keys_of(const camaroo_core::camaroo_map& map) {
+        std::vector<std::string> keys;
+        for (size_t entry = 0; entry < map.entry_count(); ++entry) {
+            if (!map.has_entry(entry))
+                continue;
+            std::string key;
+            camaroo_core::append_object(key, *map.key_at(entry));
+            keys.push_back(key);
+        }
+        return keys;
+    }
+}
+
+TEST (map_test, matching_unordered_map) {
+    camaroo_core::camaroo_map nums(camaroo_core::TokenType::num, camaroo_core::TokenType::num);
+    camaroo_core::camaroo_map texts(camaroo_core::TokenType::text, camaroo_core::TokenType::num);
+    std::unordered_map<int64_t, int64_t> expected;
+    std::vector<std::string> order;
+    std::mt19937_64 random(7);
+    for (int step = 0; step < 40000; ++step) {
+        int64_t key = static_cast<int64_t>(random() % 3000) - 1500;
+        std::string text = "key" + std::to_string(key);
+        if (random() % 4 == 0) {
+            bool had = expected.erase(key) == 1;
+            EXPECT_TRUE(nums.erase(key) == had);
+            EXPECT_TRUE(texts.erase(text) == had);
+            if (had)
+                order.erase(std::find(order.begin(), order.end(), std::to_string(key)));
+            continue;
+        }
+        if (expected.find(key) == expected.end())
+            order.push_back(std::to_string(key));
+        expected[key] += step;
+        std::get<int64_t>(nums.insert(key, int64_t(0))) += step;
+        std::get<int64_t>(texts.insert(text, int64_t(0))) += step;
+    }
+
+    EXPECT_TRUE(nums.size() == expected.size() && texts.size() == expected.size());
+    for (int64_t key = -1600; key < 1600; ++key) {
+        auto found = expected.find(key);
+        camaroo_core::Value* num_value = nums.find(key);
+        camaroo_core::Value* text_value = texts.find("key" + std::to_string(key));
+        EXPECT_TRUE((num_value != nullptr) == (found != expected.end()));
+        EXPECT_TRUE((text_value != nullptr) == (found != expected.end()));
+        if (found != expected.end() && num_value && text_value) {
+            EXPECT_TRUE(std::get<int64_t>(*num_value) == found->second);
+            EXPECT_TRUE(std::get<int64_t>(*text_value) == found->second);
+        }
+    }
+
+    // Keys stay in the order they were first put in, through erasing and rehashing
+    EXPECT_TRUE(keys_of(nums) == order);
+    std::vector<std::string> text_order = keys_of(texts);
+    EXPECT_TRUE(text_order.size() == order.size());
+    for (size_t i = 0; i < order.size() && i < text_order.size(); ++i)
+        EXPECT_TRUE(text_order[i] == "key" + order[i]);
+
+    nums.reserve(100000);
+    EXPECT_TRUE(keys_of(nums) == order);
+}
+
+TEST (map_test, grouping_in_scripts) {
+    std::string output = run(
+        "map counts = map(text, num);\n"
+        "map totals = map(text, fnum);\n"
+        "for (text row, in split(\"b:1 a:2 b:3 c:4 a:5\", \" \")) {\n"
+        "    add(counts, replace(row, \":\", \"\"), 0);\n"
+        "}\n"
+        "for (text row, in split(\"b a b c a b\", \" \")) {\n"
+        "    add(counts, row, 1);\n"
+        "    add(totals, row, 0.5);\n"
+        "}\n"
+        "println(counts);\n"
+        "println(get(totals, \"b\"));\n"
+        "println(get(counts, \"z\", 0));\n"
+        "println(remove(counts, \"a2\"));\n"
+        "println(has(counts, \"a2\"));\n"
+        "map squares = map(num, num);\n"
+        "reserve(squares, 100);\n"
+        "for (num i, in (0 to 100)) {\n"
+        "    put(squares, i % 7, i * i);\n"
+        "}\n"
+        "println(keys(squares));\n"
+        "println(len(squares));\n"
+        "println(sum(values(squares)));\n");
+    EXPECT_TRUE(output ==
+        "{b1: 0, a2: 0, b3: 0, c4: 0, a5: 0, b: 3, a: 2, c: 1}\n1.5\n0\ntrue\nfalse\n"
+        "[0, 1, 2, 3, 4, 5, 6]\n7\n64540\n");
+}
+
+TEST (map_test, types_and_errors) {
+    camaroo_core::Program program = camaroo_core::Parser(
+        "map m = map(text, num);\nput(m, \"a\", 1);\nnum n = get(m, \"a\");\n").parse_program();
+    EXPECT_TRUE(program.errors.empty());
+    EXPECT_TRUE(camaroo_core::check_types(program.statements).empty());
+    EXPECT_TRUE(!camaroo_core::Parser("map m;\n").parse_program().errors.empty());
+    EXPECT_TRUE(!camaroo_core::Parser("map m = map(fnum, num);\n").parse_program().errors.empty());
+
+    EXPECT_TRUE(run("map m = map(text, num);\nput(m, 1, 1);\n").find("Error: put expects a text key for this map") != std::string::npos);
+    EXPECT_TRUE(run("map m = map(num, text);\nput(m, 1, 1);\n").find("Error: put expects a text value for this map") != std::string::npos);
+    EXPECT_TRUE(run("map m = map(num, text);\nadd(m, 1, 1);\n").find("Error: add needs a map of num or fnum values") != std::string::npos);
+    EXPECT_TRUE(run("map m = map(num, num);\nprintln(get(m, 4));\n").find("Error: the map has nothing under 4") != std::string::npos);
+
+    // Counts past what entries can be numbered with are refused before anything is allocated
+    std::string huge = run("map m = map(num, num);\nreserve(m, 9000000000000000000);\nput(m, 1, 2);\nprintln(len(m));\n");
+    EXPECT_TRUE(huge.find("Error: reserve asks for 9000000000000000000 keys") != std::string::npos);
+    EXPECT_TRUE(huge.find("1\n") != std::string::npos);
+    EXPECT_TRUE(run("map m = map(text, num);\nreserve(m, 1000000000000);\n").find("Error: reserve asks for 1000000000000 keys") != std::string::npos);
+    camaroo_core::camaroo_map nums(camaroo_core::TokenType::num, camaroo_core::TokenType::num);
+    EXPECT_THROW(nums.reserve(camaroo_core::camaroo_map::max_keys + 1), std::runtime_error);
+}
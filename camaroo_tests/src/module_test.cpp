@@ -0,0 +1,32 @@
+#include <evaluator.h>
+#include <module.h>
+#include <gtest/gtest.h>
+#include <string>
+
+std::string get_test_file(const std::string& path);
+
+TEST (module_test, linking_used_modules) {
+    std::string path = "camaroo_tests/res/modules/module_test.cmr";
+    camaroo_core::thread_pool pool(2);
+    camaroo_core::Program program = camaroo_core::modules::link(get_test_file(path), path, pool);
+    ASSERT_TRUE(program.has_compiled);
+
+    camaroo_core::evaluator evaluator(pool);
+    EXPECT_TRUE(evaluator.evaluate_program(program));
+    EXPECT_TRUE(std::get<int64_t>(evaluator.get_variable("result")->variable_value) == 49);
+    EXPECT_TRUE(std::get<camaroo_core::camaroo_text>(evaluator.get_variable("greeting")->variable_value).view() == "hi");
+    // shared is used twice but only runs once
+    EXPECT_TRUE(std::get<int64_t>(evaluator.get_variable("loads")->variable_value) == 1);
+}
+
+TEST (module_test, rejecting_bad_uses) {
+    camaroo_core::thread_pool pool(1);
+    std::string path = "camaroo_tests/res/modules/cycle_a.cmr";
+    EXPECT_THROW(camaroo_core::modules::link(get_test_file(path), path, pool), std::runtime_error);
+
+    camaroo_core::Program missing = camaroo_core::modules::link("use missing_module;\n", path, pool);
+    EXPECT_TRUE(missing.has_compiled == false && missing.errors.size() == 1);
+
+    camaroo_core::Parser nested("{\n    use lib/math;\n}\n");
+    EXPECT_TRUE(nested.parse_program().has_compiled == false);
+}
@@ -0,0 +1,73 @@
+#include <pattern.h>
+#include <test_run.h>
+#include <gtest/gtest.h>
+#include <regex>
+#include <string>
+#include <vector>
+
+TEST (pattern_test, matching_like_std_regex) {
+    std::vector<std::string> patterns = {
+        "error", "^GET", "ms$", "^$", "a|b|cd", "(ab)+c", "colou?r", "x*", "[0-9]{3}", "\\d{2,4}-\\d+",
+        "[^a-z ]+", "\\w+@\\w+\\.com", "^(?:GET|POST) /[a-z/]*$", "a.c", "(a|ab)(c|bcd)(d*)", "\\s\\S", "a{2,}b",
+        "[a\\-z]", "\\$", "[]x]",
+    };
+    std::vector<std::string> texts = {
+        "", "error", "GET /items/12 took 3ms", "POST /a/b", "colr color colour", "abcabcabc", "call 555-1234",
+        "mail bob@example.com", "a\nc", "abcd", "ABC DEF", "aaab", "-", "costs $5", "]",
+    };
+    for (const std::string& pattern : patterns) {
+        camaroo_core::camaroo_regex regex(pattern);
+        std::regex expected(pattern == "[]x]" ? "[\\]x]" : pattern);
+        for (const std::string& text : texts) {
+            bool found = std::regex_search(text, expected);
+            EXPECT_TRUE(regex.search(text) == found) << pattern << " on " << text;
+            EXPECT_TRUE(regex.simulate(text) == found) << pattern << " on " << text;
+        }
+    }
+}
+
+TEST (pattern_test, staying_linear) {
+    // Backtracking tries every way to split the a's between a? and a, about 2^n of them
+    size_t n = 40;
+    std::string pattern;
+    for (size_t i = 0; i < n; ++i)
+        pattern += "a?";
+    pattern += std::string(n, 'a');
+    camaroo_core::camaroo_regex regex(pattern);
+    EXPECT_TRUE(regex.search(std::string(n, 'a')));
+    EXPECT_TRUE(!regex.search(std::string(n - 1, 'a')));
+
+    // More distinct states than the DFA keeps, it starts over and then hands the rest to the NFA
+    camaroo_core::camaroo_regex wide("a[ab]{12}c");
+    std::string text;
+    for (size_t i = 0; i < 60000; ++i)
+        text += ((i * 2654435761u) >> 7) % 2 ? 'a' : 'b';
+    EXPECT_TRUE(!wide.search(text));
+    EXPECT_TRUE(wide.search(text + "abbbbbbbbbbbbc"));
+
+    EXPECT_TRUE(camaroo_core::camaroo_regex::compile("ab+") == camaroo_core::camaroo_regex::compile("ab+"));
+}
+
+TEST (pattern_test, keeping_only_recent_patterns) {
+    // Patterns made from data don't pile up, one used all along stays and one left alone goes
+    auto hot = camaroo_core::camaroo_regex::compile("hot[0-9]+");
+    auto cold = camaroo_core::camaroo_regex::compile("cold[0-9]+");
+    for (size_t i = 0; i < 4 * camaroo_core::camaroo_regex::cache_limit; ++i) {
+        camaroo_core::camaroo_regex::compile("id" + std::to_string(i));
+        EXPECT_TRUE(camaroo_core::camaroo_regex::compile("hot[0-9]+") == hot);
+    }
+    EXPECT_TRUE(camaroo_core::camaroo_regex::compile("cold[0-9]+") != cold);
+}
+
+TEST (pattern_test, matching_in_scripts) {
+    std::string output = run(
+        "for (text line, in split(\"GET /a 200\\nGET /b 500 error\\nPOST /c 503 error\", \"\\n\")) {\n"
+        "    println(regex(line, \"5\\\\d\\\\d error$\"));\n"
+        "}\n"
+        "println(regex(\"abc\", \"^b\"));\n");
+    EXPECT_TRUE(output == "false\ntrue\ntrue\nfalse\n");
+
+    EXPECT_TRUE(run("println(regex(\"a\", \"(a\"));\n").find("Error: regex (a has an unmatched (") != std::string::npos);
+    EXPECT_TRUE(run("println(regex(\"a\", \"ab\\{2,1\\}\"));\n").find("Error: regex ab{2,1} repeats") != std::string::npos);
+    EXPECT_TRUE(run("println(regex(\"a\", \"a^b\"));\n").find("Error: regex a^b can only have ^ and $ at its ends") != std::string::npos);
+}
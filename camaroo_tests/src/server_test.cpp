@@ -0,0 +1,125 @@
+#include <server.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <csignal>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+    int connect_to(const std::string& path) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        path.copy(address.sun_path, path.size());
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    // Everything the server answers fd with until it closes the connection
+    std::string answer(int fd) {
+        std::string text;
+        char buffer[256];
+        ssize_t got;
+        while ((got = ::recv(fd, buffer, sizeof(buffer), 0)) > 0)
+            text.append(buffer, static_cast<size_t>(got));
+        ::close(fd);
+        return text;
+    }
+}
+#endif
+
+TEST (script_cache_test, reusing_compiled_scripts) {
+    camaroo_core::Engine engine;
+    camaroo_core::script_cache cache(engine, 2);
+
+    auto first = cache.get("num a = 1;\n");
+    EXPECT_TRUE(cache.get("num a = 1;\n") == first);
+    EXPECT_TRUE(cache.get("num a = 2;\n") != first);
+    EXPECT_TRUE(cache.size() == 2);
+
+    // "num a = 2;" is now the older one and goes first
+    cache.get("num a = 1;\n");
+    cache.get("num a = 3;\n");
+    EXPECT_TRUE(cache.size() == 2);
+    EXPECT_TRUE(cache.get("num a = 1;\n") == first);
+
+    EXPECT_THROW(cache.get("num = ;\n"), std::runtime_error);
+    EXPECT_TRUE(cache.size() == 2);
+}
+
+TEST (script_cache_test, following_file_changes) {
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "camaroo_script_cache_test";
+    std::filesystem::create_directories(directory / "lib");
+    auto write = [&](const std::string& name, const std::string& text) {
+        std::ofstream(directory / name, std::ios::binary) << text;
+    };
+    write("main.cmr", "use lib/base;\nnum result = base * 2;\n");
+    write("lib/base.cmr", "num base = 3;\n");
+    std::string path = (directory / "main.cmr").string();
+
+    camaroo_core::Engine engine;
+    camaroo_core::script_cache cache(engine, 4);
+    auto first = cache.get_file(path);
+    EXPECT_TRUE(cache.get_file(path) == first);
+    EXPECT_TRUE(first->get_sources().size() == 2);
+
+    // Modules resolve next to the file, not the working directory, and editing one compiles the script again
+    write("lib/base.cmr", "num base = 5;\n");
+    auto second = cache.get_file(path);
+    EXPECT_TRUE(second != first);
+    camaroo_core::Context context(engine);
+    EXPECT_TRUE(engine.run(*second, context));
+    EXPECT_TRUE(std::get<int64_t>(context.get_variable("result")->variable_value) == 10);
+    EXPECT_TRUE(cache.size() == 1);
+
+    std::filesystem::remove_all(directory);
+}
+
+#ifndef _WIN32
+TEST (server_test, dropping_idle_clients_and_stopping) {
+    std::string path = (std::filesystem::temp_directory_path() / "camaroo_server_test.sock").string();
+    camaroo_core::Engine engine;
+    std::future<int> served = std::async(std::launch::async, [&]() {
+        return camaroo_core::serve(path, engine, 1, std::chrono::milliseconds(200));
+    });
+
+    int first = -1;
+    for (int tries = 0; first < 0 && tries < 500; ++tries) {
+        first = connect_to(path);
+        if (first < 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_TRUE(first >= 0);
+    std::string request = "source 15\nprintln(3 + 4);";
+    ::send(first, request.data(), request.size(), 0);
+    EXPECT_TRUE(answer(first) == "o2\n7\nx0\n");
+
+    // The only worker is taken by a client that never sends anything, until it runs out of time
+    int idle = connect_to(path);
+    int waiting = connect_to(path);
+    ::send(waiting, request.data(), request.size(), 0);
+    EXPECT_TRUE(answer(idle).empty());
+    EXPECT_TRUE(answer(waiting) == "o2\n7\nx0\n");
+
+    // The stop lands on whichever thread the process picks, not necessarily the one blocked waiting for clients
+    std::raise(SIGTERM);
+    bool stopped = served.wait_for(std::chrono::seconds(5)) == std::future_status::ready;
+    // A loop that missed the stop only sees it with its next client, one more keeps the test from hanging
+    if (!stopped)
+        ::close(connect_to(path));
+    EXPECT_TRUE(stopped);
+    EXPECT_TRUE(served.get() == 0);
+    EXPECT_FALSE(std::filesystem::exists(path));
+}
+#endif
@@ -0,0 +1,96 @@
+#include <ast_cache.h>
+#include <engine.h>
+#include <sharing.h>
+#include <test_run.h>
+#include <gtest/gtest.h>
+#include <string>
+
+namespace {
+    // Repeats across statements, inside one expression, inside loops that change what they read and inside bodies
+    // the parser skipped, so a value memoised for too long shows up as a wrong total
+    const std::string script =
+        "func twice(num x) -> num {\n"
+        "    return (x * x + 1) + (x * x + 1);\n"
+        "}\n"
+        "gen pairs(num n) -> num {\n"
+        "    for (num i, in (0 to n)) {\n"
+        "        yield (i * 3 - 1) * (i * 3 - 1);\n"
+        "    }\n"
+        "}\n"
+        "num a = 4;\n"
+        "num b = 7;\n"
+        "num first = (a * b + 2) * (a * b + 2);\n"
+        "a = a + 1;\n"
+        "num second = (a * b + 2) - -(a * b + 2);\n"
+        "num total = 0;\n"
+        "for (num i, in (0 to 50)) {\n"
+        "    total = total + (i * b + a) * (i * b + a) + twice(i);\n"
+        "}\n"
+        "for (num p, in pairs(20)) {\n"
+        "    total = total + p + (a * b + 2);\n"
+        "}\n"
+        "println(first);\n"
+        "println(second);\n"
+        "println(total);\n"
+        "println([a, b, a * b] + [a, b, a * b]);\n";
+
+    std::string tree_text(const camaroo_core::Program& program) {
+        std::string text;
+        for (const auto& statement : program.statements)
+            text += statement->to_string() + "\n";
+        return text;
+    }
+
+    size_t count_shared(camaroo_core::ASTNode* node) {
+        if (!node)
+            return 0;
+        size_t found = node->node_kind() == camaroo_core::NodeKind::shared ? 1 : 0;
+        node->visit_expressions([&](std::unique_ptr<camaroo_core::ExpressionNode>& child) { found += count_shared(child.get()); });
+        return found;
+    }
+}
+
+TEST (sharing_test, sharing_repeated_expressions) {
+    for (bool lazy : {false, true}) {
+        camaroo_core::Program plain = camaroo_core::Parser(script, lazy).parse_program();
+        camaroo_core::Program shared = camaroo_core::Parser(script, lazy).parse_program();
+        ASSERT_TRUE(plain.has_compiled && shared.has_compiled);
+
+        size_t removed = camaroo_core::share_subtrees(shared.statements);
+        EXPECT_TRUE(removed > 0);
+        EXPECT_TRUE(tree_text(shared) == tree_text(plain));
+
+        // first, second and the last println hold two copies each, first gets to keep the one second uses
+        EXPECT_TRUE(count_shared(shared.statements[4].get()) == 2);
+        EXPECT_TRUE(count_shared(shared.statements[6].get()) == 2);
+
+        std::string expected = run_apart(plain);
+        EXPECT_TRUE(expected.find("Error") == std::string::npos);
+        EXPECT_TRUE(run_apart(shared) == expected);
+    }
+}
+
+TEST (sharing_test, leaving_calls_alone) {
+    camaroo_core::Program program = camaroo_core::Parser(
+        "channel c = channel(num, 4);\n"
+        "send(c, 1);\nsend(c, 1);\n"
+        "num x = receive(c) + receive(c);\n").parse_program();
+    ASSERT_TRUE(program.has_compiled);
+    EXPECT_TRUE(camaroo_core::share_subtrees(program.statements) == 0);
+    EXPECT_TRUE(run_apart(program).empty());
+}
+
+TEST (sharing_test, sharing_cached_trees) {
+    // Cache files hold the tree as parsed and sharing runs again after every load
+    camaroo_core::Program program = camaroo_core::Parser(script).parse_program();
+    ASSERT_TRUE(program.has_compiled);
+    std::string data = camaroo_core::ast_cache::serialize(program, 1);
+    std::optional<camaroo_core::Program> loaded = camaroo_core::ast_cache::deserialize(data.data(), data.size(), 1);
+    ASSERT_TRUE(loaded.has_value());
+
+    camaroo_core::share_subtrees(program.statements);
+    camaroo_core::share_subtrees(loaded->statements);
+    EXPECT_TRUE(tree_text(*loaded) == tree_text(program));
+    EXPECT_TRUE(run_apart(*loaded) == run_apart(program));
+    EXPECT_THROW(camaroo_core::ast_cache::serialize(program, 1), std::runtime_error);
+}
@@ -0,0 +1,140 @@
+#include <engine.h>
+#include <specialize.h>
+#include <test_run.h>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+
+namespace {
+    bool declares(const camaroo_core::Program& program, const std::string& name) {
+        for (const auto& statement : program.statements)
+            if (statement->node_kind() == camaroo_core::NodeKind::assign && statement->token_type() != camaroo_core::TokenType::equal &&
+                std::get<std::string>(statement->get_left()->token_value()) == name)
+                return true;
+        return false;
+    }
+
+    size_t loops(const camaroo_core::Program& program) {
+        size_t found = 0;
+        for (const auto& statement : program.statements)
+            found += statement->node_kind() == camaroo_core::NodeKind::for_loop ? 1 : 0;
+        return found;
+    }
+}
+
+TEST (specialize_test, specializing_fixed_inputs) {
+    const std::string source =
+        "num width = 2;\n"
+        "fnum scale = 1.5;\n"
+        "toggle loud = false;\n"
+        "text label = \"total\";\n"
+        "num total = 0;\n"
+        "for (num i, in (0 to width)) {\n"
+        "    for (num j, in (0 to width * 2)) {\n"
+        "        total = total + i * width + j;\n"
+        "    }\n"
+        "}\n"
+        "for (num k, in (width to 2)) {\n"
+        "    println(k);\n"
+        "}\n"
+        "println(label);\n"
+        "println(total * scale);\n"
+        "println(loud == true);\n";
+    std::string expected = run(camaroo_core::Parser(
+        "num width = 3;\n"
+        "fnum scale = 0.5;\n"
+        "toggle loud = true;\n"
+        "text label = \"sum\";\n"
+        "num total = 0;\n"
+        "for (num i, in (0 to width)) {\n"
+        "    for (num j, in (0 to width * 2)) {\n"
+        "        total = total + i * width + j;\n"
+        "    }\n"
+        "}\n"
+        "for (num k, in (width to 2)) {\n"
+        "    println(k);\n"
+        "}\n"
+        "println(label);\n"
+        "println(total * scale);\n"
+        "println(loud == true);\n").parse_program());
+
+    camaroo_core::Program program = camaroo_core::Parser(source).parse_program();
+    camaroo_core::specializations fixed = camaroo_core::parse_specializations("width=3,scale=0.5,loud=true,label=sum");
+    // Both loops over width and each inner one, the loop from 3 to 2 never runs
+    EXPECT_TRUE(camaroo_core::specialize(program.statements, fixed) == 4);
+    EXPECT_TRUE(run(program) == expected);
+    EXPECT_TRUE(loops(program) == 0);
+    EXPECT_TRUE(!declares(program, "width") && !declares(program, "scale") && !declares(program, "loud") && !declares(program, "label"));
+    EXPECT_TRUE(declares(program, "total"));
+}
+
+TEST (specialize_test, keeping_what_can_change) {
+    // limit is assigned again, so only its first value is fixed. i is assigned in the body and keeps its
+    // declaration, and the func reading size keeps size declared
+    const std::string source =
+        "num limit = 1;\n"
+        "num size = 2;\n"
+        "func grown(num by) -> num {\n"
+        "    return size + by;\n"
+        "}\n"
+        "limit = limit + 1;\n"
+        "for (num i, in (0 to limit)) {\n"
+        "    println(i);\n"
+        "}\n"
+        "for (num i, in (0 to size)) {\n"
+        "    i = i * 10;\n"
+        "    println(i);\n"
+        "}\n"
+        "for (num i, in (0 to 100)) {\n"
+        "    size = size;\n"
+        "}\n"
+        "println(grown(limit));\n";
+    camaroo_core::Program program = camaroo_core::Parser(source).parse_program();
+    EXPECT_TRUE(camaroo_core::specialize(program.statements, {{"limit", "2"}, {"size", "3"}, {"size", "2"}}) == 0);
+    EXPECT_TRUE(run(program) == "0\n1\n2\n0\n10\n5\n");
+    EXPECT_TRUE(declares(program, "limit") && declares(program, "size"));
+
+    camaroo_core::Program lazy = camaroo_core::Parser(
+        "num size = 2;\n"
+        "func grown(num by) -> num {\n"
+        "    return size + by;\n"
+        "}\n"
+        "for (num i, in (0 to size)) {\n"
+        "    i = i * 10;\n"
+        "    println(i);\n"
+        "}\n"
+        "println(grown(1));\n", true).parse_program();
+    EXPECT_TRUE(camaroo_core::specialize(lazy.statements, {{"size", "3"}}) == 1);
+    EXPECT_TRUE(run(lazy) == "0\n10\n20\n4\n");
+    EXPECT_TRUE(declares(lazy, "size") && loops(lazy) == 0);
+}
+
+TEST (specialize_test, rejecting_what_doesnt_fit) {
+    camaroo_core::specializations pairs = camaroo_core::parse_specializations("a=1,b=x=y,c=");
+    EXPECT_TRUE(pairs == camaroo_core::specializations({{"a", "1"}, {"b", "x=y"}, {"c", ""}}));
+    EXPECT_THROW(camaroo_core::parse_specializations("a=1,b"), std::runtime_error);
+    EXPECT_THROW(camaroo_core::parse_specializations("=1"), std::runtime_error);
+
+    const std::string source =
+        "num n = 1;\n"
+        "list items = [1, 2];\n"
+        "for (num i, in (0 to 2)) {\n"
+        "    num inner = i;\n"
+        "}\n";
+    for (const camaroo_core::specializations& fixed : {camaroo_core::specializations{{"n", "1.5"}},
+                                                       camaroo_core::specializations{{"n", "abc"}},
+                                                       camaroo_core::specializations{{"items", "1"}},
+                                                       camaroo_core::specializations{{"inner", "1"}},
+                                                       camaroo_core::specializations{{"missing", "1"}}}) {
+        camaroo_core::Program program = camaroo_core::Parser(source).parse_program();
+        EXPECT_THROW(camaroo_core::specialize(program.statements, fixed), std::runtime_error);
+    }
+
+    camaroo_core::Engine engine;
+    EXPECT_THROW(engine.compile(source, {{"n", "x"}}), std::runtime_error);
+    std::shared_ptr<const camaroo_core::Script> script = engine.compile("num n = 1;\nprintln(n * 2);\n", {{"n", "21"}});
+    std::ostringstream out;
+    camaroo_core::Context context(engine, out);
+    EXPECT_TRUE(engine.run(*script, context) && engine.run(*script, context));
+    EXPECT_TRUE(out.str() == "42\n42\n");
+}
@@ -0,0 +1,133 @@
+#include <optimize.h>
+#include <strength.h>
+#include <test_run.h>
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    // What the evaluator does for one step on two nums
+    int64_t reference(camaroo_core::TokenType op, int64_t a, int64_t b) {
+        uint64_t x = static_cast<uint64_t>(a), y = static_cast<uint64_t>(b);
+        switch (op) {
+            case camaroo_core::TokenType::add: return static_cast<int64_t>(x + y);
+            case camaroo_core::TokenType::subtract: return static_cast<int64_t>(x - y);
+            case camaroo_core::TokenType::multiply: return static_cast<int64_t>(x * y);
+            case camaroo_core::TokenType::division: return b == -1 ? static_cast<int64_t>(0 - x) : a / b;
+            default: return b == -1 ? 0 : a % b;
+        }
+    }
+
+    camaroo_core::ArithStep step(camaroo_core::TokenType op, const std::string& symbol, int64_t constant, bool constant_left = false) {
+        return camaroo_core::ArithStep{camaroo_core::Token{op, symbol}, camaroo_core::Token{camaroo_core::TokenType::num, std::to_string(constant)}, constant, constant_left};
+    }
+}
+
+TEST (strength_test, dividing_by_constants) {
+    std::mt19937_64 random(2024);
+    std::vector<int64_t> divisors;
+    for (int64_t d = -300; d <= 300; ++d)
+        divisors.push_back(d);
+    for (int shift = 1; shift < 63; ++shift) {
+        int64_t power = int64_t(1) << shift;
+        for (int64_t d : {power - 1, power, power + 1})
+            divisors.insert(divisors.end(), {d, -d});
+    }
+    divisors.insert(divisors.end(), {INT64_MAX, INT64_MIN, INT64_MIN + 1});
+    for (int i = 0; i < 2000; ++i)
+        divisors.push_back(static_cast<int64_t>(random()) >> (random() % 63));
+
+    std::vector<int64_t> values = {0, 1, -1, 2, -2, 7, -7, INT64_MAX, INT64_MIN, INT64_MAX - 1, INT64_MIN + 1};
+    for (int i = 0; i < 200; ++i)
+        values.push_back(static_cast<int64_t>(random()) >> (random() % 63));
+
+    for (int64_t d : divisors) {
+        camaroo_core::IntPlan quotient = camaroo_core::plan_steps({step(camaroo_core::TokenType::division, "/", d)});
+        camaroo_core::IntPlan remainder = camaroo_core::plan_steps({step(camaroo_core::TokenType::modulo, "%", d)});
+        for (int64_t n : values) {
+            if (d == 0) {
+                EXPECT_THROW(quotient.apply(n), std::runtime_error);
+                EXPECT_THROW(remainder.apply(n), std::runtime_error);
+                continue;
+            }
+            ASSERT_TRUE(quotient.apply(n) == reference(camaroo_core::TokenType::division, n, d)) << n << " / " << d;
+            ASSERT_TRUE(remainder.apply(n) == reference(camaroo_core::TokenType::modulo, n, d)) << n << " % " << d;
+        }
+    }
+}
+
+TEST (strength_test, folding_chains) {
+    // Chains of random steps against doing each step on its own
+    std::mt19937_64 random(7);
+    const camaroo_core::TokenType ops[] = {camaroo_core::TokenType::add, camaroo_core::TokenType::subtract, camaroo_core::TokenType::multiply, camaroo_core::TokenType::division, camaroo_core::TokenType::modulo};
+    const char* symbols[] = {"+", "-", "*", "/", "%"};
+    const int64_t constants[] = {0, 1, 2, 3, 5, 7, 8, 10, 16, 100, 1024, 4611686018427387904, 9223372036854775806};
+
+    for (int chain = 0; chain < 20000; ++chain) {
+        std::vector<camaroo_core::ArithStep> steps;
+        size_t length = 1 + random() % 6;
+        for (size_t i = 0; i < length; ++i) {
+            size_t op = random() % 5;
+            int64_t constant = (random() % 4 == 0) ? static_cast<int64_t>(random() >> 1) : constants[random() % 13];
+            bool left = op < 3 && random() % 3 == 0;
+            steps.push_back(step(ops[op], symbols[op], constant, left));
+        }
+        camaroo_core::IntPlan plan = camaroo_core::plan_steps(steps);
+
+        for (int64_t n : {int64_t(0), int64_t(-1), int64_t(12345), INT64_MIN, INT64_MAX, static_cast<int64_t>(random())}) {
+            bool expect_error = false;
+            int64_t expected = n;
+            for (const auto& s : steps) {
+                int64_t a = s.constant_left ? s.value : expected;
+                int64_t b = s.constant_left ? expected : s.value;
+                if ((s.op.type == camaroo_core::TokenType::division || s.op.type == camaroo_core::TokenType::modulo) && b == 0) {
+                    expect_error = true;
+                    break;
+                }
+                expected = reference(s.op.type, a, b);
+            }
+            if (expect_error)
+                EXPECT_THROW(plan.apply(n), std::runtime_error);
+            else
+                ASSERT_TRUE(plan.apply(n) == expected) << "chain " << chain << " on " << n;
+        }
+    }
+}
+
+TEST (strength_test, matching_unoptimized_scripts) {
+    // Random scripts run once as parsed and once after the passes, on nums, fnums, lists and values arithmetic rejects
+    std::mt19937_64 random(99);
+    const char* symbols[] = {"+", "-", "*", "/", "%"};
+    const char* constants[] = {"0", "1", "2", "3", "4", "7", "8", "16", "64", "1000", "4611686018427387904"};
+
+    std::string source;
+    for (int statement = 0; statement < 3000; ++statement) {
+        std::string expression = (random() % 4 == 0) ? "(x + y)" : "x";
+        size_t length = 1 + random() % 5;
+        for (size_t i = 0; i < length; ++i) {
+            size_t op = random() % 5;
+            std::string constant = constants[random() % 11];
+            if (op < 3 && random() % 3 == 0)
+                expression = "(" + constant + " " + symbols[op] + " " + expression + ")";
+            else
+                expression = "(" + expression + " " + symbols[op] + " " + constant + ")";
+        }
+        source += "println(" + expression + ");\n";
+    }
+
+    camaroo_core::Program plain = camaroo_core::Parser(source).parse_program();
+    camaroo_core::Program optimized = camaroo_core::Parser(source).parse_program();
+    ASSERT_TRUE(plain.has_compiled && optimized.has_compiled);
+    EXPECT_TRUE(camaroo_core::reduce_strength(optimized.statements) > 0);
+    camaroo_core::optimize(optimized.statements);
+    for (size_t i = 0; i < plain.statements.size(); ++i)
+        ASSERT_TRUE(plain.statements[i]->to_string() == optimized.statements[i]->to_string());
+
+    for (const char* x : {"num x = 12345;", "num x = 0 - 987654321;", "num x = 9223372036854775806;", "num x = 0;",
+                          "fnum x = 2.75;", "list x = [3, 0 - 8, 17];", "text x = \"a\";", "toggle x = true;"}) {
+        std::string declarations = std::string(x) + "\nnum y = 3;\n";
+        ASSERT_TRUE(run(optimized, declarations, 1) == run(plain, declarations, 1)) << x;
+    }
+}
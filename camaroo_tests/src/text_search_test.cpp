@@ -0,0 +1,64 @@
+#include <simd.h>
+#include <text.h>
+#include <test_run.h>
+#include <gtest/gtest.h>
+#include <string>
+#include <string_view>
+
+TEST (text_search_test, finding_like_string_view) {
+    // Needles that start and end the same way in many places, at every offset and across vector boundaries
+    std::string haystack;
+    for (int i = 0; i < 300; ++i)
+        haystack += (i % 5 ? "ab" : "aXb") + std::to_string(i % 11);
+    haystack += "needle";
+    std::string_view whole(haystack);
+    std::vector<std::string> needles = {"a", "needle", "ab1", "aXb10", "b", "zz", "ab10ab", haystack, haystack + "!"};
+    for (const std::string& needle : needles) {
+        for (size_t start = 0; start < 70; ++start) {
+            std::string_view rest = whole.substr(start);
+            size_t expected = rest.find(needle);
+            if (expected == std::string_view::npos)
+                expected = rest.size();
+            EXPECT_TRUE(camaroo_core::simd::find(rest.data(), rest.size(), needle.data(), needle.size()) == expected);
+        }
+    }
+    EXPECT_TRUE(camaroo_core::simd::find(haystack.data(), haystack.size(), "", 0) == 0);
+}
+
+TEST (text_search_test, slicing_without_copying) {
+    camaroo_core::camaroo_text base(std::string(100, 'x'));
+    for (int i = 0; i < 50; ++i)
+        base = base + camaroo_core::camaroo_text("abcd");
+    std::string expected = base.str();
+
+    camaroo_core::camaroo_text middle = base.slice(90, 120);
+    EXPECT_TRUE(middle.view() == std::string_view(expected).substr(90, 120));
+    EXPECT_TRUE(middle.view().data() == base.view().data() + 90);
+    camaroo_core::camaroo_text inner = middle.slice(10, 40);
+    EXPECT_TRUE(inner.view().data() == base.view().data() + 100);
+    EXPECT_TRUE((inner + base.slice(0, 4)).view() == expected.substr(100, 40) + "xxxx");
+    EXPECT_TRUE(base.slice(295, 100).view() == expected.substr(295));
+    EXPECT_TRUE(base.slice(500, 3).empty());
+}
+
+TEST (text_search_test, searching_in_scripts) {
+    std::string output = run(
+        "text csv = \"name,,price,count\";\n"
+        "num parts = 0;\n"
+        "for (text part, in split(csv, \",\")) {\n"
+        "    println(part);\n"
+        "    parts = parts + 1;\n"
+        "}\n"
+        "println(parts);\n"
+        "println(find(csv, \"price\"));\n"
+        "println(find(csv, \"cost\"));\n"
+        "println(contains(csv, \",,\"));\n"
+        "println(startswith(csv, \"name\"));\n"
+        "println(count(\"aaaaa\", \"aa\"));\n"
+        "println(replace(csv, \",\", \"; \"));\n"
+        "println(\"abc\" < \"abd\");\n");
+    EXPECT_TRUE(output == "name\n\nprice\ncount\n4\n6\n-1\ntrue\ntrue\n2\nname; ; price; count\ntrue\n");
+
+    EXPECT_TRUE(run("println(split(\"a\", \"\"));\n").find("Error: split expects a separator") != std::string::npos);
+    EXPECT_TRUE(run("println(find(1, \"a\"));\n").find("Error: find expects text") != std::string::npos);
+}
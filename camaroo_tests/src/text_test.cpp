@@ -0,0 +1,78 @@
+#include <engine.h>
+#include <text.h>
+#include <type_check.h>
+#include <test_run.h>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST (text_value_test, joining_pieces) {
+    camaroo_core::camaroo_text built;
+    std::string expected;
+    std::vector<camaroo_core::camaroo_text> steps;
+    for (int i = 0; i < 5000; ++i) {
+        std::string piece = "line " + std::to_string(i) + (i % 7 ? "\n" : std::string(200, '-'));
+        built = built + camaroo_core::camaroo_text(piece);
+        expected += piece;
+        if (i % 1000 == 0)
+            steps.push_back(built);
+    }
+    EXPECT_TRUE(built.size() == expected.size());
+    std::ostringstream written;
+    built.write(written);
+    EXPECT_TRUE(written.str() == expected);
+    EXPECT_TRUE(built.view() == expected);
+    EXPECT_TRUE(built == camaroo_core::camaroo_text(expected));
+
+    // Earlier texts keep what they had when later ones were joined onto them
+    for (size_t i = 0; i < steps.size(); ++i)
+        EXPECT_TRUE(expected.compare(0, steps[i].size(), steps[i].view()) == 0);
+
+    camaroo_core::camaroo_text small("short");
+    EXPECT_TRUE((small + camaroo_core::camaroo_text()).view() == "short");
+    EXPECT_TRUE((small + small).view() == "shortshort");
+    EXPECT_TRUE(small.compare(camaroo_core::camaroo_text("shorter")) < 0);
+}
+
+TEST (text_value_test, sharing_between_threads) {
+    camaroo_core::camaroo_text base(std::string(300, 'x'));
+    for (int i = 0; i < 200; ++i)
+        base = base + camaroo_core::camaroo_text("ab");
+    std::string expected = std::string(300, 'x');
+    for (int i = 0; i < 200; ++i)
+        expected += "ab";
+
+    // Every thread joins the same text the first time it's needed and extends it its own way
+    std::vector<std::thread> threads;
+    std::vector<int> matched(8, 0);
+    for (size_t t = 0; t < matched.size(); ++t)
+        threads.emplace_back([&, t]() {
+            camaroo_core::camaroo_text mine = base + camaroo_core::camaroo_text(std::to_string(t));
+            matched[t] = base.view() == expected && mine.view() == expected + std::to_string(t);
+        });
+    for (auto& thread : threads)
+        thread.join();
+    for (int match : matched)
+        EXPECT_TRUE(match == 1);
+}
+
+TEST (text_value_test, joining_in_scripts) {
+    std::string output = run(
+        "text report = \"\";\n"
+        "for (num i, in (0 to 3)) {\n"
+        "    report = report + \"row \" + \"x\";\n"
+        "}\n"
+        "text copy = report;\n"
+        "report = report + \"!\";\n"
+        "println(copy);\n"
+        "println(report);\n"
+        "println(len(report));\n"
+        "println(copy < report);\n");
+    EXPECT_TRUE(output == "row xrow xrow x\nrow xrow xrow x!\n16\ntrue\n");
+
+    camaroo_core::Program program = camaroo_core::Parser("text t = \"a\" + \"b\";\nnum n = \"a\" - \"b\";\n").parse_program();
+    std::vector<std::string> expected = {"Error: arithmetic needs num or fnum operands"};
+    EXPECT_TRUE(camaroo_core::check_types(program.statements) == expected);
+}
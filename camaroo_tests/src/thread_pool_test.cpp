@@ -0,0 +1,47 @@
+#include <thread_pool.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+TEST (thread_pool_test, parallel_for_covers_every_index_once) {
+    camaroo_core::thread_pool pool(4);
+    std::vector<std::atomic<int>> hits(10007);
+    pool.parallel_for(hits.size(), 100, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            ++hits[i];
+    });
+
+    for (const auto& hit : hits)
+        EXPECT_TRUE(hit.load() == 1);
+}
+
+TEST (thread_pool_test, nested_parallel_for_finishes) {
+    camaroo_core::thread_pool pool(3);
+    std::atomic<size_t> total{0};
+    pool.parallel_for(16, 1, [&](size_t, size_t) {
+        pool.parallel_for(1000, 10, [&](size_t begin, size_t end) {
+            total += end - begin;
+        });
+    });
+
+    EXPECT_TRUE(total.load() == 16000);
+}
+
+TEST (thread_pool_test, chunk_errors_reach_the_caller) {
+    camaroo_core::thread_pool pool(4);
+    EXPECT_THROW(pool.parallel_for(1000, 10, [](size_t begin, size_t) {
+        if (begin == 500)
+            throw std::runtime_error("chunk failed");
+    }), std::runtime_error);
+}
+
+TEST (thread_pool_test, submitted_tasks_run_before_wait_idle_returns) {
+    camaroo_core::thread_pool pool(2);
+    std::atomic<int> done{0};
+    for (int i = 0; i < 100; ++i)
+        pool.submit([&]() { ++done; });
+    pool.wait_idle();
+
+    EXPECT_TRUE(done.load() == 100);
+}
@@ -46,7 +46,7 @@ TEST (letter_test, handling_letter_value) {
 
     EXPECT_TRUE(token.has_value() == true);
     EXPECT_TRUE(token.value().type == camaroo_core::TokenType::letter);
-    EXPECT_TRUE(token.value().value == "\'\\n\'");
+    EXPECT_TRUE(token.value().value == "\'\n\'");
 
     token = tokentest.next_token();
     EXPECT_TRUE(token.has_value() == true);
@@ -71,17 +71,17 @@ TEST (letter_test, handling_letter_value) {
     token = tokentest.next_token();
     EXPECT_TRUE(token.has_value() == true);
     EXPECT_TRUE(token.value().type == camaroo_core::TokenType::letter);
-    EXPECT_TRUE(token.value().value == "\'\\\\\'");
+    EXPECT_TRUE(token.value().value == "\'\\\'");
 
     token = tokentest.next_token();
     EXPECT_TRUE(token.has_value() == true);
     EXPECT_TRUE(token.value().type == camaroo_core::TokenType::letter);
-    EXPECT_TRUE(token.value().value == "\'\\\'\'");
+    EXPECT_TRUE(token.value().value == "\'\'\'");
 
     token = tokentest.next_token();
     EXPECT_TRUE(token.has_value() == true);
     EXPECT_TRUE(token.value().type == camaroo_core::TokenType::letter);
-    EXPECT_TRUE(token.value().value == "\'\\\"\'");
+    EXPECT_TRUE(token.value().value == "\'\"\'");
 }
 
 TEST (text_test, handling_text_value) {
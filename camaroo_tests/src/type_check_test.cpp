@@ -0,0 +1,217 @@
+#include <engine.h>
+#include <type_check.h>
+#include <test_run.h>
+#include <gtest/gtest.h>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+    void operand_kinds(camaroo_core::ASTNode* node, std::map<std::string, camaroo_core::TokenType>& kinds) {
+        if (!node)
+            return;
+        if (node->node_kind() == camaroo_core::NodeKind::infix)
+            kinds[node->to_string()] = static_cast<camaroo_core::InfixExpr*>(node)->get_operand_kind();
+        node->visit_expressions([&](std::unique_ptr<camaroo_core::ExpressionNode>& child) {
+            operand_kinds(child.get(), kinds);
+        });
+        switch (node->node_kind()) {
+            case camaroo_core::NodeKind::block:
+                for (const auto& statement : static_cast<camaroo_core::BlockStmnt*>(node)->get_statements())
+                    operand_kinds(statement.get(), kinds);
+                break;
+            case camaroo_core::NodeKind::for_loop:
+                operand_kinds(static_cast<camaroo_core::ForStmnt*>(node)->get_body(), kinds);
+                break;
+            case camaroo_core::NodeKind::function:
+                operand_kinds(static_cast<camaroo_core::FuncStmnt*>(node)->get_definition()->body.get(), kinds);
+                break;
+            default:
+                break;
+        }
+    }
+
+    // Operand kind of every infix expression by how it prints
+    std::map<std::string, camaroo_core::TokenType> operand_kinds(const camaroo_core::Program& program) {
+        std::map<std::string, camaroo_core::TokenType> kinds;
+        for (const auto& statement : program.statements)
+            operand_kinds(statement.get(), kinds);
+        return kinds;
+    }
+}
+
+TEST (type_check_test, reporting_mismatches) {
+    const std::string source =
+        "num a = 1;\n"
+        "text t = \"x\";\n"
+        "num bad = t;\n"
+        "fnum widened = a;\n"
+        "a = 2.5;\n"
+        "println(t * 2);\n"
+        "println(t < true);\n"
+        "for (fnum i, in (0 to 3)) {\n"
+        "    println(i);\n"
+        "}\n"
+        "for (num i, in (0 to t)) {\n"
+        "    println(i);\n"
+        "}\n"
+        "func label(num x, text y) -> text {\n"
+        "    return x;\n"
+        "}\n"
+        "println(label(1));\n"
+        "println(label(t, t));\n"
+        "channel c = channel(num, t);\n";
+    camaroo_core::Program program = camaroo_core::Parser(source).parse_program();
+    ASSERT_TRUE(program.has_compiled);
+
+    std::vector<std::string> expected = {
+        "Error: bad is declared as num but is given text",
+        "Error: a is declared as num but is assigned fnum",
+        "Error: arithmetic needs num or fnum operands",
+        "Error: can't compare values of different types",
+        "Error: loop variable is declared as fnum but the loop goes over num values",
+        "Error: range bounds have to be num",
+        "Error: label returns text but returned num",
+        "Error: label expects 2 argument(s) but found 1",
+        "Error: label expects x to be num but found text",
+        "Error: channel capacity has to be a num of at least 1",
+    };
+    EXPECT_TRUE(camaroo_core::check_types(program.statements) == expected);
+}
+
+TEST (type_check_test, accepting_what_runs) {
+    // Widening, variables given more than one kind, names declared in loops, gens, tasks, reductions and globals
+    // nothing declares
+    const std::string source =
+        "func scale(fnum x, num by) -> fnum {\n"
+        "    fnum result = x * by;\n"
+        "    return result;\n"
+        "}\n"
+        "gen counting(num n) -> num {\n"
+        "    for (num i, in (0 to n)) {\n"
+        "        yield i * i;\n"
+        "    }\n"
+        "}\n"
+        "num total = 0;\n"
+        "fnum mixed = 1;\n"
+        "for (num i, in (0 to 10)) {\n"
+        "    num step = i * 3;\n"
+        "    total = total + step % 7;\n"
+        "    mixed = mixed * 1.5;\n"
+        "}\n"
+        "for (num v, in counting(5)) {\n"
+        "    total = total + v;\n"
+        "}\n"
+        "parallel for (num i, in (0 to 100), reduce + total) {\n"
+        "    total = total + i;\n"
+        "}\n"
+        "println(total);\n"
+        "println(mixed > 2);\n"
+        "println(scale(2, 3));\n"
+        "println(outside + 1);\n"
+        "println([1, 2, 3] * 2);\n";
+    camaroo_core::Program plain = camaroo_core::Parser(source).parse_program();
+    camaroo_core::Program checked = camaroo_core::Parser(source).parse_program();
+    ASSERT_TRUE(plain.has_compiled && checked.has_compiled);
+    EXPECT_TRUE(camaroo_core::check_types(checked.statements).empty());
+    EXPECT_TRUE(run(checked) == run(plain));
+
+    std::map<std::string, camaroo_core::TokenType> kinds = operand_kinds(checked);
+    EXPECT_TRUE(kinds["(ID: i * 3)"] == camaroo_core::TokenType::num);
+    EXPECT_TRUE(kinds["(ID: total + (ID: step % 7))"] == camaroo_core::TokenType::num);
+    EXPECT_TRUE(kinds["(ID: total + ID: i)"] == camaroo_core::TokenType::num);
+    // mixed starts out as a num and becomes an fnum, x * by mixes the two
+    EXPECT_TRUE(kinds["(ID: mixed * 1.5)"] == camaroo_core::TokenType::unknown);
+    EXPECT_TRUE(kinds["(ID: x * ID: by)"] == camaroo_core::TokenType::unknown);
+    EXPECT_TRUE(kinds["(ID: outside + 1)"] == camaroo_core::TokenType::unknown);
+}
+
+TEST (type_check_test, checking_through_the_engine) {
+    camaroo_core::Engine engine;
+    EXPECT_THROW(engine.compile("num a = \"x\";\n"), std::runtime_error);
+
+    // Skipped bodies are checked on their first call, they report the same errors on every call after
+    std::shared_ptr<const camaroo_core::Script> script = engine.compile(
+        "func broken(num x) -> num {\n"
+        "    text s = \"a\";\n"
+        "    return s;\n"
+        "}\n"
+        "func twice(num x) -> num {\n"
+        "    return x * 2;\n"
+        "}\n"
+        "fnum total = offset;\n"
+        "for (num i, in (0 to 4)) {\n"
+        "    total = total + twice(i);\n"
+        "}\n"
+        "println(total);\n"
+        "println(broken(1));\n"
+        "println(broken(2));\n");
+
+    std::ostringstream out, err;
+    camaroo_core::Context context(engine, out, err);
+    context.set_variable("offset", camaroo_core::make_object(camaroo_core::TokenType::fnum, 0.5));
+    EXPECT_TRUE(engine.run(*script, context) == false);
+    EXPECT_TRUE(out.str() == "12.5\n");
+    std::string expected = "Error: func broken doesn't type check\nError: broken returns num but returned text\n";
+    EXPECT_TRUE(err.str() == expected + expected);
+
+    auto broken = static_cast<camaroo_core::FuncStmnt*>(script->get_program().statements[0].get())->get_definition();
+    EXPECT_TRUE(broken->checked && broken->body == nullptr);
+}
+
+TEST (type_check_test, widening_into_fnums) {
+    // A num put in an fnum variable becomes an fnum there, so the division that follows isn't integer division
+    camaroo_core::Engine engine;
+    std::shared_ptr<const camaroo_core::Script> script = engine.compile(
+        "fnum y = 1;\n"
+        "println(y / 2);\n"
+        "y = 3;\n"
+        "println(y / 2);\n"
+        "func half(num x) -> fnum {\n"
+        "    fnum h = x;\n"
+        "    return h / 2;\n"
+        "}\n"
+        "println(half(3));\n"
+        "num n = 5;\n"
+        "println(n / 2);\n");
+
+    std::ostringstream out;
+    camaroo_core::Context context(engine, out, out);
+    EXPECT_TRUE(engine.run(*script, context));
+    EXPECT_TRUE(out.str() == "0.5\n1.5\n1.5\n2\n");
+    EXPECT_TRUE(context.get_variable("y")->variable_type == camaroo_core::TokenType::fnum);
+}
+
+TEST (type_check_test, knowing_what_built_ins_give) {
+    camaroo_core::Engine engine;
+    EXPECT_NO_THROW(engine.compile("num n = len(\"ab\") + count(\"abab\", \"b\") + find(\"ab\", \"b\");\ntoggle t = contains(\"ab\", \"b\");\ntoggle r = regex(\"ab\", \"b\");\n"));
+    EXPECT_THROW(engine.compile("toggle t = len(\"ab\");\n"), std::runtime_error);
+    EXPECT_THROW(engine.compile("num n = startswith(\"ab\", \"a\");\n"), std::runtime_error);
+    EXPECT_THROW(engine.compile("list p = split(\"a b\", \" \");\n"), std::runtime_error);
+    EXPECT_THROW(engine.compile("map m = map(text, num);\ntext t = has(m, \"a\");\n"), std::runtime_error);
+
+    // A func of the program takes the name over from the built-in
+    EXPECT_NO_THROW(engine.compile("func len(text t) -> text {\n    return t;\n}\ntext t = len(\"ab\");\n"));
+}
+
+TEST (type_check_test, keeping_declared_kinds_at_runtime) {
+    // What the checker can't tell before running is checked when the value gets there
+    camaroo_core::Engine engine;
+    auto fails_with = [&](const std::string& source, const std::string& error) {
+        std::ostringstream out, err;
+        camaroo_core::Context context(engine, out, err);
+        return !engine.run(*engine.compile(source), context) && err.str() == error + "\n";
+    };
+    EXPECT_TRUE(fails_with("num x = sum([1.5]);\n", "Error: x is declared as num but is given fnum"));
+    EXPECT_TRUE(fails_with("map m = map(text, text);\nput(m, \"a\", \"b\");\nnum n = get(m, \"a\");\n",
+                           "Error: n is declared as num but is given text"));
+
+    // Later runs in the same context, like lines of the REPL, can't change the kind either
+    std::ostringstream out, err;
+    camaroo_core::Context context(engine, out, err);
+    EXPECT_TRUE(engine.run(*engine.compile("num x = 1;\n"), context));
+    EXPECT_TRUE(engine.run(*engine.compile("x = \"a\";\n"), context) == false);
+    EXPECT_TRUE(err.str() == "Error: x is declared as num but is assigned text\n");
+    EXPECT_TRUE(context.get_variable("x")->variable_type == camaroo_core::TokenType::num);
+}
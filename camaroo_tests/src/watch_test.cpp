@@ -0,0 +1,102 @@
+#include <watch.h>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+
+namespace {
+    camaroo_core::Program parse(const std::string& source) {
+        camaroo_core::Parser parser(source);
+        return parser.parse_program();
+    }
+
+    const std::string script =
+        "func scale(num x) -> num {\n"
+        "    return x * factor;\n"
+        "}\n"
+        "num factor = 2;\n"
+        "num total = 0;\n"
+        "for (num i, in (0 to 100)) {\n"
+        "    total = total + scale(i);\n"
+        "}\n"
+        "num other = 5;\n"
+        "println(total);\n"
+        "println(other);\n";
+}
+
+TEST (watch_test, rerunning_only_what_changed) {
+    camaroo_core::thread_pool pool(1);
+    std::ostringstream out, err;
+    camaroo_core::watch_session session(pool, out, err);
+
+    camaroo_core::Program first = parse(script);
+    EXPECT_TRUE(session.run(first) == 6);
+    EXPECT_TRUE(out.str() == "9900\n5\n");
+
+    // Nothing changed, every result comes from the cache and the output is the same
+    out.str("");
+    camaroo_core::Program same = parse(script);
+    EXPECT_TRUE(session.run(same) == 0);
+    EXPECT_TRUE(out.str() == "9900\n5\n");
+
+    // other only reaches the last println
+    out.str("");
+    std::string edited = script;
+    edited.replace(edited.find("other = 5"), 9, "other = 6");
+    camaroo_core::Program changed_other = parse(edited);
+    EXPECT_TRUE(session.run(changed_other) == 2);
+    EXPECT_TRUE(out.str() == "9900\n6\n");
+
+    // factor is read inside scale, so the loop and the println after it run again
+    out.str("");
+    edited.replace(edited.find("factor = 2"), 10, "factor = 3");
+    camaroo_core::Program changed_factor = parse(edited);
+    EXPECT_TRUE(session.run(changed_factor) == 3);
+    EXPECT_TRUE(out.str() == "14850\n6\n");
+
+    // So does a change to the function itself
+    out.str("");
+    edited.replace(edited.find("x * factor"), 10, "x + factor");
+    camaroo_core::Program changed_function = parse(edited);
+    EXPECT_TRUE(session.run(changed_function) == 2);
+    EXPECT_TRUE(out.str() == "5250\n6\n");
+    EXPECT_TRUE(err.str().empty());
+}
+
+TEST (watch_test, always_running_statements_with_side_effects) {
+    camaroo_core::thread_pool pool(2);
+    std::ostringstream out, err;
+    camaroo_core::watch_session session(pool, out, err);
+
+    std::string source = "num a = 1;\nchannel c = channel(num, 1);\nspawn {\n    send(c, 5);\n}\nprintln(receive(c) + a);\n";
+    camaroo_core::Program first = parse(source);
+    EXPECT_TRUE(session.run(first) == 4);
+    camaroo_core::Program second = parse(source);
+    EXPECT_TRUE(session.run(second) == 3);
+    EXPECT_TRUE(out.str() == "6\n6\n");
+
+    // A statement that failed last time runs again
+    camaroo_core::Program missing = parse("println(nothing);\n");
+    EXPECT_TRUE(session.run(missing) == 1);
+    EXPECT_TRUE(session.run(missing) == 1);
+}
+
+TEST (watch_test, never_keeping_generators) {
+    camaroo_core::thread_pool pool(1);
+    std::ostringstream out, err;
+    camaroo_core::watch_session session(pool, out, err);
+
+    // A list variable can't hold the gen split gives, so the declaration fails every run and no used up
+    // generator is ever put back for the loop
+    std::string source = "list x = split(\"a b\", \" \");\nfor (text p, in x) {\n    println(p);\n}\n";
+    camaroo_core::Program first = parse(source);
+    EXPECT_TRUE(session.run(first) == 2);
+    std::string edited = source;
+    edited.replace(edited.find("println(p)"), 10, "println(p + \"!\")");
+    camaroo_core::Program second = parse(edited);
+    EXPECT_TRUE(session.run(second) == 2);
+    EXPECT_TRUE(out.str().empty());
+
+    std::string rejected = "Error: x is declared as list but is given gen\n";
+    EXPECT_TRUE(err.str().find(rejected) != std::string::npos);
+    EXPECT_TRUE(err.str().find(rejected, err.str().find(rejected) + 1) != std::string::npos);
+}